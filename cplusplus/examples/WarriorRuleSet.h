@@ -49,6 +49,17 @@ public:
         }
     };
 
+    void distributeOverlayRemainder (WeightOverlay& weights, double remainder)
+    {
+        size_t i, count = weights.getCount ();
+        if (count == 0)
+            return;
+
+        double fraction = remainder / float (count);
+        for (i = 0; i < count; i++)
+            weights.setWeight (i, weights.getWeight (i) + fraction);
+    };
+
 protected:
 };
 
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <sstream>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include "dynrules.h"
+
+using namespace dynrules;
+
+/*
+ * Checks, that creating scripts and updating weights does not allocate
+ * any memory, once the containers reached their steady-state size.
+ *
+ * The global allocation functions are replaced, so that any allocation
+ * aborts the program while the trap is enabled.
+ */
+static bool _trap = false;
+static unsigned long _allocations = 0;
+
+static void* _allocate (std::size_t size)
+{
+    void *ptr;
+
+    if (_trap)
+    {
+        fputs ("allocation on the hot path\n", stderr);
+        abort ();
+    }
+    _allocations++;
+    ptr = malloc (size ? size : 1);
+    if (ptr == 0)
+        throw std::bad_alloc ();
+    return ptr;
+}
+
+void* operator new (std::size_t size)
+{
+    return _allocate (size);
+}
+
+void* operator new[] (std::size_t size)
+{
+    return _allocate (size);
+}
+
+void operator delete (void* ptr) noexcept
+{
+    free (ptr);
+}
+
+void operator delete[] (void* ptr) noexcept
+{
+    free (ptr);
+}
+
+void operator delete (void* ptr, std::size_t) noexcept
+{
+    free (ptr);
+}
+
+void operator delete[] (void* ptr, std::size_t) noexcept
+{
+    free (ptr);
+}
+
+class TrapRuleSet : public ShardedRuleSet
+{
+public:
+    TrapRuleSet (ThreadPool* pool) : ShardedRuleSet (0, 20, pool, 64)
+    {
+    }
+
+    double calculateAdjustment (void *fitness)
+    {
+        return *(static_cast<double*>(fitness));
+    }
+};
+
+static void _episode (LearnSystem& lsystem, RuleWeights& weights,
+    std::string& script, unsigned int episode)
+{
+    RuleSet *ruleset = lsystem.getRuleSet ();
+    size_t count = ruleset->getCount ();
+    double fitness = (episode % 3) ? 0.5 : -1.0;
+    unsigned int i;
+
+    script.clear ();
+    lsystem.setOrderByPriority ((episode % 2) != 0);
+    lsystem.appendRules (script, 8);
+    lsystem.appendRules (script, weights, 8);
+    for (i = 0; i < 8; i++)
+    {
+        ruleset->getRule ((episode * 7 + i * 13) % count)->setUsed (true);
+        weights.setUsed ((episode * 5 + i * 11) % count, true);
+    }
+    ruleset->updateWeights (&fitness);
+    weights.updateWeights (&fitness);
+}
+
+int main ()
+{
+    const unsigned int rules = 1000, warmup = 100, episodes = 10000;
+    unsigned int i;
+
+    try
+    {
+        ThreadPool pool (4);
+        TrapRuleSet *ruleset = new TrapRuleSet (&pool);
+        ruleset->reserve (rules);
+        for (i = 0; i < rules; i++)
+        {
+            std::ostringstream code;
+            code << "rule" << i << " ();\n";
+            Rule *rule = new Rule (static_cast<int>(i), code.str (), 10);
+            rule->setPriority (static_cast<int>(i % 7) - 3);
+            ruleset->addRule (rule);
+        }
+
+        LearnSystem lsystem (ruleset);
+        RuleWeights weights (ruleset);
+        std::ostream devnull (0);
+        ReplayLog log (devnull);
+        std::string script;
+
+        lsystem.setSeed (1);
+        lsystem.setReplayLog (&log);
+        script.reserve (lsystem.getMaxScriptSize () * 2);
+
+        for (i = 0; i < warmup; i++)
+            _episode (lsystem, weights, script, i);
+
+        _trap = true;
+        for (i = warmup; i < warmup + episodes; i++)
+            _episode (lsystem, weights, script, i);
+        _trap = false;
+
+#if __cplusplus >= 201703L
+        /*
+         * Scripts can also be created in memory provided by a
+         * std::pmr::memory_resource, which fails instead of falling back
+         * to the heap.
+         */
+        static char buffer[4096];
+        std::pmr::monotonic_buffer_resource resource (buffer, sizeof (buffer),
+            std::pmr::null_memory_resource ());
+        std::pmr::string pmrscript (&resource);
+        pmrscript.reserve (lsystem.getMaxScriptSize ());
+
+        _trap = true;
+        for (i = 0; i < episodes; i++)
+        {
+            pmrscript.clear ();
+            lsystem.appendRules (pmrscript, weights, 8);
+        }
+        _trap = false;
+#endif
+
+        std::cout << "no allocations in " << episodes << " episodes ("
+                  << _allocations << " during setup and warm-up)"
+                  << std::endl;
+        lsystem.setReplayLog (0);
+    }
+    catch (std::exception& e)
+    {
+        std::cout << "an error occured:" << e.what () << std::endl;
+        return 1;
+    }
+    return 0;
+}
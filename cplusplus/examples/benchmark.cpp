@@ -0,0 +1,133 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include "dynrules.h"
+
+using namespace dynrules;
+
+/*
+ * Measures the time needed for creating scripts and updating the weights
+ * of a larger RuleSet, which mainly consists of calls to the accessors of
+ * Rule and RuleSet. Afterwards, the script generation is measured again
+ * on the learned weights with and without RuleSet::setOrderByWeight().
+ *
+ * Usage: benchmark [rules] [episodes]
+ *
+ * Compare the results of a library built via "make" and "make lto".
+ */
+class BenchmarkRuleSet : public RuleSet
+{
+public:
+    BenchmarkRuleSet () : RuleSet (0, 100)
+    {
+    }
+
+    double calculateAdjustment (void *fitness)
+    {
+        return *(static_cast<double*>(fitness));
+    }
+};
+
+typedef std::chrono::steady_clock Clock;
+
+static double _elapsed (Clock::time_point start, unsigned int episodes)
+{
+    std::chrono::duration<double, std::micro> elapsed = Clock::now () - start;
+    return elapsed.count () / episodes;
+}
+
+static double _generate (LearnSystem& lsystem, std::string& script,
+    unsigned int episodes, size_t& length)
+{
+    Clock::time_point start = Clock::now ();
+    unsigned int i;
+
+    for (i = 0; i < episodes; i++)
+    {
+        script.clear ();
+        lsystem.appendRules (script, 20);
+        length += script.size ();
+    }
+    return _elapsed (start, episodes);
+}
+
+static double _update (RuleSet& ruleset, unsigned int episodes)
+{
+    Clock::time_point start = Clock::now ();
+    size_t rules = ruleset.getCount ();
+    unsigned int i, j;
+    double fitness;
+
+    for (i = 0; i < episodes; i++)
+    {
+        for (j = 0; j < 20; j++)
+            ruleset.getRule ((i * 31 + j * 97) % rules)->setUsed (true);
+        fitness = (i % 3) ? 1.0 : -2.0;
+        ruleset.updateWeights (&fitness);
+    }
+    return _elapsed (start, episodes);
+}
+
+int main (int argc, char* argv[])
+{
+    unsigned int rules = 10000, episodes = 2000, i;
+
+    if (argc > 1)
+        rules = static_cast<unsigned int>(atoi (argv[1]));
+    if (argc > 2)
+        episodes = static_cast<unsigned int>(atoi (argv[2]));
+
+    try
+    {
+        BenchmarkRuleSet *ruleset = new BenchmarkRuleSet ();
+        ruleset->reserve (rules);
+        for (i = 0; i < rules; i++)
+        {
+            std::ostringstream code;
+            code << "rule" << i << " ();\n";
+            ruleset->addRule (new Rule (static_cast<int>(i), code.str (), 50));
+        }
+
+        LearnSystem lsystem (ruleset);
+        std::string script;
+        double generate, update, learned, ordered, orderedupdate;
+        uint64_t tail;
+        size_t length = 0, other = 0;
+
+        lsystem.setSeed (1);
+        script.reserve (lsystem.getMaxScriptSize ());
+
+        generate = _generate (lsystem, script, episodes, length);
+        tail = lsystem.getGenerationLatency ().getPercentile (99.9);
+        update = _update (*ruleset, episodes);
+
+        /*
+         * The learned weights differ, so that walking over the rules by
+         * their weight lets the roulette wheel selection stop earlier.
+         */
+        learned = _generate (lsystem, script, episodes, other);
+        ruleset->setOrderByWeight (true);
+        ordered = _generate (lsystem, script, episodes, other);
+        orderedupdate = _update (*ruleset, episodes);
+
+        std::cout << rules << " rules, " << episodes << " episodes"
+                  << std::endl
+                  << "  script generation: " << generate << " us/episode ("
+                  << length << " bytes), p99.9: "
+                  << static_cast<double>(tail) / 1000. << " us" << std::endl
+                  << "  weight update:     " << update << " us/episode"
+                  << std::endl
+                  << "  learned weights:   " << learned << " us/episode"
+                  << std::endl
+                  << "  ordered by weight: " << ordered << " us/episode, "
+                  << orderedupdate << " us/update" << std::endl;
+    }
+    catch (std::exception& e)
+    {
+        std::cout << "an error occured:" << e.what () << std::endl;
+        return 1;
+    }
+    return 0;
+}
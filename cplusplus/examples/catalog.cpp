@@ -0,0 +1,125 @@
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include "dynrules.h"
+
+using namespace dynrules;
+
+/*
+ * Writes a rule catalog, which mixes the text and JSON Lines format, and
+ * measures the time needed to load it with a FileRuleManager on the
+ * calling thread and on a ThreadPool and to stream it in batches from a
+ * FileRuleManager in the STREAM mode. Afterwards the rule code is moved
+ * into a CodeStore to compare the memory needed for it.
+ *
+ * Usage: catalog [rules] [threads]
+ */
+typedef std::chrono::steady_clock Clock;
+
+static const char *_FILENAME = "catalog.rules";
+
+static void _write_catalog (unsigned int rules)
+{
+    std::ofstream fd (_FILENAME, std::ios::out | std::ios::binary);
+    unsigned int i;
+
+    fd << "# dynrules example catalog" << std::endl;
+    for (i = 0; i < rules; i++)
+    {
+        if (i % 4 == 0)
+            fd << "{\"id\": " << i << ", \"weight\": " << (i % 100) + 0.5
+               << ", \"priority\": " << (i % 7) << ", \"code\": "
+               << "\"if enemy.distance < " << i % 10 << ":\\n"
+               << "    attack (\\\"rule" << i << "\\\")\\n\"}\n";
+        else
+            fd << i << '\t' << (i % 100) + 0.25 << '\t'
+               << "if enemy.health > " << i % 50 << ":\\n"
+               << "    flee (\"rule" << i << "\")\\n\n";
+    }
+    if (!fd)
+        throw std::runtime_error ("could not write the catalog");
+}
+
+static double _load (ThreadPool* pool, size_t size, size_t& count)
+{
+    Clock::time_point start = Clock::now ();
+    FileRuleManager manager (_FILENAME, 10, pool);
+    std::chrono::duration<double> elapsed = Clock::now () - start;
+
+    count = manager.getCount ();
+    return static_cast<double>(size) / (1024 * 1024) / elapsed.count ();
+}
+
+static double _stream (ThreadPool* pool, size_t size)
+{
+    Clock::time_point start = Clock::now ();
+    FileRuleManager manager (_FILENAME, 10, pool, FileRuleManager::STREAM);
+    RuleStream stream (&manager, 4096);
+    std::vector<Rule*> batch;
+    size_t i;
+
+    /* The streamed rules are owned by the caller. */
+    while (stream.next (batch))
+    {
+        for (i = 0; i < batch.size (); i++)
+            delete batch[i];
+    }
+    std::chrono::duration<double> elapsed = Clock::now () - start;
+    return static_cast<double>(size) / (1024 * 1024) / elapsed.count ();
+}
+
+int main (int argc, char* argv[])
+{
+    unsigned int rules = 1000000, threads = 4;
+    size_t size, count, i;
+
+    if (argc > 1)
+        rules = static_cast<unsigned int>(atoi (argv[1]));
+    if (argc > 2)
+        threads = static_cast<unsigned int>(atoi (argv[2]));
+
+    try
+    {
+        _write_catalog (rules);
+        std::ifstream fd (_FILENAME, std::ios::in | std::ios::binary);
+        fd.seekg (0, std::ios::end);
+        size = static_cast<size_t>(fd.tellg ());
+
+        ThreadPool pool (threads);
+        double single = _load (0, size, count);
+        double parallel = _load (&pool, size, count);
+        double streamed = _stream (&pool, size);
+
+        std::cout << count << " rules (" << size / 1024 << " kB) loaded"
+                  << std::endl
+                  << "  1 thread:  " << single << " MB/s" << std::endl
+                  << "  " << threads << " threads: " << parallel << " MB/s"
+                  << std::endl
+                  << "  streamed:  " << streamed << " MB/s" << std::endl;
+
+        FileRuleManager manager (_FILENAME, 10, &pool);
+        std::vector<Rule*> loaded = manager.loadRules ();
+        CodeStore store;
+        size_t code = 0;
+
+        std::remove (_FILENAME);
+        for (i = 0; i < loaded.size (); i++)
+            code += loaded[i]->getCode ().capacity ();
+        store.train (loaded);
+        store.addRules (loaded, true);
+        std::cout << "  code:       " << code / 1024 << " kB" << std::endl
+                  << "  compressed: " << store.getMemoryUsage () / 1024
+                  << " kB (" << store.getPhraseCount () << " phrases)"
+                  << std::endl;
+    }
+    catch (std::exception& e)
+    {
+        std::remove (_FILENAME);
+        std::cout << "an error occured:" << e.what () << std::endl;
+        return 1;
+    }
+    return 0;
+}
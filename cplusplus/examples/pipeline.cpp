@@ -0,0 +1,123 @@
+#include <iostream>
+#include <algorithm>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "dynrules.h"
+
+using namespace dynrules;
+
+/*
+ * Runs many concurrent encounters as coroutines on a LearnPipeline. Each
+ * encounter creates a script, evaluates it and learns from the result,
+ * while the weight updates of all encounters finishing within the same
+ * round are applied in one pass.
+ *
+ * This example requires a compiler with C++20 coroutine support.
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+class PipelineRuleSet : public RuleSet
+{
+public:
+    PipelineRuleSet () : RuleSet (0, 100)
+    {
+    }
+
+    double calculateAdjustment (void *fitness)
+    {
+        return (*(static_cast<double*>(fitness)) - 0.5) * 10;
+    }
+};
+
+/*
+ * A simple interpreter, which rewards the rules with an even id and
+ * treats all rules of the script as used.
+ */
+static double _evaluate (const std::string& script, std::vector<size_t>& used)
+{
+    std::istringstream stream (script);
+    std::string line;
+    size_t id, good = 0;
+
+    while (std::getline (stream, line))
+    {
+        id = static_cast<size_t>(std::stoul (line.substr (4)));
+        if (std::find (used.begin (), used.end (), id) == used.end ())
+            used.push_back (id);
+        if (id % 2 == 0)
+            good++;
+    }
+    return used.empty () ? 0 : static_cast<double>(good) /
+        static_cast<double>(used.size ());
+}
+
+static LearnTask _encounter (LearnPipeline& pipeline, unsigned int episodes)
+{
+    unsigned int i;
+
+    for (i = 0; i < episodes; i++)
+    {
+        std::string script = co_await pipeline.generate (8);
+        std::vector<size_t> used;
+        double fitness = _evaluate (script, used);
+        co_await pipeline.update (used, &fitness);
+    }
+}
+
+int main ()
+{
+    const unsigned int rules = 100, encounters = 1000, episodes = 20;
+    unsigned int i;
+
+    try
+    {
+        PipelineRuleSet *ruleset = new PipelineRuleSet ();
+        for (i = 0; i < rules; i++)
+        {
+            std::ostringstream code;
+            code << "rule" << i << "\n";
+            ruleset->addRule (new Rule (static_cast<int>(i), code.str (), 50));
+        }
+
+        LearnSystem lsystem (ruleset);
+        ThreadPool pool (4);
+        LearnPipeline pipeline (&lsystem, &pool);
+        double even = 0, odd = 0;
+        size_t rounds;
+
+        lsystem.setSeed (1);
+        for (i = 0; i < encounters; i++)
+            pipeline.spawn (_encounter (pipeline, episodes));
+        rounds = pipeline.run ();
+
+        for (i = 0; i < rules; i++)
+        {
+            if (i % 2 == 0)
+                even += ruleset->getRule (i)->getWeight ();
+            else
+                odd += ruleset->getRule (i)->getWeight ();
+        }
+        std::cout << encounters * episodes << " encounters learned in "
+                  << rounds << " rounds" << std::endl
+                  << "  weight of the rewarded rules: " << even << std::endl
+                  << "  weight of the other rules:    " << odd << std::endl;
+    }
+    catch (std::exception& e)
+    {
+        std::cout << "an error occured:" << e.what () << std::endl;
+        return 1;
+    }
+    return 0;
+}
+
+#else
+
+int main ()
+{
+    std::cout << "the pipeline example requires C++20 coroutines"
+              << std::endl;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <fstream>
+#include <cstdlib>
+#include <ctime>
+#include "dynrules.h"
+
+using namespace dynrules;
+
+/*
+ * Reconstructs the rule weights of a ReplayLog at a specific episode.
+ *
+ * Usage: replay LOGFILE [EPISODE]
+ *
+ * Without an episode, the whole log is replayed.
+ */
+int main (int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::cerr << "usage: " << argv[0] << " LOGFILE [EPISODE]" << std::endl;
+        return 2;
+    }
+
+    try
+    {
+        std::ifstream stream (argv[1], std::ios::in | std::ios::binary);
+        if (!stream)
+        {
+            std::cerr << "could not open " << argv[1] << std::endl;
+            return 1;
+        }
+
+        Replay replay (stream);
+        clock_t start = clock ();
+        if (argc > 2)
+            replay.seek (strtoul (argv[2], 0, 10));
+        else
+        {
+            while (replay.step ())
+                ;
+        }
+        double elapsed = static_cast<double>(clock () - start) /
+            CLOCKS_PER_SEC;
+
+        const RuleSet& ruleset = replay.getRuleSet ();
+        std::cout << "episode: " << replay.getEpisode () << std::endl;
+        std::cout << "seed: " << replay.getSeed () << std::endl;
+        std::cout << "replayed in " << elapsed << "s" << std::endl;
+        if (replay.isDiverged ())
+            std::cout << "warning: the weights deviate from the logged ones"
+                      << std::endl;
+
+        std::cout << "last script:";
+        const std::vector<int>& script = replay.getScript ();
+        for (size_t i = 0; i < script.size (); i++)
+            std::cout << " " << script[i];
+        std::cout << std::endl;
+
+        std::cout << "total weight: " << ruleset.getWeight () << std::endl;
+        for (size_t i = 0; i < ruleset.getCount (); i++)
+        {
+            Rule *rule = ruleset.getRule (i);
+            std::cout << rule->getId () << "\t" << rule->getWeight ()
+                      << std::endl;
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cout << "an error occured:" << e.what () << std::endl;
+        return 1;
+    }
+    return 0;
+}
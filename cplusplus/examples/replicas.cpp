@@ -0,0 +1,133 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include "dynrules.h"
+
+using namespace dynrules;
+
+/*
+ * Creates scripts on several threads, which are bound to the NUMA nodes
+ * of the system or to simulated nodes, and measures the time needed with
+ * the weights of the Rule objects and with per-node ReplicatedWeights.
+ * The weights are updated and the replicas refreshed between the rounds.
+ *
+ * Usage: replicas [rules] [threads] [nodes]
+ *
+ * nodes defaults to 2, which are simulated, unless the system has 2 NUMA
+ * nodes. If nodes is 0, the NUMA nodes of the system are used.
+ */
+typedef std::chrono::steady_clock Clock;
+
+/* The scripts created by each thread between two weight updates. */
+static const unsigned int _SCRIPTS = 50;
+
+class ReplicasRuleSet : public RuleSet
+{
+public:
+    ReplicasRuleSet () : RuleSet (0, 100)
+    {
+    }
+
+    double calculateAdjustment (void *fitness)
+    {
+        return *(static_cast<double*>(fitness));
+    }
+};
+
+static double _run (LearnSystem& lsystem, ReplicatedWeights& replicas,
+    unsigned int threads, unsigned int rounds)
+{
+    Clock::time_point start = Clock::now ();
+    std::vector<ScriptHandle> handles (threads);
+    unsigned int round, i;
+    double fitness;
+
+    for (round = 0; round < rounds; round++)
+    {
+        std::vector<std::thread> workers;
+
+        for (i = 0; i < threads; i++)
+            workers.push_back (std::thread (
+                [&lsystem, &replicas, &handles, i] ()
+                {
+                    unsigned int script;
+
+                    replicas.bindThread (i % replicas.getNodeCount ());
+                    for (script = 0; script < _SCRIPTS; script++)
+                        lsystem.createRules (handles[i], 20);
+                }));
+        for (i = 0; i < threads; i++)
+            workers[i].join ();
+
+        /* Reward the first rule of the last script of each thread. */
+        for (i = 0; i < threads; i++)
+        {
+            if (handles[i].getSelected ().empty ())
+                continue;
+            handles[i].setUsed (handles[i].getSelected ()[0], true);
+            fitness = (round % 3) ? 1.0 : -2.0;
+            lsystem.updateWeights (handles[i], &fitness);
+        }
+    }
+    std::chrono::duration<double, std::micro> elapsed = Clock::now () - start;
+    return elapsed.count () / (rounds * threads * _SCRIPTS);
+}
+
+int main (int argc, char* argv[])
+{
+    unsigned int rules = 10000, threads = 4, nodes = 2, i;
+
+    if (argc > 1)
+        rules = static_cast<unsigned int>(atoi (argv[1]));
+    if (argc > 2)
+        threads = static_cast<unsigned int>(atoi (argv[2]));
+    if (argc > 3)
+        nodes = static_cast<unsigned int>(atoi (argv[3]));
+
+    try
+    {
+        ReplicasRuleSet *ruleset = new ReplicasRuleSet ();
+        ruleset->reserve (rules);
+        for (i = 0; i < rules; i++)
+        {
+            std::ostringstream code;
+            code << "rule" << i << " ();\n";
+            ruleset->addRule (new Rule (static_cast<int>(i), code.str (),
+                (i % 10) ? 10 : 90));
+        }
+
+        LearnSystem lsystem (ruleset);
+        ReplicatedWeights replicas (ruleset, nodes);
+        lsystem.setSeed (1);
+
+        double shared = _run (lsystem, replicas, threads, 20);
+        lsystem.setReplicatedWeights (&replicas);
+        double replicated = _run (lsystem, replicas, threads, 20);
+
+        std::cout << rules << " rules, " << threads << " threads, "
+                  << replicas.getNodeCount () << " nodes"
+                  << (replicas.isSimulated () ? " (simulated)" : "")
+                  << std::endl
+                  << "  rule weights: " << shared << " us/script"
+                  << std::endl
+                  << "  replicas:     " << replicated << " us/script ("
+                  << replicas.getGeneration () << " refreshes)"
+                  << std::endl;
+
+        for (i = 0; i < replicas.getNodeCount (); i++)
+        {
+            if (replicas.getReplica (i).getWeight () != ruleset->getWeight ())
+                throw std::runtime_error ("replica differs from the RuleSet");
+        }
+    }
+    catch (std::exception& e)
+    {
+        std::cout << "an error occured:" << e.what () << std::endl;
+        return 1;
+    }
+    return 0;
+}
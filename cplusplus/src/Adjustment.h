@@ -0,0 +1,134 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _ADJUSTMENT_H_
+#define _ADJUSTMENT_H_
+
+#include <cstddef>
+#include <vector>
+#include "Rule.h"
+
+namespace dynrules
+{
+    /**
+     * \brief Calculates the compensation for the rules, which were not
+     * used.
+     *
+     * The unused rules share the negated adjustment of the used rules, so
+     * that the total weight is kept.
+     *
+     * \param adjustment The adjustment of each used rule.
+     * \param usedcount The amount of used rules.
+     * \param count The amount of rules, which must be greater than
+     * usedcount.
+     * \return The compensation of each unused rule.
+     */
+    inline double calculateCompensation (double adjustment, size_t usedcount,
+        size_t count)
+    {
+        return (static_cast<double>(-(static_cast<int>(usedcount)) *
+                adjustment)) / static_cast<double>(count - usedcount);
+    }
+
+    /**
+     * \brief Changes the weights of a range of rules and limits them to
+     * the minimum and maximum weight.
+     *
+     * This is the weight update of Pieter Spronck's dynamic scripting
+     * algorithm as explained in Spronck et al: 2005, 'Adaptive Game AI
+     * with Dynamic Scripting'. It is shared by the RuleSet and all weight
+     * storages, so that they calculate the same weights.
+     *
+     * The function object is called in the ascending order of the rules
+     * and has to provide the following methods:
+     *
+     * \code
+     *   double get (size_t index);     // the current weight
+     *   double change (size_t index);  // the adjustment or compensation
+     *   double store (size_t index, double weight);
+     * \endcode
+     *
+     * store() receives the limited weight and returns the weight, which
+     * was actually stored.
+     *
+     * \param weights The function object accessing the weights.
+     * \param begin The index of the first rule.
+     * \param end The index after the last rule.
+     * \param minweight The minimum weight.
+     * \param maxweight The maximum weight.
+     * \param remainder The weight differences cut off by the limits are
+     * added to it.
+     * \return The sum of the stored weights.
+     */
+    template <typename Weights>
+    double adjustWeights (Weights& weights, size_t begin, size_t end,
+        double minweight, double maxweight, double& remainder)
+    {
+        size_t i;
+        double weight, total = 0;
+
+        for (i = begin; i < end; i++)
+        {
+            weight = weights.get (i) + weights.change (i);
+
+            if (weight < minweight)
+            {
+                remainder += (weight - minweight);
+                weight = minweight;
+            }
+            else if (weight > maxweight)
+            {
+                remainder += (weight - maxweight);
+                weight = maxweight;
+            }
+            total += weights.store (i, weight);
+        }
+        return total;
+    }
+
+    /**
+     * \brief Accesses the weights of Rule objects for adjustWeights(),
+     * which are changed based on their usage states.
+     */
+    struct RuleAdjustment
+    {
+        /**
+         * \brief The Rule objects to change.
+         */
+        const std::vector<Rule*> *rules;
+
+        /**
+         * \brief The adjustment of the used rules.
+         */
+        double adjustment;
+
+        /**
+         * \brief The compensation of the unused rules.
+         */
+        double compensation;
+
+        double get (size_t index) const
+        {
+            return (*rules)[index]->getWeight ();
+        }
+
+        double change (size_t index) const
+        {
+            return (*rules)[index]->getUsed () ? adjustment : compensation;
+        }
+
+        double store (size_t index, double weight) const
+        {
+            (*rules)[index]->setWeight (weight);
+            return weight;
+        }
+    };
+
+} // namespace
+
+#endif /* _ADJUSTMENT_H_ */
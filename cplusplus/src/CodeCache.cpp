@@ -0,0 +1,99 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include "CodeCache.h"
+
+namespace dynrules
+{
+
+CodeCache::CodeCache (RuleManager* manager, size_t maxsize) :
+    _manager(manager),
+    _maxsize(maxsize),
+    _size(0),
+    _hits(0),
+    _misses(0),
+    _entries(),
+    _index()
+{
+    if (manager == 0)
+        throw std::invalid_argument ("manager must not be NULL");
+}
+
+CodeCache::~CodeCache ()
+{
+}
+
+const std::string& CodeCache::getCode (int id)
+{
+    std::map<int, std::list<Entry>::iterator>::iterator iter;
+    Entry entry;
+
+    iter = this->_index.find (id);
+    if (iter != this->_index.end ())
+    {
+        this->_hits++;
+        this->_entries.splice (this->_entries.begin (), this->_entries,
+            iter->second);
+        return iter->second->code;
+    }
+
+    this->_misses++;
+    entry.id = id;
+    entry.code = this->_manager->loadCode (id);
+    this->_entries.push_front (entry);
+    this->_index[id] = this->_entries.begin ();
+    this->_size += entry.code.size ();
+    this->shrink ();
+    return this->_entries.front ().code;
+}
+
+void CodeCache::shrink ()
+{
+    while (this->_size > this->_maxsize && this->_entries.size () > 1)
+    {
+        this->_size -= this->_entries.back ().code.size ();
+        this->_index.erase (this->_entries.back ().id);
+        this->_entries.pop_back ();
+    }
+}
+
+void CodeCache::clear ()
+{
+    this->_entries.clear ();
+    this->_index.clear ();
+    this->_size = 0;
+}
+
+size_t CodeCache::getMaxSize () const
+{
+    return this->_maxsize;
+}
+
+void CodeCache::setMaxSize (size_t maxsize)
+{
+    this->_maxsize = maxsize;
+    this->shrink ();
+}
+
+size_t CodeCache::getSize () const
+{
+    return this->_size;
+}
+
+unsigned long CodeCache::getHits () const
+{
+    return this->_hits;
+}
+
+unsigned long CodeCache::getMisses () const
+{
+    return this->_misses;
+}
+
+} // namespace
@@ -0,0 +1,185 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _CODECACHE_H_
+#define _CODECACHE_H_
+
+#include <list>
+#include <map>
+#include <string>
+#include "RuleManager.h"
+
+namespace dynrules
+{
+    /**
+     * \brief A least-recently-used cache for rule code.
+     *
+     * CodeCache loads the code of rules on demand from a RuleManager using
+     * RuleManager::loadCode() and keeps the most recently used code in
+     * memory, up to a maximum amount of bytes.
+     *
+     * This allows the Rule objects within a RuleSet to be kept without any
+     * code, so that only their id, weight and usage state need to be held
+     * in memory. If a LearnSystem uses a CodeCache, the code of the
+     * selected rules is taken from the CodeCache instead of the Rule
+     * objects.
+     *
+     * The CodeCache only saves memory, if the RuleManager does not keep
+     * the code itself, like a FileRuleManager in the STREAM mode, which
+     * parses the code of a rule from the catalog file on each
+     * RuleManager::loadCode() call. MMapRuleManager and a FileRuleManager
+     * in the PRELOAD mode keep all code in memory.
+     *
+     * The CodeCache is not thread-safe.
+     */
+    class CodeCache
+    {
+    public:
+        /**
+         * \brief Creates a new CodeCache instance.
+         *
+         * \param manager The RuleManager to load the code from.
+         * \param maxsize The maximum amount of bytes to keep in memory.
+         * \exception invalid_argument Thrown, if manager is NULL.
+         */
+        CodeCache (RuleManager* manager, size_t maxsize);
+
+        /**
+         * \brief Destroys the CodeCache.
+         */
+        virtual ~CodeCache ();
+
+        /**
+         * \brief Gets the code of a specific rule.
+         *
+         * Gets the code of the rule from the cache or loads it from the
+         * RuleManager, if it is not cached yet. In the latter case, the
+         * least recently used code will be removed from the cache, if the
+         * maximum size is exceeded.
+         *
+         * \param id The id of the rule.
+         * \return The code of the rule. The reference is valid until the
+         * next call to getCode() or clear().
+         */
+        const std::string& getCode (int id);
+
+        /**
+         * \brief Removes all code from the cache.
+         */
+        void clear ();
+
+        /**
+         * \brief Gets the maximum amount of bytes to keep in memory.
+         *
+         * \return The maximum amount of bytes to keep in memory.
+         */
+        size_t getMaxSize () const;
+
+        /**
+         * \brief Sets the maximum amount of bytes to keep in memory.
+         *
+         * \param maxsize The maximum amount of bytes to keep in memory.
+         */
+        void setMaxSize (size_t maxsize);
+
+        /**
+         * \brief Gets the amount of bytes currently kept in memory.
+         *
+         * \return The amount of bytes currently kept in memory.
+         */
+        size_t getSize () const;
+
+        /**
+         * \brief Gets the amount of getCode() calls, which were served from
+         * the cache.
+         *
+         * \return The amount of cache hits.
+         */
+        unsigned long getHits () const;
+
+        /**
+         * \brief Gets the amount of getCode() calls, which required the
+         * code to be loaded from the RuleManager.
+         *
+         * \return The amount of cache misses.
+         */
+        unsigned long getMisses () const;
+
+    protected:
+
+        /**
+         * \brief A cached code entry.
+         */
+        struct Entry
+        {
+            Entry () : id(0), code()
+            {
+            }
+
+            /**
+             * \brief The id of the rule.
+             */
+            int id;
+
+            /**
+             * \brief The code of the rule.
+             */
+            std::string code;
+        };
+
+        /**
+         * \brief Removes the least recently used code, until the maximum
+         * size is not exceeded anymore.
+         *
+         * The most recently used code is always kept.
+         */
+        void shrink ();
+
+        /**
+         * \brief The RuleManager to load the code from.
+         */
+        RuleManager* _manager;
+
+        /**
+         * \brief The maximum amount of bytes to keep in memory.
+         */
+        size_t _maxsize;
+
+        /**
+         * \brief The amount of bytes currently kept in memory.
+         */
+        size_t _size;
+
+        /**
+         * \brief The amount of cache hits.
+         */
+        unsigned long _hits;
+
+        /**
+         * \brief The amount of cache misses.
+         */
+        unsigned long _misses;
+
+        /**
+         * \brief The cached code, most recently used first.
+         */
+        std::list<Entry> _entries;
+
+        /**
+         * \brief The position of the cached code for each rule id.
+         */
+        std::map<int, std::list<Entry>::iterator> _index;
+
+    private:
+        CodeCache (const CodeCache&);
+        CodeCache& operator= (const CodeCache&);
+    };
+
+} // namespace
+
+#endif /* _CODECACHE_H_ */
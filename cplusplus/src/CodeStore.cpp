@@ -0,0 +1,423 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include "CodeStore.h"
+
+namespace dynrules
+{
+
+/*
+ * The offset of the entries of ids, for which no code is stored.
+ */
+static const uint32_t _NONE = 0xffffffffu;
+
+/*
+ * The maximum amount of tokens and bytes of a trained phrase.
+ */
+static const size_t _MAXTOKENS = 8;
+static const size_t _MAXPHRASE = 64;
+
+/*
+ * A phrase considered for the dictionary.
+ */
+struct _Candidate
+{
+    const std::string *phrase;
+    size_t score;
+
+    bool operator< (const _Candidate& candidate) const
+    {
+        if (this->score != candidate.score)
+            return this->score > candidate.score;
+        return *this->phrase < *candidate.phrase;
+    }
+};
+
+static bool _is_word (char c)
+{
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+/*
+ * Gets the end of the token, which starts at pos. Tokens are words, runs
+ * of the same whitespace or single other characters including digits, so
+ * that phrases can contain the common parts of numbers.
+ */
+static size_t _token_end (const std::string& code, size_t pos)
+{
+    char first = code[pos++];
+
+    if (_is_word (first))
+    {
+        while (pos < code.size () && _is_word (code[pos]))
+            pos++;
+    }
+    else if (first == ' ' || first == '\t')
+    {
+        while (pos < code.size () && code[pos] == first)
+            pos++;
+    }
+    return pos;
+}
+
+/*
+ * Builds the trie for the phrases sorted[lo, hi), which share their first
+ * depth bytes, and returns its root node.
+ */
+template <typename Node, typename Edge>
+static uint32_t _build_trie (const std::vector<std::string>& phrases,
+    const std::vector<uint32_t>& sorted, size_t lo, size_t hi, size_t depth,
+    std::vector<Node>& nodes, std::vector<Edge>& edges)
+{
+    uint32_t node = static_cast<uint32_t>(nodes.size ());
+    std::vector<Edge> children;
+    size_t end;
+
+    nodes.push_back (Node ());
+    nodes[node].phrase = -1;
+    if (lo < hi && phrases[sorted[lo]].size () == depth)
+        nodes[node].phrase = static_cast<int32_t>(sorted[lo++]);
+
+    while (lo < hi)
+    {
+        Edge edge;
+        edge.byte = static_cast<unsigned char>(phrases[sorted[lo]][depth]);
+        for (end = lo + 1; end < hi; end++)
+        {
+            if (static_cast<unsigned char>(phrases[sorted[end]][depth]) !=
+                edge.byte)
+                break;
+        }
+        edge.node = _build_trie (phrases, sorted, lo, end, depth + 1,
+            nodes, edges);
+        children.push_back (edge);
+        lo = end;
+    }
+
+    nodes[node].edges = static_cast<uint32_t>(edges.size ());
+    nodes[node].count = static_cast<uint32_t>(children.size ());
+    edges.insert (edges.end (), children.begin (), children.end ());
+    return node;
+}
+
+CodeStore::CodeStore () :
+    _phrases(),
+    _offsets(),
+    _nodes(),
+    _edges(),
+    _data(),
+    _entries(),
+    _count(0),
+    _codesize(0)
+{
+    std::vector<std::string> phrases;
+    int i;
+
+    for (i = 0; i < 256; i++)
+        phrases.push_back (std::string (1, static_cast<char>(i)));
+    this->setPhrases (phrases);
+}
+
+CodeStore::~CodeStore ()
+{
+}
+
+void CodeStore::train (const std::vector<Rule*>& rules, size_t maxphrases,
+    size_t samplesize)
+{
+    std::unordered_map<std::string, size_t> counts;
+    std::unordered_map<std::string, size_t>::const_iterator iter;
+    std::vector<const std::string*> sample;
+    std::vector<_Candidate> candidates;
+    std::vector<std::string> phrases;
+    std::vector<size_t> bounds, usage;
+    std::vector<uint32_t> order;
+    std::vector<unsigned char> encoded;
+    size_t i, j, n, total = 0, sampled = 0;
+
+    if (maxphrases < 256 || maxphrases > 32768)
+        throw std::invalid_argument
+            ("maxphrases must be in the range [256, 32768]");
+
+    /*
+     * Take random rules, if there is too much code, since rules with
+     * regular patterns within the catalog would be missed by a fixed
+     * step. The fixed seed keeps the dictionary reproducible.
+     */
+    for (i = 0; i < rules.size (); i++)
+        total += rules[i]->getCode ().size ();
+    if (total <= samplesize)
+    {
+        for (i = 0; i < rules.size (); i++)
+            sample.push_back (&rules[i]->getCode ());
+    }
+    else
+    {
+        std::mt19937 random (1);
+        for (i = 0; i < rules.size () && sampled < samplesize; i++)
+        {
+            const std::string& code =
+                rules[random () % rules.size ()]->getCode ();
+            sample.push_back (&code);
+            sampled += code.size ();
+        }
+    }
+
+    /* Count all phrases of up to _MAXTOKENS tokens. */
+    for (i = 0; i < sample.size (); i++)
+    {
+        const std::string& code = *sample[i];
+
+        bounds.clear ();
+        for (j = 0; j < code.size (); j = _token_end (code, j))
+            bounds.push_back (j);
+        bounds.push_back (code.size ());
+
+        for (j = 0; j + 1 < bounds.size (); j++)
+        {
+            for (n = 1; n <= _MAXTOKENS && j + n < bounds.size (); n++)
+            {
+                size_t len = bounds[j + n] - bounds[j];
+                if (len > _MAXPHRASE)
+                    break;
+                if (len > 1)
+                    counts[code.substr (bounds[j], len)]++;
+            }
+        }
+    }
+
+    /*
+     * Each use of a phrase saves its length minus the byte of its code,
+     * while the dictionary keeps it once.
+     */
+    for (iter = counts.begin (); iter != counts.end (); iter++)
+    {
+        size_t len = iter->first.size ();
+        if (iter->second < 2 || iter->second * (len - 1) <= len)
+            continue;
+        _Candidate candidate = { &iter->first, iter->second * (len - 1) - len };
+        candidates.push_back (candidate);
+    }
+    n = std::min (candidates.size (), maxphrases - 256);
+    std::partial_sort (candidates.begin (), candidates.begin () + n,
+        candidates.end ());
+
+    for (i = 0; i < 256; i++)
+        phrases.push_back (std::string (1, static_cast<char>(i)));
+    for (i = 0; i < n; i++)
+        phrases.push_back (*candidates[i].phrase);
+    this->setPhrases (phrases);
+    this->clear ();
+
+    /*
+     * Compress the sample to find the phrases actually used by the
+     * longest matches and give the most used phrases the shortest codes.
+     * Unused phrases are kept, since they can still match the rules,
+     * which are not within the sample.
+     */
+    usage.resize (phrases.size ());
+    for (i = 0; i < sample.size (); i++)
+    {
+        encoded.clear ();
+        this->encode (sample[i]->data (), sample[i]->size (), encoded, &usage);
+    }
+    for (i = 0; i < phrases.size (); i++)
+        order.push_back (static_cast<uint32_t>(i));
+    std::stable_sort (order.begin (), order.end (),
+        [&usage] (uint32_t a, uint32_t b) { return usage[a] > usage[b]; });
+
+    std::vector<std::string> used;
+    for (i = 0; i < order.size (); i++)
+        used.push_back (phrases[order[i]]);
+    this->setPhrases (used);
+}
+
+void CodeStore::setPhrases (const std::vector<std::string>& phrases)
+{
+    std::vector<uint32_t> sorted;
+    size_t i;
+
+    this->_phrases.clear ();
+    this->_offsets.clear ();
+    for (i = 0; i < phrases.size (); i++)
+    {
+        this->_offsets.push_back (
+            static_cast<uint32_t>(this->_phrases.size ()));
+        this->_phrases += phrases[i];
+        sorted.push_back (static_cast<uint32_t>(i));
+    }
+    this->_offsets.push_back (static_cast<uint32_t>(this->_phrases.size ()));
+    this->_phrases.shrink_to_fit ();
+
+    std::sort (sorted.begin (), sorted.end (),
+        [&phrases] (uint32_t a, uint32_t b)
+        { return phrases[a] < phrases[b]; });
+    this->_nodes.clear ();
+    this->_edges.clear ();
+    _build_trie (phrases, sorted, 0, sorted.size (), 0, this->_nodes,
+        this->_edges);
+    this->_nodes.shrink_to_fit ();
+    this->_edges.shrink_to_fit ();
+}
+
+void CodeStore::encode (const char* code, size_t size,
+    std::vector<unsigned char>& out, std::vector<size_t>* usage) const
+{
+    const Node *nodes = this->_nodes.data ();
+    const Edge *edges = this->_edges.data ();
+    size_t pos = 0, i, length;
+    int32_t phrase;
+    uint32_t node;
+
+    while (pos < size)
+    {
+        /* Find the longest phrase. All single bytes are phrases. */
+        node = 0;
+        phrase = -1;
+        length = 0;
+        for (i = pos; i < size; i++)
+        {
+            const Edge *first = edges + nodes[node].edges;
+            const Edge *last = first + nodes[node].count;
+            unsigned char byte = static_cast<unsigned char>(code[i]);
+
+            first = std::lower_bound (first, last, byte,
+                [] (const Edge& edge, unsigned char value)
+                { return edge.byte < value; });
+            if (first == last || first->byte != byte)
+                break;
+            node = first->node;
+            if (nodes[node].phrase >= 0)
+            {
+                phrase = nodes[node].phrase;
+                length = i + 1 - pos;
+            }
+        }
+
+        if (phrase < 0x80)
+            out.push_back (static_cast<unsigned char>(phrase));
+        else
+        {
+            out.push_back (static_cast<unsigned char>(0x80 | (phrase >> 8)));
+            out.push_back (static_cast<unsigned char>(phrase & 0xff));
+        }
+        if (usage != 0)
+            (*usage)[static_cast<size_t>(phrase)]++;
+        pos += length;
+    }
+}
+
+void CodeStore::addCode (int id, const std::string& code)
+{
+    size_t offset = this->_data.size (), index;
+
+    if (id < 0)
+        throw std::invalid_argument ("id must not be negative");
+
+    index = static_cast<size_t>(id);
+    if (index >= this->_entries.size ())
+    {
+        Entry empty = { _NONE, 0 };
+        this->_entries.resize (index + 1, empty);
+    }
+
+    this->encode (code.data (), code.size (), this->_data, 0);
+    if (offset >= _NONE || code.size () > 0xffffffffu)
+    {
+        this->_data.resize (offset);
+        throw std::length_error ("the code exceeds the size of the CodeStore");
+    }
+    Entry& entry = this->_entries[index];
+    if (entry.offset == _NONE)
+        this->_count++;
+    else
+        this->_codesize -= entry.length;
+    entry.offset = static_cast<uint32_t>(offset);
+    entry.length = static_cast<uint32_t>(code.size ());
+    this->_codesize += code.size ();
+}
+
+void CodeStore::addRules (const std::vector<Rule*>& rules, bool release)
+{
+    std::vector<Rule*>::const_iterator iter;
+
+    for (iter = rules.begin (); iter != rules.end (); iter++)
+    {
+        this->addCode ((*iter)->getId (), (*iter)->getCode ());
+        if (release)
+            (*iter)->setCode ("");
+    }
+    this->_data.shrink_to_fit ();
+    this->_entries.shrink_to_fit ();
+}
+
+const CodeStore::Entry& CodeStore::getEntry (int id) const
+{
+    if (id < 0 || static_cast<size_t>(id) >= this->_entries.size () ||
+        this->_entries[static_cast<size_t>(id)].offset == _NONE)
+        throw std::out_of_range ("no code stored for such an id");
+    return this->_entries[static_cast<size_t>(id)];
+}
+
+bool CodeStore::contains (int id) const
+{
+    return id >= 0 && static_cast<size_t>(id) < this->_entries.size () &&
+        this->_entries[static_cast<size_t>(id)].offset != _NONE;
+}
+
+size_t CodeStore::getLength (int id) const
+{
+    return this->getEntry (id).length;
+}
+
+std::string CodeStore::getCode (int id) const
+{
+    std::string code;
+
+    code.reserve (this->getEntry (id).length);
+    this->appendCode (code, id);
+    return code;
+}
+
+void CodeStore::clear ()
+{
+    std::vector<unsigned char> ().swap (this->_data);
+    std::vector<Entry> ().swap (this->_entries);
+    this->_count = 0;
+    this->_codesize = 0;
+}
+
+size_t CodeStore::getCount () const
+{
+    return this->_count;
+}
+
+size_t CodeStore::getPhraseCount () const
+{
+    return this->_offsets.size () - 1;
+}
+
+size_t CodeStore::getCodeSize () const
+{
+    return this->_codesize;
+}
+
+size_t CodeStore::getMemoryUsage () const
+{
+    return sizeof (CodeStore) + this->_phrases.capacity () +
+        this->_offsets.capacity () * sizeof (uint32_t) +
+        this->_nodes.capacity () * sizeof (Node) +
+        this->_edges.capacity () * sizeof (Edge) +
+        this->_data.capacity () +
+        this->_entries.capacity () * sizeof (Entry);
+}
+
+} // namespace
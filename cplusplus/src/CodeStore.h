@@ -0,0 +1,332 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _CODESTORE_H_
+#define _CODESTORE_H_
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "Rule.h"
+
+namespace dynrules
+{
+    /**
+     * \brief A compressed, in-memory store for rule code.
+     *
+     * The code of rules within a catalog usually consists of few, often
+     * repeated fragments, such as the same conditions and actions with
+     * different values. CodeStore keeps the code of rules compressed with
+     * a dictionary of such phrases, which is shared by all rules. Each
+     * rule is stored as a sequence of phrase codes, which take one byte
+     * for the 128 most frequently used phrases and two bytes for the
+     * others.
+     *
+     * The dictionary is trained on a sample of the rules via train().
+     * Without training, it only consists of the single bytes, so that any
+     * code can be stored, but is not compressed.
+     *
+     * If a LearnSystem uses a CodeStore, the code of the selected rules is
+     * decompressed directly into the created scripts. The Rule objects can
+     * then be kept without any code, see addRules().
+     *
+     * The CodeStore can be read by multiple threads at once, as long as
+     * it is not changed.
+     */
+    class CodeStore
+    {
+    public:
+        /**
+         * \brief Creates a new, empty CodeStore, which does not compress
+         * the code.
+         */
+        CodeStore ();
+
+        /**
+         * \brief Destroys the CodeStore.
+         */
+        virtual ~CodeStore ();
+
+        /**
+         * \brief Trains the dictionary on the code of a set of rules.
+         *
+         * Collects the phrases, which consist of up to a few tokens
+         * (words, numbers, runs of whitespace or single characters) and
+         * occur most frequently within the code of the rules, and uses
+         * the maxphrases most worthwhile ones as dictionary. If the code
+         * of the rules exceeds samplesize bytes, only randomly chosen
+         * rules with about samplesize bytes of code are used.
+         *
+         * All code stored so far is removed.
+         *
+         * \param rules The rules to train the dictionary on.
+         * \param maxphrases The maximum amount of phrases, including the
+         * 256 single bytes.
+         * \param samplesize The maximum amount of code bytes to train on.
+         * \exception invalid_argument Thrown, if maxphrases is smaller
+         * than 256 or greater than 32768.
+         */
+        void train (const std::vector<Rule*>& rules,
+            size_t maxphrases = 4096, size_t samplesize = 1 << 20);
+
+        /**
+         * \brief Stores the code of a rule.
+         *
+         * If code is already stored for the id, it will be replaced.
+         * The memory of the replaced code is only released by clear().
+         *
+         * \param id The id of the rule. The code is kept in a table indexed
+         * by the id, so the ids should be small, like the line numbers of
+         * a catalog.
+         * \param code The code to store.
+         * \exception invalid_argument Thrown, if id is negative.
+         * \exception length_error Thrown, if the compressed code of all
+         * rules would exceed 4 GiB.
+         */
+        void addCode (int id, const std::string& code);
+
+        /**
+         * \brief Stores the code of a set of rules.
+         *
+         * \param rules The rules to store the code of.
+         * \param release Indicates, whether the code of the Rule objects
+         * shall be released after storing it.
+         * \exception invalid_argument Thrown, if the id of a rule is
+         * negative.
+         */
+        void addRules (const std::vector<Rule*>& rules, bool release);
+
+        /**
+         * \brief Checks, whether code is stored for a specific rule.
+         *
+         * \param id The id of the rule.
+         * \return true, if code is stored for the rule, false otherwise.
+         */
+        bool contains (int id) const;
+
+        /**
+         * \brief Gets the length of the uncompressed code of a rule.
+         *
+         * \param id The id of the rule.
+         * \return The length of the code in bytes.
+         * \exception out_of_range Thrown, if no code is stored for the id.
+         */
+        size_t getLength (int id) const;
+
+        /**
+         * \brief Gets the uncompressed code of a rule.
+         *
+         * \param id The id of the rule.
+         * \return The code of the rule.
+         * \exception out_of_range Thrown, if no code is stored for the id.
+         */
+        std::string getCode (int id) const;
+
+        /**
+         * \brief Appends the uncompressed code of a rule to a string.
+         *
+         * \param script The std::string or std::pmr::string to append the
+         * code to.
+         * \param id The id of the rule.
+         * \exception out_of_range Thrown, if no code is stored for the id.
+         */
+        template <typename String>
+        void appendCode (String& script, int id) const;
+
+        /**
+         * \brief Removes all code, but keeps the dictionary.
+         */
+        void clear ();
+
+        /**
+         * \brief Gets the amount of rules, for which code is stored.
+         *
+         * \return The amount of rules.
+         */
+        size_t getCount () const;
+
+        /**
+         * \brief Gets the amount of phrases within the dictionary.
+         *
+         * \return The amount of phrases.
+         */
+        size_t getPhraseCount () const;
+
+        /**
+         * \brief Gets the amount of uncompressed code bytes stored.
+         *
+         * \return The amount of uncompressed bytes.
+         */
+        size_t getCodeSize () const;
+
+        /**
+         * \brief Gets the amount of memory used by the CodeStore, including
+         * the dictionary.
+         *
+         * \return The amount of bytes used.
+         */
+        size_t getMemoryUsage () const;
+
+    protected:
+
+        /**
+         * \brief The position of the compressed code of a rule.
+         */
+        struct Entry
+        {
+            /**
+             * \brief The offset of the compressed code within the data.
+             */
+            uint32_t offset;
+
+            /**
+             * \brief The length of the uncompressed code in bytes.
+             */
+            uint32_t length;
+        };
+
+        /**
+         * \brief A node of the trie for finding the longest phrase.
+         */
+        struct Node
+        {
+            /**
+             * \brief The phrase ending at the node or -1.
+             */
+            int32_t phrase;
+
+            /**
+             * \brief The index of the first edge of the node.
+             */
+            uint32_t edges;
+
+            /**
+             * \brief The amount of edges of the node.
+             */
+            uint32_t count;
+        };
+
+        /**
+         * \brief An edge between two nodes of the trie.
+         */
+        struct Edge
+        {
+            /**
+             * \brief The byte leading to the node.
+             */
+            unsigned char byte;
+
+            /**
+             * \brief The node the edge leads to.
+             */
+            uint32_t node;
+        };
+
+        /**
+         * \brief Gets the Entry of a rule.
+         *
+         * \param id The id of the rule.
+         * \return The Entry of the rule.
+         * \exception out_of_range Thrown, if no code is stored for the id.
+         */
+        const Entry& getEntry (int id) const;
+
+        /**
+         * \brief Sets the phrases of the dictionary and builds the trie.
+         *
+         * \param phrases The phrases, most frequently used first.
+         */
+        void setPhrases (const std::vector<std::string>& phrases);
+
+        /**
+         * \brief Compresses code into the phrase codes.
+         *
+         * \param code The code to compress.
+         * \param size The size of the code in bytes.
+         * \param out The vector to append the phrase codes to.
+         * \param usage The vector to count the usage of the phrases in or 0.
+         */
+        void encode (const char* code, size_t size,
+            std::vector<unsigned char>& out,
+            std::vector<size_t>* usage) const;
+
+        /**
+         * \brief The phrases of the dictionary.
+         */
+        std::string _phrases;
+
+        /**
+         * \brief The offsets of the phrases within _phrases, followed by
+         * the end of the last phrase.
+         */
+        std::vector<uint32_t> _offsets;
+
+        /**
+         * \brief The nodes of the trie, starting with the root.
+         */
+        std::vector<Node> _nodes;
+
+        /**
+         * \brief The edges of the trie nodes, sorted by their byte.
+         */
+        std::vector<Edge> _edges;
+
+        /**
+         * \brief The compressed code of all rules.
+         */
+        std::vector<unsigned char> _data;
+
+        /**
+         * \brief The positions of the compressed code, indexed by the id.
+         */
+        std::vector<Entry> _entries;
+
+        /**
+         * \brief The amount of rules, for which code is stored.
+         */
+        size_t _count;
+
+        /**
+         * \brief The amount of uncompressed code bytes stored.
+         */
+        size_t _codesize;
+
+    private:
+        CodeStore (const CodeStore&);
+        CodeStore& operator= (const CodeStore&);
+    };
+
+    /*
+     * Decompressing is defined inline, so that the code can be appended
+     * to any string type used by the LearnSystem.
+     */
+    template <typename String>
+    inline void CodeStore::appendCode (String& script, int id) const
+    {
+        const Entry& entry = this->getEntry (id);
+        const unsigned char *pos = this->_data.data () + entry.offset;
+        const char *phrases = this->_phrases.data ();
+        const uint32_t *offsets = this->_offsets.data ();
+        size_t code, length, remaining = entry.length;
+
+        /* The compressed size is not kept, but the uncompressed one. */
+        while (remaining > 0)
+        {
+            code = *pos++;
+            if (code & 0x80)
+                code = ((code & 0x7f) << 8) | *pos++;
+            length = offsets[code + 1] - offsets[code];
+            script.append (phrases + offsets[code], length);
+            remaining -= length;
+        }
+    }
+
+} // namespace
+
+#endif /* _CODESTORE_H_ */
@@ -0,0 +1,972 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <limits>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "FileRuleManager.h"
+
+#ifdef _WIN32
+#include <iterator>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace dynrules
+{
+
+/*
+ * The minimum size of a chunk parsed by a single task.
+ */
+static const size_t _MINCHUNKSIZE = 256 * 1024;
+
+static std::runtime_error _file_error (const std::string& filename,
+    const char *action)
+{
+    return std::runtime_error (std::string ("could not ") + action +
+        " file '" + filename + "': " + std::strerror (errno));
+}
+
+/*
+ * The contents of a catalog file, which are memory-mapped, if possible.
+ */
+class FileRuleManager::CatalogFile
+{
+public:
+    CatalogFile (const std::string& filename) :
+        _data(0),
+        _size(0),
+        _buffer()
+    {
+#ifdef _WIN32
+        std::ifstream fd (filename.c_str (), std::ios::in | std::ios::binary);
+        if (!fd)
+            throw _file_error (filename, "open");
+        this->_buffer.assign (std::istreambuf_iterator<char>(fd),
+            std::istreambuf_iterator<char>());
+        this->_size = this->_buffer.size ();
+        this->_data = this->_buffer.empty () ? 0 : &this->_buffer[0];
+#else
+        struct stat st;
+        void *addr;
+        int fd;
+
+        fd = open (filename.c_str (), O_RDONLY);
+        if (fd == -1)
+            throw _file_error (filename, "open");
+        if (fstat (fd, &st) == -1)
+        {
+            std::runtime_error error = _file_error (filename, "stat");
+            close (fd);
+            throw error;
+        }
+        this->_size = static_cast<size_t>(st.st_size);
+        if (this->_size > 0)
+        {
+            addr = mmap (0, this->_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr == MAP_FAILED)
+            {
+                std::runtime_error error = _file_error (filename, "map");
+                close (fd);
+                throw error;
+            }
+            /* The chunks are read in parallel, so read ahead everything. */
+            madvise (addr, this->_size, MADV_WILLNEED);
+            this->_data = static_cast<const char*>(addr);
+        }
+        close (fd);
+#endif
+    }
+
+    ~CatalogFile ()
+    {
+#ifndef _WIN32
+        if (this->_data != 0)
+            munmap (const_cast<char*>(this->_data), this->_size);
+#endif
+    }
+
+    const char* data () const
+    {
+        return this->_data;
+    }
+
+    size_t size () const
+    {
+        return this->_size;
+    }
+
+private:
+    CatalogFile (const CatalogFile&);
+    CatalogFile& operator= (const CatalogFile&);
+
+    const char *_data;
+    size_t _size;
+    std::vector<char> _buffer;
+};
+
+/*
+ * A part of the catalog, which starts and ends at a line boundary.
+ */
+struct _Chunk
+{
+    const char *begin;
+    const char *end;
+    size_t records;
+    size_t lines;
+    size_t firstrecord;
+    size_t firstline;
+};
+
+static const char* _line_end (const char* pos, const char* end)
+{
+    const void *found = std::memchr (pos, '\n', static_cast<size_t>(end - pos));
+    return (found != 0) ? static_cast<const char*>(found) : end;
+}
+
+static bool _is_record (const char* pos, const char* end)
+{
+    while (pos < end && (*pos == ' ' || *pos == '\t' || *pos == '\r'))
+        pos++;
+    return pos < end && *pos != '#';
+}
+
+/*
+ * Parses a single line of the catalog into a Rule.
+ */
+class _LineParser
+{
+public:
+    _LineParser () : _pos(0), _end(0), _code()
+    {
+    }
+
+    void parse (const char* begin, const char* end, Rule& rule)
+    {
+        this->_pos = begin;
+        this->_end = end;
+
+        /* Allow files with Windows line endings. */
+        if (this->_end > this->_pos && this->_end[-1] == '\r')
+            this->_end--;
+        this->skipSpaces ();
+        if (*this->_pos == '{')
+            this->parseJSON (rule);
+        else
+            this->parseText (rule);
+    }
+
+private:
+    _LineParser (const _LineParser&);
+    _LineParser& operator= (const _LineParser&);
+
+    void fail (const char* message) const
+    {
+        throw std::runtime_error (message);
+    }
+
+    void skipSpaces ()
+    {
+        while (this->_pos < this->_end &&
+            (*this->_pos == ' ' || *this->_pos == '\t'))
+            this->_pos++;
+    }
+
+    const char* fieldEnd () const
+    {
+        const void *found = std::memchr (this->_pos, '\t',
+            static_cast<size_t>(this->_end - this->_pos));
+        return (found != 0) ? static_cast<const char*>(found) : this->_end;
+    }
+
+    const char* tokenEnd () const
+    {
+        const char *pos = this->_pos;
+
+        while (pos < this->_end && (*pos == '-' || *pos == '+' ||
+                *pos == '.' || *pos == 'e' || *pos == 'E' ||
+                (*pos >= '0' && *pos <= '9')))
+            pos++;
+        return pos;
+    }
+
+    /*
+     * Parses an integer, which ends at end, except for trailing spaces.
+     */
+    int parseInteger (const char* end)
+    {
+        const char *pos = this->_pos;
+        bool negative = false;
+        long long value = 0;
+
+        while (pos < end && *pos == ' ')
+            pos++;
+        if (pos < end && (*pos == '-' || *pos == '+'))
+            negative = (*pos++ == '-');
+        if (pos == end || *pos < '0' || *pos > '9')
+            this->fail ("invalid integer");
+        while (pos < end && *pos >= '0' && *pos <= '9')
+        {
+            value = value * 10 + (*pos++ - '0');
+            if (value > static_cast<long long>(
+                    std::numeric_limits<int>::max ()) + 1)
+                this->fail ("integer out of range");
+        }
+        while (pos < end && *pos == ' ')
+            pos++;
+        if (pos != end)
+            this->fail ("invalid integer");
+        if (negative)
+            value = -value;
+        if (value > std::numeric_limits<int>::max ())
+            this->fail ("integer out of range");
+        this->_pos = end;
+        return static_cast<int>(value);
+    }
+
+    /*
+     * Parses a number, which ends at end, except for trailing spaces.
+     */
+    double parseNumber (const char* end)
+    {
+        char buf[64], *last;
+        size_t len;
+        double value;
+
+        while (end > this->_pos && end[-1] == ' ')
+            end--;
+        while (this->_pos < end && *this->_pos == ' ')
+            this->_pos++;
+        len = static_cast<size_t>(end - this->_pos);
+        if (len == 0 || len >= sizeof (buf))
+            this->fail ("invalid number");
+
+        /* The mapped data is not terminated, so copy the number. */
+        std::memcpy (buf, this->_pos, len);
+        buf[len] = '\0';
+        value = std::strtod (buf, &last);
+        if (last != buf + len || !(std::fabs (value) <=
+                std::numeric_limits<double>::max ()))
+            this->fail ("invalid number");
+        this->_pos = end;
+        return value;
+    }
+
+    void parseText (Rule& rule)
+    {
+        const char *end, *pos;
+
+        end = this->fieldEnd ();
+        if (end == this->_end)
+            this->fail ("missing weight");
+        rule.setId (this->parseInteger (end));
+        this->_pos++;
+
+        end = this->fieldEnd ();
+        if (end == this->_end)
+            this->fail ("missing code");
+        rule.setWeight (this->parseNumber (end));
+        this->_pos++;
+
+        /* The code does not contain any tabs, so a tab ends the priority. */
+        end = this->fieldEnd ();
+        if (end != this->_end)
+        {
+            rule.setPriority (this->parseInteger (end));
+            this->_pos++;
+        }
+
+        this->_code.clear ();
+        for (pos = this->_pos; pos < this->_end; pos++)
+        {
+            if (*pos != '\\' || pos + 1 == this->_end)
+            {
+                this->_code += *pos;
+                continue;
+            }
+            switch (*++pos)
+            {
+            case 'n':
+                this->_code += '\n';
+                break;
+            case 'r':
+                this->_code += '\r';
+                break;
+            case 't':
+                this->_code += '\t';
+                break;
+            case '\\':
+                this->_code += '\\';
+                break;
+            default:
+                this->_code += '\\';
+                this->_code += *pos;
+                break;
+            }
+        }
+        rule.setCode (this->_code);
+    }
+
+    void expect (char c, const char* message)
+    {
+        this->skipSpaces ();
+        if (this->_pos == this->_end || *this->_pos != c)
+            this->fail (message);
+        this->_pos++;
+    }
+
+    static void appendUTF8 (std::string& str, unsigned long code)
+    {
+        if (code < 0x80)
+            str += static_cast<char>(code);
+        else if (code < 0x800)
+        {
+            str += static_cast<char>(0xc0 | (code >> 6));
+            str += static_cast<char>(0x80 | (code & 0x3f));
+        }
+        else if (code < 0x10000)
+        {
+            str += static_cast<char>(0xe0 | (code >> 12));
+            str += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            str += static_cast<char>(0x80 | (code & 0x3f));
+        }
+        else
+        {
+            str += static_cast<char>(0xf0 | (code >> 18));
+            str += static_cast<char>(0x80 | ((code >> 12) & 0x3f));
+            str += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+            str += static_cast<char>(0x80 | (code & 0x3f));
+        }
+    }
+
+    unsigned long parseHex ()
+    {
+        unsigned long code = 0;
+        int i;
+        char c;
+
+        if (this->_end - this->_pos < 4)
+            this->fail ("invalid unicode escape");
+        for (i = 0; i < 4; i++)
+        {
+            c = *this->_pos++;
+            code <<= 4;
+            if (c >= '0' && c <= '9')
+                code |= static_cast<unsigned long>(c - '0');
+            else if (c >= 'a' && c <= 'f')
+                code |= static_cast<unsigned long>(c - 'a' + 10);
+            else if (c >= 'A' && c <= 'F')
+                code |= static_cast<unsigned long>(c - 'A' + 10);
+            else
+                this->fail ("invalid unicode escape");
+        }
+        return code;
+    }
+
+    /*
+     * Parses a JSON string. If str is 0, the string is skipped.
+     */
+    void parseString (std::string* str)
+    {
+        unsigned long code, low;
+        const char *start;
+
+        this->expect ('"', "string expected");
+        while (true)
+        {
+            /* Copy the unescaped parts at once. */
+            start = this->_pos;
+            while (this->_pos < this->_end && *this->_pos != '"' &&
+                *this->_pos != '\\')
+                this->_pos++;
+            if (str != 0)
+                str->append (start, static_cast<size_t>(this->_pos - start));
+            if (this->_pos == this->_end)
+                this->fail ("unterminated string");
+            if (*this->_pos++ == '"')
+                return;
+
+            if (this->_pos == this->_end)
+                this->fail ("unterminated string");
+            switch (*this->_pos++)
+            {
+            case '"':
+                code = '"';
+                break;
+            case '\\':
+                code = '\\';
+                break;
+            case '/':
+                code = '/';
+                break;
+            case 'b':
+                code = '\b';
+                break;
+            case 'f':
+                code = '\f';
+                break;
+            case 'n':
+                code = '\n';
+                break;
+            case 'r':
+                code = '\r';
+                break;
+            case 't':
+                code = '\t';
+                break;
+            case 'u':
+                code = this->parseHex ();
+                if (code >= 0xd800 && code < 0xdc00)
+                {
+                    /* A surrogate pair. */
+                    if (this->_end - this->_pos < 2 ||
+                        this->_pos[0] != '\\' || this->_pos[1] != 'u')
+                        this->fail ("invalid unicode escape");
+                    this->_pos += 2;
+                    low = this->parseHex ();
+                    if (low < 0xdc00 || low >= 0xe000)
+                        this->fail ("invalid unicode escape");
+                    code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                }
+                break;
+            default:
+                this->fail ("invalid escape sequence");
+                code = 0;
+                break;
+            }
+            if (str != 0)
+                appendUTF8 (*str, code);
+        }
+    }
+
+    void skipValue ()
+    {
+        int depth = 0;
+
+        this->skipSpaces ();
+        do
+        {
+            if (this->_pos == this->_end)
+                this->fail ("unexpected end of line");
+            switch (*this->_pos)
+            {
+            case '"':
+                this->parseString (0);
+                break;
+            case '{':
+            case '[':
+                depth++;
+                this->_pos++;
+                break;
+            case '}':
+            case ']':
+                if (depth == 0)
+                    this->fail ("value expected");
+                depth--;
+                this->_pos++;
+                break;
+            case ',':
+            case ':':
+                if (depth == 0)
+                    this->fail ("value expected");
+                this->_pos++;
+                break;
+            default:
+                /* Numbers and literals. */
+                if (*this->_pos == ' ' || *this->_pos == '\t')
+                {
+                    this->_pos++;
+                    break;
+                }
+                while (this->_pos < this->_end && *this->_pos != ',' &&
+                    *this->_pos != '}' && *this->_pos != ']' &&
+                    *this->_pos != ' ' && *this->_pos != '\t')
+                    this->_pos++;
+                break;
+            }
+        }
+        while (depth > 0);
+    }
+
+    void parseJSON (Rule& rule)
+    {
+        bool hasid = false, hasweight = false;
+        const char *start;
+        size_t len;
+
+        this->expect ('{', "object expected");
+        this->skipSpaces ();
+        if (this->_pos < this->_end && *this->_pos == '}')
+            this->fail ("missing id");
+
+        while (true)
+        {
+            this->skipSpaces ();
+            start = this->_pos + 1;
+            this->parseString (0);
+            len = static_cast<size_t>(this->_pos - start - 1);
+            this->expect (':', "':' expected");
+            this->skipSpaces ();
+
+            if (len == 2 && std::memcmp (start, "id", 2) == 0)
+            {
+                rule.setId (this->parseInteger (this->tokenEnd ()));
+                hasid = true;
+            }
+            else if (len == 6 && std::memcmp (start, "weight", 6) == 0)
+            {
+                rule.setWeight (this->parseNumber (this->tokenEnd ()));
+                hasweight = true;
+            }
+            else if (len == 8 && std::memcmp (start, "priority", 8) == 0)
+                rule.setPriority (this->parseInteger (this->tokenEnd ()));
+            else if (len == 4 && std::memcmp (start, "code", 4) == 0)
+            {
+                this->_code.clear ();
+                if (this->_end - this->_pos >= 4 &&
+                    std::memcmp (this->_pos, "null", 4) == 0)
+                    this->_pos += 4;
+                else
+                    this->parseString (&this->_code);
+                rule.setCode (this->_code);
+            }
+            else
+                this->skipValue ();
+
+            this->skipSpaces ();
+            if (this->_pos == this->_end)
+                this->fail ("unterminated object");
+            if (*this->_pos == '}')
+                break;
+            this->expect (',', "',' or '}' expected");
+        }
+        this->_pos++;
+        this->skipSpaces ();
+        if (this->_pos != this->_end)
+            this->fail ("unexpected data after object");
+        if (!hasid)
+            this->fail ("missing id");
+        if (!hasweight)
+            this->fail ("missing weight");
+    }
+
+    const char *_pos;
+    const char *_end;
+    std::string _code;
+};
+
+/*
+ * Prefixes the error of an invalid line with the line number.
+ */
+static std::runtime_error _line_error (size_t line,
+    const std::runtime_error& error)
+{
+    std::ostringstream stream;
+    stream << "line " << line << ": " << error.what ();
+    return std::runtime_error (stream.str ());
+}
+
+static void _count_chunk (_Chunk& chunk)
+{
+    const char *pos, *end;
+
+    for (pos = chunk.begin; pos < chunk.end; pos = end + 1)
+    {
+        end = _line_end (pos, chunk.end);
+        chunk.lines++;
+        if (_is_record (pos, end))
+            chunk.records++;
+    }
+}
+
+static void _parse_chunk (const _Chunk& chunk, Rule* rules)
+{
+    _LineParser parser;
+    const char *pos, *end;
+    size_t line = chunk.firstline;
+
+    for (pos = chunk.begin; pos < chunk.end; pos = end + 1, line++)
+    {
+        end = _line_end (pos, chunk.end);
+        if (!_is_record (pos, end))
+            continue;
+        try
+        {
+            parser.parse (pos, end, *rules++);
+        }
+        catch (std::runtime_error& e)
+        {
+            throw _line_error (line, e);
+        }
+    }
+}
+
+/*
+ * Validates the records of a chunk and stores their offsets and ids.
+ */
+static void _index_chunk (const _Chunk& chunk, const char* data,
+    size_t* offsets, int* ids)
+{
+    _LineParser parser;
+    const char *pos, *end;
+    size_t line = chunk.firstline;
+    Rule rule;
+
+    for (pos = chunk.begin; pos < chunk.end; pos = end + 1, line++)
+    {
+        end = _line_end (pos, chunk.end);
+        if (!_is_record (pos, end))
+            continue;
+        try
+        {
+            parser.parse (pos, end, rule);
+        }
+        catch (std::runtime_error& e)
+        {
+            throw _line_error (line, e);
+        }
+        *offsets++ = static_cast<size_t>(pos - data);
+        *ids++ = rule.getId ();
+    }
+}
+
+static void _write_code (std::ostream& stream, const std::string& code)
+{
+    std::string::const_iterator iter;
+
+    for (iter = code.begin (); iter != code.end (); iter++)
+    {
+        switch (*iter)
+        {
+        case '\n':
+            stream << "\\n";
+            break;
+        case '\r':
+            stream << "\\r";
+            break;
+        case '\t':
+            stream << "\\t";
+            break;
+        case '\\':
+            stream << "\\\\";
+            break;
+        default:
+            stream << *iter;
+            break;
+        }
+    }
+}
+
+FileRuleManager::FileRuleManager (const std::string& filename,
+    unsigned int maxrules, ThreadPool* pool, LoadMode mode) :
+    RuleManager (maxrules),
+    _filename(filename),
+    _mode(mode),
+    _file(0),
+    _offsets(),
+    _ids(),
+    _storage(0),
+    _rules()
+{
+    CatalogFile *file = new CatalogFile (filename);
+    try
+    {
+        this->parse (file->data (), file->size (), pool);
+    }
+    catch (std::runtime_error& e)
+    {
+        delete file;
+        throw std::runtime_error (filename + ": " + e.what ());
+    }
+    catch (...)
+    {
+        delete file;
+        throw;
+    }
+
+    /* The rules are parsed on demand from the mapped file. */
+    if (mode == STREAM)
+        this->_file = file;
+    else
+        delete file;
+}
+
+FileRuleManager::~FileRuleManager ()
+{
+    delete [] this->_storage;
+    delete this->_file;
+}
+
+const std::string& FileRuleManager::getFileName () const
+{
+    return this->_filename;
+}
+
+FileRuleManager::LoadMode FileRuleManager::getLoadMode () const
+{
+    return this->_mode;
+}
+
+size_t FileRuleManager::getCount () const
+{
+    if (this->_mode == STREAM)
+        return this->_offsets.size ();
+    return this->_rules.size ();
+}
+
+void FileRuleManager::parse (const char* data, size_t size, ThreadPool* pool)
+{
+    std::vector<_Chunk> chunks;
+    const char *pos = data, *end = data + size;
+    size_t i, chunksize, records = 0, lines = 1;
+    unsigned int threads = (pool != 0) ? pool->getThreads () : 1;
+
+    if (size == 0)
+        return;
+
+    /*
+     * Split the data into a few chunks per thread, so that threads
+     * finishing early can take over.
+     */
+    chunksize = size / (threads > 1 ? threads * 4 : 1);
+    if (chunksize < _MINCHUNKSIZE)
+        chunksize = _MINCHUNKSIZE;
+    while (pos < end)
+    {
+        _Chunk chunk = { pos, end, 0, 0, 0, 0 };
+        if (static_cast<size_t>(end - pos) > chunksize)
+        {
+            chunk.end = _line_end (pos + chunksize, end);
+            if (chunk.end < end)
+                chunk.end++;
+        }
+        chunks.push_back (chunk);
+        pos = chunk.end;
+    }
+
+    /* Count the rules first, so that they can be parsed in place. */
+    if (pool != 0)
+        pool->run (chunks.size (), [&chunks] (size_t index)
+            {
+                _count_chunk (chunks[index]);
+            });
+    else
+    {
+        for (i = 0; i < chunks.size (); i++)
+            _count_chunk (chunks[i]);
+    }
+    for (i = 0; i < chunks.size (); i++)
+    {
+        chunks[i].firstrecord = records;
+        chunks[i].firstline = lines;
+        records += chunks[i].records;
+        lines += chunks[i].lines;
+    }
+
+    if (this->_mode == STREAM)
+    {
+        std::vector<size_t> offsets (records);
+        std::vector<int> ids (records);
+        size_t *first = offsets.empty () ? 0 : &offsets[0];
+        int *firstid = ids.empty () ? 0 : &ids[0];
+
+        if (pool != 0)
+            pool->run (chunks.size (),
+                [&chunks, data, first, firstid] (size_t index)
+                {
+                    _index_chunk (chunks[index], data,
+                        first + chunks[index].firstrecord,
+                        firstid + chunks[index].firstrecord);
+                });
+        else
+        {
+            for (i = 0; i < chunks.size (); i++)
+                _index_chunk (chunks[i], data, first + chunks[i].firstrecord,
+                    firstid + chunks[i].firstrecord);
+        }
+        this->_offsets.swap (offsets);
+        this->indexIds (firstid, records);
+        return;
+    }
+
+    Rule *storage = new Rule[records];
+    try
+    {
+        if (pool != 0)
+            pool->run (chunks.size (), [&chunks, storage] (size_t index)
+                {
+                    _parse_chunk (chunks[index],
+                        storage + chunks[index].firstrecord);
+                });
+        else
+        {
+            for (i = 0; i < chunks.size (); i++)
+                _parse_chunk (chunks[i], storage + chunks[i].firstrecord);
+        }
+    }
+    catch (...)
+    {
+        delete [] storage;
+        throw;
+    }
+
+    this->_storage = storage;
+    this->_rules.resize (records);
+    for (i = 0; i < records; i++)
+        this->_rules[i] = storage + i;
+
+    std::vector<int> ids (records);
+    for (i = 0; i < records; i++)
+        ids[i] = storage[i].getId ();
+    this->indexIds (ids.empty () ? 0 : &ids[0], records);
+}
+
+void FileRuleManager::indexIds (const int* ids, size_t count)
+{
+    size_t i;
+
+    this->_ids.resize (count);
+    for (i = 0; i < count; i++)
+    {
+        this->_ids[i].id = ids[i];
+        this->_ids[i].index = i;
+    }
+    std::sort (this->_ids.begin (), this->_ids.end ());
+}
+
+void FileRuleManager::parseRecord (size_t index, Rule& rule) const
+{
+    const char *data = this->_file->data ();
+    const char *end = data + this->_file->size ();
+    const char *pos = data + this->_offsets[index];
+    _LineParser parser;
+
+    try
+    {
+        parser.parse (pos, _line_end (pos, end), rule);
+    }
+    catch (std::runtime_error& e)
+    {
+        /* The file was validated on construction, so this is rare. */
+        size_t line = static_cast<size_t>(std::count (data, pos, '\n')) + 1;
+        throw std::runtime_error (this->_filename + ": " +
+            _line_error (line, e).what ());
+    }
+}
+
+std::vector<Rule*> FileRuleManager::loadRules ()
+{
+    if (this->_mode == STREAM)
+        return this->loadRules (0,
+            static_cast<unsigned int>(this->_offsets.size ()));
+    return this->_rules;
+}
+
+std::vector<Rule*> FileRuleManager::loadRules (unsigned int maxrules)
+{
+    return this->loadRules (0, maxrules);
+}
+
+std::vector<Rule*> FileRuleManager::loadRules (unsigned int offset,
+    unsigned int maxrules)
+{
+    std::vector<Rule*> rules;
+    size_t count = this->getCount (), i;
+
+    if (offset >= count)
+        return rules;
+    if (maxrules > count - offset)
+        maxrules = static_cast<unsigned int>(count - offset);
+    if (this->_mode == PRELOAD)
+        return std::vector<Rule*> (this->_rules.begin () + offset,
+            this->_rules.begin () + offset + maxrules);
+
+    rules.reserve (maxrules);
+    try
+    {
+        for (i = offset; i < offset + maxrules; i++)
+        {
+            rules.push_back (new Rule ());
+            this->parseRecord (i, *rules.back ());
+        }
+    }
+    catch (...)
+    {
+        for (i = 0; i < rules.size (); i++)
+            delete rules[i];
+        throw;
+    }
+    return rules;
+}
+
+bool FileRuleManager::saveRules (std::vector<Rule*> rules)
+{
+    std::vector<Rule*>::const_iterator iter;
+    std::string tmpname = this->_filename + ".tmp";
+    std::ofstream fd;
+
+    /*
+     * Write a new file instead of truncating the existing one, which may
+     * still be mapped in the STREAM mode.
+     */
+    fd.open (tmpname.c_str (), std::ios::out | std::ios::binary);
+    if (!fd)
+        return false;
+
+    fd.precision (std::numeric_limits<double>::digits10 + 2);
+    for (iter = rules.begin (); iter != rules.end (); iter++)
+    {
+        fd << (*iter)->getId () << '\t' << (*iter)->getWeight () << '\t'
+           << (*iter)->getPriority () << '\t';
+        _write_code (fd, (*iter)->getCode ());
+        fd << '\n';
+    }
+    fd.close ();
+    if (fd.fail ())
+    {
+        std::remove (tmpname.c_str ());
+        return false;
+    }
+#ifdef _WIN32
+    std::remove (this->_filename.c_str ());
+#endif
+    if (std::rename (tmpname.c_str (), this->_filename.c_str ()) != 0)
+    {
+        std::remove (tmpname.c_str ());
+        return false;
+    }
+    return true;
+}
+
+std::string FileRuleManager::loadCode (int id)
+{
+    std::vector<RecordId>::const_iterator iter;
+    RecordId key = { id, 0 };
+    Rule rule;
+
+    iter = std::lower_bound (this->_ids.begin (), this->_ids.end (), key);
+    if (iter == this->_ids.end () || iter->id != id)
+        throw std::out_of_range ("no rule with such an id");
+    if (this->_mode == PRELOAD)
+        return this->_rules[iter->index]->getCode ();
+
+    this->parseRecord (iter->index, rule);
+    return rule.getCode ();
+}
+
+} // namespace
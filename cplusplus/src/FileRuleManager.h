@@ -0,0 +1,271 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _FILERULEMANAGER_H_
+#define _FILERULEMANAGER_H_
+
+#include <string>
+#include <vector>
+#include "RuleManager.h"
+#include "ThreadPool.h"
+
+namespace dynrules
+{
+    /**
+     * \brief A RuleManager, which loads the rules from a catalog file.
+     *
+     * The catalog contains one rule per line, either as tab-separated
+     * text or as JSON object (JSON Lines):
+     *
+     * \code
+     *   # id <TAB> weight <TAB> [priority <TAB>] code
+     *   1	10	if enemy.near: attack ()\n
+     *   2	5	-1	flee ()
+     *   {"id": 3, "weight": 7.5, "priority": 2, "code": "heal ()\n"}
+     * \endcode
+     *
+     * Empty lines and lines starting with '#' are skipped. Within the text
+     * format, the code may contain the escape sequences \\n, \\r, \\t and
+     * \\\\. Within the JSON format, the keys "id" and "weight" are required,
+     * "priority" and "code" are optional and other keys are ignored. The
+     * formats can be mixed within a catalog.
+     *
+     * The file is memory-mapped and split into chunks at line boundaries,
+     * which are parsed in parallel on a ThreadPool. In the PRELOAD mode,
+     * the rules are stored in a single, contiguous array owned by the
+     * FileRuleManager. In the STREAM mode, only the positions of the rules
+     * within the file are kept and the file stays mapped, so that
+     * loadRules(unsigned int, unsigned int) parses only the requested
+     * range of rules. This keeps the memory usage bounded for huge
+     * catalogs, if the rules are loaded incrementally, e.g. via a
+     * RuleStream.
+     */
+    class FileRuleManager : public RuleManager
+    {
+    public:
+
+        /**
+         * \brief The ways of keeping the rules of the catalog.
+         */
+        enum LoadMode
+        {
+            /**
+             * Parses all rules on construction and keeps them in memory.
+             * The loaded rules are owned by the FileRuleManager. This is
+             * the default.
+             */
+            PRELOAD = 0,
+            /**
+             * Keeps the positions of the rules within the memory-mapped
+             * file and parses the rules on each load. The loaded rules
+             * are owned by the caller.
+             */
+            STREAM = 1
+        };
+
+        /**
+         * \brief Creates a new FileRuleManager and loads the rules of a
+         * catalog file.
+         *
+         * \param filename The catalog file to load.
+         * \param maxrules The maximum amount of rules to use for a script.
+         * \param pool The ThreadPool to parse the catalog with or 0 to
+         * parse it on the calling thread.
+         * \param mode The way of keeping the rules. The catalog is parsed
+         * completely in both modes, so that invalid lines are detected on
+         * construction.
+         * \exception runtime_error Thrown, if the file could not be read or
+         * contains an invalid line.
+         */
+        FileRuleManager (const std::string& filename, unsigned int maxrules,
+            ThreadPool* pool = 0, LoadMode mode = PRELOAD);
+
+        /**
+         * \brief Destroys the FileRuleManager and its rules.
+         */
+        virtual ~FileRuleManager ();
+
+        /**
+         * \brief Gets the catalog file of the FileRuleManager.
+         *
+         * \return The catalog file.
+         */
+        const std::string& getFileName () const;
+
+        /**
+         * \brief Gets the way of keeping the rules of the catalog.
+         *
+         * \return The LoadMode of the FileRuleManager.
+         */
+        LoadMode getLoadMode () const;
+
+        /**
+         * \brief Gets the amount of rules loaded.
+         *
+         * \return The amount of rules.
+         */
+        size_t getCount () const;
+
+        /**
+         * \brief Gets all rules.
+         *
+         * In the PRELOAD mode, the rules are owned by the FileRuleManager.
+         * In the STREAM mode, the rules are parsed and owned by the caller.
+         *
+         * \return The rules in the order of the catalog.
+         */
+        std::vector<Rule*> loadRules ();
+
+        /**
+         * \brief Gets the first rules.
+         *
+         * \param maxrules The maximum amount of rules to get.
+         * \return The rules in the order of the catalog.
+         */
+        std::vector<Rule*> loadRules (unsigned int maxrules);
+
+        /**
+         * \brief Gets a range of the rules.
+         *
+         * In the STREAM mode, only the requested rules are parsed.
+         *
+         * \param offset The index of the first rule to get.
+         * \param maxrules The maximum amount of rules to get.
+         * \return The rules in the order of the catalog.
+         */
+        std::vector<Rule*> loadRules (unsigned int offset,
+            unsigned int maxrules);
+
+        using RuleManager::loadRules;
+
+        /**
+         * \brief Writes rules to the catalog file in the text format.
+         *
+         * The file is replaced by a new one, so that the rules already
+         * loaded are not changed. In the STREAM mode, the FileRuleManager
+         * keeps loading the rules of the previous file.
+         *
+         * \param rules The rules to write.
+         * \return true, if the rules were written, false otherwise.
+         */
+        bool saveRules (std::vector<Rule*> rules);
+
+        /**
+         * \brief Gets the code of a rule.
+         *
+         * The rule is looked up by its id in O(log n) steps. In the STREAM
+         * mode, only the code of the rule is parsed from the file, so that
+         * a CodeCache keeps the only copy of the code in memory.
+         *
+         * \param id The id of the rule.
+         * \return The code of the rule. If multiple rules have the id, it
+         * is the code of the first one.
+         * \exception out_of_range Thrown, if there is no rule with the id.
+         */
+        std::string loadCode (int id);
+
+    protected:
+
+        /**
+         * \brief The id of a rule and its index within the catalog.
+         */
+        struct RecordId
+        {
+            /**
+             * \brief The id of the rule.
+             */
+            int id;
+
+            /**
+             * \brief The index of the rule within the catalog.
+             */
+            size_t index;
+
+            bool operator< (const RecordId& other) const
+            {
+                return id < other.id ||
+                    (id == other.id && index < other.index);
+            }
+        };
+
+        /**
+         * \brief The contents of a catalog file.
+         */
+        class CatalogFile;
+
+        /**
+         * \brief Parses a catalog into the rule array or, in the STREAM
+         * mode, the record positions.
+         *
+         * \param data The catalog data.
+         * \param size The size of the catalog data in bytes.
+         * \param pool The ThreadPool to parse the catalog with or 0.
+         */
+        void parse (const char* data, size_t size, ThreadPool* pool);
+
+        /**
+         * \brief Parses a record of the catalog in the STREAM mode.
+         *
+         * \param index The index of the record.
+         * \param rule The Rule to store the parsed values in.
+         * \exception runtime_error Thrown, if the record is invalid.
+         */
+        void parseRecord (size_t index, Rule& rule) const;
+
+        /**
+         * \brief Sorts the ids of the rules for loadCode().
+         *
+         * \param ids The ids of the rules in the order of the catalog.
+         * \param count The amount of rules.
+         */
+        void indexIds (const int* ids, size_t count);
+
+        /**
+         * \brief The catalog file.
+         */
+        std::string _filename;
+
+        /**
+         * \brief The way of keeping the rules.
+         */
+        LoadMode _mode;
+
+        /**
+         * \brief The mapped catalog file in the STREAM mode or 0.
+         */
+        CatalogFile* _file;
+
+        /**
+         * \brief The byte offsets of the records within the catalog file
+         * in the STREAM mode.
+         */
+        std::vector<size_t> _offsets;
+
+        /**
+         * \brief The ids of the rules sorted by the id for loadCode().
+         */
+        std::vector<RecordId> _ids;
+
+        /**
+         * \brief The contiguous array of the loaded rules.
+         */
+        Rule* _storage;
+
+        /**
+         * \brief The loaded rules.
+         */
+        std::vector<Rule*> _rules;
+
+    private:
+        FileRuleManager (const FileRuleManager&);
+        FileRuleManager& operator= (const FileRuleManager&);
+    };
+
+} // namespace
+
+#endif /* _FILERULEMANAGER_H_ */
@@ -0,0 +1,206 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include <cmath>
+#include "LatencyHistogram.h"
+
+namespace dynrules
+{
+
+static const uint64_t _NOVALUE = ~static_cast<uint64_t>(0);
+static const uint64_t _HALF = static_cast<uint64_t>(1) <<
+    (LatencyHistogram::PRECISION - 1);
+
+/*
+ * Gets the position of the highest set bit of a value greater than 0.
+ */
+static unsigned int _highest_bit (uint64_t value)
+{
+    unsigned int bit = 0, shift;
+
+    for (shift = 32; shift > 0; shift /= 2)
+    {
+        if (value >> shift)
+        {
+            value >>= shift;
+            bit += shift;
+        }
+    }
+    return bit;
+}
+
+LatencyHistogram::LatencyHistogram () :
+    _count(0),
+    _sum(0),
+    _min(_NOVALUE),
+    _max(0)
+{
+    size_t i;
+
+    for (i = 0; i < BUCKETS; i++)
+        this->_buckets[i].store (0, std::memory_order_relaxed);
+}
+
+LatencyHistogram::~LatencyHistogram ()
+{
+}
+
+size_t LatencyHistogram::getBucket (uint64_t nanoseconds)
+{
+    unsigned int shift;
+
+    if (nanoseconds < 2 * _HALF)
+        return static_cast<size_t>(nanoseconds);
+    if (nanoseconds >> RANGE)
+        nanoseconds = (static_cast<uint64_t>(1) << RANGE) - 1;
+
+    /*
+     * Keep the PRECISION highest bits, of which the highest one is always
+     * set, and use the amount of dropped bits as exponent.
+     */
+    shift = _highest_bit (nanoseconds) - PRECISION + 1;
+    return static_cast<size_t>(2 * _HALF + (shift - 1) * _HALF +
+        ((nanoseconds >> shift) - _HALF));
+}
+
+uint64_t LatencyHistogram::getBucketLimit (size_t bucket)
+{
+    uint64_t shift, mantissa;
+
+    if (bucket >= BUCKETS)
+        throw std::out_of_range ("bucket out of range");
+    if (bucket < 2 * _HALF)
+        return bucket;
+    bucket -= static_cast<size_t>(2 * _HALF);
+    shift = bucket / _HALF + 1;
+    mantissa = _HALF + bucket % _HALF;
+    return ((mantissa + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record (uint64_t nanoseconds)
+{
+    uint64_t current;
+
+    this->_buckets[getBucket (nanoseconds)].fetch_add (1,
+        std::memory_order_relaxed);
+    this->_count.fetch_add (1, std::memory_order_relaxed);
+    this->_sum.fetch_add (nanoseconds, std::memory_order_relaxed);
+
+    current = this->_min.load (std::memory_order_relaxed);
+    while (nanoseconds < current && !this->_min.compare_exchange_weak
+        (current, nanoseconds, std::memory_order_relaxed));
+    current = this->_max.load (std::memory_order_relaxed);
+    while (nanoseconds > current && !this->_max.compare_exchange_weak
+        (current, nanoseconds, std::memory_order_relaxed));
+}
+
+void LatencyHistogram::add (const LatencyHistogram& histogram)
+{
+    uint64_t value, current;
+    size_t i;
+
+    for (i = 0; i < BUCKETS; i++)
+    {
+        value = histogram._buckets[i].load (std::memory_order_relaxed);
+        if (value != 0)
+            this->_buckets[i].fetch_add (value, std::memory_order_relaxed);
+    }
+    this->_count.fetch_add (histogram.getCount (), std::memory_order_relaxed);
+    this->_sum.fetch_add (histogram._sum.load (std::memory_order_relaxed),
+        std::memory_order_relaxed);
+
+    value = histogram._min.load (std::memory_order_relaxed);
+    current = this->_min.load (std::memory_order_relaxed);
+    while (value < current && !this->_min.compare_exchange_weak
+        (current, value, std::memory_order_relaxed));
+    value = histogram._max.load (std::memory_order_relaxed);
+    current = this->_max.load (std::memory_order_relaxed);
+    while (value > current && !this->_max.compare_exchange_weak
+        (current, value, std::memory_order_relaxed));
+}
+
+void LatencyHistogram::reset ()
+{
+    size_t i;
+
+    for (i = 0; i < BUCKETS; i++)
+        this->_buckets[i].store (0, std::memory_order_relaxed);
+    this->_count.store (0, std::memory_order_relaxed);
+    this->_sum.store (0, std::memory_order_relaxed);
+    this->_min.store (_NOVALUE, std::memory_order_relaxed);
+    this->_max.store (0, std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getCount () const
+{
+    return this->_count.load (std::memory_order_relaxed);
+}
+
+uint64_t LatencyHistogram::getMin () const
+{
+    uint64_t value = this->_min.load (std::memory_order_relaxed);
+    return (value == _NOVALUE) ? 0 : value;
+}
+
+uint64_t LatencyHistogram::getMax () const
+{
+    return this->_max.load (std::memory_order_relaxed);
+}
+
+double LatencyHistogram::getMean () const
+{
+    uint64_t count = this->getCount ();
+
+    if (count == 0)
+        return 0;
+    return static_cast<double>(this->_sum.load (std::memory_order_relaxed)) /
+        static_cast<double>(count);
+}
+
+uint64_t LatencyHistogram::getPercentile (double percentile) const
+{
+    uint64_t count = 0, target, limit, max = this->getMax ();
+    size_t i;
+
+    if (!(percentile >= 0 && percentile <= 100))
+        throw std::invalid_argument ("percentile must be between 0 and 100");
+
+    /*
+     * The buckets are summed up instead of using _count, which might be
+     * ahead of them while latencies are recorded.
+     */
+    for (i = 0; i < BUCKETS; i++)
+        count += this->_buckets[i].load (std::memory_order_relaxed);
+    if (count == 0)
+        return 0;
+
+    target = static_cast<uint64_t>(std::ceil (percentile / 100 *
+        static_cast<double>(count)));
+    if (target == 0)
+        target = 1;
+    for (i = 0, count = 0; i < BUCKETS; i++)
+    {
+        count += this->_buckets[i].load (std::memory_order_relaxed);
+        if (count >= target)
+            break;
+    }
+    if (i == BUCKETS)
+        i--;
+    limit = getBucketLimit (i);
+    return (limit < max) ? limit : max;
+}
+
+uint64_t LatencyHistogram::getBucketCount (size_t bucket) const
+{
+    if (bucket >= BUCKETS)
+        throw std::out_of_range ("bucket out of range");
+    return this->_buckets[bucket].load (std::memory_order_relaxed);
+}
+
+} // namespace
@@ -0,0 +1,193 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _LATENCYHISTOGRAM_H_
+#define _LATENCYHISTOGRAM_H_
+
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+namespace dynrules
+{
+    /**
+     * \brief A histogram of latencies with a fixed relative precision.
+     *
+     * LatencyHistogram counts latencies in nanoseconds in buckets, whose
+     * width grows with the latency, like a HDR histogram. Latencies below
+     * 256 ns are counted exactly, larger ones with a relative error below
+     * 1%. Latencies up to about 18 minutes are distinguished, larger ones
+     * are counted as the largest distinguished latency.
+     *
+     * The buckets are allocated on construction, so that recording a
+     * latency neither allocates memory nor takes a lock. Latencies can be
+     * recorded by multiple threads at once. Reading the histogram while
+     * latencies are recorded is safe, but the results may not include
+     * all of the latencies recorded meanwhile.
+     *
+     * \code
+     *   const LatencyHistogram& latency = lsystem.getGenerationLatency ();
+     *   std::cout << "p99.9: " << latency.getPercentile (99.9) << " ns";
+     * \endcode
+     */
+    class LatencyHistogram
+    {
+    public:
+        /**
+         * \brief The amount of bits of a latency, that are kept.
+         */
+        static const unsigned int PRECISION = 8;
+
+        /**
+         * \brief The amount of bits of the largest distinguished latency.
+         */
+        static const unsigned int RANGE = 40;
+
+        /**
+         * \brief The amount of buckets.
+         */
+        static const size_t BUCKETS =
+            (1 << PRECISION) + (RANGE - PRECISION) * (1 << (PRECISION - 1));
+
+        /**
+         * \brief Creates a new, empty LatencyHistogram.
+         */
+        LatencyHistogram ();
+
+        /**
+         * \brief Destroys the LatencyHistogram.
+         */
+        virtual ~LatencyHistogram ();
+
+        /**
+         * \brief Records a latency.
+         *
+         * \param nanoseconds The latency in nanoseconds.
+         */
+        void record (uint64_t nanoseconds);
+
+        /**
+         * \brief Adds the latencies of another LatencyHistogram.
+         *
+         * \param histogram The LatencyHistogram to add the latencies of.
+         */
+        void add (const LatencyHistogram& histogram);
+
+        /**
+         * \brief Removes all recorded latencies.
+         */
+        void reset ();
+
+        /**
+         * \brief Gets the amount of recorded latencies.
+         *
+         * \return The amount of recorded latencies.
+         */
+        uint64_t getCount () const;
+
+        /**
+         * \brief Gets the lowest recorded latency.
+         *
+         * \return The lowest latency in nanoseconds or 0, if no latency was
+         * recorded.
+         */
+        uint64_t getMin () const;
+
+        /**
+         * \brief Gets the highest recorded latency.
+         *
+         * \return The highest latency in nanoseconds or 0, if no latency
+         * was recorded.
+         */
+        uint64_t getMax () const;
+
+        /**
+         * \brief Gets the mean of the recorded latencies.
+         *
+         * \return The mean latency in nanoseconds or 0, if no latency was
+         * recorded.
+         */
+        double getMean () const;
+
+        /**
+         * \brief Gets the latency, which is not exceeded by a percentage
+         * of the recorded latencies.
+         *
+         * \param percentile The percentage of the latencies, between 0
+         * and 100, e.g. 99.9 for the p99.9 latency.
+         * \return The highest latency within the bucket of the percentile
+         * in nanoseconds, but not more than getMax(). If no latency was
+         * recorded, 0 is returned.
+         * \exception invalid_argument Thrown, if percentile is not within
+         * the range 0 to 100.
+         */
+        uint64_t getPercentile (double percentile) const;
+
+        /**
+         * \brief Gets the amount of latencies within a bucket.
+         *
+         * \param bucket The index of the bucket.
+         * \return The amount of latencies.
+         * \exception out_of_range Thrown, if bucket is not less than
+         * BUCKETS.
+         */
+        uint64_t getBucketCount (size_t bucket) const;
+
+        /**
+         * \brief Gets the highest latency counted in a bucket.
+         *
+         * \param bucket The index of the bucket.
+         * \return The highest latency of the bucket in nanoseconds.
+         * \exception out_of_range Thrown, if bucket is not less than
+         * BUCKETS.
+         */
+        static uint64_t getBucketLimit (size_t bucket);
+
+        /**
+         * \brief Gets the bucket, in which a latency is counted.
+         *
+         * \param nanoseconds The latency in nanoseconds.
+         * \return The index of the bucket.
+         */
+        static size_t getBucket (uint64_t nanoseconds);
+
+    protected:
+
+        /**
+         * \brief The amount of latencies per bucket.
+         */
+        std::atomic<uint64_t> _buckets[BUCKETS];
+
+        /**
+         * \brief The amount of recorded latencies.
+         */
+        std::atomic<uint64_t> _count;
+
+        /**
+         * \brief The sum of the recorded latencies.
+         */
+        std::atomic<uint64_t> _sum;
+
+        /**
+         * \brief The lowest recorded latency.
+         */
+        std::atomic<uint64_t> _min;
+
+        /**
+         * \brief The highest recorded latency.
+         */
+        std::atomic<uint64_t> _max;
+
+    private:
+        LatencyHistogram (const LatencyHistogram&);
+        LatencyHistogram& operator= (const LatencyHistogram&);
+    };
+
+} // namespace
+
+#endif /* _LATENCYHISTOGRAM_H_ */
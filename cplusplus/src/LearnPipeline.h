@@ -0,0 +1,783 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _LEARNPIPELINE_H_
+#define _LEARNPIPELINE_H_
+
+/*
+ * The LearnPipeline requires C++20 coroutines and is only available, if
+ * the including code is compiled with them. It consists of templates and
+ * inline functions only, so that the library itself does not need to be
+ * built with C++20.
+ */
+#if defined(__cpp_impl_coroutine) && __cpp_impl_coroutine >= 201902L
+
+#include <coroutine>
+#include <exception>
+#include <mutex>
+#include <condition_variable>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "LearnSystem.h"
+#include "ThreadPool.h"
+#include "ReplicatedWeights.h"
+#include "ScriptHandle.h"
+#include "WeightMaintenance.h"
+
+namespace dynrules
+{
+    class LearnPipeline;
+
+    /**
+     * \brief A coroutine, which is executed by a LearnPipeline.
+     *
+     * LearnTask is the return type for coroutines using the awaitables of
+     * LearnPipeline. A LearnTask does not start, before it was passed to
+     * LearnPipeline::spawn().
+     *
+     * \code
+     *   LearnTask encounter (LearnPipeline& pipeline, Game& game)
+     *   {
+     *       std::string script = co_await pipeline.generate (8);
+     *       std::vector<size_t> used;
+     *       double fitness = game.play (script, used);
+     *       co_await pipeline.update (used, &fitness);
+     *   }
+     * \endcode
+     */
+    class LearnTask
+    {
+    public:
+        struct promise_type;
+        typedef std::coroutine_handle<promise_type> Handle;
+
+        /**
+         * \brief Creates an empty LearnTask.
+         */
+        LearnTask () : _handle()
+        {
+        }
+
+        /**
+         * \brief Takes over the coroutine of another LearnTask.
+         *
+         * \param task The LearnTask to take the coroutine from.
+         */
+        LearnTask (LearnTask&& task) noexcept : _handle(task._handle)
+        {
+            task._handle = Handle ();
+        }
+
+        /**
+         * \brief Destroys the LearnTask and its coroutine, if it was not
+         * passed to a LearnPipeline.
+         */
+        ~LearnTask ()
+        {
+            if (this->_handle)
+                this->_handle.destroy ();
+        }
+
+        /**
+         * \brief Releases the coroutine of the LearnTask.
+         *
+         * \return The coroutine, which has to be destroyed by the caller.
+         */
+        Handle release ()
+        {
+            Handle handle = this->_handle;
+            this->_handle = Handle ();
+            return handle;
+        }
+
+    private:
+        explicit LearnTask (Handle handle) : _handle(handle)
+        {
+        }
+
+        LearnTask (const LearnTask&);
+        LearnTask& operator= (const LearnTask&);
+
+        Handle _handle;
+
+        friend struct promise_type;
+    };
+
+    /**
+     * \brief A result, which is provided by a different thread or an
+     * event loop and awaited by a LearnTask via LearnPipeline::wait().
+     */
+    class PendingResult
+    {
+    public:
+        /**
+         * \brief Creates a new, incomplete PendingResult.
+         */
+        PendingResult () : _value(0), _done(false), _waiter()
+        {
+        }
+
+    private:
+        PendingResult (const PendingResult&);
+        PendingResult& operator= (const PendingResult&);
+
+        void *_value;
+        bool _done;
+        std::coroutine_handle<> _waiter;
+
+        friend class LearnPipeline;
+    };
+
+    /**
+     * \brief Executes coroutines creating scripts and learning from their
+     * results on a ThreadPool.
+     *
+     * The LearnPipeline executes the spawned LearnTask coroutines in
+     * rounds. In each round, the weight updates awaited via update() are
+     * applied in one pass via RuleSet::applyUpdates() and all coroutines,
+     * which can continue, are resumed in parallel on the ThreadPool. The
+     * evaluation of the scripts thus overlaps with the script generation
+     * of other coroutines, while the weights are only changed between the
+     * rounds.
+     *
+     * Scripts awaited via generate() are created in the following round,
+     * so that they use the weights including all updates collected so far.
+     * Each coroutine creates its scripts within its own ScriptHandle, so
+     * that the coroutines resumed in parallel do not contend for the random
+     * number generator of the LearnSystem.
+     *
+     * The LearnSystem and its RuleSet must not be changed by other threads
+     * while run() is executed.
+     */
+    class LearnPipeline
+    {
+    public:
+        /**
+         * \brief Awaitable returned by generate().
+         */
+        class GenerateAwaiter
+        {
+        public:
+            bool await_ready () const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend (LearnTask::Handle handle);
+
+            std::string await_resume () const
+            {
+                this->_pipeline->_lsystem->createRules (*this->_handle,
+                    this->_maxrules);
+                return this->_handle->getScript ();
+            }
+
+        private:
+            GenerateAwaiter (LearnPipeline* pipeline, unsigned int maxrules) :
+                _pipeline(pipeline),
+                _maxrules(maxrules),
+                _handle(0)
+            {
+            }
+
+            LearnPipeline *_pipeline;
+            unsigned int _maxrules;
+            ScriptHandle *_handle;
+
+            friend class LearnPipeline;
+        };
+
+        /**
+         * \brief Awaitable returned by update().
+         */
+        class UpdateAwaiter
+        {
+        public:
+            bool await_ready () const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend (std::coroutine_handle<> handle)
+            {
+                this->_pipeline->enqueue (this->_update, handle);
+            }
+
+            void await_resume () const noexcept
+            {
+            }
+
+        private:
+            UpdateAwaiter (LearnPipeline* pipeline, const size_t* used,
+                size_t count, void* fitness) :
+                _pipeline(pipeline),
+                _update()
+            {
+                this->_update.fitness = fitness;
+                this->_update.used = used;
+                this->_update.count = count;
+            }
+
+            LearnPipeline *_pipeline;
+            WeightUpdate _update;
+
+            friend class LearnPipeline;
+        };
+
+        /**
+         * \brief Awaitable returned by wait().
+         */
+        class ResultAwaiter
+        {
+        public:
+            bool await_ready () const
+            {
+                std::lock_guard<std::mutex> guard (this->_pipeline->_lock);
+                return this->_result->_done;
+            }
+
+            bool await_suspend (std::coroutine_handle<> handle)
+            {
+                std::lock_guard<std::mutex> guard (this->_pipeline->_lock);
+                if (this->_result->_done)
+                    return false;
+                this->_result->_waiter = handle;
+                return true;
+            }
+
+            void* await_resume () const
+            {
+                return this->_result->_value;
+            }
+
+        private:
+            ResultAwaiter (LearnPipeline* pipeline, PendingResult* result) :
+                _pipeline(pipeline),
+                _result(result)
+            {
+            }
+
+            LearnPipeline *_pipeline;
+            PendingResult *_result;
+
+            friend class LearnPipeline;
+        };
+
+        /**
+         * \brief Creates a new LearnPipeline.
+         *
+         * \param lsystem The LearnSystem to create the scripts with and to
+         * update the RuleSet of.
+         * \param pool The ThreadPool to resume the coroutines on or 0 to
+         * resume them on the thread calling run().
+         * \param batchsize The minimum amount of updates to collect, before
+         * they are applied. Fewer updates are applied, if no coroutine
+         * could continue otherwise.
+         * \exception invalid_argument Thrown, if lsystem is NULL.
+         */
+        LearnPipeline (LearnSystem* lsystem, ThreadPool* pool = 0,
+            size_t batchsize = 1) :
+            _lsystem(lsystem),
+            _pool(pool),
+            _batchsize(batchsize),
+            _maintenance(0),
+            _budget(0),
+            _tasks(0),
+            _all(),
+            _ready(),
+            _updates(),
+            _waiters(),
+            _finished(),
+            _lock(),
+            _cond()
+        {
+            if (lsystem == 0)
+                throw std::invalid_argument ("lsystem must not be NULL");
+        }
+
+        /**
+         * \brief Destroys the LearnPipeline and all unfinished coroutines.
+         */
+        virtual ~LearnPipeline ()
+        {
+            size_t i;
+
+            for (i = 0; i < this->_all.size (); i++)
+                this->_all[i].destroy ();
+        }
+
+        /**
+         * \brief Gets the amount of unfinished coroutines.
+         *
+         * \return The amount of unfinished coroutines.
+         */
+        size_t getTasks () const
+        {
+            std::lock_guard<std::mutex> guard (this->_lock);
+            return this->_tasks;
+        }
+
+        /**
+         * \brief Gets the WeightMaintenance, which is run between the
+         * rounds.
+         *
+         * \return The WeightMaintenance or 0.
+         */
+        WeightMaintenance* getMaintenance () const
+        {
+            return this->_maintenance;
+        }
+
+        /**
+         * \brief Sets the WeightMaintenance, which is run between the
+         * rounds.
+         *
+         * Each round of run() calls WeightMaintenance::step() after
+         * applying the collected updates, while no coroutine creates
+         * scripts.
+         *
+         * \param maintenance The WeightMaintenance or 0 to not maintain the
+         * weights. It will not be freed by the LearnPipeline.
+         * \param microseconds The time budget per round.
+         * \exception invalid_argument Thrown, if the WeightMaintenance does
+         * not maintain the RuleSet of the LearnSystem.
+         */
+        void setMaintenance (WeightMaintenance* maintenance,
+            unsigned int microseconds = 100)
+        {
+            if (maintenance != 0 &&
+                maintenance->getRuleSet () != this->_lsystem->getRuleSet ())
+                throw std::invalid_argument
+                    ("maintenance must use the RuleSet of the LearnSystem");
+            this->_maintenance = maintenance;
+            this->_budget = microseconds;
+        }
+
+        /**
+         * \brief Adds a coroutine to the LearnPipeline.
+         *
+         * The coroutine will be started by the next round of run().
+         *
+         * \param task The coroutine to add.
+         * \exception invalid_argument Thrown, if task is empty.
+         */
+        void spawn (LearnTask task);
+
+        /**
+         * \brief Creates a script in the next round.
+         *
+         * \param maxrules The maximum amount of rules to add to the script.
+         * \return An awaitable, which results in the script.
+         */
+        GenerateAwaiter generate (unsigned int maxrules)
+        {
+            return GenerateAwaiter (this, maxrules);
+        }
+
+        /**
+         * \brief Updates the weights for the result of an encounter.
+         *
+         * The coroutine is resumed after the update was applied together
+         * with the other collected updates. The used rules and the fitness
+         * must stay valid until then, which is the case for locals of the
+         * awaiting coroutine.
+         *
+         * \param used The indices of the rules used in the encounter.
+         * \param count The amount of indices.
+         * \param fitness The fitness to pass to
+         * RuleSet::calculateAdjustment().
+         * \return An awaitable, which results in no value.
+         */
+        UpdateAwaiter update (const size_t* used, size_t count, void* fitness)
+        {
+            return UpdateAwaiter (this, used, count, fitness);
+        }
+
+        /**
+         * \brief Updates the weights for the result of an encounter.
+         *
+         * \param used The indices of the rules used in the encounter.
+         * \param fitness The fitness to pass to
+         * RuleSet::calculateAdjustment().
+         * \return An awaitable, which results in no value.
+         */
+        UpdateAwaiter update (const std::vector<size_t>& used, void* fitness)
+        {
+            return UpdateAwaiter (this, used.empty () ? 0 : &used[0],
+                used.size (), fitness);
+        }
+
+        /**
+         * \brief Waits for a result provided via complete().
+         *
+         * \param result The PendingResult to wait for.
+         * \return An awaitable, which results in the value passed to
+         * complete().
+         */
+        ResultAwaiter wait (PendingResult& result)
+        {
+            return ResultAwaiter (this, &result);
+        }
+
+        /**
+         * \brief Completes a PendingResult and resumes the coroutine
+         * waiting for it in the next round.
+         *
+         * This can be called from any thread.
+         *
+         * \param result The PendingResult to complete.
+         * \param value The value of the result.
+         */
+        void complete (PendingResult& result, void* value);
+
+        /**
+         * \brief Executes the coroutines until all of them finished.
+         *
+         * Blocks, while all unfinished coroutines wait for a PendingResult.
+         * If the LearnSystem uses ReplicatedWeights, they are refreshed
+         * after the weights were changed within a round.
+         *
+         * \return The amount of rounds executed.
+         * \exception exception The first exception thrown by a coroutine or
+         * RuleSet::applyUpdates(), which is rethrown after the current
+         * round. The other coroutines are continued by the next call to
+         * run(), the coroutines waiting for failed updates are resumed
+         * nonetheless.
+         */
+        size_t run ();
+
+    protected:
+
+        /**
+         * \brief Resumes a coroutine in the next round.
+         *
+         * \param handle The coroutine to resume.
+         */
+        void schedule (std::coroutine_handle<> handle)
+        {
+            std::lock_guard<std::mutex> guard (this->_lock);
+            this->_ready.push_back (handle);
+            this->_cond.notify_all ();
+        }
+
+        /**
+         * \brief Collects a weight update.
+         *
+         * \param update The weight update.
+         * \param handle The coroutine to resume after applying the update.
+         */
+        void enqueue (const WeightUpdate& update,
+            std::coroutine_handle<> handle)
+        {
+            std::lock_guard<std::mutex> guard (this->_lock);
+            this->_updates.push_back (update);
+            this->_waiters.push_back (handle);
+            this->_cond.notify_all ();
+        }
+
+        /**
+         * \brief Marks a coroutine as finished.
+         *
+         * \param handle The finished coroutine.
+         */
+        void finish (LearnTask::Handle handle)
+        {
+            std::lock_guard<std::mutex> guard (this->_lock);
+            this->_finished.push_back (handle);
+        }
+
+        /**
+         * \brief The LearnSystem to create the scripts with.
+         */
+        LearnSystem *_lsystem;
+
+        /**
+         * \brief The ThreadPool to resume the coroutines on.
+         */
+        ThreadPool *_pool;
+
+        /**
+         * \brief The minimum amount of updates to apply at once.
+         */
+        size_t _batchsize;
+
+        /**
+         * \brief The WeightMaintenance to run between the rounds.
+         */
+        WeightMaintenance *_maintenance;
+
+        /**
+         * \brief The time budget of the WeightMaintenance per round in
+         * microseconds.
+         */
+        unsigned int _budget;
+
+        /**
+         * \brief The amount of unfinished coroutines.
+         */
+        size_t _tasks;
+
+        /**
+         * \brief All unfinished coroutines.
+         */
+        std::vector<LearnTask::Handle> _all;
+
+        /**
+         * \brief The coroutines to resume in the next round.
+         */
+        std::vector<std::coroutine_handle<> > _ready;
+
+        /**
+         * \brief The collected weight updates.
+         */
+        std::vector<WeightUpdate> _updates;
+
+        /**
+         * \brief The coroutines waiting for the collected weight updates.
+         */
+        std::vector<std::coroutine_handle<> > _waiters;
+
+        /**
+         * \brief The coroutines finished in the current round.
+         */
+        std::vector<LearnTask::Handle> _finished;
+
+        /**
+         * \brief Guards the queues of the LearnPipeline.
+         */
+        mutable std::mutex _lock;
+
+        /**
+         * \brief Signals new work for run().
+         */
+        std::condition_variable _cond;
+
+    private:
+        LearnPipeline (const LearnPipeline&);
+        LearnPipeline& operator= (const LearnPipeline&);
+
+        friend struct LearnTask::promise_type;
+    };
+
+    /**
+     * \brief The promise of a LearnTask.
+     */
+    struct LearnTask::promise_type
+    {
+        /**
+         * \brief Notifies the LearnPipeline about the finished coroutine.
+         */
+        struct FinalAwaiter
+        {
+            bool await_ready () const noexcept
+            {
+                return false;
+            }
+
+            void await_suspend (Handle handle) noexcept
+            {
+                handle.promise ().pipeline->finish (handle);
+            }
+
+            void await_resume () const noexcept
+            {
+            }
+        };
+
+        promise_type () : pipeline(0), error(), script()
+        {
+        }
+
+        LearnTask get_return_object ()
+        {
+            return LearnTask (Handle::from_promise (*this));
+        }
+
+        std::suspend_always initial_suspend () const noexcept
+        {
+            return std::suspend_always ();
+        }
+
+        FinalAwaiter final_suspend () const noexcept
+        {
+            return FinalAwaiter ();
+        }
+
+        void return_void () const noexcept
+        {
+        }
+
+        void unhandled_exception ()
+        {
+            this->error = std::current_exception ();
+        }
+
+        /**
+         * \brief The LearnPipeline executing the coroutine.
+         */
+        LearnPipeline *pipeline;
+
+        /**
+         * \brief The exception thrown by the coroutine.
+         */
+        std::exception_ptr error;
+
+        /**
+         * \brief The ScriptHandle to create the scripts of the coroutine
+         * in.
+         */
+        ScriptHandle script;
+
+    private:
+        promise_type (const promise_type&);
+        promise_type& operator= (const promise_type&);
+    };
+
+    inline void LearnPipeline::GenerateAwaiter::await_suspend
+        (LearnTask::Handle handle)
+    {
+        this->_handle = &handle.promise ().script;
+        this->_pipeline->schedule (handle);
+    }
+
+    inline void LearnPipeline::spawn (LearnTask task)
+    {
+        LearnTask::Handle handle = task.release ();
+
+        if (!handle)
+            throw std::invalid_argument ("task must not be empty");
+        handle.promise ().pipeline = this;
+
+        std::lock_guard<std::mutex> guard (this->_lock);
+        this->_all.push_back (handle);
+        this->_tasks++;
+        this->_ready.push_back (handle);
+        this->_cond.notify_all ();
+    }
+
+    inline void LearnPipeline::complete (PendingResult& result, void* value)
+    {
+        std::lock_guard<std::mutex> guard (this->_lock);
+
+        result._value = value;
+        result._done = true;
+        if (result._waiter)
+        {
+            this->_ready.push_back (result._waiter);
+            result._waiter = std::coroutine_handle<> ();
+            this->_cond.notify_all ();
+        }
+    }
+
+    /*
+     * run() is entered once for all rounds, so keep it out of line instead
+     * of expanding it into the caller.
+     */
+    [[gnu::noinline]] inline size_t LearnPipeline::run ()
+    {
+        std::vector<std::coroutine_handle<> > ready;
+        std::vector<WeightUpdate> updates;
+        std::vector<std::coroutine_handle<> > waiters;
+        std::vector<LearnTask::Handle> finished;
+        std::exception_ptr error;
+        ReplicatedWeights *replicas;
+        size_t i, j, rounds = 0;
+        bool changed;
+
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> guard (this->_lock);
+                while (this->_tasks > 0 && this->_ready.empty () &&
+                    this->_updates.empty ())
+                    this->_cond.wait (guard);
+                if (this->_tasks == 0)
+                    break;
+
+                ready.swap (this->_ready);
+                /*
+                 * Keep collecting updates, as long as there are enough
+                 * coroutines to continue with.
+                 */
+                if (this->_updates.size () >= this->_batchsize ||
+                    ready.empty ())
+                {
+                    updates.swap (this->_updates);
+                    waiters.swap (this->_waiters);
+                }
+            }
+
+            changed = !updates.empty () || this->_maintenance != 0;
+            if (!updates.empty ())
+            {
+                try
+                {
+                    this->_lsystem->getRuleSet ()->applyUpdates (&updates[0],
+                        updates.size ());
+                }
+                catch (...)
+                {
+                    /* Keep the coroutines going, the caller gets the error. */
+                    error = std::current_exception ();
+                }
+                ready.insert (ready.end (), waiters.begin (), waiters.end ());
+                updates.clear ();
+                waiters.clear ();
+            }
+            if (this->_maintenance != 0)
+                this->_maintenance->step (this->_budget);
+            replicas = this->_lsystem->getReplicatedWeights ();
+            if (changed && replicas != 0)
+                replicas->refresh ();
+
+            if (this->_pool != 0)
+                this->_pool->run (ready.size (), [&ready] (size_t index)
+                    {
+                        ready[index].resume ();
+                    });
+            else
+            {
+                for (i = 0; i < ready.size (); i++)
+                    ready[i].resume ();
+            }
+            ready.clear ();
+            rounds++;
+
+            {
+                std::lock_guard<std::mutex> guard (this->_lock);
+                finished.swap (this->_finished);
+                for (i = 0; i < finished.size (); i++)
+                {
+                    if (!error)
+                        error = finished[i].promise ().error;
+                    for (j = 0; j < this->_all.size (); j++)
+                    {
+                        if (this->_all[j] == finished[i])
+                        {
+                            this->_all[j] = this->_all.back ();
+                            this->_all.pop_back ();
+                            break;
+                        }
+                    }
+                    finished[i].destroy ();
+                    this->_tasks--;
+                }
+            }
+            finished.clear ();
+            if (error)
+                std::rethrow_exception (error);
+        }
+        return rounds;
+    }
+
+} // namespace
+
+#endif /* __cpp_impl_coroutine */
+
+#endif /* _LEARNPIPELINE_H_ */
@@ -7,42 +7,465 @@
  */
 
 #include <ctime>
+#include <chrono>
+#include <algorithm>
 #include <stdexcept>
 #include "LearnSystem.h"
+#include "CodeCache.h"
+#include "CodeStore.h"
+#include "ScriptHandle.h"
+#include "ReplayLog.h"
+#include "ReplicatedWeights.h"
+#include "Selection.h"
 
 namespace dynrules
 {
 
+typedef std::chrono::steady_clock _Clock;
+
+/*
+ * Gets the nanoseconds elapsed since start.
+ */
+static uint64_t _elapsed (_Clock::time_point start)
+{
+    return static_cast<uint64_t>(std::chrono::duration_cast
+        <std::chrono::nanoseconds>(_Clock::now () - start).count ());
+}
+
+/*
+ * Rule selectors for _create_rules(), so that the roulette wheel, greedy
+ * and softmax selection can work on the Rule objects as well as on a
+ * WeightOverlay instance.
+ */
+struct _RuleSelector
+{
+    const RuleSet *ruleset;
+
+    double operator() (size_t index) const
+    {
+        return ruleset->getRule (index)->getWeight ();
+    }
+
+    size_t operator() (double fraction) const
+    {
+        return ruleset->selectRule (fraction);
+    }
+
+    size_t best (size_t* indices, size_t count) const
+    {
+        return selectBestRules (*this, ruleset->getCount (), indices, count);
+    }
+
+    size_t softmax (double fraction, double temperature) const
+    {
+        return selectSoftmaxRule (*this, ruleset->getCount (),
+            ruleset->getMaxWeight (), fraction, temperature);
+    }
+};
+
+struct _OverlaySelector
+{
+    const WeightOverlay *weights;
+
+    size_t operator() (double fraction) const
+    {
+        return weights->selectRule (fraction);
+    }
+
+    size_t best (size_t* indices, size_t count) const
+    {
+        return weights->selectBest (indices, count);
+    }
+
+    size_t softmax (double fraction, double temperature) const
+    {
+        return weights->selectSoftmax (fraction, temperature);
+    }
+};
+
+/*
+ * The settings and buffers of the LearnSystem used by _create_rules().
+ */
+struct _Generation
+{
+    CodeCache *codecache;
+    CodeStore *codestore;
+    unsigned int maxtries;
+    unsigned int maxscriptsize;
+    LearnSystem::SelectionMode mode;
+    double temperature;
+    bool ordered;
+    std::mt19937 *random;
+    XorShift *handlerandom;
+    ReplayLog *log;
+    std::vector<int> *ids;
+    std::vector<size_t> *ranked;
+    std::vector<uint64_t> *order;
+    std::vector<size_t> *selected;
+    bool limited;
+    _Clock::time_point deadline;
+    std::string *pending;
+    std::vector<size_t> *pendingoffsets;
+};
+
+/*
+ * Appends the code of a rule. If code is 0, the compressed code of the
+ * CodeStore is decompressed directly into the script.
+ */
+template <typename String>
+static void _emit_rule (String& retval, const Rule* rule, const char* code,
+    size_t length, const _Generation& gen)
+{
+    if (code == 0)
+        gen.codestore->appendCode (retval, rule->getId ());
+    else
+        retval.append (code, length);
+    if (gen.log != 0)
+        gen.ids->push_back (rule->getId ());
+}
+
+/*
+ * Appends the code of a rule, if it fits into the script. If the rules
+ * shall be ordered by their priority, the rule index is kept in
+ * gen.ranked instead, starting at position.
+ *
+ * The code of each rule is fetched once. Code of the CodeCache is only
+ * valid until its next use, so it is kept in gen.pending, if the rules
+ * are ordered.
+ */
+template <typename String>
+static bool _add_rule (String& retval, const RuleSet& ruleset, size_t index,
+    const _Generation& gen, size_t& written, size_t position)
+{
+    const Rule *rule = ruleset.getRule (index);
+    const std::string *code = 0;
+    size_t len;
+
+    if (gen.codestore != 0)
+        len = gen.codestore->getLength (rule->getId ());
+    else
+    {
+        code = (gen.codecache != 0) ?
+            &gen.codecache->getCode (rule->getId ()) : &rule->getCode ();
+        len = code->size ();
+    }
+
+    if (written + len > static_cast<size_t>(gen.maxscriptsize))
+        return false;
+    written += len;
+    if (gen.selected != 0)
+        gen.selected->push_back (index);
+    if (!gen.ordered)
+    {
+        _emit_rule (retval, rule, code ? code->data () : 0, len, gen);
+        return true;
+    }
+
+    if (position < gen.ranked->size ())
+        (*gen.ranked)[position] = index;
+    else
+        gen.ranked->push_back (index);
+    if (gen.codecache != 0)
+    {
+        std::vector<size_t>& offsets = *gen.pendingoffsets;
+
+        if (position == 0)
+            gen.pending->clear ();
+        if (position < offsets.size ())
+            offsets[position] = gen.pending->size ();
+        else
+            offsets.push_back (gen.pending->size ());
+        gen.pending->append (*code);
+    }
+    return true;
+}
+
+/*
+ * Appends the code of the first count rules of gen.ranked ordered by
+ * their descending priority. Rules of the same priority keep the order,
+ * in which they were selected.
+ *
+ * Instead of comparing the rules, their priorities are sorted via a LSD
+ * radix sort over the bytes, that differ between the rules. The scripts
+ * usually only use few, small priorities, so that a single counting pass
+ * over a buffer of maxrules entries is needed.
+ */
+template <typename String>
+static void _emit_ordered (String& retval, const RuleSet& ruleset,
+    size_t count, const _Generation& gen)
+{
+    std::vector<size_t>& ranked = *gen.ranked;
+    std::vector<uint64_t>& order = *gen.order;
+    uint64_t *src, *dst, *tmp;
+    uint32_t key, first = 0, differ = 0;
+    size_t i, buckets[256];
+    unsigned int shift, digit;
+
+    if (count == 0)
+        return;
+    if (order.size () < 2 * count)
+        order.resize (2 * count);
+    src = &order[0];
+    dst = src + count;
+
+    for (i = 0; i < count; i++)
+    {
+        /*
+         * Flip the sign bit to keep the order of the signed priorities and
+         * invert the key, so that higher priorities come first. The
+         * position within ranked is kept in the lower bits.
+         */
+        key = ~(static_cast<uint32_t>(
+                ruleset.getRule (ranked[i])->getPriority ()) ^ 0x80000000u);
+        if (i == 0)
+            first = key;
+        differ |= key ^ first;
+        src[i] = (static_cast<uint64_t>(key) << 32) | i;
+    }
+
+    for (shift = 32; shift < 64; shift += 8)
+    {
+        if (((differ >> (shift - 32)) & 0xff) == 0)
+            continue;
+
+        std::fill (buckets, buckets + 256, 0);
+        for (i = 0; i < count; i++)
+            buckets[(src[i] >> shift) & 0xff]++;
+        for (digit = 0, i = 0; digit < 256; digit++)
+        {
+            size_t amount = buckets[digit];
+            buckets[digit] = i;
+            i += amount;
+        }
+        for (i = 0; i < count; i++)
+            dst[buckets[(src[i] >> shift) & 0xff]++] = src[i];
+
+        tmp = src;
+        src = dst;
+        dst = tmp;
+    }
+
+    for (i = 0; i < count; i++)
+    {
+        size_t position = src[i] & 0xffffffffu;
+        const Rule *rule = ruleset.getRule (ranked[position]);
+
+        if (gen.codestore != 0)
+            _emit_rule (retval, rule, 0, 0, gen);
+        else if (gen.codecache != 0)
+        {
+            const std::vector<size_t>& offsets = *gen.pendingoffsets;
+            size_t end = (position + 1 < count) ?
+                offsets[position + 1] : gen.pending->size ();
+
+            _emit_rule (retval, rule, gen.pending->data () +
+                offsets[position], end - offsets[position], gen);
+        }
+        else
+            _emit_rule (retval, rule, rule->getCode ().data (),
+                rule->getCode ().size (), gen);
+    }
+}
+
+/*
+ * Gets the next random fraction for selecting a rule from the generator of
+ * the ScriptHandle or, if there is none, the one of the LearnSystem.
+ */
+static double _next_fraction (const _Generation& gen)
+{
+    if (gen.handlerandom != 0)
+        return static_cast<double>((*gen.handlerandom) ()) /
+            XorShift::max ();
+    return static_cast<double>((*gen.random) ()) / gen.random->max ();
+}
+
+template <typename String, typename RuleSelector>
+static void _create_rules (String& retval, const RuleSet& ruleset,
+    const RuleSelector& select, double weights, unsigned int maxrules,
+    const _Generation& gen)
+{
+    std::vector<size_t>& ranked = *gen.ranked;
+    unsigned int tries, i;
+    int added = 0;
+    size_t selected, count = 0, written = 0;
+    double fraction;
+
+    /* Also catches NaN totals, which no rule could be selected for. */
+    if (!(weights > 0) || maxrules == 0 || ruleset.getCount () == 0)
+        return;
+
+    /* ids, ranked and order keep their capacity between the calls. */
+    gen.ids->clear ();
+
+    if (gen.mode == LearnSystem::GREEDY)
+    {
+        ranked.resize (maxrules);
+        selected = select.best (&ranked[0], maxrules);
+        for (i = 0; i < selected; i++)
+        {
+            if (!_add_rule (retval, ruleset, ranked[i], gen, written, count))
+                break;
+            count++;
+        }
+        goto finish;
+    }
+
+    for (i = 0; i < maxrules; i++)
+    {
+        if (written >= static_cast<size_t>(gen.maxscriptsize))
+            break;
+        if (gen.limited && _Clock::now () >= gen.deadline)
+            break;
+
+        tries = added = 0;
+        while (tries < gen.maxtries && !added)
+        {
+            fraction = _next_fraction (gen);
+            if (gen.mode == LearnSystem::SOFTMAX)
+                selected = select.softmax (fraction, gen.temperature);
+            else
+                selected = select (fraction * weights);
+
+            /* Write the rule code */
+            if (!_add_rule (retval, ruleset, selected, gen, written, count))
+                goto finish;
+            count++;
+            added = 1;
+
+            tries++;
+            break;
+        }
+    }
+
+finish:
+    if (gen.ordered)
+        _emit_ordered (retval, ruleset, count, gen);
+    if (gen.log != 0)
+        gen.log->writeScript (gen.ids->empty () ? 0 : &(*gen.ids)[0],
+            gen.ids->size ());
+}
+
 LearnSystem::LearnSystem () :
     _maxtries (100),
     _maxscriptsize(1024),
-    _ruleset (new RuleSet(0,0))
+    _ruleset (new RuleSet(0,0)),
+    _weights(),
+    _codecache(0),
+    _codestore(0),
+    _seed(static_cast<unsigned int>(time (0))),
+    _random(_seed),
+    _randomlock(),
+    _epoch(0),
+    _replaylog(0),
+    _selected(),
+    _mode(ROULETTE),
+    _temperature(1),
+    _ranked(),
+    _ordered(false),
+    _order(),
+    _pending(),
+    _pendingoffsets(),
+    _timelimit(0),
+    _generationlatency(),
+    _updatelatency(),
+    _replicas(0)
 {
 }
 
 LearnSystem::LearnSystem (double minweight, double maxweight) :
     _maxtries (100),
     _maxscriptsize(1024),
-    _ruleset(new RuleSet (minweight, maxweight))
+    _ruleset(new RuleSet (minweight, maxweight)),
+    _weights(),
+    _codecache(0),
+    _codestore(0),
+    _seed(static_cast<unsigned int>(time (0))),
+    _random(_seed),
+    _randomlock(),
+    _epoch(0),
+    _replaylog(0),
+    _selected(),
+    _mode(ROULETTE),
+    _temperature(1),
+    _ranked(),
+    _ordered(false),
+    _order(),
+    _pending(),
+    _pendingoffsets(),
+    _timelimit(0),
+    _generationlatency(),
+    _updatelatency(),
+    _replicas(0)
 {
 }
 
 LearnSystem::LearnSystem (RuleSet* ruleset) :
     _maxtries(100),
     _maxscriptsize(1024),
-    _ruleset(ruleset)
+    _ruleset(ruleset),
+    _weights(),
+    _codecache(0),
+    _codestore(0),
+    _seed(static_cast<unsigned int>(time (0))),
+    _random(_seed),
+    _randomlock(),
+    _epoch(0),
+    _replaylog(0),
+    _selected(),
+    _mode(ROULETTE),
+    _temperature(1),
+    _ranked(),
+    _ordered(false),
+    _order(),
+    _pending(),
+    _pendingoffsets(),
+    _timelimit(0),
+    _generationlatency(),
+    _updatelatency(),
+    _replicas(0)
 {
 }
 
 LearnSystem::LearnSystem (const LearnSystem& lsystem) :
     _maxtries(lsystem.getMaxTries ()),
     _maxscriptsize(lsystem.getMaxScriptSize ()),
-    _ruleset(new RuleSet (*(lsystem.getRuleSet())))
+    _ruleset(new RuleSet (*(lsystem.getRuleSet()))),
+    _weights(),
+    _codecache(lsystem.getCodeCache ()),
+    _codestore(lsystem.getCodeStore ()),
+    _seed(lsystem.getSeed ()),
+    _random(lsystem._random),
+    _randomlock(),
+    _epoch(0),
+    _replaylog(0),
+    _selected(),
+    _mode(lsystem.getSelectionMode ()),
+    _temperature(lsystem.getTemperature ()),
+    _ranked(),
+    _ordered(lsystem.getOrderByPriority ()),
+    _order(),
+    _pending(),
+    _pendingoffsets(),
+    _timelimit(lsystem.getTimeLimit ()),
+    _generationlatency(),
+    _updatelatency(),
+    _replicas(0)
 {
+    std::map<std::string, RuleWeights*>::const_iterator iter;
+    for (iter = lsystem._weights.begin (); iter != lsystem._weights.end ();
+        iter++)
+    {
+        this->_weights[iter->first] =
+            new RuleWeights (this->_ruleset, *(iter->second));
+    }
 }
 
 LearnSystem::~LearnSystem ()
 {
+    std::map<std::string, RuleWeights*>::iterator iter;
+    for (iter = this->_weights.begin (); iter != this->_weights.end (); iter++)
+        delete iter->second;
+    this->_weights.clear ();
     delete this->_ruleset;
 }
 
@@ -56,6 +479,149 @@ void LearnSystem::setRuleSet (RuleSet* ruleset)
     if (ruleset == 0)
         throw new std::invalid_argument ("ruleset must not be NULL");
     this->_ruleset = ruleset;
+    if (this->_replicas != 0 && this->_replicas->getRuleSet () != ruleset)
+        this->_replicas = 0;
+
+    std::map<std::string, RuleWeights*>::iterator iter;
+    for (iter = this->_weights.begin (); iter != this->_weights.end (); iter++)
+        iter->second->setRuleSet (ruleset);
+}
+
+RuleWeights* LearnSystem::addRuleWeights (const std::string& name)
+{
+    RuleWeights *weights = new RuleWeights (this->_ruleset);
+
+    this->removeRuleWeights (name);
+    this->_weights[name] = weights;
+    return weights;
+}
+
+RuleWeights* LearnSystem::getRuleWeights (const std::string& name) const
+{
+    std::map<std::string, RuleWeights*>::const_iterator iter;
+
+    iter = this->_weights.find (name);
+    if (iter == this->_weights.end ())
+        return 0;
+    return iter->second;
+}
+
+bool LearnSystem::removeRuleWeights (const std::string& name)
+{
+    std::map<std::string, RuleWeights*>::iterator iter;
+
+    iter = this->_weights.find (name);
+    if (iter == this->_weights.end ())
+        return false;
+    delete iter->second;
+    this->_weights.erase (iter);
+    return true;
+}
+
+std::vector<std::string> LearnSystem::getRuleWeightsNames () const
+{
+    std::vector<std::string> names;
+    std::map<std::string, RuleWeights*>::const_iterator iter;
+
+    for (iter = this->_weights.begin (); iter != this->_weights.end (); iter++)
+        names.push_back (iter->first);
+    return names;
+}
+
+CodeCache* LearnSystem::getCodeCache () const
+{
+    return this->_codecache;
+}
+
+void LearnSystem::setCodeCache (CodeCache* codecache)
+{
+    this->_codecache = codecache;
+}
+
+CodeStore* LearnSystem::getCodeStore () const
+{
+    return this->_codestore;
+}
+
+void LearnSystem::setCodeStore (CodeStore* codestore)
+{
+    this->_codestore = codestore;
+}
+
+ReplicatedWeights* LearnSystem::getReplicatedWeights () const
+{
+    return this->_replicas;
+}
+
+void LearnSystem::setReplicatedWeights (ReplicatedWeights* replicas)
+{
+    if (replicas != 0 && replicas->getRuleSet () != this->_ruleset)
+        throw std::invalid_argument
+            ("replicas must replicate the RuleSet of the LearnSystem");
+    this->_replicas = replicas;
+    if (replicas != 0)
+        replicas->refresh ();
+}
+
+unsigned int LearnSystem::getSeed () const
+{
+    return this->_seed;
+}
+
+void LearnSystem::setSeed (unsigned int seed)
+{
+    std::lock_guard<std::mutex> guard (this->_randomlock);
+
+    this->_seed = seed;
+    this->_random.seed (seed);
+    this->_epoch++;
+    if (this->_replaylog != 0)
+        this->_replaylog->writeSeed (seed);
+}
+
+ReplayLog* LearnSystem::getReplayLog () const
+{
+    return this->_replaylog;
+}
+
+void LearnSystem::setReplayLog (ReplayLog* log)
+{
+    this->_replaylog = log;
+    this->_ruleset->setReplayLog (log);
+    if (log != 0)
+        this->setSeed (this->_seed);
+}
+
+LearnSystem::SelectionMode LearnSystem::getSelectionMode () const
+{
+    return this->_mode;
+}
+
+void LearnSystem::setSelectionMode (SelectionMode mode)
+{
+    this->_mode = mode;
+}
+
+double LearnSystem::getTemperature () const
+{
+    return this->_temperature;
+}
+
+void LearnSystem::setTemperature (double temperature)
+{
+    if (!(temperature > 0))
+        throw std::invalid_argument ("temperature must be greater than 0");
+    this->_temperature = temperature;
+}
+
+bool LearnSystem::getOrderByPriority () const
+{
+    return this->_ordered;
+}
+
+void LearnSystem::setOrderByPriority (bool ordered)
+{
+    this->_ordered = ordered;
 }
 
 unsigned int LearnSystem::getMaxTries () const
@@ -78,6 +644,32 @@ void LearnSystem::setMaxScriptSize (unsigned int maxscriptsize)
     this->_maxscriptsize = maxscriptsize;
 }
 
+unsigned int LearnSystem::getTimeLimit () const
+{
+    return this->_timelimit;
+}
+
+void LearnSystem::setTimeLimit (unsigned int microseconds)
+{
+    this->_timelimit = microseconds;
+}
+
+const LatencyHistogram& LearnSystem::getGenerationLatency () const
+{
+    return this->_generationlatency;
+}
+
+const LatencyHistogram& LearnSystem::getUpdateLatency () const
+{
+    return this->_updatelatency;
+}
+
+void LearnSystem::resetLatency ()
+{
+    this->_generationlatency.reset ();
+    this->_updatelatency.reset ();
+}
+
 std::string LearnSystem::createHeader () const
 {
     std::string retval = "";
@@ -92,69 +684,200 @@ std::string LearnSystem::createFooter () const
 
 std::string LearnSystem::createRules (unsigned int maxrules) const
 {
-    std::string buf, retval = "";
-    std::vector<Rule*> rules;
-    Rule *rule;
-    unsigned int tries, i;
-    unsigned long j;
-    int added = 0, selected;
-    size_t len, count, written = 0;
-    double wsum, fraction, weights = this->_ruleset->getWeight ();
+    std::string retval = "";
+    this->appendRules (retval, maxrules);
+    return retval;
+}
 
-    if (weights == 0 || maxrules == 0)
-        return retval;
+std::string LearnSystem::createRules (const std::string& name,
+    unsigned int maxrules) const
+{
+    RuleWeights *weights = this->getRuleWeights (name);
 
-    rules = this->_ruleset->getRules ();
-    count = rules.size ();
+    if (weights == 0)
+        throw std::invalid_argument ("no RuleWeights with such a name");
+    return this->createRules (*weights, maxrules);
+}
 
-    /* Initialise the random number generator */
-    srand (static_cast<unsigned int>(time (0)));
+std::string LearnSystem::createRules (const WeightOverlay& weights,
+    unsigned int maxrules) const
+{
+    std::string retval = "";
+    this->appendRules (retval, weights, maxrules);
+    return retval;
+}
 
-    for (i = 0; i < maxrules; i++)
+void LearnSystem::seedHandle (ScriptHandle& handle) const
+{
+    if (handle._seeder == this && handle._epoch == this->_epoch.load ())
+        return;
+
+    std::lock_guard<std::mutex> guard (this->_randomlock);
+    handle._random.seed
+        (static_cast<XorShift::result_type>(this->_random ()));
+    handle._seeder = this;
+    handle._epoch = this->_epoch.load ();
+}
+
+template <typename String>
+void LearnSystem::appendRulesTo (String& script, unsigned int maxrules,
+    ScriptHandle* handle) const
+{
+    if (this->_replicas != 0)
     {
-        if (written >= static_cast<size_t>(this->_maxscriptsize))
-            break;
+        ReplicaReader reader (*this->_replicas);
+        this->appendRulesTo (script, reader.getLocalReplica (), maxrules,
+            handle);
+        return;
+    }
 
-        tries = added = 0;
-        while (tries < this->_maxtries && !added)
-        {
-            j = 0;
-            selected = -1;
-            wsum = 0.;
-            fraction = ((static_cast<double>(rand())) / RAND_MAX) * weights;
-            while (selected == -1)
-            {
-                rule = rules.at (j);
-                wsum += rule->getWeight ();
-                if (wsum > fraction)
-                {
-                    selected = j;
-                    break;
-                }
-                j = ((j + 1) % count);
-            }
-
-            rule = rules.at (static_cast<unsigned int>(selected));
+    _Clock::time_point start = _Clock::now ();
+    std::unique_lock<std::mutex> guard (this->_randomlock, std::defer_lock);
+    _Generation gen = { this->_codecache, this->_codestore,
+        this->_maxtries, this->_maxscriptsize, this->_mode,
+        this->_temperature, this->_ordered, &this->_random, 0,
+        this->_replaylog, &this->_selected, &this->_ranked, &this->_order,
+        0, this->_timelimit != 0,
+        start + std::chrono::microseconds (this->_timelimit),
+        &this->_pending, &this->_pendingoffsets };
+    _RuleSelector select;
 
-            /* Write the rule code */
-            buf = rule->getCode ();
-            len = buf.size ();
-            /* Buffer acquired, write the raw data. */
-            if (written + len > static_cast<size_t>(this->_maxscriptsize))
-                goto finish;
-            retval.append (buf);
-            written += len;
-            added = 1;
+    if (handle != 0)
+    {
+        this->seedHandle (*handle);
+        gen.handlerandom = &handle->_random;
+        gen.ids = &handle->_ids;
+        gen.ranked = &handle->_ranked;
+        gen.order = &handle->_order;
+        gen.selected = &handle->_selected;
+    }
+    /* The CodeCache is not thread-safe, so keep serializing its use. */
+    if (handle == 0 || this->_codecache != 0)
+        guard.lock ();
 
-            tries++;
-            break;
-        }
+    select.ruleset = this->_ruleset;
+    _create_rules (script, *(this->_ruleset), select,
+        this->_ruleset->getWeight (), maxrules, gen);
+    this->_generationlatency.record (_elapsed (start));
+}
+
+template <typename String>
+void LearnSystem::appendRulesTo (String& script, const WeightOverlay& weights,
+    unsigned int maxrules, ScriptHandle* handle) const
+{
+    _Clock::time_point start = _Clock::now ();
+    std::unique_lock<std::mutex> guard (this->_randomlock, std::defer_lock);
+    _Generation gen = { this->_codecache, this->_codestore,
+        this->_maxtries, this->_maxscriptsize, this->_mode,
+        this->_temperature, this->_ordered, &this->_random, 0,
+        this->_replaylog, &this->_selected, &this->_ranked, &this->_order,
+        0, this->_timelimit != 0,
+        start + std::chrono::microseconds (this->_timelimit),
+        &this->_pending, &this->_pendingoffsets };
+    _OverlaySelector select;
+
+    if (handle != 0)
+    {
+        this->seedHandle (*handle);
+        gen.handlerandom = &handle->_random;
+        gen.ids = &handle->_ids;
+        gen.ranked = &handle->_ranked;
+        gen.order = &handle->_order;
+        gen.selected = &handle->_selected;
     }
+    if (handle == 0 || this->_codecache != 0)
+        guard.lock ();
 
-finish:
-    return retval;
+    select.weights = &weights;
+    _create_rules (script, *(weights.getRuleSet ()), select,
+        weights.getWeight (), maxrules, gen);
+    this->_generationlatency.record (_elapsed (start));
+}
+
+void LearnSystem::appendRules (std::string& script, unsigned int maxrules) const
+{
+    this->appendRulesTo (script, maxrules);
+}
+
+void LearnSystem::appendRules (std::string& script,
+    const WeightOverlay& weights, unsigned int maxrules) const
+{
+    this->appendRulesTo (script, weights, maxrules);
+}
+
+void LearnSystem::createRules (ScriptHandle& handle,
+    unsigned int maxrules) const
+{
+    handle.clear ();
+    handle._ruleset = this->_ruleset;
+    this->appendRulesTo (handle._script, maxrules, &handle);
 }
 
+void LearnSystem::createRules (ScriptHandle& handle,
+    const WeightOverlay& weights, unsigned int maxrules) const
+{
+    handle.clear ();
+    handle._ruleset = weights.getRuleSet ();
+    this->appendRulesTo (handle._script, weights, maxrules, &handle);
+}
+
+void LearnSystem::updateWeights (void *fitness)
+{
+    _Clock::time_point start = _Clock::now ();
+
+    this->_ruleset->updateWeights (fitness);
+    if (this->_replicas != 0)
+        this->_replicas->refresh ();
+    this->_updatelatency.record (_elapsed (start));
+}
+
+void LearnSystem::updateWeights (const ScriptHandle& handle, void *fitness)
+{
+    const std::vector<size_t>& used = handle.getUsedRules ();
+    WeightUpdate update = { fitness, used.empty () ? 0 : &used[0],
+        used.size () };
+
+    _Clock::time_point start = _Clock::now ();
+
+    if (handle.getRuleSet () != this->_ruleset)
+        throw std::invalid_argument
+            ("script was not created from the RuleSet");
+    this->_ruleset->applyUpdates (&update, 1);
+    if (this->_replicas != 0)
+        this->_replicas->refresh ();
+    this->_updatelatency.record (_elapsed (start));
+}
+
+void LearnSystem::updateWeights (const ScriptHandle& handle,
+    WeightOverlay& weights, void *fitness)
+{
+    const std::vector<size_t>& used = handle.getUsedRules ();
+    _Clock::time_point start = _Clock::now ();
+    size_t i;
+
+    if (handle.getRuleSet () != weights.getRuleSet ())
+        throw std::invalid_argument
+            ("script was not created from the RuleSet of the WeightOverlay");
+    for (i = 0; i < used.size (); i++)
+        weights.setUsed (used[i], true);
+    weights.updateWeights (fitness);
+    this->_updatelatency.record (_elapsed (start));
+}
+
+#if __cplusplus >= 201703L
+void LearnSystem::appendRules (std::pmr::string& script,
+    unsigned int maxrules) const
+{
+    this->appendRulesTo (script, maxrules);
+}
+
+void LearnSystem::appendRules (std::pmr::string& script,
+    const WeightOverlay& weights, unsigned int maxrules) const
+{
+    this->appendRulesTo (script, weights, maxrules);
+}
+#endif
+
 void LearnSystem::createScript (std::ostream& stream, unsigned int maxrules)
 {
     stream << this->createHeader () << std::endl;
@@ -163,4 +886,22 @@ void LearnSystem::createScript (std::ostream& stream, unsigned int maxrules)
     return;
 }
 
+void LearnSystem::createScript (std::ostream& stream, const std::string& name,
+    unsigned int maxrules)
+{
+    stream << this->createHeader () << std::endl;
+    stream << this->createRules (name, maxrules) << std::endl;
+    stream << this->createFooter () << std::endl;
+    return;
+}
+
+void LearnSystem::createScript (std::ostream& stream,
+    const WeightOverlay& weights, unsigned int maxrules)
+{
+    stream << this->createHeader () << std::endl;
+    stream << this->createRules (weights, maxrules) << std::endl;
+    stream << this->createFooter () << std::endl;
+    return;
+}
+
 } // namespace
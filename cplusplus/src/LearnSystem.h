@@ -10,11 +10,29 @@
 #define _LEARNSYSTEM_H_
 
 #include <iostream>
+#include <cstdint>
 #include <string>
+#include <map>
+#include <vector>
+#include <random>
+#include <mutex>
+#include <atomic>
+#if __cplusplus >= 201703L
+#include <memory_resource>
+#endif
 #include "RuleSet.h"
+#include "WeightOverlay.h"
+#include "RuleWeights.h"
+#include "LatencyHistogram.h"
 
 namespace dynrules
 {
+    class CodeCache;
+    class CodeStore;
+    class ScriptHandle;
+    class ReplayLog;
+    class ReplicatedWeights;
+
     /**
      * \brief The LearnSystem class generates scripts from RuleSet objects.
      *
@@ -31,10 +49,70 @@ namespace dynrules
      *  The header and footer are freely choosable. You can simple override
      *  or reassign the create_header() and create_footer() methods to let
      *  them return your required code.
+     *
+     * Besides the RuleSet, a LearnSystem can manage any amount of named
+     * RuleWeights, which use the RuleSet as shared rule catalog. This
+     * allows scripts to be created for different behaviours (e.g. combat,
+     * idle, flee), without duplicating the Rule objects for each of them.
+     * Scripts can also be created for any other WeightOverlay, such as a
+     * FloatRuleWeights or SparseRuleWeights per agent.
+     *
+     * If a CodeCache is set, the code of the selected rules is taken from
+     * it instead of the Rule objects. This allows the Rule objects to be
+     * kept without any code. If a CodeStore is set, the code is taken
+     * from it instead and decompressed directly into the scripts.
+     *
+     * The rules are selected using a random number generator, which is
+     * seeded with the current time on construction. Use setSeed() to
+     * create reproducible scripts. Together with a ReplayLog, the
+     * selected rules and weight updates can be recorded and replayed.
+     *
+     * Scripts can be created from multiple threads. The random number
+     * generator of the LearnSystem is shared by all of them and guarded
+     * by a lock. Scripts created within a ScriptHandle use the generator
+     * of the ScriptHandle instead and are not serialized, unless a
+     * CodeCache is set, which is not thread-safe.
+     *
+     * Besides the weight-proportional roulette wheel selection of the
+     * dynamic scripting algorithm, the rules can be selected greedily or
+     * using a softmax distribution, see setSelectionMode(). The selected
+     * rules can be ordered by their priority, see setOrderByPriority().
+     *
+     * Selecting a rule takes at most one pass over the weights, see
+     * selectRouletteRule(), or O(log n) steps with a RankedRuleWeights.
+     * The time needed for creating a script can additionally be limited
+     * via setTimeLimit(). The latencies of creating scripts and updating
+     * the weights are recorded, see getGenerationLatency() and
+     * getUpdateLatency().
+     *
+     * On systems with multiple NUMA nodes, the weights can be replicated
+     * per node, see setReplicatedWeights().
      */
     class LearnSystem
     {
     public:
+        /**
+         * \brief The ways of selecting the rules for a script.
+         */
+        enum SelectionMode
+        {
+            /**
+             * Selects rules with a probability proportional to their
+             * weight. This is the default.
+             */
+            ROULETTE = 0,
+            /**
+             * Selects the rules with the highest weights in the order of
+             * their weights. Each rule is selected at most once.
+             */
+            GREEDY = 1,
+            /**
+             * Selects rules with a probability proportional to
+             * exp(weight / temperature).
+             */
+            SOFTMAX = 2
+        };
+
         /**
          * \brief Creates a new LearnSystem instance.
          *
@@ -66,7 +144,7 @@ namespace dynrules
          * \brief Creates a new LearnSystem instance from a LearnSystem.
          *
          * Creates a new LearnSystem instance from a LearnSystem. The embedded
-         * RuleSet will be copied, not shared.
+         * RuleSet and named RuleWeights will be copied, not shared.
          *
          * \param lsystem The LearnSystem to create the instance from.
          * \exception bad_alloc Thrown, if the embedded RuleSet could not be
@@ -78,7 +156,7 @@ namespace dynrules
          * \brief Destroys the LearnSystem.
          *
          * Destroys the LearnSystem and frees the memory hold by the
-         * embedded RuleSet.
+         * embedded RuleSet and the named RuleWeights.
          */
         virtual ~LearnSystem ();
 
@@ -102,10 +180,221 @@ namespace dynrules
          *   delete tmp;
          * \endcode
          *
+         * All named RuleWeights will be reset to the weights of the new
+         * RuleSet.
+         *
          * \param ruleset The RuleSet to use.
          */
         void setRuleSet (RuleSet* ruleset);
 
+        /**
+         * \brief Adds a new, named set of weights for the RuleSet.
+         *
+         * Creates a new RuleWeights instance for the RuleSet, which is
+         * managed by the LearnSystem. The initial weights are taken from
+         * the Rule objects of the RuleSet. If a RuleWeights with the same
+         * name exists, it will be replaced.
+         *
+         * \param name The name of the RuleWeights.
+         * \return The newly created RuleWeights.
+         */
+        RuleWeights* addRuleWeights (const std::string& name);
+
+        /**
+         * \brief Gets the named set of weights.
+         *
+         * \param name The name of the RuleWeights.
+         * \return The RuleWeights or 0, if no such RuleWeights exists.
+         */
+        RuleWeights* getRuleWeights (const std::string& name) const;
+
+        /**
+         * \brief Removes and frees the named set of weights.
+         *
+         * \param name The name of the RuleWeights.
+         * \return true, if the RuleWeights could be removed successfully,
+         * false, if not found.
+         */
+        bool removeRuleWeights (const std::string& name);
+
+        /**
+         * \brief Gets the names of all RuleWeights managed by the
+         * LearnSystem.
+         *
+         * \return A std::vector containing the names.
+         */
+        std::vector<std::string> getRuleWeightsNames () const;
+
+        /**
+         * \brief Gets the CodeCache used for getting the rule code.
+         *
+         * \return The CodeCache or 0, if the code is taken from the Rule
+         * objects.
+         */
+        CodeCache* getCodeCache () const;
+
+        /**
+         * \brief Sets the CodeCache to use for getting the rule code.
+         *
+         * The CodeCache will not be freed by the LearnSystem.
+         *
+         * \param codecache The CodeCache to use or 0 to take the code from
+         * the Rule objects.
+         */
+        void setCodeCache (CodeCache* codecache);
+
+        /**
+         * \brief Gets the CodeStore used for getting the rule code.
+         *
+         * \return The CodeStore or 0, if the code is not taken from a
+         * CodeStore.
+         */
+        CodeStore* getCodeStore () const;
+
+        /**
+         * \brief Sets the CodeStore to use for getting the rule code.
+         *
+         * The CodeStore takes precedence over the CodeCache and will not be
+         * freed by the LearnSystem. It must contain the code of all rules,
+         * which can be selected.
+         *
+         * \param codestore The CodeStore to use or 0 to take the code from
+         * the CodeCache or Rule objects.
+         */
+        void setCodeStore (CodeStore* codestore);
+
+        /**
+         * \brief Gets the ReplicatedWeights, from which the scripts are
+         * created.
+         *
+         * \return The ReplicatedWeights or 0.
+         */
+        ReplicatedWeights* getReplicatedWeights () const;
+
+        /**
+         * \brief Sets the ReplicatedWeights, from which the scripts are
+         * created.
+         *
+         * The scripts, which are created without a WeightOverlay, take
+         * the weights from the replica of the node of the calling thread
+         * instead of the Rule objects. The replicas are refreshed, when
+         * they are set, and by the updateWeights() methods of the
+         * LearnSystem, which have to be used instead of
+         * RuleSet::updateWeights() therefore. Setting another RuleSet
+         * removes the ReplicatedWeights.
+         *
+         * \param replicas The ReplicatedWeights to use or 0 to use the
+         * weights of the Rule objects. They will not be freed by the
+         * LearnSystem.
+         * \exception invalid_argument Thrown, if the ReplicatedWeights do
+         * not replicate the RuleSet of the LearnSystem.
+         */
+        void setReplicatedWeights (ReplicatedWeights* replicas);
+
+        /**
+         * \brief Gets the seed of the random number generator.
+         *
+         * \return The seed of the random number generator.
+         */
+        unsigned int getSeed () const;
+
+        /**
+         * \brief Sets the seed of the random number generator.
+         *
+         * Reseeds the random number generator, so that the following
+         * scripts will be created in the same way for the same seed,
+         * RuleSet and weights. ScriptHandle objects are seeded anew from
+         * the generator on their next use, in the order in which they are
+         * used.
+         *
+         * \param seed The seed to set.
+         */
+        void setSeed (unsigned int seed);
+
+        /**
+         * \brief Gets the ReplayLog, to which the seed and the selected
+         * rules are written.
+         *
+         * \return The ReplayLog or 0, if nothing is logged.
+         */
+        ReplayLog* getReplayLog () const;
+
+        /**
+         * \brief Sets the ReplayLog, to which the seed and the selected
+         * rules are written.
+         *
+         * The ReplayLog will also be set for the RuleSet, so that its
+         * weight updates are logged. The random number generator is
+         * reseeded with the current seed, which is written to the log.
+         * The ReplayLog will not be freed by the LearnSystem.
+         *
+         * \param log The ReplayLog to use or 0 to stop logging.
+         */
+        void setReplayLog (ReplayLog* log);
+
+        /**
+         * \brief Gets the way of selecting the rules.
+         *
+         * \return The SelectionMode used.
+         */
+        SelectionMode getSelectionMode () const;
+
+        /**
+         * \brief Sets the way of selecting the rules.
+         *
+         * The GREEDY and SOFTMAX selection of a WeightOverlay is done via
+         * WeightOverlay::selectBest() and WeightOverlay::selectSoftmax(),
+         * which can be implemented efficiently by specialized overlays,
+         * such as RankedRuleWeights.
+         *
+         * \param mode The SelectionMode to use.
+         */
+        void setSelectionMode (SelectionMode mode);
+
+        /**
+         * \brief Gets the temperature for the SOFTMAX selection.
+         *
+         * \return The temperature.
+         */
+        double getTemperature () const;
+
+        /**
+         * \brief Sets the temperature for the SOFTMAX selection.
+         *
+         * Low temperatures prefer the rules with the highest weights,
+         * high temperatures select the rules more uniformly. The default
+         * is 1.
+         *
+         * \param temperature The temperature to set.
+         * \exception invalid_argument Thrown, if temperature is not
+         * greater than 0.
+         */
+        void setTemperature (double temperature);
+
+        /**
+         * \brief Gets, whether the rules are ordered by their priority
+         * within the scripts.
+         *
+         * \return true, if the rules are ordered by their priority, false
+         * otherwise.
+         */
+        bool getOrderByPriority () const;
+
+        /**
+         * \brief Sets, whether the rules are ordered by their priority
+         * within the scripts.
+         *
+         * If enabled, the selected rules are collected first and their
+         * code is appended in the order of the descending Rule::getPriority()
+         * values. Rules with the same priority keep the order of their
+         * selection. This is disabled by default, so that the rule code is
+         * appended in the order of selection.
+         *
+         * \param ordered true to order the rules by their priority, false
+         * otherwise.
+         */
+        void setOrderByPriority (bool ordered);
+
         /**
          * \brief Gets the amount of tries to select and add rules to the
          * script to generate.
@@ -136,6 +425,54 @@ namespace dynrules
          */
         void setMaxScriptSize (unsigned int maxscriptsize);
 
+        /**
+         * \brief Gets the time limit for creating the rule code of a
+         * script.
+         *
+         * \return The time limit in microseconds or 0, if the time is not
+         * limited.
+         */
+        unsigned int getTimeLimit () const;
+
+        /**
+         * \brief Sets the time limit for creating the rule code of a
+         * script.
+         *
+         * Once the time limit is exceeded, no further rules are selected,
+         * so that the script contains less rules than requested. Selecting
+         * the rules greedily is not limited. The limit may be exceeded by
+         * the time needed for selecting a single rule, which is bounded by
+         * a single pass over the weights. This is disabled by default.
+         *
+         * \param microseconds The time limit in microseconds or 0 to not
+         * limit the time.
+         */
+        void setTimeLimit (unsigned int microseconds);
+
+        /**
+         * \brief Gets the latencies of creating the rule code of scripts.
+         *
+         * All ways of creating scripts record the time from the call until
+         * the rule code was created, including the time of waiting for
+         * concurrent calls.
+         *
+         * \return The LatencyHistogram of the script creation.
+         */
+        const LatencyHistogram& getGenerationLatency () const;
+
+        /**
+         * \brief Gets the latencies of updating the weights via the
+         * updateWeights() methods of the LearnSystem.
+         *
+         * \return The LatencyHistogram of the weight updates.
+         */
+        const LatencyHistogram& getUpdateLatency () const;
+
+        /**
+         * \brief Removes all recorded latencies.
+         */
+        void resetLatency ();
+
         /**
          * \brief Creates and returns the header information for the script to
          * generate.
@@ -170,6 +507,166 @@ namespace dynrules
          */
         virtual std::string createRules (unsigned int maxrules) const;
 
+        /**
+         * \brief Creates and returns the code of maxrules rules using a
+         * named set of weights.
+         *
+         * Works like createRules(unsigned int), but selects the rules of
+         * the RuleSet based on the weights of the named RuleWeights.
+         *
+         * \param name The name of the RuleWeights to use.
+         * \param maxrules The maximum amount of rule code to create.
+         * \return The string containing the rule code.
+         * \exception invalid_argument Thrown, if no RuleWeights with the
+         * passed name exists.
+         */
+        virtual std::string createRules (const std::string& name,
+            unsigned int maxrules) const;
+
+        /**
+         * \brief Creates and returns the code of maxrules rules using a
+         * WeightOverlay.
+         *
+         * Works like createRules(unsigned int), but selects the rules of
+         * the RuleSet used by the WeightOverlay based on the weights of the
+         * WeightOverlay.
+         *
+         * \param weights The WeightOverlay to use.
+         * \param maxrules The maximum amount of rule code to create.
+         * \return The string containing the rule code.
+         */
+        virtual std::string createRules (const WeightOverlay& weights,
+            unsigned int maxrules) const;
+
+        /**
+         * \brief Appends the code of maxrules rules to a script.
+         *
+         * Works like createRules(unsigned int), but appends the rule code
+         * to an existing string. This does not allocate any memory, if the
+         * capacity of script is large enough for the maximum script size,
+         * the code of the rules is available and no ReplayLog is used or
+         * the log's buffers reached their steady-state size.
+         *
+         * \param script The string to append the rule code to.
+         * \param maxrules The maximum amount of rule code to create.
+         */
+        void appendRules (std::string& script, unsigned int maxrules) const;
+
+        /**
+         * \brief Appends the code of maxrules rules to a script using a
+         * WeightOverlay.
+         *
+         * Works like createRules(const WeightOverlay&, unsigned int), but
+         * appends the rule code to an existing string.
+         *
+         * \param script The string to append the rule code to.
+         * \param weights The WeightOverlay to use.
+         * \param maxrules The maximum amount of rule code to create.
+         */
+        void appendRules (std::string& script, const WeightOverlay& weights,
+            unsigned int maxrules) const;
+
+        /**
+         * \brief Creates the code of maxrules rules within a ScriptHandle.
+         *
+         * Works like createRules(unsigned int), but keeps the code and the
+         * selected rules in the ScriptHandle, so that the used rules can be
+         * tracked by it. Any previous script of the ScriptHandle is
+         * replaced. The rules are selected with the random number
+         * generator of the ScriptHandle, so that scripts can be created
+         * for different ScriptHandle objects concurrently.
+         *
+         * \param handle The ScriptHandle to create the script in.
+         * \param maxrules The maximum amount of rule code to create.
+         */
+        void createRules (ScriptHandle& handle, unsigned int maxrules) const;
+
+        /**
+         * \brief Creates the code of maxrules rules within a ScriptHandle
+         * using a WeightOverlay.
+         *
+         * Works like createRules(const WeightOverlay&, unsigned int), but
+         * keeps the code and the selected rules in the ScriptHandle.
+         *
+         * \param handle The ScriptHandle to create the script in.
+         * \param weights The WeightOverlay to use.
+         * \param maxrules The maximum amount of rule code to create.
+         */
+        void createRules (ScriptHandle& handle, const WeightOverlay& weights,
+            unsigned int maxrules) const;
+
+        /**
+         * \brief Updates the weights of the RuleSet for the used rules.
+         *
+         * Calls RuleSet::updateWeights() and refreshes the
+         * ReplicatedWeights afterwards, if they are set.
+         *
+         * \param fitness The measure of the fitness of the script, which is
+         * passed to RuleSet::calculateAdjustment().
+         */
+        void updateWeights (void *fitness);
+
+        /**
+         * \brief Updates the weights of the RuleSet for the rules used by a
+         * script.
+         *
+         * Works like RuleSet::updateWeights(), but takes the used rules
+         * from the ScriptHandle instead of the Rule objects, see
+         * RuleSet::applyUpdates(). The usage states of the Rule objects are
+         * neither used nor changed, so that the weights can be updated for
+         * any amount of concurrently run scripts. The updates must not be
+         * done concurrently with each other or the creation of scripts.
+         * If ReplicatedWeights are set, they are refreshed afterwards.
+         *
+         * \param handle The ScriptHandle of the script.
+         * \param fitness The measure of the fitness of the script, which is
+         * passed to RuleSet::calculateAdjustment().
+         * \exception invalid_argument Thrown, if the script was not created
+         * from the RuleSet of the LearnSystem.
+         */
+        void updateWeights (const ScriptHandle& handle, void *fitness);
+
+        /**
+         * \brief Updates the weights of a WeightOverlay for the rules used
+         * by a script.
+         *
+         * Marks the used rules of the ScriptHandle as used within the
+         * WeightOverlay and calls WeightOverlay::updateWeights(), which
+         * resets the usage states afterwards. No other usage states of the
+         * WeightOverlay should be set.
+         *
+         * \param handle The ScriptHandle of the script.
+         * \param weights The WeightOverlay to update.
+         * \param fitness The measure of the fitness of the script.
+         * \exception invalid_argument Thrown, if the script was not created
+         * from the RuleSet of the WeightOverlay.
+         */
+        void updateWeights (const ScriptHandle& handle,
+            WeightOverlay& weights, void *fitness);
+
+#if __cplusplus >= 201703L
+        /**
+         * \brief Appends the code of maxrules rules to a script, which
+         * uses a std::pmr::memory_resource.
+         *
+         * \param script The string to append the rule code to.
+         * \param maxrules The maximum amount of rule code to create.
+         */
+        void appendRules (std::pmr::string& script,
+            unsigned int maxrules) const;
+
+        /**
+         * \brief Appends the code of maxrules rules to a script, which
+         * uses a std::pmr::memory_resource, using a WeightOverlay.
+         *
+         * \param script The string to append the rule code to.
+         * \param weights The WeightOverlay to use.
+         * \param maxrules The maximum amount of rule code to create.
+         */
+        void appendRules (std::pmr::string& script,
+            const WeightOverlay& weights, unsigned int maxrules) const;
+#endif
+
         /**
          * \brief Creates the complete script contents.
          *
@@ -189,8 +686,75 @@ namespace dynrules
          */
         void createScript (std::ostream &stream, unsigned int maxrules);
 
+        /**
+         * \brief Creates the complete script contents using a named set of
+         * weights.
+         *
+         * Works like createScript(std::ostream&, unsigned int), but uses
+         * createRules(const std::string&, unsigned int) for the rules.
+         *
+         * \param stream The stream to pass the script code to.
+         * \param name The name of the RuleWeights to use.
+         * \param maxrules The maximum amount of rule code to create.
+         * \exception invalid_argument Thrown, if no RuleWeights with the
+         * passed name exists.
+         */
+        void createScript (std::ostream &stream, const std::string& name,
+            unsigned int maxrules);
+
+        /**
+         * \brief Creates the complete script contents using a
+         * WeightOverlay.
+         *
+         * Works like createScript(std::ostream&, unsigned int), but uses
+         * createRules(const WeightOverlay&, unsigned int) for the rules.
+         *
+         * \param stream The stream to pass the script code to.
+         * \param weights The WeightOverlay to use.
+         * \param maxrules The maximum amount of rule code to create.
+         */
+        void createScript (std::ostream &stream, const WeightOverlay& weights,
+            unsigned int maxrules);
+
     protected:
 
+        /**
+         * \brief Seeds the random number generator of a ScriptHandle from
+         * the one of the LearnSystem, if it was not seeded yet or setSeed()
+         * was called since.
+         *
+         * \param handle The ScriptHandle to seed.
+         */
+        void seedHandle (ScriptHandle& handle) const;
+
+        /**
+         * \brief Appends the rule code to a string of any type.
+         *
+         * \param script The string to append the rule code to.
+         * \param maxrules The maximum amount of rule code to create.
+         * \param handle The ScriptHandle, whose random number generator
+         * and buffers are used and which receives the indices of the
+         * selected rules, or 0 to use the ones of the LearnSystem.
+         */
+        template <typename String>
+        void appendRulesTo (String& script, unsigned int maxrules,
+            ScriptHandle* handle = 0) const;
+
+        /**
+         * \brief Appends the rule code to a string of any type using a
+         * WeightOverlay.
+         *
+         * \param script The string to append the rule code to.
+         * \param weights The WeightOverlay to use.
+         * \param maxrules The maximum amount of rule code to create.
+         * \param handle The ScriptHandle, whose random number generator
+         * and buffers are used and which receives the indices of the
+         * selected rules, or 0 to use the ones of the LearnSystem.
+         */
+        template <typename String>
+        void appendRulesTo (String& script, const WeightOverlay& weights,
+            unsigned int maxrules, ScriptHandle* handle = 0) const;
+
         /**
          * \brief The maximum number of tries to create script content from rules.
          */
@@ -205,6 +769,113 @@ namespace dynrules
          * \brief The RuleSet to take the rules from for generating the scripts.
          */
         RuleSet* _ruleset;
+
+        /**
+         * \brief The named RuleWeights using the RuleSet as rule catalog.
+         */
+        std::map<std::string, RuleWeights*> _weights;
+
+        /**
+         * \brief The CodeCache to take the rule code from.
+         */
+        CodeCache* _codecache;
+
+        /**
+         * \brief The CodeStore to take the compressed rule code from.
+         */
+        CodeStore* _codestore;
+
+        /**
+         * \brief The seed of the random number generator.
+         */
+        unsigned int _seed;
+
+        /**
+         * \brief The random number generator for selecting the rules.
+         */
+        mutable std::mt19937 _random;
+
+        /**
+         * \brief Serializes the access to the random number generator.
+         */
+        mutable std::mutex _randomlock;
+
+        /**
+         * \brief The amount of calls to setSeed(), so that ScriptHandle
+         * objects are seeded anew afterwards.
+         */
+        std::atomic<unsigned long> _epoch;
+
+        /**
+         * \brief The ReplayLog to write the seed and selected rules to.
+         */
+        ReplayLog* _replaylog;
+
+        /**
+         * \brief The ids of the selected rules for the ReplayLog, which
+         * are kept to avoid allocations.
+         */
+        mutable std::vector<int> _selected;
+
+        /**
+         * \brief The way of selecting the rules.
+         */
+        SelectionMode _mode;
+
+        /**
+         * \brief The temperature for the SOFTMAX selection.
+         */
+        double _temperature;
+
+        /**
+         * \brief The indices of the rules for the GREEDY selection and the
+         * ordering by priority, which are kept to avoid allocations.
+         */
+        mutable std::vector<size_t> _ranked;
+
+        /**
+         * \brief Indicates, whether the rules are ordered by their
+         * priority.
+         */
+        bool _ordered;
+
+        /**
+         * \brief The sort keys for ordering the rules by their priority,
+         * which are kept to avoid allocations.
+         */
+        mutable std::vector<uint64_t> _order;
+
+        /**
+         * \brief The code of the rules taken from the CodeCache, while
+         * they are ordered by their priority, which is kept to avoid
+         * allocations.
+         */
+        mutable std::string _pending;
+
+        /**
+         * \brief The offsets of the code of the rules within _pending.
+         */
+        mutable std::vector<size_t> _pendingoffsets;
+
+        /**
+         * \brief The time limit for creating the rule code in microseconds.
+         */
+        unsigned int _timelimit;
+
+        /**
+         * \brief The latencies of creating the rule code.
+         */
+        mutable LatencyHistogram _generationlatency;
+
+        /**
+         * \brief The latencies of updating the weights.
+         */
+        LatencyHistogram _updatelatency;
+
+        /**
+         * \brief The ReplicatedWeights to create the scripts from.
+         */
+        ReplicatedWeights* _replicas;
     };
 
 } // namespace
@@ -36,7 +36,18 @@ std::vector<Rule*> MMapRuleManager::loadRules ()
 
 std::vector<Rule*> MMapRuleManager::loadRules (unsigned int maxrules)
 {
-    return this->_rules;
+    return this->loadRules (0, maxrules);
+}
+
+std::vector<Rule*> MMapRuleManager::loadRules (unsigned int offset,
+    unsigned int maxrules)
+{
+    if (offset >= this->_rules.size ())
+        return std::vector<Rule*> ();
+    if (maxrules > this->_rules.size () - offset)
+        maxrules = static_cast<unsigned int>(this->_rules.size () - offset);
+    return std::vector<Rule*> (this->_rules.begin () + offset,
+        this->_rules.begin () + offset + maxrules);
 }
 
 bool MMapRuleManager::saveRules (std::vector<Rule*> rules)
@@ -44,4 +55,13 @@ bool MMapRuleManager::saveRules (std::vector<Rule*> rules)
     return true;
 }
 
+std::string MMapRuleManager::loadCode (int id)
+{
+    /* The rules are created with their index as id. */
+    if (id >= 0 && static_cast<size_t>(id) < this->_rules.size () &&
+        this->_rules[static_cast<size_t>(id)]->getId () == id)
+        return this->_rules[static_cast<size_t>(id)]->getCode ();
+    return RuleManager::loadCode (id);
+}
+
 } // namespace
@@ -56,13 +56,26 @@ namespace dynrules
         /**
          * \brief Loads a specific amount of rules.
          *
-         * This behaves exactly like loadRules().
-         *
          * \param maxrules The amount of rules to load.
-         * \return A std::vector containing the loaded rules.
+         * \return A std::vector containing the first maxrules Rule objects
+         * hold by this instance. The caller should not free the returned
+         * results.
          */
         std::vector<Rule*> loadRules (unsigned int maxrules);
 
+        /**
+         * \brief Loads a specific range of rules.
+         *
+         * \param offset The index of the first rule to load.
+         * \param maxrules The amount of rules to load.
+         * \return A std::vector containing the Rule objects hold by this
+         * instance. The caller should not free the returned results.
+         */
+        std::vector<Rule*> loadRules (unsigned int offset,
+            unsigned int maxrules);
+
+        using RuleManager::loadRules;
+
         /**
          * \brief Saves the passed rules to the underlying data source.
          *
@@ -73,6 +86,18 @@ namespace dynrules
          */
         bool saveRules (std::vector<Rule*> rules);
 
+        /**
+         * \brief Gets the code of a specific rule.
+         *
+         * The code is taken from the Rule objects in memory, so that a
+         * CodeCache on top of a MMapRuleManager does not save any memory.
+         *
+         * \param id The id of the rule.
+         * \return The code of the rule.
+         * \exception out_of_range Thrown, if no rule with the id exists.
+         */
+        std::string loadCode (int id);
+
     protected:
 
         /**
@@ -0,0 +1,297 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+#include "RankedRuleWeights.h"
+
+namespace dynrules
+{
+
+const size_t RankedRuleWeights::NONE;
+
+/*
+ * The tree nodes still to search by selectBest(), kept per thread, so that
+ * concurrent selections neither race nor allocate each time.
+ */
+static thread_local std::vector<size_t> _search_nodes;
+
+RankedRuleWeights::RankedRuleWeights (RuleSet* ruleset, double temperature) :
+    WeightOverlay(ruleset),
+    _weights(0),
+    _used(0),
+    _leaves(0),
+    _sums(0),
+    _exps(0),
+    _best(0),
+    _temperature(temperature),
+    _deferred(false)
+{
+    if (!(temperature > 0))
+        throw std::invalid_argument ("temperature must be greater than 0");
+    this->reset ();
+}
+
+RankedRuleWeights::RankedRuleWeights (RuleSet* ruleset,
+    const RankedRuleWeights& weights) :
+    WeightOverlay(ruleset),
+    _weights(weights._weights),
+    _used(weights._used),
+    _leaves(weights._leaves),
+    _sums(weights._sums),
+    _exps(weights._exps),
+    _best(weights._best),
+    _temperature(weights._temperature),
+    _deferred(false)
+{
+    this->_weight = weights._weight;
+}
+
+RankedRuleWeights::~RankedRuleWeights ()
+{
+}
+
+double RankedRuleWeights::getTemperature () const
+{
+    return this->_temperature;
+}
+
+void RankedRuleWeights::setTemperature (double temperature)
+{
+    if (!(temperature > 0))
+        throw std::invalid_argument ("temperature must be greater than 0");
+    this->_temperature = temperature;
+    this->rebuild ();
+}
+
+size_t RankedRuleWeights::getCount () const
+{
+    return this->_weights.size ();
+}
+
+double RankedRuleWeights::getWeight (size_t index) const
+{
+    return this->_weights.at (index);
+}
+
+void RankedRuleWeights::setWeights (const double* weights, size_t count)
+{
+    this->_deferred = true;
+    try
+    {
+        WeightOverlay::setWeights (weights, count);
+    }
+    catch (...)
+    {
+        this->_deferred = false;
+        this->rebuild ();
+        throw;
+    }
+    this->_deferred = false;
+    this->rebuild ();
+}
+
+bool RankedRuleWeights::getUsed (size_t index) const
+{
+    return this->_used.at (index) != 0;
+}
+
+void RankedRuleWeights::setUsed (size_t index, bool used)
+{
+    this->_used.at (index) = used ? 1 : 0;
+}
+
+size_t RankedRuleWeights::better (size_t a, size_t b) const
+{
+    if (a == NONE)
+        return b;
+    if (b == NONE)
+        return a;
+    if (this->_weights[b] > this->_weights[a] ||
+        (this->_weights[b] == this->_weights[a] && b < a))
+        return b;
+    return a;
+}
+
+void RankedRuleWeights::rebuild ()
+{
+    size_t i, count = this->_weights.size ();
+    size_t leaves = 1;
+    double maxweight = this->_ruleset->getMaxWeight ();
+    double temperature = this->_temperature;
+
+    while (leaves < count)
+        leaves *= 2;
+    this->_leaves = leaves;
+    this->_sums.assign (2 * leaves, 0.);
+    this->_exps.assign (2 * leaves, 0.);
+    this->_best.assign (2 * leaves, NONE);
+
+    for (i = 0; i < count; i++)
+    {
+        this->_sums[leaves + i] = this->_weights[i];
+        this->_exps[leaves + i] =
+            std::exp ((this->_weights[i] - maxweight) / temperature);
+        this->_best[leaves + i] = i;
+    }
+    for (i = leaves - 1; i > 0; i--)
+    {
+        this->_sums[i] = this->_sums[2 * i] + this->_sums[2 * i + 1];
+        this->_exps[i] = this->_exps[2 * i] + this->_exps[2 * i + 1];
+        this->_best[i] = this->better (this->_best[2 * i],
+            this->_best[2 * i + 1]);
+    }
+}
+
+void RankedRuleWeights::updateLeaf (size_t index)
+{
+    size_t node = this->_leaves + index;
+
+    this->_sums[node] = this->_weights[index];
+    this->_exps[node] = std::exp ((this->_weights[index] -
+            this->_ruleset->getMaxWeight ()) / this->_temperature);
+    for (node /= 2; node > 0; node /= 2)
+    {
+        this->_sums[node] = this->_sums[2 * node] + this->_sums[2 * node + 1];
+        this->_exps[node] = this->_exps[2 * node] + this->_exps[2 * node + 1];
+    }
+    this->updateBest (this->_leaves + index);
+}
+
+void RankedRuleWeights::updateBest (size_t node)
+{
+    for (node /= 2; node > 0; node /= 2)
+        this->_best[node] = this->better (this->_best[2 * node],
+            this->_best[2 * node + 1]);
+}
+
+size_t RankedRuleWeights::findLeaf (const std::vector<double>& tree,
+    double fraction) const
+{
+    size_t node = 1, index;
+
+    while (node < this->_leaves)
+    {
+        node *= 2;
+        if (!(fraction < tree[node]))
+        {
+            fraction -= tree[node];
+            node++;
+        }
+    }
+
+    /*
+     * Rounding errors might lead beyond the last rule or to a rule
+     * without any weight.
+     */
+    index = node - this->_leaves;
+    if (index >= this->_weights.size ())
+        index = this->_weights.size () - 1;
+    while (index > 0 && tree[this->_leaves + index] == 0)
+        index--;
+    return index;
+}
+
+size_t RankedRuleWeights::selectRule (double fraction) const
+{
+    return this->findLeaf (this->_sums, fraction);
+}
+
+size_t RankedRuleWeights::selectBest (size_t* indices, size_t count) const
+{
+    std::vector<size_t>& nodes = _search_nodes;
+    size_t found, node, leaf;
+    auto worse = [this] (size_t a, size_t b)
+    {
+        a = this->_best[a];
+        b = this->_best[b];
+        return a != b && this->better (a, b) == b;
+    };
+
+    /*
+     * Search the tournament tree best-first without modifying it: take the
+     * subtree with the best winner and add the remaining subtrees on the
+     * path to the winner's leaf, until enough rules were found.
+     */
+    nodes.clear ();
+    if (this->_best[1] != NONE)
+        nodes.push_back (1);
+    for (found = 0; found < count && !nodes.empty (); found++)
+    {
+        std::pop_heap (nodes.begin (), nodes.end (), worse);
+        node = nodes.back ();
+        nodes.pop_back ();
+        indices[found] = this->_best[node];
+        for (leaf = this->_leaves + indices[found]; leaf > node; leaf /= 2)
+        {
+            if (this->_best[leaf ^ 1] == NONE)
+                continue;
+            nodes.push_back (leaf ^ 1);
+            std::push_heap (nodes.begin (), nodes.end (), worse);
+        }
+    }
+    return found;
+}
+
+size_t RankedRuleWeights::selectSoftmax (double fraction,
+    double temperature) const
+{
+    if (temperature != this->_temperature)
+        return WeightOverlay::selectSoftmax (fraction, temperature);
+    if (!(this->_exps[1] > 0))
+        return this->_best[1];
+    return this->findLeaf (this->_exps, fraction * this->_exps[1]);
+}
+
+void RankedRuleWeights::reset ()
+{
+    size_t i, count = this->_ruleset->getCount ();
+    double totweight = 0;
+
+    this->_weights.resize (count);
+    for (i = 0; i < count; i++)
+    {
+        this->_weights[i] = this->_ruleset->getRule (i)->getWeight ();
+        totweight += this->_weights[i];
+    }
+    this->_used.assign (count, 0);
+    this->_weight = totweight;
+    this->rebuild ();
+}
+
+void RankedRuleWeights::updateWeights (void *fitness)
+{
+    this->_deferred = true;
+    try
+    {
+        WeightOverlay::updateWeights (fitness);
+    }
+    catch (...)
+    {
+        this->_deferred = false;
+        this->rebuild ();
+        throw;
+    }
+    this->_deferred = false;
+    this->rebuild ();
+}
+
+void RankedRuleWeights::storeWeight (size_t index, double weight)
+{
+    this->_weights.at (index) = weight;
+    if (!this->_deferred)
+        this->updateLeaf (index);
+}
+
+void RankedRuleWeights::clearUsed ()
+{
+    this->_used.assign (this->_used.size (), 0);
+}
+
+} // namespace
@@ -0,0 +1,196 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _RANKEDRULEWEIGHTS_H_
+#define _RANKEDRULEWEIGHTS_H_
+
+#include <vector>
+#include "WeightOverlay.h"
+
+namespace dynrules
+{
+    /**
+     * \brief Rule weights, which keep the rules ordered for a fast
+     * selection.
+     *
+     * RankedRuleWeights maintains three complete binary trees over the
+     * weights, which are updated along with the weights:
+     *  - a sum tree of the weights for the roulette wheel selection
+     *  - a tournament tree of the best rules for the greedy selection
+     *  - a sum tree of exp((weight - maxweight) / temperature) for the
+     *    softmax selection
+     *
+     * Selecting a rule thus needs O(log n) steps and selecting the k best
+     * rules O(k log n) steps, instead of walking through or sorting all
+     * rules. Setting a single weight updates the trees in O(log n) steps,
+     * updateWeights() and setWeights() rebuild them in O(n) steps.
+     *
+     * The softmax tree is built for the temperature set via
+     * setTemperature(). Other temperatures passed to selectSoftmax() use
+     * the O(n) implementation of WeightOverlay.
+     *
+     * The selection functions update the trees temporarily and thus must
+     * not be called by multiple threads at the same time.
+     */
+    class RankedRuleWeights : public WeightOverlay
+    {
+    public:
+        using WeightOverlay::getWeight;
+
+        /**
+         * \brief Creates a new RankedRuleWeights instance.
+         *
+         * The initial weights are the ones of the Rule objects of the
+         * passed RuleSet.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \param temperature The temperature for the softmax selection.
+         * \exception invalid_argument Thrown, if ruleset is NULL or
+         * temperature is not greater than 0.
+         */
+        RankedRuleWeights (RuleSet* ruleset, double temperature = 1);
+
+        /**
+         * \brief Creates a new RankedRuleWeights instance from another
+         * one.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \param weights The RankedRuleWeights to copy the weights and
+         * usage states from.
+         * \exception invalid_argument Thrown, if ruleset is NULL.
+         */
+        RankedRuleWeights (RuleSet* ruleset, const RankedRuleWeights& weights);
+
+        /**
+         * \brief Destroys the RankedRuleWeights.
+         */
+        virtual ~RankedRuleWeights ();
+
+        /**
+         * \brief Gets the temperature for the softmax selection.
+         *
+         * \return The temperature.
+         */
+        double getTemperature () const;
+
+        /**
+         * \brief Sets the temperature for the softmax selection.
+         *
+         * \param temperature The temperature to set.
+         * \exception invalid_argument Thrown, if temperature is not
+         * greater than 0.
+         */
+        void setTemperature (double temperature);
+
+        size_t getCount () const;
+        double getWeight (size_t index) const;
+        void setWeights (const double* weights, size_t count);
+        bool getUsed (size_t index) const;
+        void setUsed (size_t index, bool used);
+        size_t selectRule (double fraction) const;
+        size_t selectBest (size_t* indices, size_t count) const;
+        size_t selectSoftmax (double fraction, double temperature) const;
+        void reset ();
+        void updateWeights (void *fitness);
+
+    protected:
+        void storeWeight (size_t index, double weight);
+        void clearUsed ();
+
+        /**
+         * \brief Rebuilds all trees from the weights.
+         */
+        void rebuild ();
+
+        /**
+         * \brief Updates all trees after a weight changed.
+         *
+         * \param index The index of the changed weight.
+         */
+        void updateLeaf (size_t index);
+
+        /**
+         * \brief Updates the tournament tree above a tree node.
+         *
+         * \param node The tree node, whose parents shall be updated.
+         */
+        void updateBest (size_t node);
+
+        /**
+         * \brief Gets the better of two rules.
+         *
+         * \param a The index of the first rule or NONE.
+         * \param b The index of the second rule or NONE.
+         * \return The index of the rule with the higher weight or the
+         * lower index for equal weights.
+         */
+        size_t better (size_t a, size_t b) const;
+
+        /**
+         * \brief Finds the leaf for a fraction of a sum tree.
+         *
+         * \param tree The sum tree.
+         * \param fraction A value between 0 and the root of the tree.
+         * \return The index of the rule.
+         */
+        size_t findLeaf (const std::vector<double>& tree,
+            double fraction) const;
+
+        /**
+         * \brief Marks an unused leaf of the tournament tree.
+         */
+        static const size_t NONE = static_cast<size_t>(-1);
+
+        /**
+         * \brief The weights of the rules.
+         */
+        std::vector<double> _weights;
+
+        /**
+         * \brief The usage states of the rules.
+         */
+        std::vector<unsigned char> _used;
+
+        /**
+         * \brief The amount of leaves of the trees, a power of 2.
+         */
+        size_t _leaves;
+
+        /**
+         * \brief The sum tree of the weights.
+         */
+        std::vector<double> _sums;
+
+        /**
+         * \brief The sum tree of the softmax values.
+         */
+        std::vector<double> _exps;
+
+        /**
+         * \brief The tournament tree of the rule indices.
+         */
+        std::vector<size_t> _best;
+
+        /**
+         * \brief The temperature for the softmax selection.
+         */
+        double _temperature;
+
+        /**
+         * \brief Indicates, that the trees are rebuilt after a bulk update.
+         */
+        bool _deferred;
+
+    private:
+        RankedRuleWeights (const RankedRuleWeights&);
+        RankedRuleWeights& operator= (const RankedRuleWeights&);
+    };
+
+} // namespace
+
+#endif /* _RANKEDRULEWEIGHTS_H_ */
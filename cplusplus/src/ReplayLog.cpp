@@ -0,0 +1,493 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include <cfloat>
+#include <cmath>
+#include "ReplayLog.h"
+
+namespace dynrules
+{
+
+/*
+ * The RuleSet used by Replay, which applies the logged adjustment instead
+ * of calculating it.
+ */
+class _ReplayRuleSet : public RuleSet
+{
+public:
+    _ReplayRuleSet () : RuleSet(), adjustment(0)
+    {
+    }
+
+    /* Batches pass the logged adjustment of each encounter as fitness. */
+    double calculateAdjustment (void* fitness)
+    {
+        if (fitness != 0)
+            return *static_cast<double*>(fitness);
+        return this->adjustment;
+    }
+
+    double adjustment;
+};
+
+/*
+ * Checks, whether the total weight of the ruleset matches a logged one.
+ * ShardedRuleSet sums up the weights per shard, so that the logged total
+ * may differ by the rounding error of summing up in another order.
+ */
+static bool _is_same_weight (const RuleSet& ruleset, double weight)
+{
+    size_t i, count = ruleset.getCount ();
+    double total = 0;
+
+    if (ruleset.getWeight () == weight)
+        return true;
+    for (i = 0; i < count; i++)
+        total += std::fabs (ruleset.getRule (i)->getWeight ());
+    return std::fabs (ruleset.getWeight () - weight) <=
+        static_cast<double>(count) * DBL_EPSILON * total;
+}
+
+static void _delete_rules (RuleSet& ruleset)
+{
+    size_t i;
+
+    for (i = 0; i < ruleset.getCount (); i++)
+        delete ruleset.getRule (i);
+    ruleset.clear ();
+}
+
+ReplayLog::ReplayLog (std::ostream& stream, size_t buffersize) :
+    _stream(stream),
+    _buffer(),
+    _buffersize(buffersize),
+    _episode(0),
+    _lock()
+{
+    unsigned int header[2] = { MAGIC, VERSION };
+
+    this->_buffer.reserve (buffersize);
+    this->append (header, sizeof (header));
+}
+
+ReplayLog::~ReplayLog ()
+{
+    this->flush ();
+}
+
+unsigned long ReplayLog::getEpisode () const
+{
+    return this->_episode;
+}
+
+void ReplayLog::append (const void* data, size_t size)
+{
+    const char *bytes = static_cast<const char*>(data);
+    this->_buffer.insert (this->_buffer.end (), bytes, bytes + size);
+}
+
+void ReplayLog::appendEvent (EventType type, size_t size)
+{
+    unsigned char etype = static_cast<unsigned char>(type);
+    unsigned int esize = static_cast<unsigned int>(size);
+
+    this->commit (sizeof (etype) + sizeof (esize) + size);
+    this->append (&etype, sizeof (etype));
+    this->append (&esize, sizeof (esize));
+}
+
+void ReplayLog::commit (size_t size)
+{
+    /*
+     * Write the buffer before it would grow, so that no memory is
+     * allocated for events smaller than the buffer size.
+     */
+    if (!this->_buffer.empty () &&
+        this->_buffer.size () + size > this->_buffersize)
+    {
+        this->_stream.write (&this->_buffer[0],
+            static_cast<std::streamsize>(this->_buffer.size ()));
+        this->_buffer.clear ();
+    }
+}
+
+void ReplayLog::writeSeed (unsigned int seed)
+{
+    std::lock_guard<std::mutex> guard (this->_lock);
+
+    this->appendEvent (SEED, sizeof (seed));
+    this->append (&seed, sizeof (seed));
+}
+
+void ReplayLog::writeScript (const int* ids, size_t count)
+{
+    std::lock_guard<std::mutex> guard (this->_lock);
+    unsigned int ecount = static_cast<unsigned int>(count);
+
+    this->appendEvent (SCRIPT, sizeof (ecount) + count * sizeof (int));
+    this->append (&ecount, sizeof (ecount));
+    this->append (ids, count * sizeof (int));
+}
+
+void ReplayLog::writeUpdate (double adjustment, double weight,
+    const int* ids, size_t count)
+{
+    std::lock_guard<std::mutex> guard (this->_lock);
+    unsigned int ecount = static_cast<unsigned int>(count);
+
+    this->appendEvent (UPDATE, 2 * sizeof (double) + sizeof (ecount) +
+        count * sizeof (int));
+    this->append (&adjustment, sizeof (adjustment));
+    this->append (&weight, sizeof (weight));
+    this->append (&ecount, sizeof (ecount));
+    if (count > 0)
+        this->append (ids, count * sizeof (int));
+    this->_episode++;
+}
+
+void ReplayLog::writeBatch (const RuleSet& ruleset,
+    const WeightUpdate* updates, const double* adjustments, size_t count,
+    double weight)
+{
+    std::lock_guard<std::mutex> guard (this->_lock);
+    size_t i, j, size, rules = ruleset.getCount ();
+    unsigned int ecount = 0, ucount;
+    int id;
+
+    size = sizeof (weight) + sizeof (ecount);
+    for (i = 0; i < count; i++)
+    {
+        if (updates[i].count == 0 || updates[i].count == rules)
+            continue;
+        size += sizeof (double) + sizeof (ucount) +
+            updates[i].count * sizeof (int);
+        ecount++;
+    }
+
+    this->appendEvent (BATCH, size);
+    this->append (&weight, sizeof (weight));
+    this->append (&ecount, sizeof (ecount));
+    for (i = 0; i < count; i++)
+    {
+        if (updates[i].count == 0 || updates[i].count == rules)
+            continue;
+        ucount = static_cast<unsigned int>(updates[i].count);
+        this->append (&adjustments[i], sizeof (double));
+        this->append (&ucount, sizeof (ucount));
+        for (j = 0; j < updates[i].count; j++)
+        {
+            id = ruleset.getRule (updates[i].used[j])->getId ();
+            this->append (&id, sizeof (id));
+        }
+    }
+    this->_episode += ecount;
+}
+
+void ReplayLog::writeRescale (double center, double decay, double scale,
+    size_t first, size_t count, double weight)
+{
+    std::lock_guard<std::mutex> guard (this->_lock);
+    unsigned int range[2] = {
+        static_cast<unsigned int>(first), static_cast<unsigned int>(count)
+    };
+
+    this->appendEvent (RESCALE, 4 * sizeof (double) + sizeof (range));
+    this->append (&center, sizeof (center));
+    this->append (&decay, sizeof (decay));
+    this->append (&scale, sizeof (scale));
+    this->append (range, sizeof (range));
+    this->append (&weight, sizeof (weight));
+}
+
+void ReplayLog::writeWeights (const RuleSet& ruleset)
+{
+    std::lock_guard<std::mutex> guard (this->_lock);
+    size_t i, count = ruleset.getCount ();
+    unsigned int ecount = static_cast<unsigned int>(count);
+    double minweight = ruleset.getMinWeight ();
+    double maxweight = ruleset.getMaxWeight ();
+    double weight;
+    int id;
+    Rule *rule;
+
+    this->appendEvent (WEIGHTS, 2 * sizeof (double) + sizeof (ecount) +
+        count * (sizeof (int) + sizeof (double)));
+    this->append (&minweight, sizeof (minweight));
+    this->append (&maxweight, sizeof (maxweight));
+    this->append (&ecount, sizeof (ecount));
+    for (i = 0; i < count; i++)
+    {
+        rule = ruleset.getRule (i);
+        id = rule->getId ();
+        weight = rule->getWeight ();
+        this->append (&id, sizeof (id));
+        this->append (&weight, sizeof (weight));
+    }
+}
+
+void ReplayLog::flush ()
+{
+    std::lock_guard<std::mutex> guard (this->_lock);
+
+    if (!this->_buffer.empty ())
+    {
+        this->_stream.write (&this->_buffer[0],
+            static_cast<std::streamsize>(this->_buffer.size ()));
+        this->_buffer.clear ();
+    }
+    this->_stream.flush ();
+}
+
+Replay::Replay (std::istream& stream) :
+    _stream(stream),
+    _ruleset(new _ReplayRuleSet ()),
+    _indices(),
+    _script(),
+    _episode(0),
+    _seed(0),
+    _diverged(false)
+{
+    unsigned int header[2];
+
+    if (!this->_stream.read (reinterpret_cast<char*>(header),
+            sizeof (header)) || header[0] != ReplayLog::MAGIC)
+    {
+        delete this->_ruleset;
+        throw std::runtime_error ("stream does not contain a replay log");
+    }
+    if (header[1] == 0 || header[1] > ReplayLog::VERSION)
+    {
+        delete this->_ruleset;
+        throw std::runtime_error ("unsupported replay log version");
+    }
+}
+
+Replay::~Replay ()
+{
+    _delete_rules (*this->_ruleset);
+    delete this->_ruleset;
+}
+
+void Replay::read (void* data, size_t size)
+{
+    if (!this->_stream.read (static_cast<char*>(data),
+            static_cast<std::streamsize>(size)))
+        throw std::runtime_error ("replay log is truncated");
+}
+
+bool Replay::step ()
+{
+    unsigned char type;
+    unsigned int size, count;
+
+    if (this->_stream.peek () == std::istream::traits_type::eof ())
+        return false;
+
+    this->read (&type, sizeof (type));
+    this->read (&size, sizeof (size));
+    switch (type)
+    {
+    case ReplayLog::SEED:
+        this->read (&this->_seed, sizeof (this->_seed));
+        break;
+    case ReplayLog::SCRIPT:
+        this->read (&count, sizeof (count));
+        this->_script.resize (count);
+        if (count > 0)
+            this->read (&this->_script[0], count * sizeof (int));
+        break;
+    case ReplayLog::UPDATE:
+        this->readUpdate ();
+        break;
+    case ReplayLog::WEIGHTS:
+        this->readWeights ();
+        break;
+    case ReplayLog::BATCH:
+        this->readBatch ();
+        break;
+    case ReplayLog::RESCALE:
+        this->readRescale ();
+        break;
+    default:
+        /* Skip unknown events. */
+        if (!this->_stream.ignore (size))
+            throw std::runtime_error ("replay log is truncated");
+        break;
+    }
+    return true;
+}
+
+void Replay::readWeights ()
+{
+    double minweight, maxweight, weight;
+    unsigned int i, count;
+    int id;
+
+    this->read (&minweight, sizeof (minweight));
+    this->read (&maxweight, sizeof (maxweight));
+    this->read (&count, sizeof (count));
+
+    _delete_rules (*this->_ruleset);
+    this->_indices.clear ();
+    if (minweight > this->_ruleset->getMaxWeight ())
+    {
+        this->_ruleset->setMaxWeight (maxweight);
+        this->_ruleset->setMinWeight (minweight);
+    }
+    else
+    {
+        this->_ruleset->setMinWeight (minweight);
+        this->_ruleset->setMaxWeight (maxweight);
+    }
+    for (i = 0; i < count; i++)
+    {
+        this->read (&id, sizeof (id));
+        this->read (&weight, sizeof (weight));
+        this->_ruleset->addRule (new Rule (id, weight));
+        this->_indices[id] = i;
+    }
+    this->_diverged = false;
+}
+
+void Replay::readUpdate ()
+{
+    _ReplayRuleSet *ruleset = static_cast<_ReplayRuleSet*>(this->_ruleset);
+    std::map<int, size_t>::const_iterator iter;
+    double adjustment, weight;
+    unsigned int i, count;
+    int id;
+
+    this->read (&adjustment, sizeof (adjustment));
+    this->read (&weight, sizeof (weight));
+    this->read (&count, sizeof (count));
+    for (i = 0; i < count; i++)
+    {
+        this->read (&id, sizeof (id));
+        iter = this->_indices.find (id);
+        if (iter == this->_indices.end ())
+            throw std::runtime_error ("update refers to an unknown rule");
+        ruleset->getRule (iter->second)->setUsed (true);
+    }
+
+    ruleset->adjustment = adjustment;
+    ruleset->updateWeights (0);
+    if (!_is_same_weight (*ruleset, weight))
+        this->_diverged = true;
+    this->_episode++;
+}
+
+void Replay::readBatch ()
+{
+    std::map<int, size_t>::const_iterator iter;
+    std::vector<double> adjustments;
+    std::vector<size_t> used;
+    std::vector<WeightUpdate> updates;
+    double weight;
+    unsigned int i, j, count, ucount;
+    size_t offset;
+    int id;
+
+    this->read (&weight, sizeof (weight));
+    this->read (&count, sizeof (count));
+    adjustments.resize (count);
+    updates.resize (count);
+    for (i = 0; i < count; i++)
+    {
+        this->read (&adjustments[i], sizeof (double));
+        this->read (&ucount, sizeof (ucount));
+        updates[i].count = ucount;
+        for (j = 0; j < ucount; j++)
+        {
+            this->read (&id, sizeof (id));
+            iter = this->_indices.find (id);
+            if (iter == this->_indices.end ())
+                throw std::runtime_error ("update refers to an unknown rule");
+            used.push_back (iter->second);
+        }
+    }
+
+    /* Point the updates into the collected indices, once all were read. */
+    offset = 0;
+    for (i = 0; i < count; i++)
+    {
+        updates[i].fitness = &adjustments[i];
+        updates[i].used = used.empty () ? 0 : &used[offset];
+        offset += updates[i].count;
+    }
+
+    if (count > 0)
+        this->_ruleset->applyUpdates (&updates[0], count);
+    if (!_is_same_weight (*this->_ruleset, weight))
+        this->_diverged = true;
+    this->_episode += count;
+}
+
+void Replay::readRescale ()
+{
+    double center, decay, scale, weight;
+    unsigned int range[2];
+
+    this->read (&center, sizeof (center));
+    this->read (&decay, sizeof (decay));
+    this->read (&scale, sizeof (scale));
+    this->read (range, sizeof (range));
+    this->read (&weight, sizeof (weight));
+
+    if (range[0] > this->_ruleset->getCount () ||
+        range[1] > this->_ruleset->getCount () - range[0])
+        throw std::runtime_error ("rescaling refers to unknown rules");
+    this->_ruleset->rescaleWeights (center, decay, scale, range[0],
+        range[1]);
+    if (!_is_same_weight (*this->_ruleset, weight))
+        this->_diverged = true;
+}
+
+unsigned long Replay::seek (unsigned long episode)
+{
+    int next;
+
+    while (true)
+    {
+        next = this->_stream.peek ();
+        if (next == std::istream::traits_type::eof ())
+            break;
+        if ((next == ReplayLog::UPDATE || next == ReplayLog::BATCH) &&
+            this->_episode >= episode)
+            break;
+        this->step ();
+    }
+    return this->_episode;
+}
+
+unsigned long Replay::getEpisode () const
+{
+    return this->_episode;
+}
+
+unsigned int Replay::getSeed () const
+{
+    return this->_seed;
+}
+
+const std::vector<int>& Replay::getScript () const
+{
+    return this->_script;
+}
+
+const RuleSet& Replay::getRuleSet () const
+{
+    return *this->_ruleset;
+}
+
+bool Replay::isDiverged () const
+{
+    return this->_diverged;
+}
+
+} // namespace
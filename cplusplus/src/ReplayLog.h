@@ -0,0 +1,406 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _REPLAYLOG_H_
+#define _REPLAYLOG_H_
+
+#include <iostream>
+#include <vector>
+#include <map>
+#include <mutex>
+#include "RuleSet.h"
+
+namespace dynrules
+{
+    /**
+     * \brief A compact, binary log of the script generation and learning
+     * events.
+     *
+     * A ReplayLog records the random seed of a LearnSystem, the ids of the
+     * rules selected for each script, the adjustments applied by
+     * RuleSet::updateWeights() and RuleSet::applyUpdates(), the rescalings
+     * of RuleSet::rescaleWeights() and checkpoints of the rule weights, so
+     * that the weights at any episode can be reconstructed with Replay.
+     *
+     * The events are collected in memory and written to the stream in
+     * blocks, once the buffer is full, on flush() and on destruction.
+     * Writing events, which are smaller than the buffer, does not allocate
+     * any memory.
+     *
+     * \code
+     *   std::ofstream stream ("learning.log", std::ios::binary);
+     *   ReplayLog log (stream);
+     *   lsystem.setReplayLog (&log);
+     *   ...
+     * \endcode
+     *
+     * The log uses the byte order of the host and is safe to be written
+     * to from multiple threads.
+     */
+    class ReplayLog
+    {
+    public:
+        /**
+         * \brief The event types of the log.
+         */
+        enum EventType
+        {
+            /** The seed of the random number generator. */
+            SEED = 1,
+            /** The ids of the rules selected for a script. */
+            SCRIPT = 2,
+            /** A weight update with the ids of the used rules. */
+            UPDATE = 3,
+            /** The ids and weights of all rules. */
+            WEIGHTS = 4,
+            /** The adjustments and used rules of multiple encounters. */
+            BATCH = 5,
+            /** A rescaling of the weights of a range of rules. */
+            RESCALE = 6
+        };
+
+        /**
+         * \brief The magic value at the start of the log.
+         */
+        static const unsigned int MAGIC = 0x4c525244;
+
+        /**
+         * \brief The version of the log format.
+         */
+        static const unsigned int VERSION = 2;
+
+        /**
+         * \brief Creates a new ReplayLog.
+         *
+         * \param stream The stream to write the log to. It must be opened
+         * in binary mode.
+         * \param buffersize The amount of bytes to collect, before they
+         * are written to the stream.
+         */
+        ReplayLog (std::ostream& stream, size_t buffersize = 65536);
+
+        /**
+         * \brief Destroys the ReplayLog and writes the remaining events.
+         */
+        virtual ~ReplayLog ();
+
+        /**
+         * \brief Gets the amount of weight updates written.
+         *
+         * \return The amount of weight updates.
+         */
+        unsigned long getEpisode () const;
+
+        /**
+         * \brief Writes the seed of the random number generator.
+         *
+         * \param seed The seed.
+         */
+        void writeSeed (unsigned int seed);
+
+        /**
+         * \brief Writes the ids of the rules selected for a script.
+         *
+         * \param ids The ids of the rules in the order of selection.
+         * \param count The amount of ids.
+         */
+        void writeScript (const int* ids, size_t count);
+
+        /**
+         * \brief Writes a weight update of a RuleSet.
+         *
+         * The ids of the used rules are collected by the RuleSet while
+         * it resets their usage states, so that writing the update does
+         * not need another pass over the rules.
+         *
+         * \param adjustment The adjustment applied to the used rules.
+         * \param weight The total weight after the update, summed up in
+         * the order of the rules.
+         * \param ids The ids of the used rules in the order of the rules.
+         * \param count The amount of ids.
+         */
+        void writeUpdate (double adjustment, double weight, const int* ids,
+            size_t count);
+
+        /**
+         * \brief Writes the encounters applied by RuleSet::applyUpdates().
+         *
+         * The ids of the used rules are taken from the RuleSet. Encounters,
+         * in which no or all rules were used, are skipped. Each written
+         * encounter counts as a weight update.
+         *
+         * \param ruleset The RuleSet, which applied the encounters.
+         * \param updates The results of the encounters.
+         * \param adjustments The adjustment of each encounter.
+         * \param count The amount of encounters.
+         * \param weight The total weight after the updates, summed up in
+         * the order of the rules.
+         */
+        void writeBatch (const RuleSet& ruleset, const WeightUpdate* updates,
+            const double* adjustments, size_t count, double weight);
+
+        /**
+         * \brief Writes a rescaling done by RuleSet::rescaleWeights().
+         *
+         * Rescalings do not count as weight updates.
+         *
+         * \param center The value the weights were moved toward.
+         * \param decay The fraction of the distance to center kept.
+         * \param scale The factor the weights were multiplied with.
+         * \param first The index of the first changed rule.
+         * \param count The amount of changed rules.
+         * \param weight The total weight after the rescaling.
+         */
+        void writeRescale (double center, double decay, double scale,
+            size_t first, size_t count, double weight);
+
+        /**
+         * \brief Writes a checkpoint of the ids and weights of all rules of
+         * a RuleSet.
+         *
+         * This must be called after adding or removing rules, so that the
+         * following updates can be replayed.
+         *
+         * \param ruleset The RuleSet to write the weights for.
+         */
+        void writeWeights (const RuleSet& ruleset);
+
+        /**
+         * \brief Writes the collected events to the stream.
+         */
+        void flush ();
+
+    protected:
+
+        /**
+         * \brief Appends raw data to the buffer.
+         *
+         * \param data The data to append.
+         * \param size The size of the data in bytes.
+         */
+        void append (const void* data, size_t size);
+
+        /**
+         * \brief Appends the type and size of an event to the buffer.
+         *
+         * \param type The event type.
+         * \param size The size of the event data in bytes.
+         */
+        void appendEvent (EventType type, size_t size);
+
+        /**
+         * \brief Writes the buffer to the stream, if an event does not fit
+         * into it anymore.
+         *
+         * \param size The size of the event in bytes.
+         */
+        void commit (size_t size);
+
+        /**
+         * \brief The stream to write the log to.
+         */
+        std::ostream& _stream;
+
+        /**
+         * \brief The collected events.
+         */
+        std::vector<char> _buffer;
+
+        /**
+         * \brief The amount of bytes to collect before writing them.
+         */
+        size_t _buffersize;
+
+        /**
+         * \brief The amount of weight updates written.
+         */
+        unsigned long _episode;
+
+        /**
+         * \brief Serializes the writes to the log.
+         */
+        std::mutex _lock;
+
+    private:
+        ReplayLog (const ReplayLog&);
+        ReplayLog& operator= (const ReplayLog&);
+    };
+
+    /**
+     * \brief Reconstructs the rule weights from a ReplayLog.
+     *
+     * Replay reads the events of a log and applies them to its own RuleSet,
+     * which is created from the weight checkpoints of the log. Weight
+     * updates are recomputed from the logged adjustments without creating
+     * or evaluating any scripts.
+     *
+     * Updates of RuleSet classes with a custom
+     * RuleSet::distributeRemainder() implementation cannot be recomputed
+     * exactly. This is detected by comparing the total weight after each
+     * update with the logged one, see isDiverged(). The totals may differ
+     * by the rounding error of summing up the weights in another order,
+     * as done by ShardedRuleSet. Writing checkpoints
+     * regularly via ReplayLog::writeWeights() limits the effect of such
+     * deviations.
+     */
+    class Replay
+    {
+    public:
+        /**
+         * \brief Creates a new Replay for a log.
+         *
+         * \param stream The stream to read the log from. It must be opened
+         * in binary mode.
+         * \exception runtime_error Thrown, if the stream does not contain
+         * a ReplayLog.
+         */
+        Replay (std::istream& stream);
+
+        /**
+         * \brief Destroys the Replay.
+         */
+        virtual ~Replay ();
+
+        /**
+         * \brief Applies the next event of the log.
+         *
+         * \return true, if an event was applied, false, if the end of the
+         * log was reached.
+         * \exception runtime_error Thrown, if the log is corrupt or an
+         * update refers to an unknown rule.
+         */
+        bool step ();
+
+        /**
+         * \brief Applies the events of the log up to an episode.
+         *
+         * Applies all events until the next update would exceed the
+         * passed episode or the end of the log was reached. The encounters
+         * of a batch are applied together, so that the episode reached
+         * may exceed the passed one.
+         *
+         * \param episode The episode, i.e. the amount of weight updates,
+         * to seek to.
+         * \return The episode reached.
+         * \exception runtime_error Thrown, if the log is corrupt or an
+         * update refers to an unknown rule.
+         */
+        unsigned long seek (unsigned long episode);
+
+        /**
+         * \brief Gets the amount of weight updates applied.
+         *
+         * \return The amount of weight updates applied.
+         */
+        unsigned long getEpisode () const;
+
+        /**
+         * \brief Gets the last seed read.
+         *
+         * \return The last seed read.
+         */
+        unsigned int getSeed () const;
+
+        /**
+         * \brief Gets the ids of the rules of the last script read.
+         *
+         * \return The ids of the rules of the last script.
+         */
+        const std::vector<int>& getScript () const;
+
+        /**
+         * \brief Gets the RuleSet holding the reconstructed weights.
+         *
+         * \return The RuleSet holding the reconstructed weights.
+         */
+        const RuleSet& getRuleSet () const;
+
+        /**
+         * \brief Checks, whether the reconstructed weights deviated from
+         * the logged ones since the last checkpoint.
+         *
+         * \return true, if the weights deviated, false otherwise.
+         */
+        bool isDiverged () const;
+
+    protected:
+
+        /**
+         * \brief Reads raw data from the stream.
+         *
+         * \param data The location to store the data at.
+         * \param size The amount of bytes to read.
+         * \exception runtime_error Thrown, if less than size bytes could
+         * be read.
+         */
+        void read (void* data, size_t size);
+
+        /**
+         * \brief Replaces the rules of the RuleSet with the ones of a
+         * checkpoint.
+         */
+        void readWeights ();
+
+        /**
+         * \brief Recomputes a weight update.
+         */
+        void readUpdate ();
+
+        /**
+         * \brief Recomputes the weight updates of a batch.
+         */
+        void readBatch ();
+
+        /**
+         * \brief Recomputes a rescaling of the weights.
+         */
+        void readRescale ();
+
+        /**
+         * \brief The stream to read the log from.
+         */
+        std::istream& _stream;
+
+        /**
+         * \brief The RuleSet holding the reconstructed weights.
+         */
+        RuleSet* _ruleset;
+
+        /**
+         * \brief The indices of the rules of the RuleSet by their id.
+         */
+        std::map<int, size_t> _indices;
+
+        /**
+         * \brief The ids of the rules of the last script.
+         */
+        std::vector<int> _script;
+
+        /**
+         * \brief The amount of weight updates applied.
+         */
+        unsigned long _episode;
+
+        /**
+         * \brief The last seed read.
+         */
+        unsigned int _seed;
+
+        /**
+         * \brief Indicates, whether the weights deviated.
+         */
+        bool _diverged;
+
+    private:
+        Replay (const Replay&);
+        Replay& operator= (const Replay&);
+    };
+
+} // namespace
+
+#endif /* _REPLAYLOG_H_ */
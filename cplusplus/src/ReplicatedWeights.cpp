@@ -0,0 +1,424 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include <thread>
+#include <map>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include "ReplicatedWeights.h"
+#include "RuleSet.h"
+#include "Selection.h"
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace dynrules
+{
+
+/*
+ * The nodes bound to the calling thread via bindThread() by the id of the
+ * ReplicatedWeights instance. The ids are never reused, so that bindings
+ * of destroyed instances do not apply to new ones.
+ */
+static thread_local std::map<unsigned long long, unsigned int> _thread_nodes;
+
+/*
+ * The id of the next ReplicatedWeights instance.
+ */
+static std::atomic<unsigned long long> _next_id (0);
+
+/*
+ * The weights of a replica for selectRouletteRule().
+ */
+struct _ReplicaWeights
+{
+    const double *weights;
+
+    double operator() (size_t index) const
+    {
+        return weights[index];
+    }
+};
+
+#ifdef __linux__
+/*
+ * Reads the CPUs of a NUMA node from a list like "0-3,8-11".
+ */
+static bool _read_cpulist (unsigned int node, std::vector<int>& cpus)
+{
+    std::ostringstream path;
+    std::string list, range;
+    int first, last;
+    char dash;
+
+    path << "/sys/devices/system/node/node" << node << "/cpulist";
+    std::ifstream fd (path.str ().c_str ());
+    if (!fd || !std::getline (fd, list))
+        return false;
+
+    std::istringstream ranges (list);
+    while (std::getline (ranges, range, ','))
+    {
+        std::istringstream values (range);
+        if (!(values >> first))
+            continue;
+        if (!(values >> dash >> last))
+            last = first;
+        for (; first <= last; first++)
+            cpus.push_back (first);
+    }
+    return true;
+}
+
+static bool _pin_thread (const std::vector<int>& cpus)
+{
+    cpu_set_t set;
+    size_t i;
+
+    CPU_ZERO (&set);
+    for (i = 0; i < cpus.size (); i++)
+        CPU_SET (cpus[i], &set);
+    return sched_setaffinity (0, sizeof (set), &set) == 0;
+}
+#endif
+
+/*
+ * Allocates the memory for count weights and writes it first on a thread
+ * running on one of the CPUs, so that the pages are placed on their node.
+ */
+static void _place_weights (std::vector<double>& weights, size_t count,
+    const std::vector<int>& cpus)
+{
+    std::vector<double> placed;
+
+    if (cpus.empty ())
+    {
+        placed.assign (count, 0);
+        weights.swap (placed);
+        return;
+    }
+
+    std::thread worker ([&placed, &cpus, count] ()
+        {
+#ifdef __linux__
+            /* Without pinning, the memory is placed like any other. */
+            _pin_thread (cpus);
+#endif
+            placed.assign (count, 0);
+        });
+    worker.join ();
+    weights.swap (placed);
+}
+
+WeightReplica::WeightReplica (RuleSet* ruleset, unsigned int node,
+    const std::vector<int>* cpus) :
+    WeightOverlay(ruleset),
+    _node(node),
+    _cpus(cpus),
+    _weights()
+{
+}
+
+WeightReplica::~WeightReplica ()
+{
+}
+
+unsigned int WeightReplica::getNode () const
+{
+    return this->_node;
+}
+
+size_t WeightReplica::getCount () const
+{
+    return this->_weights.size ();
+}
+
+double WeightReplica::getWeight (size_t index) const
+{
+    return this->_weights.at (index);
+}
+
+bool WeightReplica::getUsed (size_t index) const
+{
+    if (index >= this->_weights.size ())
+        throw std::out_of_range ("index out of range");
+    return false;
+}
+
+void WeightReplica::setUsed (size_t /* index */, bool /* used */)
+{
+    throw std::logic_error ("replicated weights are read-only");
+}
+
+size_t WeightReplica::selectRule (double fraction) const
+{
+    _ReplicaWeights weights = { this->_weights.data () };
+    return selectRouletteRule (weights, this->_weights.size (), fraction);
+}
+
+void WeightReplica::reset ()
+{
+    size_t i, count = this->_ruleset->getCount ();
+    double weight, totweight = 0;
+
+    if (count != this->_weights.size ())
+        _place_weights (this->_weights, count, *this->_cpus);
+    for (i = 0; i < count; i++)
+    {
+        weight = this->_ruleset->getRule (i)->getWeight ();
+        this->_weights[i] = weight;
+        totweight += weight;
+    }
+    this->_weight = totweight;
+}
+
+void WeightReplica::updateWeights (void* /* fitness */)
+{
+    throw std::logic_error ("replicated weights are read-only");
+}
+
+void WeightReplica::storeWeight (size_t /* index */, double /* weight */)
+{
+    throw std::logic_error ("replicated weights are read-only");
+}
+
+void WeightReplica::clearUsed ()
+{
+}
+
+ReplicatedWeights::ReplicatedWeights (RuleSet* ruleset, unsigned int nodes) :
+    _ruleset(ruleset),
+    _cpus(),
+    _cpunodes(),
+    _replicas(),
+    _readers(),
+    _simulated(true),
+    _generation(0),
+    _id(_next_id++)
+{
+    std::vector<int> cpus;
+    unsigned int node, buffer;
+    size_t i;
+
+    if (ruleset == 0)
+        throw std::invalid_argument ("ruleset must not be NULL");
+
+#ifdef __linux__
+    for (node = 0; _read_cpulist (node, cpus); node++)
+    {
+        this->_cpus.push_back (cpus);
+        cpus.clear ();
+    }
+    if (!this->_cpus.empty () &&
+        (nodes == 0 || nodes == this->_cpus.size ()))
+        this->_simulated = false;
+    else
+    {
+        cpu_set_t set;
+
+        /* Simulate the nodes using the CPUs the process may run on. */
+        this->_cpus.clear ();
+        CPU_ZERO (&set);
+        if (sched_getaffinity (0, sizeof (set), &set) == 0)
+        {
+            for (i = 0; i < CPU_SETSIZE; i++)
+            {
+                if (CPU_ISSET (i, &set))
+                    cpus.push_back (static_cast<int>(i));
+            }
+        }
+    }
+#else
+    for (i = 0; i < std::thread::hardware_concurrency (); i++)
+        cpus.push_back (static_cast<int>(i));
+#endif
+
+    if (this->_simulated)
+    {
+        if (nodes == 0)
+            nodes = 1;
+        this->_cpus.resize (nodes);
+        for (i = 0; i < cpus.size (); i++)
+            this->_cpus[i % nodes].push_back (cpus[i]);
+    }
+
+    for (node = 0; node < this->_cpus.size (); node++)
+    {
+        for (i = 0; i < this->_cpus[node].size (); i++)
+        {
+            size_t cpu = static_cast<size_t>(this->_cpus[node][i]);
+            if (cpu >= this->_cpunodes.size ())
+                this->_cpunodes.resize (cpu + 1, 0);
+            this->_cpunodes[cpu] = node;
+        }
+    }
+
+    try
+    {
+        for (buffer = 0; buffer < 2; buffer++)
+        {
+            for (node = 0; node < this->_cpus.size (); node++)
+            {
+                this->_replicas[buffer].push_back (0);
+                this->_replicas[buffer][node] = new WeightReplica (ruleset,
+                    node, &this->_cpus[node]);
+                this->_replicas[buffer][node]->reset ();
+            }
+        }
+    }
+    catch (...)
+    {
+        for (buffer = 0; buffer < 2; buffer++)
+        {
+            for (i = 0; i < this->_replicas[buffer].size (); i++)
+                delete this->_replicas[buffer][i];
+        }
+        throw;
+    }
+}
+
+ReplicatedWeights::~ReplicatedWeights ()
+{
+    size_t i, buffer;
+
+    for (buffer = 0; buffer < 2; buffer++)
+    {
+        for (i = 0; i < this->_replicas[buffer].size (); i++)
+            delete this->_replicas[buffer][i];
+    }
+}
+
+RuleSet* ReplicatedWeights::getRuleSet () const
+{
+    return this->_ruleset;
+}
+
+unsigned int ReplicatedWeights::getNodeCount () const
+{
+    return static_cast<unsigned int>(this->_replicas[0].size ());
+}
+
+bool ReplicatedWeights::isSimulated () const
+{
+    return this->_simulated;
+}
+
+const std::vector<int>& ReplicatedWeights::getCpus (unsigned int node) const
+{
+    return this->_cpus.at (node);
+}
+
+unsigned long long ReplicatedWeights::getGeneration () const
+{
+    return this->_generation.load (std::memory_order_acquire);
+}
+
+unsigned long long ReplicatedWeights::refresh ()
+{
+    unsigned long long generation =
+        this->_generation.load (std::memory_order_relaxed) + 1;
+    std::vector<WeightReplica*>& replicas = this->_replicas[generation & 1];
+    size_t i;
+
+    /*
+     * Readers keep using the other set, until the new one is published.
+     * Wait for the ones, which registered for this set before the other
+     * set was published.
+     */
+    while (this->_readers[generation & 1].load () != 0)
+        std::this_thread::yield ();
+    for (i = 0; i < replicas.size (); i++)
+        replicas[i]->reset ();
+    this->_generation.store (generation);
+    return generation;
+}
+
+const WeightReplica& ReplicatedWeights::getReplica (unsigned int node) const
+{
+    return *this->_replicas[this->getGeneration () & 1].at (node);
+}
+
+const WeightReplica& ReplicatedWeights::getLocalReplica () const
+{
+    return *this->_replicas[this->getGeneration () & 1][
+        this->getCurrentNode ()];
+}
+
+unsigned int ReplicatedWeights::getCurrentNode () const
+{
+    std::map<unsigned long long, unsigned int>::const_iterator iter =
+        _thread_nodes.find (this->_id);
+
+    if (iter != _thread_nodes.end ())
+        return iter->second;
+#ifdef __linux__
+    int cpu = sched_getcpu ();
+    if (cpu >= 0 && static_cast<size_t>(cpu) < this->_cpunodes.size ())
+        return this->_cpunodes[static_cast<size_t>(cpu)];
+#endif
+    return 0;
+}
+
+void ReplicatedWeights::bindThread (unsigned int node) const
+{
+    const std::vector<int>& cpus = this->_cpus.at (node);
+
+#ifdef __linux__
+    if (!cpus.empty () && !_pin_thread (cpus))
+        throw std::runtime_error ("could not pin the thread to the node");
+#endif
+    _thread_nodes[this->_id] = node;
+}
+
+void ReplicatedWeights::unbindThread () const
+{
+    _thread_nodes.erase (this->_id);
+}
+
+ReplicaReader::ReplicaReader (const ReplicatedWeights& replicas) :
+    _replicas(&replicas),
+    _buffer(0)
+{
+    unsigned long long generation;
+
+    /*
+     * Register for the published set and check, that it is still
+     * published. Otherwise, refresh() might have checked the readers of
+     * the set before the registration and is writing it already.
+     */
+    while (true)
+    {
+        generation = replicas._generation.load ();
+        this->_buffer = static_cast<unsigned int>(generation & 1);
+        replicas._readers[this->_buffer]++;
+        if (replicas._generation.load () == generation)
+            break;
+        replicas._readers[this->_buffer]--;
+    }
+}
+
+ReplicaReader::~ReplicaReader ()
+{
+    this->_replicas->_readers[this->_buffer]--;
+}
+
+const WeightReplica& ReplicaReader::getReplica (unsigned int node) const
+{
+    return *this->_replicas->_replicas[this->_buffer].at (node);
+}
+
+const WeightReplica& ReplicaReader::getLocalReplica () const
+{
+    return *this->_replicas->_replicas[this->_buffer][
+        this->_replicas->getCurrentNode ()];
+}
+
+} // namespace
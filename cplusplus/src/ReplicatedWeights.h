@@ -0,0 +1,413 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _REPLICATEDWEIGHTS_H_
+#define _REPLICATEDWEIGHTS_H_
+
+#include <vector>
+#include <atomic>
+#include "WeightOverlay.h"
+
+namespace dynrules
+{
+    class ReplicatedWeights;
+    class ReplicaReader;
+
+    /**
+     * \brief A read-only copy of the weights of a RuleSet, which is kept
+     * in the memory of a NUMA node.
+     *
+     * WeightReplica objects are created and refreshed by a
+     * ReplicatedWeights instance.
+     */
+    class WeightReplica : public WeightOverlay
+    {
+        friend class ReplicatedWeights;
+
+    public:
+        using WeightOverlay::getWeight;
+
+        /**
+         * \brief Destroys the WeightReplica.
+         */
+        virtual ~WeightReplica ();
+
+        /**
+         * \brief Gets the NUMA node, in whose memory the weights are kept.
+         *
+         * \return The index of the node.
+         */
+        unsigned int getNode () const;
+
+        size_t getCount () const;
+        double getWeight (size_t index) const;
+
+        /**
+         * \brief Gets whether a specific rule was used or not.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \return Always false.
+         * \exception out_of_range Thrown, if index is out of range.
+         */
+        bool getUsed (size_t index) const;
+
+        /**
+         * \brief Not supported.
+         *
+         * \exception logic_error Always thrown, since the weights are
+         * read-only.
+         */
+        void setUsed (size_t index, bool used);
+
+        size_t selectRule (double fraction) const;
+
+        /**
+         * \brief Copies the weights of the Rule objects of the RuleSet.
+         *
+         * If the amount of rules changed, the memory for the weights is
+         * allocated anew on the node of the WeightReplica. This is only
+         * done by ReplicatedWeights::refresh() for the set of replicas,
+         * which is neither published nor read.
+         */
+        void reset ();
+
+        /**
+         * \brief Not supported.
+         *
+         * \exception logic_error Always thrown, since the weights are
+         * read-only.
+         */
+        void updateWeights (void *fitness);
+
+    protected:
+
+        /**
+         * \brief Creates a new WeightReplica on a NUMA node.
+         *
+         * \param ruleset The RuleSet to copy the weights of.
+         * \param node The index of the node.
+         * \param cpus The CPUs of the node, which are used for placing the
+         * memory of the weights.
+         */
+        WeightReplica (RuleSet* ruleset, unsigned int node,
+            const std::vector<int>* cpus);
+
+        /**
+         * \brief Not supported.
+         *
+         * \exception logic_error Always thrown, since the weights are
+         * read-only.
+         */
+        void storeWeight (size_t index, double weight);
+
+        void clearUsed ();
+
+        /**
+         * \brief The index of the NUMA node.
+         */
+        unsigned int _node;
+
+        /**
+         * \brief The CPUs of the NUMA node.
+         */
+        const std::vector<int> *_cpus;
+
+        /**
+         * \brief The copied weights.
+         */
+        std::vector<double> _weights;
+
+    private:
+        WeightReplica (const WeightReplica&);
+        WeightReplica& operator= (const WeightReplica&);
+    };
+
+    /**
+     * \brief Replicates the weights of a RuleSet for each NUMA node.
+     *
+     * On systems with multiple NUMA nodes, reading the weights of the Rule
+     * objects from threads on another node than the one holding their
+     * memory is slower. ReplicatedWeights keeps a WeightReplica of the
+     * weights per node. The memory of each replica is written first by a
+     * thread running on a CPU of its node, so that the operating system
+     * places it on that node.
+     *
+     * If set via LearnSystem::setReplicatedWeights(), the LearnSystem
+     * creates scripts from the replica of the node of the calling thread.
+     * The node of a thread is determined by the CPU it runs on, or can be
+     * set using bindThread().
+     *
+     * \code
+     *   ReplicatedWeights replicas (ruleset);
+     *   lsystem.setReplicatedWeights (&replicas);
+     *   ... on each worker thread ...
+     *   replicas.bindThread (node);
+     *   lsystem.createRules (handle, 10);
+     *   ... on the learning thread, after updating the weights ...
+     *   replicas.refresh ();
+     * \endcode
+     *
+     * The replicas are refreshed by the updateWeights() methods of the
+     * LearnSystem and by a LearnPipeline after applying the collected
+     * updates. After changing the weights of the RuleSet in other ways,
+     * refresh() must be called. Two sets of replicas are kept. refresh()
+     * writes the set, which is not published, and publishes it
+     * afterwards, so that scripts can be created while the replicas are
+     * refreshed. The replicas are read via a ReplicaReader, which keeps
+     * refresh() from writing them until the ReplicaReader is destroyed.
+     * refresh() must not be called concurrently with itself.
+     *
+     * To test the replication on a system with a single node, more nodes
+     * can be simulated. The CPUs are then assigned to the simulated nodes
+     * in turn. The NUMA topology is only detected on Linux. On other
+     * systems, all nodes are simulated and bindThread() does not pin the
+     * thread to any CPU.
+     */
+    class ReplicatedWeights
+    {
+    public:
+        /**
+         * \brief Creates a new ReplicatedWeights instance.
+         *
+         * \param ruleset The RuleSet to replicate the weights of.
+         * \param nodes The amount of nodes or 0 to use the NUMA nodes of
+         * the system. If it differs from the amount of NUMA nodes of the
+         * system, the nodes will be simulated.
+         * \exception invalid_argument Thrown, if ruleset is NULL.
+         */
+        ReplicatedWeights (RuleSet* ruleset, unsigned int nodes = 0);
+
+        /**
+         * \brief Destroys the ReplicatedWeights and its replicas.
+         */
+        virtual ~ReplicatedWeights ();
+
+        /**
+         * \brief Gets the RuleSet, whose weights are replicated.
+         *
+         * \return The RuleSet.
+         */
+        RuleSet* getRuleSet () const;
+
+        /**
+         * \brief Gets the amount of nodes.
+         *
+         * \return The amount of nodes, which is the amount of replicas.
+         */
+        unsigned int getNodeCount () const;
+
+        /**
+         * \brief Checks, whether the nodes are simulated.
+         *
+         * \return true, if the nodes are simulated, false, if they are the
+         * NUMA nodes of the system.
+         */
+        bool isSimulated () const;
+
+        /**
+         * \brief Gets the CPUs of a node.
+         *
+         * \param node The index of the node.
+         * \return The CPUs of the node, which can be empty for simulated
+         * nodes.
+         * \exception out_of_range Thrown, if node is out of range.
+         */
+        const std::vector<int>& getCpus (unsigned int node) const;
+
+        /**
+         * \brief Gets the amount of refreshes since the construction.
+         *
+         * \return The generation of the replicated weights.
+         */
+        unsigned long long getGeneration () const;
+
+        /**
+         * \brief Copies the current weights of the RuleSet into all
+         * replicas.
+         *
+         * Writes the set of replicas, which is not published, and
+         * publishes it afterwards. Before writing the set, refresh() waits
+         * for the ReplicaReader objects still reading it, so the calling
+         * thread must not keep a ReplicaReader itself.
+         *
+         * \return The generation of the replicated weights.
+         */
+        unsigned long long refresh ();
+
+        /**
+         * \brief Gets the replica of a node.
+         *
+         * The replica can be written by the second next refresh(), use a
+         * ReplicaReader to read it while the weights are refreshed.
+         *
+         * \param node The index of the node.
+         * \return The WeightReplica of the node.
+         * \exception out_of_range Thrown, if node is out of range.
+         */
+        const WeightReplica& getReplica (unsigned int node) const;
+
+        /**
+         * \brief Gets the replica of the node of the calling thread.
+         *
+         * The replica can be written by the second next refresh(), use a
+         * ReplicaReader to read it while the weights are refreshed.
+         *
+         * \return The WeightReplica of the node.
+         */
+        const WeightReplica& getLocalReplica () const;
+
+        /**
+         * \brief Gets the node of the calling thread.
+         *
+         * \return The node set via bindThread() or, if none was set, the
+         * node of the CPU the thread runs on.
+         */
+        unsigned int getCurrentNode () const;
+
+        /**
+         * \brief Binds the calling thread to a node.
+         *
+         * Pins the thread to the CPUs of the node, if there are any, and
+         * uses the replica of the node for the thread, regardless of the
+         * CPU it runs on. The binding only applies to this
+         * ReplicatedWeights instance and is kept, until the thread ends or
+         * unbindThread() is called.
+         *
+         * \param node The index of the node.
+         * \exception out_of_range Thrown, if node is out of range.
+         * \exception runtime_error Thrown, if the thread could not be
+         * pinned to the CPUs of the node.
+         */
+        void bindThread (unsigned int node) const;
+
+        /**
+         * \brief Removes the node binding of the calling thread for this
+         * ReplicatedWeights instance.
+         *
+         * The thread is not unpinned from the CPUs.
+         */
+        void unbindThread () const;
+
+    protected:
+
+        /**
+         * \brief The RuleSet, whose weights are replicated.
+         */
+        RuleSet *_ruleset;
+
+        /**
+         * \brief The CPUs of the nodes.
+         */
+        std::vector<std::vector<int> > _cpus;
+
+        /**
+         * \brief The node of each CPU.
+         */
+        std::vector<unsigned int> _cpunodes;
+
+        /**
+         * \brief The two sets of replicas of the nodes. The published set
+         * is selected by the lowest bit of the generation.
+         */
+        std::vector<WeightReplica*> _replicas[2];
+
+        /**
+         * \brief The amount of ReplicaReader objects of each set of
+         * replicas.
+         */
+        mutable std::atomic<unsigned int> _readers[2];
+
+        /**
+         * \brief Indicates, whether the nodes are simulated.
+         */
+        bool _simulated;
+
+        /**
+         * \brief The amount of refreshes.
+         */
+        std::atomic<unsigned long long> _generation;
+
+        /**
+         * \brief The unique id of the instance for the node bindings of
+         * the threads.
+         */
+        unsigned long long _id;
+
+    private:
+        ReplicatedWeights (const ReplicatedWeights&);
+        ReplicatedWeights& operator= (const ReplicatedWeights&);
+
+        friend class ReplicaReader;
+    };
+
+    /**
+     * \brief Reads the published replicas of a ReplicatedWeights instance.
+     *
+     * A ReplicaReader registers itself for the set of replicas, which is
+     * published on its construction. ReplicatedWeights::refresh() does
+     * not write that set, until the ReplicaReader is destroyed, so that
+     * its replicas stay unchanged while they are read.
+     *
+     * \code
+     *   {
+     *       ReplicaReader reader (replicas);
+     *       size_t index = reader.getLocalReplica ().selectRule (fraction);
+     *       ...
+     *   }
+     * \endcode
+     */
+    class ReplicaReader
+    {
+    public:
+        /**
+         * \brief Creates a new ReplicaReader for the published replicas.
+         *
+         * \param replicas The ReplicatedWeights to read.
+         */
+        explicit ReplicaReader (const ReplicatedWeights& replicas);
+
+        /**
+         * \brief Destroys the ReplicaReader, so that its replicas can be
+         * refreshed.
+         */
+        ~ReplicaReader ();
+
+        /**
+         * \brief Gets the replica of a node.
+         *
+         * \param node The index of the node.
+         * \return The WeightReplica of the node.
+         * \exception out_of_range Thrown, if node is out of range.
+         */
+        const WeightReplica& getReplica (unsigned int node) const;
+
+        /**
+         * \brief Gets the replica of the node of the calling thread.
+         *
+         * \return The WeightReplica of the node.
+         */
+        const WeightReplica& getLocalReplica () const;
+
+    private:
+        ReplicaReader (const ReplicaReader&);
+        ReplicaReader& operator= (const ReplicaReader&);
+
+        /**
+         * \brief The ReplicatedWeights to read.
+         */
+        const ReplicatedWeights *_replicas;
+
+        /**
+         * \brief The index of the set of replicas to read.
+         */
+        unsigned int _buffer;
+    };
+
+} // namespace
+
+#endif /* _REPLICATEDWEIGHTS_H_ */
@@ -11,73 +11,84 @@
 
 namespace dynrules
 {
+const std::string Rule::_nocode;
+
+/* Creates the out-of-line code of a Rule, if there is any code. */
+static std::string* _create_code (const std::string& code)
+{
+    return code.empty () ? 0 : new std::string (code);
+}
+
 Rule::Rule () :
-    _id(0),
     _weight(0.f),
-    _used(false),
-    _code("")
+    _code(0),
+    _id(0),
+    _priority(0),
+    _used(false)
 {
 }
 
 Rule::Rule (int id) :
-    _id(id),
     _weight(0.f),
-    _used(false),
-    _code("")
+    _code(0),
+    _id(id),
+    _priority(0),
+    _used(false)
 {
 }
 
 Rule::Rule (int id, std::string code) :
-    _id(id),
     _weight(0.f),
-    _used(false),
-    _code(code)
+    _code(_create_code (code)),
+    _id(id),
+    _priority(0),
+    _used(false)
 {
 }
 
 Rule::Rule (int id, double weight) :
-    _id(id),
     _weight(weight),
-    _used(false),
-    _code("")
+    _code(0),
+    _id(id),
+    _priority(0),
+    _used(false)
 {
 }
 
 Rule::Rule (int id, std::string code, double weight) :
-    _id(id),
     _weight(weight),
-    _used(false),
-    _code(code)
-{
-}
-
-Rule::~Rule ()
-{
-}
-
-double Rule::getWeight () const
+    _code(_create_code (code)),
+    _id(id),
+    _priority(0),
+    _used(false)
 {
-    return this->_weight;
 }
 
-void Rule::setWeight (double weight)
-{
-    this->_weight = weight;
-}
-    
-bool Rule::getUsed () const
+Rule::Rule (const Rule& rule) :
+    _weight(rule._weight),
+    _code(_create_code (rule.getCode ())),
+    _id(rule._id),
+    _priority(rule._priority),
+    _used(rule._used)
 {
-    return this->_used;
 }
 
-void Rule::setUsed (bool used)
+Rule::~Rule ()
 {
-    this->_used = used;
+    delete this->_code;
 }
 
-int Rule::getId () const
+Rule& Rule::operator= (const Rule& rule)
 {
-    return _id;
+    if (this != &rule)
+    {
+        this->setCode (rule.getCode ());
+        this->_weight = rule._weight;
+        this->_id = rule._id;
+        this->_priority = rule._priority;
+        this->_used = rule._used;
+    }
+    return *this;
 }
 
 void Rule::setId (int id)
@@ -85,14 +96,22 @@ void Rule::setId (int id)
     this->_id = id;
 }
 
-std::string Rule::getCode () const
+void Rule::setCode (const std::string& code)
 {
-    return this->_code;
+    if (code.empty ())
+    {
+        delete this->_code;
+        this->_code = 0;
+    }
+    else if (this->_code)
+        *this->_code = code;
+    else
+        this->_code = new std::string (code);
 }
 
-void Rule::setCode (const std::string& code)
+void Rule::setPriority (int priority)
 {
-    this->_code = code;
+    this->_priority = priority;
 }
 
 bool Rule::operator ==(const Rule& rule)
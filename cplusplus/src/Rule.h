@@ -19,6 +19,11 @@ namespace dynrules
      * Rule is a simple class type that carries a weight indicator and
      * arbitrary code data for usage in the dynamic script generation
      * process.
+     *
+     * The code is kept out of line and only allocated, if a Rule holds
+     * any code, so that the fields used by the weight updates and the
+     * rule selection stay compact. Rules, whose code is provided by a
+     * CodeCache or CodeStore, do not need to hold any code at all.
      */
     class Rule
     {
@@ -60,11 +65,26 @@ namespace dynrules
          */
         Rule (int id, std::string code, double weight);
 
+        /**
+         * \brief Creates a new Rule instance from another one.
+         *
+         * \param rule The Rule to copy.
+         */
+        Rule (const Rule& rule);
+
         /**
          * \brief Destroys the Rule.
          */
         virtual ~Rule ();
 
+        /**
+         * \brief Copies the values of another Rule.
+         *
+         * \param rule The Rule to copy.
+         * \return The Rule.
+         */
+        Rule& operator= (const Rule& rule);
+
         /**
          * \brief Gets the weight of the Rule.
          *
@@ -110,17 +130,38 @@ namespace dynrules
         /**
          * \brief Gets the code hold by the Rule.
          *
-         * \return The code hold by the Rule.
+         * \return The code hold by the Rule. It is valid until the next
+         * setCode() call.
          */
-        std::string getCode () const;
+        const std::string& getCode () const;
 
         /**
          * \brief Sets the code to hold by the Rule.
          *
+         * Setting an empty code releases the memory of the previous code.
+         *
          * \param code The code to hold.
          */
         void setCode (const std::string& code);
 
+        /**
+         * \brief Gets the priority of the Rule.
+         *
+         * \return The priority of the Rule.
+         */
+        int getPriority () const;
+
+        /**
+         * \brief Sets the priority of the Rule.
+         *
+         * The priority is used by LearnSystem::setOrderByPriority() to
+         * order the rules within a script. Rules with a higher priority are
+         * placed first. The default priority is 0.
+         *
+         * \param priority The priority to set.
+         */
+        void setPriority (int priority);
+
         /**
          * \brief Compares the rule with another Rule.
          *
@@ -135,15 +176,25 @@ namespace dynrules
 
     protected:
 
+        /**
+         * \brief The current weight.
+         */
+        double _weight;
+
+        /**
+         * \brief The code to execute or NULL, if there is no code.
+         */
+        std::string* _code;
+
         /**
          * \brief The (unique) id.
          */
         int _id;
 
         /**
-         * \brief The current weight.
+         * \brief The priority within a script.
          */
-        double _weight;
+        int _priority;
 
         /**
          * \brief Usage flag indicating whether the Rule was executed.
@@ -151,9 +202,9 @@ namespace dynrules
         bool _used;
 
         /**
-         * \brief The code to execute.
+         * \brief The code of all Rules without any code.
          */
-        std::string _code;
+        static const std::string _nocode;
     };
 
     /**
@@ -166,6 +217,45 @@ namespace dynrules
      */
     bool operator ==(const Rule& a, const Rule& b);
 
+    /*
+     * The accessors used by the script generation and weight updates are
+     * defined inline, so that they do not cause a call per rule.
+     */
+    inline double Rule::getWeight () const
+    {
+        return this->_weight;
+    }
+
+    inline void Rule::setWeight (double weight)
+    {
+        this->_weight = weight;
+    }
+
+    inline bool Rule::getUsed () const
+    {
+        return this->_used;
+    }
+
+    inline void Rule::setUsed (bool used)
+    {
+        this->_used = used;
+    }
+
+    inline int Rule::getId () const
+    {
+        return this->_id;
+    }
+
+    inline const std::string& Rule::getCode () const
+    {
+        return this->_code ? *this->_code : _nocode;
+    }
+
+    inline int Rule::getPriority () const
+    {
+        return this->_priority;
+    }
+
 } //namespace
 
 #endif /* _RULE_H_ */
@@ -6,11 +6,16 @@
  * This file is distributed under the Public Domain.
  */
 
+#include <stdexcept>
 #include "RuleManager.h"
 
 namespace dynrules
 {
 
+RuleBatchHandler::~RuleBatchHandler ()
+{
+}
+
 RuleManager::RuleManager (unsigned int maxrules) :
     _maxrules (maxrules)
 {
@@ -20,6 +25,54 @@ RuleManager::~RuleManager ()
 {
 }
 
+std::vector<Rule*> RuleManager::loadRules (unsigned int offset,
+    unsigned int maxrules)
+{
+    std::vector<Rule*> rules = this->loadRules ();
+
+    if (offset >= rules.size ())
+        return std::vector<Rule*> ();
+    if (maxrules > rules.size () - offset)
+        maxrules = static_cast<unsigned int>(rules.size () - offset);
+    return std::vector<Rule*> (rules.begin () + offset,
+        rules.begin () + offset + maxrules);
+}
+
+unsigned int RuleManager::loadRules (RuleBatchHandler& handler,
+    unsigned int batchsize)
+{
+    std::vector<Rule*> rules;
+    unsigned int offset = 0;
+
+    if (batchsize == 0)
+        throw std::invalid_argument ("batchsize must not be 0");
+
+    do
+    {
+        rules = this->loadRules (offset, batchsize);
+        if (rules.empty ())
+            break;
+        offset += static_cast<unsigned int>(rules.size ());
+        if (!handler.handleRules (rules))
+            break;
+    }
+    while (rules.size () == batchsize);
+    return offset;
+}
+
+std::string RuleManager::loadCode (int id)
+{
+    std::vector<Rule*> rules = this->loadRules ();
+    std::vector<Rule*>::iterator iter;
+
+    for (iter = rules.begin (); iter != rules.end (); iter++)
+    {
+        if ((*iter)->getId () == id)
+            return (*iter)->getCode ();
+    }
+    throw std::out_of_range ("no rule with such an id");
+}
+
 unsigned int RuleManager::getMaxRules () const
 {
     return this->_maxrules;
@@ -18,6 +18,30 @@
 
 namespace dynrules
 {
+    /**
+     * \brief Receives batches of Rule objects from a RuleManager.
+     *
+     * A RuleBatchHandler is used by RuleManager::loadRules(RuleBatchHandler&,
+     * unsigned int) to deliver the rules of large rule catalogs in small
+     * batches.
+     */
+    class RuleBatchHandler
+    {
+    public:
+        /**
+         * \brief Destroys the RuleBatchHandler.
+         */
+        virtual ~RuleBatchHandler ();
+
+        /**
+         * \brief Handles a batch of loaded Rule objects.
+         *
+         * \param rules A std::vector containing the loaded rules.
+         * \return true to continue loading, false to stop.
+         */
+        virtual bool handleRules (const std::vector<Rule*>& rules) = 0;
+    };
+
     /**
      * \brief The RuleManager class takes care of loading and saving rules from
      *  arbitrary data sources.
@@ -59,6 +83,41 @@ namespace dynrules
          */
         virtual std::vector<Rule*> loadRules (unsigned int maxrules) = 0;
 
+        /**
+         * \brief Loads a specific range of rules from the underlying data
+         * source.
+         *
+         * This is used for loading the rules incrementally. The default
+         * implementation is only a fallback, which uses loadRules() and
+         * returns the requested part of it, so that loading all rules in
+         * batches takes quadratic time and the memory of the whole
+         * catalog. Inheriting classes should load only the requested
+         * range, like FileRuleManager in its STREAM mode.
+         *
+         * \param offset The index of the first rule to load.
+         * \param maxrules The amount of rules to load.
+         * \return A std::vector containing the loaded rules. If it
+         * contains less than maxrules rules, the end of the data source
+         * was reached.
+         */
+        virtual std::vector<Rule*> loadRules (unsigned int offset,
+            unsigned int maxrules);
+
+        /**
+         * \brief Loads all rules in batches from the underlying data source.
+         *
+         * Loads all rules in batches of batchsize rules using
+         * loadRules(unsigned int, unsigned int) and passes each batch to
+         * the handler, as soon as it was loaded.
+         *
+         * \param handler The RuleBatchHandler to pass the batches to.
+         * \param batchsize The amount of rules per batch.
+         * \return The total amount of rules passed to the handler.
+         * \exception invalid_argument Thrown, if batchsize is 0.
+         */
+        unsigned int loadRules (RuleBatchHandler& handler,
+            unsigned int batchsize);
+
         /**
          * \brief Saves the passed rules to the underlying data source.
          *
@@ -67,6 +126,21 @@ namespace dynrules
          */
         virtual bool saveRules (std::vector<Rule*> rules) = 0;
 
+        /**
+         * \brief Loads the code of a specific rule from the underlying data
+         * source.
+         *
+         * This is used by the CodeCache to load the code of rules on
+         * demand. The default implementation uses loadRules() to find the
+         * rule. Inheriting classes should implement a more efficient
+         * approach for large rule catalogs.
+         *
+         * \param id The id of the rule.
+         * \return The code of the rule.
+         * \exception out_of_range Thrown, if no rule with the id exists.
+         */
+        virtual std::string loadCode (int id);
+
         /**
          * \brief Saves a LearnSystem/RuleSet combination to a physical
          * file.
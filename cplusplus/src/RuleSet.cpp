@@ -6,17 +6,112 @@
  * This file is distributed under the Public Domain.
  */
 
+#include <algorithm>
 #include <stdexcept>
 #include "RuleSet.h"
+#include "Adjustment.h"
+#include "ReplayLog.h"
+#include "Selection.h"
 
 namespace dynrules
 {
 
+/*
+ * The weights of the rules in the order, in which they were added, for
+ * selectRouletteRule().
+ */
+struct _AddedWeights
+{
+    const std::vector<Rule*> *rules;
+
+    double operator() (size_t index) const
+    {
+        return (*rules)[index]->getWeight ();
+    }
+};
+
+/*
+ * The weights of the rules in the order of their weights.
+ */
+struct RuleSet::OrderedWeights
+{
+    const std::vector<WeightedRule> *order;
+
+    double operator() (size_t index) const
+    {
+        return (*order)[index].weight;
+    }
+};
+
+/*
+ * The weights of the rules for applyUpdates(), which receive the summed up
+ * compensation of all updates except for the ones they were used in and
+ * the adjustments of the latter.
+ */
+struct _BatchedRules
+{
+    const std::vector<Rule*> *rules;
+    const std::vector<double> *deltas;
+    const std::vector<double> *skipped;
+    double base;
+
+    double get (size_t index) const
+    {
+        return (*rules)[index]->getWeight ();
+    }
+
+    double change (size_t index) const
+    {
+        return (*deltas)[index] + (base - (*skipped)[index]);
+    }
+
+    double store (size_t index, double weight) const
+    {
+        (*rules)[index]->setWeight (weight);
+        return weight;
+    }
+};
+
+/*
+ * The current weights of the rules in the order of their weights, while
+ * the weights within the order are outdated.
+ */
+struct RuleSet::CurrentWeights
+{
+    const std::vector<WeightedRule> *order;
+    const std::vector<Rule*> *rules;
+
+    double operator() (size_t index) const
+    {
+        return (*rules)[(*order)[index].index]->getWeight ();
+    }
+};
+
+/*
+ * Compares two rules by their weight.
+ */
+struct RuleSet::HeavierRule
+{
+    bool operator() (const WeightedRule& a, const WeightedRule& b) const
+    {
+        return a.weight > b.weight;
+    }
+};
+
 RuleSet::RuleSet () :
     _minweight(0),
     _maxweight(0),
     _weight(0),
-    _rules(0)
+    _rules(0),
+    _replaylog(0),
+    _usedids(),
+    _deltas(),
+    _skipped(),
+    _adjustments(),
+    _sorted(false),
+    _stale(false),
+    _order(),
+    _displaced()
 {
 }
 
@@ -24,7 +119,16 @@ RuleSet::RuleSet (double minweight, double maxweight) :
     _minweight(0),
     _maxweight(0),
     _weight(0),
-    _rules(0)
+    _rules(0),
+    _replaylog(0),
+    _usedids(),
+    _deltas(),
+    _skipped(),
+    _adjustments(),
+    _sorted(false),
+    _stale(false),
+    _order(),
+    _displaced()
 {
     if (minweight > maxweight)
         throw std::invalid_argument ("maxweight must not be smaller than minweight");
@@ -32,13 +136,37 @@ RuleSet::RuleSet (double minweight, double maxweight) :
     this->_maxweight = maxweight;
 }
 
-RuleSet::~RuleSet ()
+RuleSet::RuleSet (const RuleSet& ruleset) :
+    _minweight(ruleset._minweight),
+    _maxweight(ruleset._maxweight),
+    _weight(ruleset._weight),
+    _rules(ruleset._rules),
+    _replaylog(0),
+    _usedids(),
+    _deltas(),
+    _skipped(),
+    _adjustments(),
+    _sorted(ruleset._sorted),
+    _stale(ruleset._stale),
+    _order(ruleset._order),
+    _displaced()
+{
+}
+
+RuleSet& RuleSet::operator= (const RuleSet& ruleset)
 {
+    this->_minweight = ruleset._minweight;
+    this->_maxweight = ruleset._maxweight;
+    this->_weight = ruleset._weight;
+    this->_rules = ruleset._rules;
+    this->_sorted = ruleset._sorted;
+    this->_stale = ruleset._stale;
+    this->_order = ruleset._order;
+    return *this;
 }
 
-double RuleSet::getMinWeight () const
+RuleSet::~RuleSet ()
 {
-    return this->_minweight;
 }
 
 void RuleSet::setMinWeight (double minweight)
@@ -48,11 +176,6 @@ void RuleSet::setMinWeight (double minweight)
     this->_minweight = minweight;
 }
 
-double RuleSet::getMaxWeight () const
-{
-    return this->_maxweight;
-}
-
 void RuleSet::setMaxWeight (double maxweight)
 {
     if (maxweight < this->_minweight)
@@ -60,11 +183,6 @@ void RuleSet::setMaxWeight (double maxweight)
     this->_maxweight = maxweight;
 }
 
-double RuleSet::getWeight () const
-{
-    return this->_weight;
-}
-
 std::vector<Rule*> RuleSet::getRules () const
 {
     return this->_rules;
@@ -81,6 +199,12 @@ void RuleSet::addRule (Rule* rule)
     else if (rule->getWeight () < this->_minweight)
         rule->setWeight (this->_minweight);
     this->_weight += rule->getWeight ();
+    if (this->_sorted)
+    {
+        WeightedRule entry = { rule->getWeight (), this->_rules.size () - 1 };
+        this->_order.push_back (entry);
+        this->updateOrder ();
+    }
 }
 
 bool RuleSet::removeRule (Rule* rule)
@@ -100,8 +224,12 @@ bool RuleSet::removeRule (Rule* rule)
     }
     if (found)
     {
-        this->_rules.erase (iter);
         this->_weight -= (*iter)->getWeight ();
+        this->_rules.erase (iter);
+
+        /* The indices changed, so the order has to be recreated. */
+        this->_order.clear ();
+        this->updateOrder ();
     }
     return found;
 }
@@ -118,9 +246,112 @@ Rule *RuleSet::find (int id)
 void RuleSet::clear ()
 {
     this->_rules.clear();
+    this->_order.clear ();
+    this->_stale = false;
     this->_weight = 0.f;
 }
 
+void RuleSet::reserve (size_t count)
+{
+    this->_rules.reserve (count);
+    if (this->_sorted)
+    {
+        this->_order.reserve (count);
+        this->_displaced.reserve (count);
+    }
+}
+
+void RuleSet::setWeights (const double* weights, size_t count)
+{
+    size_t i;
+    double weight, totweight = 0;
+
+    if (count != this->_rules.size ())
+        throw std::invalid_argument ("count must match the amount of rules");
+
+    for (i = 0; i < count; i++)
+    {
+        weight = weights[i];
+        if (weight > this->_maxweight)
+            weight = this->_maxweight;
+        else if (weight < this->_minweight)
+            weight = this->_minweight;
+        this->_rules[i]->setWeight (weight);
+        totweight += weight;
+    }
+    this->_weight = totweight;
+    this->updateOrder ();
+}
+
+void RuleSet::rescaleWeights (double center, double decay, double scale,
+    size_t first, size_t count)
+{
+    size_t i;
+    double weight, delta = 0, total = 0;
+
+    if (!(decay >= 0 && decay <= 1))
+        throw std::invalid_argument ("decay must be between 0 and 1");
+    if (!(scale >= 0))
+        throw std::invalid_argument ("scale must not be negative");
+    if (first > this->_rules.size () || count > this->_rules.size () - first)
+        throw std::out_of_range ("range exceeds the amount of rules");
+
+    for (i = first; i < first + count; i++)
+    {
+        weight = this->_rules[i]->getWeight ();
+        delta -= weight;
+        weight = (center + (weight - center) * decay) * scale;
+        if (weight > this->_maxweight)
+            weight = this->_maxweight;
+        else if (weight < this->_minweight)
+            weight = this->_minweight;
+        this->_rules[i]->setWeight (weight);
+        delta += weight;
+        total += weight;
+    }
+    /*
+     * Avoid accumulating rounding errors, if all weights are known. The
+     * order is kept for partial rescalings, which would move most rules
+     * of a larger RuleSet otherwise.
+     */
+    if (count == this->_rules.size ())
+    {
+        this->_weight = total;
+        this->updateOrder ();
+    }
+    else
+    {
+        this->_weight += delta;
+        if (count > 0)
+            this->_stale = this->_sorted;
+    }
+    if (this->_replaylog != 0)
+        this->_replaylog->writeRescale (center, decay, scale, first, count,
+            this->_weight);
+}
+
+void RuleSet::decayWeights (double decay)
+{
+    size_t count = this->_rules.size ();
+
+    if (!(decay >= 0 && decay <= 1))
+        throw std::invalid_argument ("decay must be between 0 and 1");
+    if (count == 0)
+        return;
+    this->rescaleWeights (this->_weight / static_cast<double>(count), decay,
+        1, 0, count);
+}
+
+void RuleSet::normalizeWeights (double weight)
+{
+    if (!(weight > 0))
+        throw std::invalid_argument ("weight must be greater than 0");
+    if (!(this->_weight > 0))
+        return;
+    this->rescaleWeights (0, 1, weight / this->_weight, 0,
+        this->_rules.size ());
+}
+
 void RuleSet::updateWeights (void *fitness)
 {
     /*
@@ -129,8 +360,10 @@ void RuleSet::updateWeights (void *fitness)
      */
     Rule *rule;
     std::vector<Rule*>::iterator it;
-    size_t count, usedcount = 0, nonactive;
-    double totweight = 0, adjustment, compensation, _remainder, weight;
+    RuleAdjustment rules;
+    ReplayLog *log = this->_replaylog;
+    size_t count, usedcount = 0;
+    double totweight = 0, adjustment, _remainder = 0;
 
     count = this->_rules.size ();
     if (count == 0)
@@ -145,45 +378,101 @@ void RuleSet::updateWeights (void *fitness)
     if (usedcount == 0 || usedcount == count)
         return;
 
-    nonactive = count - usedcount;
     adjustment = this->calculateAdjustment (fitness);
-    compensation = (static_cast<double>(-(static_cast<int>(usedcount)) *
-            adjustment)) / nonactive;
-    _remainder = 0;
+    rules.rules = &this->_rules;
+    rules.adjustment = adjustment;
+    rules.compensation = calculateCompensation (adjustment, usedcount, count);
+
+    this->_weight = adjustWeights (rules, 0, count, this->_minweight,
+        this->_maxweight, _remainder);
+    this->distributeRemainder (_remainder);
 
+    /* Collect the used rules for the log while resetting them. */
+    if (log != 0)
+    {
+        this->_usedids.clear ();
+        this->_usedids.reserve (usedcount);
+    }
     for (it = this->_rules.begin (); it != this->_rules.end (); it++)
     {
         rule = *it;
+        if (log != 0 && rule->getUsed ())
+            this->_usedids.push_back (rule->getId ());
+        rule->setUsed (false);
+        totweight += rule->getWeight ();
+    }
+    this->_weight = totweight;
+    if (log != 0)
+        log->writeUpdate (adjustment, totweight,
+            this->_usedids.empty () ? 0 : &this->_usedids[0],
+            this->_usedids.size ());
+    this->refreshOrder ();
+}
 
-        weight = rule->getWeight () +
-            ((rule->getUsed ()) ? adjustment : compensation);
+void RuleSet::applyUpdates (const WeightUpdate* updates, size_t count)
+{
+    _BatchedRules batch;
+    ReplayLog *log = this->_replaylog;
+    size_t i, j, rules, usedcount;
+    double base = 0, totweight = 0, _remainder = 0, adjustment, compensation;
 
-        if (weight < this->_minweight)
+    rules = this->_rules.size ();
+    if (rules == 0 || count == 0)
+        return;
+    for (i = 0; i < count; i++)
+    {
+        for (j = 0; j < updates[i].count; j++)
         {
-            _remainder += (weight - this->_minweight);
-            rule->setWeight (this->_minweight);
+            if (updates[i].used[j] >= rules)
+                throw std::out_of_range ("index of a used rule out of range");
         }
-        else if (weight > this->_maxweight)
+    }
+
+    /*
+     * Each rule receives the adjustments of the encounters it was used in
+     * and the compensation of all other encounters. The skipped
+     * compensations are summed up separately, so that a single encounter
+     * changes the weights exactly like updateWeights().
+     */
+    this->_deltas.assign (rules, 0.);
+    this->_skipped.assign (rules, 0.);
+    if (log != 0)
+        this->_adjustments.assign (count, 0.);
+    for (i = 0; i < count; i++)
+    {
+        usedcount = updates[i].count;
+        if (usedcount == 0 || usedcount == rules)
+            continue;
+
+        adjustment = this->calculateAdjustment (updates[i].fitness);
+        compensation = calculateCompensation (adjustment, usedcount, rules);
+        base += compensation;
+        for (j = 0; j < usedcount; j++)
         {
-            _remainder += (weight - this->_maxweight);
-            rule->setWeight (this->_maxweight);
+            this->_deltas[updates[i].used[j]] += adjustment;
+            this->_skipped[updates[i].used[j]] += compensation;
         }
-        else
-            rule->setWeight (weight);
-        totweight += rule->getWeight();
+        if (log != 0)
+            this->_adjustments[i] = adjustment;
     }
 
-    this->_weight = totweight;
+    batch.rules = &this->_rules;
+    batch.deltas = &this->_deltas;
+    batch.skipped = &this->_skipped;
+    batch.base = base;
+    this->_weight = adjustWeights (batch, 0, rules, this->_minweight,
+        this->_maxweight, _remainder);
     this->distributeRemainder (_remainder);
 
     totweight = 0;
-    for (it = this->_rules.begin (); it != this->_rules.end (); it++)
-    {
-        rule = *it;
-        rule->setUsed (false);
-        totweight += rule->getWeight ();
-    }
+    for (i = 0; i < rules; i++)
+        totweight += this->_rules[i]->getWeight ();
     this->_weight = totweight;
+
+    this->refreshOrder ();
+    if (log != 0)
+        log->writeBatch (*this, updates, &this->_adjustments[0], count,
+            totweight);
 }
 
 double RuleSet::calculateAdjustment (void *fitness)
@@ -195,4 +484,137 @@ void RuleSet::distributeRemainder (double remainder)
 {
 }
 
+void RuleSet::distributeOverlayRemainder (WeightOverlay& /* weights */,
+    double /* remainder */)
+{
+}
+
+size_t RuleSet::selectRule (double fraction) const
+{
+    size_t count = this->_rules.size ();
+
+    if (this->_sorted && this->_stale)
+    {
+        CurrentWeights weights = { &this->_order, &this->_rules };
+        return this->_order[selectRouletteRule (weights, count,
+            fraction)].index;
+    }
+    if (this->_sorted)
+    {
+        OrderedWeights weights = { &this->_order };
+        return this->_order[selectRouletteRule (weights, count,
+            fraction)].index;
+    }
+    _AddedWeights weights = { &this->_rules };
+    return selectRouletteRule (weights, count, fraction);
+}
+
+bool RuleSet::getOrderByWeight () const
+{
+    return this->_sorted;
+}
+
+void RuleSet::setOrderByWeight (bool ordered)
+{
+    this->_sorted = ordered;
+    this->_order.clear ();
+    if (ordered)
+    {
+        this->_order.reserve (this->_rules.capacity ());
+        this->_displaced.reserve (this->_rules.capacity ());
+        this->updateOrder ();
+    }
+    else
+    {
+        std::vector<WeightedRule> ().swap (this->_order);
+        std::vector<WeightedRule> ().swap (this->_displaced);
+    }
+}
+
+void RuleSet::updateOrder ()
+{
+    const std::vector<Rule*>& rules = this->_rules;
+    HeavierRule heavier;
+    std::vector<WeightedRule>& order = this->_order;
+    std::vector<WeightedRule>& displaced = this->_displaced;
+    size_t i, j, kept = 0, count = rules.size ();
+    double weight;
+
+    this->_stale = false;
+    if (!this->_sorted)
+        return;
+
+    if (order.size () != count)
+    {
+        order.resize (count);
+        for (i = 0; i < count; i++)
+        {
+            order[i].weight = rules[i]->getWeight ();
+            order[i].index = i;
+        }
+        std::sort (order.begin (), order.end (), heavier);
+        return;
+    }
+
+    /*
+     * Keep the rules, which are still in order compared to the previous
+     * kept and the next rule, and move the others aside. A rule, whose
+     * weight increased, is heavier than the previous one, a rule, whose
+     * weight decreased, is lighter than the next one. The weights are
+     * refreshed one rule ahead of the comparisons.
+     */
+    displaced.clear ();
+    if (count > 0)
+        order[0].weight = rules[order[0].index]->getWeight ();
+    for (i = 0; i < count; i++)
+    {
+        if (i + 1 < count)
+            order[i + 1].weight = rules[order[i + 1].index]->getWeight ();
+        weight = order[i].weight;
+        if ((kept > 0 && weight > order[kept - 1].weight) ||
+            (i + 1 < count && weight < order[i + 1].weight))
+            displaced.push_back (order[i]);
+        else
+            order[kept++] = order[i];
+    }
+    if (displaced.empty ())
+        return;
+
+    /* Merge the sorted, moved rules back from the lightest one on. */
+    std::sort (displaced.begin (), displaced.end (), heavier);
+    i = kept;
+    j = displaced.size ();
+    while (j > 0)
+    {
+        if (i > 0 && heavier (displaced[j - 1], order[i - 1]))
+        {
+            order[i + j - 1] = order[i - 1];
+            i--;
+        }
+        else
+        {
+            order[i + j - 1] = displaced[j - 1];
+            j--;
+        }
+    }
+}
+
+void RuleSet::refreshOrder ()
+{
+    if (!this->_stale)
+        this->updateOrder ();
+}
+
+ReplayLog* RuleSet::getReplayLog () const
+{
+    return this->_replaylog;
+}
+
+void RuleSet::setReplayLog (ReplayLog* log)
+{
+    this->_replaylog = log;
+    if (log != 0)
+        log->writeWeights (*this);
+}
+
 } // namespace
@@ -14,6 +14,31 @@
 
 namespace dynrules
 {
+    class ReplayLog;
+    class WeightOverlay;
+
+    /**
+     * \brief The result of a single encounter for RuleSet::applyUpdates().
+     */
+    struct WeightUpdate
+    {
+        /**
+         * \brief The fitness to pass to RuleSet::calculateAdjustment().
+         */
+        void *fitness;
+
+        /**
+         * \brief The indices of the rules used in the encounter. Each index
+         * must be contained only once.
+         */
+        const size_t *used;
+
+        /**
+         * \brief The amount of indices.
+         */
+        size_t count;
+    };
+
     /**
      * \brief A container class for managing Rule objects and their weights.
      */
@@ -35,6 +60,26 @@ namespace dynrules
          */
         RuleSet (double minweight, double maxweight);
 
+        /**
+         * \brief Creates a new RuleSet instance from a RuleSet.
+         *
+         * The Rule objects will be shared, the ReplayLog will not be used
+         * by the new RuleSet.
+         *
+         * \param ruleset The RuleSet to create the instance from.
+         */
+        RuleSet (const RuleSet& ruleset);
+
+        /**
+         * \brief Assigns the weight limits and Rule objects of a RuleSet.
+         *
+         * The Rule objects will be shared, the ReplayLog is kept.
+         *
+         * \param ruleset The RuleSet to assign.
+         * \return The RuleSet.
+         */
+        RuleSet& operator= (const RuleSet& ruleset);
+
         /**
          * \brief Destroys the RuleSet.
          */
@@ -86,6 +131,25 @@ namespace dynrules
          */
         std::vector<Rule*> getRules() const;
 
+        /**
+         * \brief Gets the amount of Rule objects hold by the RuleSet.
+         *
+         * \return The amount of Rule objects.
+         */
+        size_t getCount () const;
+
+        /**
+         * \brief Gets a specific Rule hold by the RuleSet.
+         *
+         * Other than getRules(), this does not create a copy of the
+         * internal Rule list.
+         *
+         * \param index The index of the Rule.
+         * \return The Rule at the specified index.
+         * \exception out_of_range Thrown, if index is out of range.
+         */
+        Rule* getRule (size_t index) const;
+
         /**
          * \brief Adds a Rule to the RuleSet.
          *
@@ -121,6 +185,87 @@ namespace dynrules
          */
         void clear ();
 
+        /**
+         * \brief Reserves space for Rule objects.
+         *
+         * Adding Rule objects does not allocate any memory, as long as
+         * the amount of Rule objects does not exceed the reserved amount.
+         *
+         * \param count The amount of Rule objects to reserve space for.
+         */
+        void reserve (size_t count);
+
+        /**
+         * \brief Sets the weights of all Rule objects at once.
+         *
+         * The weights will be limited to the minimum and maximum weight
+         * and the total weight will be recalculated.
+         *
+         * \param weights The weights to set, in the order of the Rule
+         * objects.
+         * \param count The amount of weights.
+         * \exception invalid_argument Thrown, if count does not match the
+         * amount of Rule objects.
+         */
+        void setWeights (const double* weights, size_t count);
+
+        /**
+         * \brief Moves the weights of a range of rules toward a value and
+         * scales them.
+         *
+         * Each weight becomes (center + (weight - center) * decay) * scale,
+         * limited to the minimum and maximum weight. The total weight is
+         * adjusted for the changed rules, so that the RuleSet stays
+         * consistent after each call. This allows the weights of larger
+         * RuleSets to be rescaled in small steps, see WeightMaintenance.
+         * If the rules are walked by their weight and only a part of them
+         * is rescaled, they keep their position in the walk until
+         * updateOrder() is called, see setOrderByWeight().
+         * If a ReplayLog is set, the rescaling is written to it, see
+         * ReplayLog::writeRescale().
+         *
+         * \param center The value to move the weights toward.
+         * \param decay The fraction of the distance to center to keep,
+         * between 0 and 1.
+         * \param scale The factor to multiply the weights with afterwards.
+         * \param first The index of the first rule to change.
+         * \param count The amount of rules to change.
+         * \exception invalid_argument Thrown, if decay is not within the
+         * range 0 to 1 or scale is negative.
+         * \exception out_of_range Thrown, if the range exceeds the amount
+         * of rules.
+         */
+        void rescaleWeights (double center, double decay, double scale,
+            size_t first, size_t count);
+
+        /**
+         * \brief Moves all weights toward their mean.
+         *
+         * Weights, which saturated at the minimum or maximum weight, lose
+         * their distance to the mean over repeated calls, so that later
+         * updates can change their order again. The total weight is kept.
+         * If a ReplayLog is set, the rescaling is written to it.
+         *
+         * \param decay The fraction of the distance to the mean to keep,
+         * between 0 and 1.
+         * \exception invalid_argument Thrown, if decay is not within the
+         * range 0 to 1.
+         */
+        void decayWeights (double decay);
+
+        /**
+         * \brief Scales all weights, so that their total equals a weight.
+         *
+         * The weights are limited to the minimum and maximum weight, so
+         * that the resulting total can differ. If a ReplayLog is set, the
+         * rescaling is written to it.
+         *
+         * \param weight The total weight to scale the weights to.
+         * \exception invalid_argument Thrown, if weight is not greater
+         * than 0.
+         */
+        void normalizeWeights (double weight);
+
         /**
          * \brief Updates the weights of all contained Rules objects.
          *
@@ -131,7 +276,34 @@ namespace dynrules
          * performance or whatever is suitable in the concrete
          * RuleSet::calculateAdjustment() implementation.
          */
-        void updateWeights (void *fitness);
+        virtual void updateWeights (void *fitness);
+
+        /**
+         * \brief Updates the weights for the results of multiple encounters
+         * at once.
+         *
+         * Instead of updating all weights for each encounter, the
+         * adjustments and compensations of all encounters are summed up
+         * per rule and applied in a single pass. The weights are limited
+         * to the minimum and maximum weight and distributeRemainder() is
+         * called once after all encounters were applied. The result equals
+         * the one of calling updateWeights() for each encounter, unless a
+         * weight exceeds its limits in between, apart from the rounding
+         * of the summed up changes. A single encounter results in exactly
+         * the same weights as updateWeights().
+         *
+         * The usage states of the Rule objects are neither used nor
+         * changed. Encounters, in which no or all rules were used, are
+         * skipped like by updateWeights(). If a ReplayLog is set, the
+         * adjustments and used rules of the encounters are written to it,
+         * see ReplayLog::writeBatch().
+         *
+         * \param updates The results of the encounters.
+         * \param count The amount of results.
+         * \exception out_of_range Thrown, if an index of a used rule is out
+         * of range. The weights are not changed in this case.
+         */
+        void applyUpdates (const WeightUpdate* updates, size_t count);
 
         /**
          * \brief Calculates the reward or penalty for the active rules.
@@ -154,7 +326,141 @@ namespace dynrules
          */
         virtual void distributeRemainder (double remainder);
 
+        /**
+         * \brief Distributes the remainder of the weight differences of a
+         * WeightOverlay.
+         *
+         * This is called by WeightOverlay::updateWeights() for the
+         * overlays using the RuleSet as rule catalog, like
+         * distributeRemainder() is called by updateWeights(). RuleSet
+         * classes, which override distributeRemainder(), should override
+         * this as well and distribute the remainder over the weights of the
+         * WeightOverlay in the same way, so that the overlays learn like the
+         * RuleSet. The default implementation does nothing.
+         *
+         * \param weights The WeightOverlay, whose weights were updated.
+         * \param remainder The remainder to distribute.
+         */
+        virtual void distributeOverlayRemainder (WeightOverlay& weights,
+            double remainder);
+
+        /**
+         * \brief Selects a Rule for the roulette wheel selection.
+         *
+         * Walks over the rules and sums up their weights, until the sum
+         * exceeds fraction. The walk takes at most one pass over the rules,
+         * see selectRouletteRule().
+         *
+         * \param fraction The fraction of the total weight, between 0 and
+         * getWeight().
+         * \return The index of the selected Rule.
+         */
+        size_t selectRule (double fraction) const;
+
+        /**
+         * \brief Gets, whether selectRule() walks over the rules by their
+         * descending weight.
+         *
+         * \return true, if the rules are walked by their weight, false, if
+         * they are walked in the order, in which they were added.
+         */
+        bool getOrderByWeight () const;
+
+        /**
+         * \brief Sets, whether selectRule() walks over the rules by their
+         * descending weight.
+         *
+         * With skewed weights, most selections land on few rules with a
+         * high weight. Walking over these first lets selectRule() stop
+         * after few rules. The rules keep their indices, the walk goes over
+         * a separate, compact array of their weights and indices. It is
+         * updated incrementally by updateWeights(), applyUpdates(),
+         * setWeights() and rescaleWeights(), so that this is useful for
+         * small and medium RuleSets, which do not need a
+         * RankedRuleWeights. If the weights are about equal, the walk
+         * gains nothing and the upkeep of the order makes it slower.
+         *
+         * Rescaling only a part of the rules keeps the order until
+         * updateOrder() is called. Meanwhile, selectRule() reads the
+         * current weights of the rules while walking over them, so that
+         * the selection stays exact.
+         *
+         * \param ordered true to walk over the rules by their weight, false
+         * to walk over them in the order, in which they were added.
+         */
+        void setOrderByWeight (bool ordered);
+
+        /**
+         * \brief Updates the order of the rules by their weight.
+         *
+         * This must be called, if the weights of the Rule objects were
+         * changed directly, since selectRule() walks over the weights
+         * taken by the last update of the order. Rules, which changed
+         * their position, are sorted and merged into the other rules,
+         * which requires O(n + k log k) steps for k such rules.
+         */
+        void updateOrder ();
+
+        /**
+         * \brief Gets the ReplayLog, to which the weight updates are written.
+         *
+         * \return The ReplayLog or 0, if the updates are not logged.
+         */
+        ReplayLog* getReplayLog () const;
+
+        /**
+         * \brief Sets the ReplayLog, to which the weight updates are written.
+         *
+         * Writes a checkpoint of the current weights to the ReplayLog. The
+         * ReplayLog will not be freed by the RuleSet.
+         *
+         * \param log The ReplayLog to use or 0 to stop logging.
+         */
+        void setReplayLog (ReplayLog* log);
+
     protected:
+
+        /**
+         * \brief The weight of a rule together with its index for walking
+         * over the rules by their weight.
+         */
+        struct WeightedRule
+        {
+            /**
+             * \brief The weight of the rule.
+             */
+            double weight;
+
+            /**
+             * \brief The index of the rule.
+             */
+            size_t index;
+        };
+
+        /**
+         * \brief Accesses the weights of _order for selectRule().
+         */
+        struct OrderedWeights;
+
+        /**
+         * \brief Accesses the current weights of the rules in the order of
+         * _order for selectRule().
+         */
+        struct CurrentWeights;
+
+        /**
+         * \brief Orders the entries of _order by descending weight.
+         */
+        struct HeavierRule;
+
+        /**
+         * \brief Updates the order of the rules after an update of their
+         * weights.
+         *
+         * The order is kept, if it is outdated by a partial rescaling, see
+         * rescaleWeights().
+         */
+        void refreshOrder ();
         
         /**
          * \brief The minimum weight an individual Rule can have.
@@ -175,8 +481,90 @@ namespace dynrules
          * \brief The list of Rule objects currently hold by the RuleSet.
          */
         std::vector<Rule*> _rules;
+
+        /**
+         * \brief The ReplayLog to write the weight updates to.
+         */
+        ReplayLog* _replaylog;
+
+        /**
+         * \brief The ids of the used rules of the last update for the
+         * ReplayLog, which are kept to avoid allocations.
+         */
+        std::vector<int> _usedids;
+
+        /**
+         * \brief The summed up weight changes for applyUpdates(), which are
+         * kept to avoid allocations.
+         */
+        std::vector<double> _deltas;
+
+        /**
+         * \brief The summed up compensations, which the used rules do not
+         * receive within applyUpdates(), which are kept to avoid
+         * allocations.
+         */
+        std::vector<double> _skipped;
+
+        /**
+         * \brief The adjustments of the encounters of applyUpdates() for
+         * the ReplayLog, which are kept to avoid allocations.
+         */
+        std::vector<double> _adjustments;
+
+        /**
+         * \brief Indicates, whether the rules are walked by their weight.
+         */
+        bool _sorted;
+
+        /**
+         * \brief Indicates, whether the weights within _order are outdated
+         * by a partial rescaling.
+         */
+        bool _stale;
+
+        /**
+         * \brief The weights and indices of the rules by descending weight,
+         * so that selectRule() walks over them sequentially.
+         */
+        std::vector<WeightedRule> _order;
+
+        /**
+         * \brief The rules, which changed their position within _order,
+         * which are kept to avoid allocations.
+         */
+        std::vector<WeightedRule> _displaced;
     };
 
+    /*
+     * The accessors used by the script generation and weight updates are
+     * defined inline, so that they do not cause a call per rule.
+     */
+    inline double RuleSet::getMinWeight () const
+    {
+        return this->_minweight;
+    }
+
+    inline double RuleSet::getMaxWeight () const
+    {
+        return this->_maxweight;
+    }
+
+    inline double RuleSet::getWeight () const
+    {
+        return this->_weight;
+    }
+
+    inline size_t RuleSet::getCount () const
+    {
+        return this->_rules.size ();
+    }
+
+    inline Rule* RuleSet::getRule (size_t index) const
+    {
+        return this->_rules.at (index);
+    }
+
 } //namespace
 
 #endif /* _RULESET_H_ */
@@ -0,0 +1,133 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include "RuleStream.h"
+
+namespace dynrules
+{
+
+RuleStream::RuleStream (RuleManager* manager, unsigned int batchsize,
+    unsigned int prefetch) :
+    _manager(manager),
+    _batchsize(batchsize),
+    _prefetch(prefetch),
+    _loaded(0),
+    _done(false),
+    _stop(false),
+    _batches(),
+    _error(),
+    _lock(),
+    _cond(),
+    _thread()
+{
+    if (manager == 0)
+        throw std::invalid_argument ("manager must not be NULL");
+    if (batchsize == 0)
+        throw std::invalid_argument ("batchsize must not be 0");
+    if (prefetch == 0)
+        throw std::invalid_argument ("prefetch must not be 0");
+    this->_thread = std::thread (&RuleStream::run, this);
+}
+
+RuleStream::~RuleStream ()
+{
+    this->close ();
+}
+
+void RuleStream::run ()
+{
+    std::vector<Rule*> rules;
+    unsigned int offset = 0, count;
+
+    try
+    {
+        while (true)
+        {
+            {
+                std::unique_lock<std::mutex> guard (this->_lock);
+                while (!this->_stop &&
+                    this->_batches.size () >= this->_prefetch)
+                    this->_cond.wait (guard);
+                if (this->_stop)
+                    break;
+            }
+
+            /* Load without holding the lock, so next() is not blocked. */
+            rules = this->_manager->loadRules (offset, this->_batchsize);
+            count = static_cast<unsigned int>(rules.size ());
+            offset += count;
+
+            std::lock_guard<std::mutex> guard (this->_lock);
+            if (count > 0)
+            {
+                this->_batches.push_back (std::vector<Rule*> ());
+                this->_batches.back ().swap (rules);
+                this->_loaded = offset;
+                this->_cond.notify_all ();
+            }
+            /* An empty or partial batch marks the end of the rules. */
+            if (count < this->_batchsize)
+                break;
+        }
+    }
+    catch (...)
+    {
+        std::lock_guard<std::mutex> guard (this->_lock);
+        this->_error = std::current_exception ();
+    }
+
+    std::lock_guard<std::mutex> guard (this->_lock);
+    this->_done = true;
+    this->_cond.notify_all ();
+}
+
+bool RuleStream::next (std::vector<Rule*>& batch)
+{
+    std::unique_lock<std::mutex> guard (this->_lock);
+    std::exception_ptr error;
+
+    while (this->_batches.empty () && !this->_done)
+        this->_cond.wait (guard);
+
+    if (!this->_batches.empty ())
+    {
+        batch.swap (this->_batches.front ());
+        this->_batches.pop_front ();
+        this->_cond.notify_all ();
+        return true;
+    }
+
+    batch.clear ();
+    if (this->_error)
+    {
+        error = this->_error;
+        this->_error = std::exception_ptr ();
+        std::rethrow_exception (error);
+    }
+    return false;
+}
+
+void RuleStream::close ()
+{
+    {
+        std::lock_guard<std::mutex> guard (this->_lock);
+        this->_stop = true;
+        this->_cond.notify_all ();
+    }
+    if (this->_thread.joinable ())
+        this->_thread.join ();
+}
+
+unsigned int RuleStream::getLoaded () const
+{
+    std::lock_guard<std::mutex> guard (this->_lock);
+    return this->_loaded;
+}
+
+} // namespace
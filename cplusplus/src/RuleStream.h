@@ -0,0 +1,177 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _RULESTREAM_H_
+#define _RULESTREAM_H_
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include "RuleManager.h"
+
+namespace dynrules
+{
+    /**
+     * \brief Loads the rules of a RuleManager incrementally in the
+     * background.
+     *
+     * RuleStream loads the rules of a RuleManager in batches using
+     * RuleManager::loadRules(unsigned int, unsigned int) on a background
+     * thread. At most prefetch batches are loaded in advance, so that the
+     * memory needed for loading stays bounded, if the RuleManager loads
+     * only the requested ranges, like FileRuleManager in its STREAM mode.
+     * RuleManager implementations, which keep all rules in memory, like
+     * MMapRuleManager, or which rely on the default implementation of the
+     * ranged loadRules(), need the memory of the whole catalog. The loaded
+     * batches can be fetched using next(), which allows a RuleSet to be
+     * populated and used, while the remaining rules are still loaded:
+     *
+     * \code
+     *   RuleStream stream (&manager, 1024);
+     *   std::vector<Rule*> batch;
+     *   while (stream.next (batch))
+     *   {
+     *       for (size_t i = 0; i < batch.size (); i++)
+     *           ruleset->addRule (batch[i]);
+     *   }
+     * \endcode
+     *
+     * The RuleManager must not be used otherwise, while the RuleStream
+     * loads rules from it.
+     */
+    class RuleStream
+    {
+    public:
+        /**
+         * \brief Creates a new RuleStream and starts loading the rules.
+         *
+         * \param manager The RuleManager to load the rules from.
+         * \param batchsize The amount of rules per batch.
+         * \param prefetch The maximum amount of batches to load in
+         * advance.
+         * \exception invalid_argument Thrown, if manager is NULL or
+         * batchsize or prefetch are 0.
+         */
+        RuleStream (RuleManager* manager, unsigned int batchsize,
+            unsigned int prefetch = 2);
+
+        /**
+         * \brief Destroys the RuleStream.
+         *
+         * Stops loading the rules and waits for the background thread to
+         * finish.
+         */
+        virtual ~RuleStream ();
+
+        /**
+         * \brief Gets the next batch of rules.
+         *
+         * Waits until the next batch of rules was loaded and stores it in
+         * batch.
+         *
+         * \param batch The std::vector to store the rules in. Its previous
+         * contents will be replaced.
+         * \return true, if a batch was stored, false, if all rules were
+         * loaded.
+         * \exception exception Any exception, that was raised by the
+         * RuleManager while loading the rules.
+         */
+        bool next (std::vector<Rule*>& batch);
+
+        /**
+         * \brief Stops loading the rules.
+         *
+         * Stops loading the rules and waits for the background thread to
+         * finish. Subsequent calls to next() will return the batches,
+         * which were loaded already. If the rules are owned by the caller,
+         * like the ones of a FileRuleManager in the STREAM mode, the
+         * remaining batches have to be fetched to free them.
+         */
+        void close ();
+
+        /**
+         * \brief Gets the amount of rules, which were loaded so far.
+         *
+         * \return The amount of rules loaded so far.
+         */
+        unsigned int getLoaded () const;
+
+    protected:
+
+        /**
+         * \brief Loads the rules on the background thread.
+         */
+        void run ();
+
+        /**
+         * \brief The RuleManager to load the rules from.
+         */
+        RuleManager* _manager;
+
+        /**
+         * \brief The amount of rules per batch.
+         */
+        unsigned int _batchsize;
+
+        /**
+         * \brief The maximum amount of batches to load in advance.
+         */
+        unsigned int _prefetch;
+
+        /**
+         * \brief The amount of rules loaded so far.
+         */
+        unsigned int _loaded;
+
+        /**
+         * \brief Indicates, whether the background thread finished.
+         */
+        bool _done;
+
+        /**
+         * \brief Indicates, whether the background thread shall stop.
+         */
+        bool _stop;
+
+        /**
+         * \brief The loaded batches, which were not fetched yet.
+         */
+        std::deque<std::vector<Rule*> > _batches;
+
+        /**
+         * \brief The exception raised while loading the rules, if any.
+         */
+        std::exception_ptr _error;
+
+        /**
+         * \brief Guards the state shared with the background thread.
+         */
+        mutable std::mutex _lock;
+
+        /**
+         * \brief Signals changes of the state shared with the background
+         * thread.
+         */
+        std::condition_variable _cond;
+
+        /**
+         * \brief The background thread loading the rules.
+         */
+        std::thread _thread;
+
+    private:
+        RuleStream (const RuleStream&);
+        RuleStream& operator= (const RuleStream&);
+    };
+
+} // namespace
+
+#endif /* _RULESTREAM_H_ */
@@ -0,0 +1,407 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _RULEWEIGHTS_H_
+#define _RULEWEIGHTS_H_
+
+#include <stdexcept>
+#include <vector>
+#if __cplusplus >= 202002L
+#include <span>
+#endif
+#include "WeightOverlay.h"
+#include "WeightStorage.h"
+#include "Selection.h"
+#include "Adjustment.h"
+
+namespace dynrules
+{
+    /**
+     * \brief A dense set of rule weights on top of a shared RuleSet.
+     *
+     * BasicRuleWeights stores the weights of all rules of the RuleSet and
+     * their usage states as contiguous values, which can be accessed
+     * directly using getData() and getUsedData(). The storage
+     * type of the weights is determined by the StoragePolicy, which can
+     * be DoubleWeight, FloatWeight or FixedWeight. See their documentation
+     * for the precision guarantees.
+     *
+     * The weight updates and the rule selection work directly on the
+     * stored values, so that no virtual method calls are involved.
+     *
+     * The minimum and maximum weight of the RuleSet are taken over on
+     * constructing and on calling reset().
+     */
+    template <typename StoragePolicy>
+    class BasicRuleWeights : public WeightOverlay
+    {
+    public:
+        using WeightOverlay::getWeight;
+
+        /**
+         * \brief The type used for storing a weight.
+         */
+        typedef typename StoragePolicy::value_type value_type;
+
+        /**
+         * \brief Creates a new BasicRuleWeights instance.
+         *
+         * The initial weights are taken from the Rule objects of the
+         * passed RuleSet.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \exception invalid_argument Thrown, if the passed argument
+         * is NULL.
+         */
+        BasicRuleWeights (RuleSet* ruleset) :
+            WeightOverlay(ruleset),
+            _minweight(0),
+            _maxweight(0),
+            _step(0),
+            _dither(DITHERSEED),
+            _weights(0),
+            _used(0)
+        {
+            this->reset ();
+        }
+
+        /**
+         * \brief Creates a new BasicRuleWeights instance from another one.
+         *
+         * Creates a copy of the passed BasicRuleWeights, which uses another
+         * RuleSet as rule catalog. The RuleSet must contain the same
+         * rules as the one used by weights.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \param weights The BasicRuleWeights to copy the weights from.
+         * \exception invalid_argument Thrown, if ruleset is NULL.
+         */
+        BasicRuleWeights (RuleSet* ruleset, const BasicRuleWeights& weights) :
+            WeightOverlay(ruleset),
+            _minweight(weights._minweight),
+            _maxweight(weights._maxweight),
+            _step(weights._step),
+            _dither(weights._dither),
+            _weights(weights._weights),
+            _used(weights._used)
+        {
+            this->_weight = weights._weight;
+        }
+
+        /**
+         * \brief Destroys the BasicRuleWeights.
+         */
+        virtual ~BasicRuleWeights ()
+        {
+        }
+
+        size_t getCount () const
+        {
+            return this->_weights.size ();
+        }
+
+        double getWeight (size_t index) const
+        {
+            return StoragePolicy::decode (this->_weights.at (index),
+                this->_minweight, this->_step);
+        }
+
+        bool getUsed (size_t index) const
+        {
+            return this->_used.at (index) != 0;
+        }
+
+        void setUsed (size_t index, bool used)
+        {
+            this->_used.at (index) = used ? 1 : 0;
+        }
+
+        /**
+         * \brief Gets the stored weights.
+         *
+         * The stored values have to be decoded using the StoragePolicy,
+         * except for DoubleWeight.
+         *
+         * \return A pointer to the getCount() stored weights or NULL, if
+         * there are no weights. It is valid until the next reset().
+         */
+        const value_type* getData () const
+        {
+            return this->_weights.empty () ? 0 : &this->_weights[0];
+        }
+
+        /**
+         * \brief Gets the usage states.
+         *
+         * Each usage state is stored as one byte, which is 0, if the rule
+         * was not used, and 1, if it was.
+         *
+         * \return A pointer to the getCount() usage states or NULL, if
+         * there are no weights. It is valid until the next reset().
+         */
+        unsigned char* getUsedData ()
+        {
+            return this->_used.empty () ? 0 : &this->_used[0];
+        }
+
+        /**
+         * \brief Gets the usage states.
+         *
+         * \return A pointer to the getCount() usage states or NULL, if
+         * there are no weights. It is valid until the next reset().
+         */
+        const unsigned char* getUsedData () const
+        {
+            return this->_used.empty () ? 0 : &this->_used[0];
+        }
+
+#if __cplusplus >= 202002L
+        /**
+         * \brief Gets the stored weights as std::span.
+         *
+         * \return The stored weights, see getData().
+         */
+        std::span<const value_type> getWeights () const
+        {
+            return std::span<const value_type> (this->_weights);
+        }
+
+        /**
+         * \brief Gets the usage states as std::span.
+         *
+         * \return The usage states, see getUsedData().
+         */
+        std::span<unsigned char> getUsedStates ()
+        {
+            return std::span<unsigned char> (this->_used);
+        }
+#endif
+
+        void setWeights (const double* weights, size_t count)
+        {
+            size_t i;
+            double weight, totweight = 0;
+
+            if (count != this->_weights.size ())
+                throw std::invalid_argument
+                    ("count must match the amount of rules");
+
+            for (i = 0; i < count; i++)
+            {
+                weight = weights[i];
+                if (weight > this->_maxweight)
+                    weight = this->_maxweight;
+                else if (weight < this->_minweight)
+                    weight = this->_minweight;
+                this->_weights[i] = StoragePolicy::encode (weight,
+                    this->_minweight, this->_step);
+                totweight += StoragePolicy::decode (this->_weights[i],
+                    this->_minweight, this->_step);
+            }
+            this->_weight = totweight;
+        }
+
+        size_t selectRule (double fraction) const
+        {
+            StoredWeights weights = { this };
+            return selectRouletteRule (weights, this->_weights.size (),
+                fraction);
+        }
+
+        void reset ()
+        {
+            size_t i, count = this->_ruleset->getCount ();
+            double weight;
+
+            this->_minweight = this->_ruleset->getMinWeight ();
+            this->_maxweight = this->_ruleset->getMaxWeight ();
+            this->_step = (this->_maxweight - this->_minweight) /
+                FixedWeight::MAXVALUE;
+
+            this->_dither.seed (DITHERSEED);
+            this->_weights.resize (count);
+            this->_used.assign (count, 0);
+            this->_weight = 0;
+            for (i = 0; i < count; i++)
+            {
+                weight = this->_ruleset->getRule (i)->getWeight ();
+                if (weight > this->_maxweight)
+                    weight = this->_maxweight;
+                else if (weight < this->_minweight)
+                    weight = this->_minweight;
+                this->storeWeight (i, weight);
+                this->_weight += this->getWeight (i);
+            }
+        }
+
+        void updateWeights (void *fitness)
+        {
+            /*
+             * Same as WeightOverlay::updateWeights(), but working directly
+             * on the stored values.
+             */
+            AdjustedStoredWeights weights = { this, 0, 0 };
+            size_t i, count, usedcount = 0;
+            double totweight = 0, _remainder = 0;
+
+            count = this->_weights.size ();
+            if (count == 0)
+                return;
+
+            for (i = 0; i < count; i++)
+            {
+                if (this->_used[i])
+                    usedcount++;
+            }
+            if (usedcount == 0 || usedcount == count)
+                return;
+
+            weights.adjustment = this->_ruleset->calculateAdjustment (fitness);
+            weights.compensation = calculateCompensation (weights.adjustment,
+                usedcount, count);
+
+            this->_weight = adjustWeights (weights, 0, count,
+                this->_minweight, this->_maxweight, _remainder);
+            this->distributeRemainder (_remainder);
+
+            this->clearUsed ();
+            for (i = 0; i < count; i++)
+            {
+                totweight += StoragePolicy::decode (this->_weights[i],
+                    this->_minweight, this->_step);
+            }
+            this->_weight = totweight;
+        }
+
+    protected:
+
+        /**
+         * \brief Decodes the stored weights for the rule selection.
+         */
+        struct StoredWeights
+        {
+            const BasicRuleWeights *weights;
+
+            double operator() (size_t index) const
+            {
+                return StoragePolicy::decode (weights->_weights[index],
+                    weights->_minweight, weights->_step);
+            }
+        };
+
+        /**
+         * \brief Accesses the stored weights for adjustWeights().
+         */
+        struct AdjustedStoredWeights
+        {
+            BasicRuleWeights *weights;
+            double adjustment;
+            double compensation;
+
+            double get (size_t index) const
+            {
+                return StoragePolicy::decode (weights->_weights[index],
+                    weights->_minweight, weights->_step);
+            }
+
+            double change (size_t index) const
+            {
+                return weights->_used[index] ? adjustment : compensation;
+            }
+
+            double store (size_t index, double weight) const
+            {
+                double dither = 0.5;
+
+                if (StoragePolicy::STOCHASTIC)
+                    dither = weights->nextDither ();
+                weights->_weights[index] = StoragePolicy::encode (weight,
+                    weights->_minweight, weights->_step, dither);
+                return get (index);
+            }
+        };
+
+        /**
+         * \brief The initial state of the dither generator.
+         */
+        static const unsigned int DITHERSEED = 2463534242U;
+
+        /**
+         * \brief Gets the next dither value for the stochastic rounding.
+         *
+         * The values are created by a XorShift generator, so that the
+         * weight updates are reproducible.
+         *
+         * \return A value in the range [0, 1).
+         */
+        double nextDither ()
+        {
+            return this->_dither () / 4294967296.0;
+        }
+
+        void storeWeight (size_t index, double weight)
+        {
+            this->_weights.at (index) = StoragePolicy::encode (weight,
+                this->_minweight, this->_step);
+        }
+
+        void clearUsed ()
+        {
+            this->_used.assign (this->_used.size (), 0);
+        }
+
+        /**
+         * \brief The minimum weight at the time of the last reset().
+         */
+        double _minweight;
+
+        /**
+         * \brief The maximum weight at the time of the last reset().
+         */
+        double _maxweight;
+
+        /**
+         * \brief The weight difference between two fixed-point values.
+         */
+        double _step;
+
+        /**
+         * \brief The state of the dither generator for the stochastic
+         * rounding of the weight updates.
+         */
+        XorShift _dither;
+
+        /**
+         * \brief The weights of the individual rules.
+         */
+        std::vector<value_type> _weights;
+
+        /**
+         * \brief The usage states of the individual rules.
+         */
+        std::vector<unsigned char> _used;
+    };
+
+    /**
+     * \brief Dense rule weights stored as double values.
+     */
+    typedef BasicRuleWeights<DoubleWeight> RuleWeights;
+
+    /**
+     * \brief Dense rule weights stored as float values.
+     */
+    typedef BasicRuleWeights<FloatWeight> FloatRuleWeights;
+
+    /**
+     * \brief Dense rule weights stored as 16-bit fixed-point values.
+     */
+    typedef BasicRuleWeights<FixedWeight> FixedRuleWeights;
+
+} // namespace
+
+#endif /* _RULEWEIGHTS_H_ */
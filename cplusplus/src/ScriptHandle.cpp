@@ -0,0 +1,107 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "ScriptHandle.h"
+
+namespace dynrules
+{
+
+ScriptHandle::ScriptHandle () :
+    _ruleset(0),
+    _script(),
+    _selected(),
+    _used(),
+    _random(),
+    _seeder(0),
+    _epoch(0),
+    _ids(),
+    _ranked(),
+    _order()
+{
+}
+
+ScriptHandle::ScriptHandle (const ScriptHandle& handle) :
+    _ruleset(handle._ruleset),
+    _script(handle._script),
+    _selected(handle._selected),
+    _used(handle._used),
+    _random(),
+    _seeder(0),
+    _epoch(0),
+    _ids(),
+    _ranked(),
+    _order()
+{
+}
+
+ScriptHandle& ScriptHandle::operator= (const ScriptHandle& handle)
+{
+    this->_ruleset = handle._ruleset;
+    this->_script = handle._script;
+    this->_selected = handle._selected;
+    this->_used = handle._used;
+    return *this;
+}
+
+ScriptHandle::~ScriptHandle ()
+{
+}
+
+const RuleSet* ScriptHandle::getRuleSet () const
+{
+    return this->_ruleset;
+}
+
+const std::string& ScriptHandle::getScript () const
+{
+    return this->_script;
+}
+
+const std::vector<size_t>& ScriptHandle::getSelected () const
+{
+    return this->_selected;
+}
+
+const std::vector<size_t>& ScriptHandle::getUsedRules () const
+{
+    return this->_used;
+}
+
+bool ScriptHandle::getUsed (size_t index) const
+{
+    return std::find (this->_used.begin (), this->_used.end (), index) !=
+        this->_used.end ();
+}
+
+void ScriptHandle::setUsed (size_t index, bool used)
+{
+    std::vector<size_t>::iterator iter;
+
+    /* Scripts consist of few rules, so that searching them is cheap. */
+    if (std::find (this->_selected.begin (), this->_selected.end (), index) ==
+        this->_selected.end ())
+        throw std::out_of_range ("rule is not part of the script");
+
+    iter = std::find (this->_used.begin (), this->_used.end (), index);
+    if (used && iter == this->_used.end ())
+        this->_used.push_back (index);
+    else if (!used && iter != this->_used.end ())
+        this->_used.erase (iter);
+}
+
+void ScriptHandle::clear ()
+{
+    this->_ruleset = 0;
+    this->_script.clear ();
+    this->_selected.clear ();
+    this->_used.clear ();
+}
+
+} // namespace
@@ -0,0 +1,200 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _SCRIPTHANDLE_H_
+#define _SCRIPTHANDLE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "RuleSet.h"
+#include "Selection.h"
+
+namespace dynrules
+{
+    class LearnSystem;
+    /**
+     * \brief A script created by a LearnSystem together with the rules it
+     * consists of and the rules used while running it.
+     *
+     * Other than the usage state of the Rule objects, which is shared by
+     * all scripts created from the same RuleSet, a ScriptHandle tracks the
+     * used rules of a single script. This allows any amount of scripts to
+     * be run concurrently and learned from independently via
+     * LearnSystem::updateWeights(const ScriptHandle&, void*).
+     *
+     * \code
+     *   ScriptHandle handle;
+     *   lsystem.createRules (handle, 10);
+     *   ... run handle.getScript () and call handle.setUsed () for each
+     *       rule, which was used ...
+     *   lsystem.updateWeights (handle, &fitness);
+     * \endcode
+     *
+     * A ScriptHandle can be reused for creating another script, which
+     * does not allocate any memory, once its buffers reached the size
+     * required by the scripts.
+     *
+     * Each ScriptHandle selects the rules with its own random number
+     * generator and buffers, so that scripts can be created for different
+     * ScriptHandle objects concurrently. The generator is seeded from the
+     * one of the LearnSystem, when the ScriptHandle is used first and
+     * after LearnSystem::setSeed() was called.
+     */
+    class ScriptHandle
+    {
+        friend class LearnSystem;
+
+    public:
+        /**
+         * \brief Creates a new, empty ScriptHandle.
+         */
+        ScriptHandle ();
+
+        /**
+         * \brief Creates a new ScriptHandle from a ScriptHandle.
+         *
+         * The script, its rules and the used rules are copied, the RuleSet
+         * is shared. The random number generator is not copied, the new
+         * ScriptHandle is seeded anew on its first use.
+         *
+         * \param handle The ScriptHandle to create the instance from.
+         */
+        ScriptHandle (const ScriptHandle& handle);
+
+        /**
+         * \brief Assigns the script, its rules and the used rules of a
+         * ScriptHandle.
+         *
+         * The random number generator is kept.
+         *
+         * \param handle The ScriptHandle to assign.
+         * \return The ScriptHandle.
+         */
+        ScriptHandle& operator= (const ScriptHandle& handle);
+
+        /**
+         * \brief Destroys the ScriptHandle.
+         */
+        ~ScriptHandle ();
+
+        /**
+         * \brief Gets the RuleSet, from which the rules of the script were
+         * selected.
+         *
+         * \return The RuleSet or 0, if no script was created yet.
+         */
+        const RuleSet* getRuleSet () const;
+
+        /**
+         * \brief Gets the rule code of the script.
+         *
+         * \return The rule code.
+         */
+        const std::string& getScript () const;
+
+        /**
+         * \brief Gets the indices of the rules within the script.
+         *
+         * \return The indices of the rules within the RuleSet in the order
+         * of their selection. A rule may be contained multiple times.
+         */
+        const std::vector<size_t>& getSelected () const;
+
+        /**
+         * \brief Gets the indices of the rules, which were used.
+         *
+         * \return The indices of the used rules within the RuleSet. Each
+         * rule is contained only once.
+         */
+        const std::vector<size_t>& getUsedRules () const;
+
+        /**
+         * \brief Checks, whether a rule of the script was used.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \return true, if the rule was used, false otherwise.
+         */
+        bool getUsed (size_t index) const;
+
+        /**
+         * \brief Sets, whether a rule of the script was used.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \param used Indicates, whether the rule was used.
+         * \exception out_of_range Thrown, if the rule is not part of the
+         * script.
+         */
+        void setUsed (size_t index, bool used);
+
+        /**
+         * \brief Removes the script and its rules, but keeps the memory
+         * allocated for them.
+         */
+        void clear ();
+
+    protected:
+
+        /**
+         * \brief The RuleSet, from which the rules were selected.
+         */
+        const RuleSet* _ruleset;
+
+        /**
+         * \brief The rule code of the script.
+         */
+        std::string _script;
+
+        /**
+         * \brief The indices of the rules within the script.
+         */
+        std::vector<size_t> _selected;
+
+        /**
+         * \brief The indices of the used rules.
+         */
+        std::vector<size_t> _used;
+
+        /**
+         * \brief The random number generator for selecting the rules.
+         */
+        XorShift _random;
+
+        /**
+         * \brief The LearnSystem, which seeded the random number generator.
+         */
+        const LearnSystem* _seeder;
+
+        /**
+         * \brief The seed epoch of the LearnSystem at the time of seeding,
+         * see LearnSystem::setSeed().
+         */
+        unsigned long _epoch;
+
+        /**
+         * \brief The ids of the selected rules for the ReplayLog, which
+         * are kept to avoid allocations.
+         */
+        std::vector<int> _ids;
+
+        /**
+         * \brief The indices of the rules for the GREEDY selection and the
+         * ordering by priority, which are kept to avoid allocations.
+         */
+        std::vector<size_t> _ranked;
+
+        /**
+         * \brief The sort keys for ordering the rules by their priority,
+         * which are kept to avoid allocations.
+         */
+        std::vector<uint64_t> _order;
+    };
+
+} // namespace
+
+#endif /* _SCRIPTHANDLE_H_ */
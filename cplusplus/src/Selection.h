@@ -0,0 +1,252 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _SELECTION_H_
+#define _SELECTION_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cmath>
+#include <algorithm>
+
+namespace dynrules
+{
+    /**
+     * \brief Orders rule indices by descending weight.
+     *
+     * Rules with equal weights are ordered by their index.
+     */
+    template <typename Weights>
+    struct BetterRule
+    {
+        /**
+         * \brief The weights of the rules.
+         */
+        const Weights *weights;
+
+        /**
+         * \brief Checks, whether rule a is better than rule b.
+         *
+         * \param a The index of the first rule.
+         * \param b The index of the second rule.
+         * \return true, if a has a higher weight than b or the same weight
+         * and a lower index, false otherwise.
+         */
+        bool operator() (size_t a, size_t b) const
+        {
+            double wa = (*weights) (a), wb = (*weights) (b);
+            return wa > wb || (wa == wb && a < b);
+        }
+    };
+
+    /**
+     * \brief Gets the indices of the rules with the highest weights.
+     *
+     * Keeps the best rules in a heap of at most k entries, so that only
+     * O(n log k) comparisons are needed instead of sorting all rules.
+     *
+     * \param weights A function object returning the weight for a rule
+     * index.
+     * \param count The amount of rules.
+     * \param indices The array to store the indices at.
+     * \param k The amount of indices to store.
+     * \return The amount of indices stored, which is the lower of k and
+     * count. The indices are ordered by descending weight.
+     */
+    template <typename Weights>
+    size_t selectBestRules (const Weights& weights, size_t count,
+        size_t* indices, size_t k)
+    {
+        BetterRule<Weights> better = { &weights };
+        size_t i, size = 0;
+
+        for (i = 0; i < count && k > 0; i++)
+        {
+            if (size < k)
+            {
+                indices[size++] = i;
+                std::push_heap (indices, indices + size, better);
+            }
+            else if (better (i, indices[0]))
+            {
+                /* The heap's front is the worst of the best rules. */
+                std::pop_heap (indices, indices + size, better);
+                indices[size - 1] = i;
+                std::push_heap (indices, indices + size, better);
+            }
+        }
+        std::sort_heap (indices, indices + size, better);
+        return size;
+    }
+
+    /**
+     * \brief Selects a rule with a probability proportional to its weight.
+     *
+     * Walks over the rules and sums up their weights, until the sum
+     * exceeds fraction. The walk stops after a single pass, so that the
+     * selection takes at most count steps, even if fraction is not below
+     * the sum of all weights due to rounding errors or outdated totals or
+     * if all weights are 0.
+     *
+     * \param weights A function object returning the weight for a rule
+     * index.
+     * \param count The amount of rules, which must be greater than 0.
+     * \param fraction A value between 0 and the sum of all weights.
+     * \return The index of the selected rule. If the weights do not sum
+     * up to more than fraction, the last rule with a positive weight or,
+     * if there is none, the first rule is returned.
+     */
+    template <typename Weights>
+    size_t selectRouletteRule (const Weights& weights, size_t count,
+        double fraction)
+    {
+        size_t i;
+        double wsum = 0;
+
+        for (i = 0; i < count; i++)
+        {
+            wsum += weights (i);
+            if (wsum > fraction)
+                return i;
+        }
+        /* Only reached on invalid fractions, so search from the end. */
+        for (i = count; i > 1; i--)
+        {
+            if (weights (i - 1) > 0)
+                break;
+        }
+        return i - 1;
+    }
+
+    /**
+     * \brief Selects a rule with a probability proportional to
+     * exp(weight / temperature).
+     *
+     * \param weights A function object returning the weight for a rule
+     * index.
+     * \param count The amount of rules.
+     * \param maxweight The maximum weight of the rules, which is
+     * subtracted from all weights to keep the exponentials in range.
+     * \param fraction A value between 0 and 1.
+     * \param temperature The temperature. Low values prefer the rules
+     * with the highest weights, high values select the rules more
+     * uniformly.
+     * \return The index of the selected rule.
+     */
+    template <typename Weights>
+    size_t selectSoftmaxRule (const Weights& weights, size_t count,
+        double maxweight, double fraction, double temperature)
+    {
+        size_t i, best = 0;
+        double total = 0, wsum = 0;
+
+        for (i = 0; i < count; i++)
+            total += std::exp ((weights (i) - maxweight) / temperature);
+        if (!(total > 0))
+        {
+            /* All probabilities vanished, use the best rule. */
+            for (i = 1; i < count; i++)
+            {
+                if (weights (i) > weights (best))
+                    best = i;
+            }
+            return best;
+        }
+
+        fraction *= total;
+        for (i = 0; i < count; i++)
+        {
+            wsum += std::exp ((weights (i) - maxweight) / temperature);
+            if (wsum > fraction)
+                return i;
+        }
+        return count - 1;
+    }
+
+    /**
+     * \brief A xorshift random number generator with a 32-bit state.
+     *
+     * It is used, where many generators are kept and their state has to
+     * stay small, like for the stochastic rounding of RuleWeights and for
+     * each ScriptHandle.
+     */
+    class XorShift
+    {
+    public:
+        typedef uint32_t result_type;
+
+        /**
+         * \brief The state used for the seed 0, which the generator can't
+         * leave.
+         */
+        static const result_type DEFAULTSEED = 2463534242U;
+
+        /**
+         * \brief Creates a new XorShift generator.
+         *
+         * \param value The seed to use.
+         */
+        explicit XorShift (result_type value = DEFAULTSEED) :
+            _state(DEFAULTSEED)
+        {
+            this->seed (value);
+        }
+
+        /**
+         * \brief Seeds the generator.
+         *
+         * \param value The seed to use. 0 is replaced by DEFAULTSEED.
+         */
+        void seed (result_type value)
+        {
+            this->_state = (value != 0) ? value : DEFAULTSEED;
+        }
+
+        /**
+         * \brief Gets the smallest value created by the generator.
+         *
+         * \return The smallest value.
+         */
+        static result_type min ()
+        {
+            return 1;
+        }
+
+        /**
+         * \brief Gets the largest value created by the generator.
+         *
+         * \return The largest value.
+         */
+        static result_type max ()
+        {
+            return 0xFFFFFFFFU;
+        }
+
+        /**
+         * \brief Creates the next value.
+         *
+         * \return A value in the range [min(), max()].
+         */
+        result_type operator() ()
+        {
+            result_type state = this->_state;
+
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            this->_state = state;
+            return state;
+        }
+
+    private:
+        result_type _state;
+    };
+
+} // namespace
+
+#endif /* _SELECTION_H_ */
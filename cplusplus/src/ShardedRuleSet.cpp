@@ -0,0 +1,165 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include "ShardedRuleSet.h"
+#include "ReplayLog.h"
+#include "Adjustment.h"
+
+namespace dynrules
+{
+
+ShardedRuleSet::ShardedRuleSet (double minweight, double maxweight,
+    ThreadPool* pool, size_t shardsize) :
+    RuleSet(minweight, maxweight),
+    _pool(pool),
+    _shardsize(0),
+    _shards()
+{
+    this->setShardSize (shardsize);
+}
+
+ShardedRuleSet::~ShardedRuleSet ()
+{
+}
+
+ThreadPool* ShardedRuleSet::getThreadPool () const
+{
+    return this->_pool;
+}
+
+void ShardedRuleSet::setThreadPool (ThreadPool* pool)
+{
+    this->_pool = pool;
+}
+
+size_t ShardedRuleSet::getShardSize () const
+{
+    return this->_shardsize;
+}
+
+void ShardedRuleSet::setShardSize (size_t shardsize)
+{
+    if (shardsize == 0)
+        throw std::invalid_argument ("shardsize must not be 0");
+    this->_shardsize = ((shardsize + ALIGNMENT - 1) / ALIGNMENT) * ALIGNMENT;
+}
+
+size_t ShardedRuleSet::getShardCount () const
+{
+    return (this->_rules.size () + this->_shardsize - 1) / this->_shardsize;
+}
+
+void ShardedRuleSet::updateWeights (void *fitness)
+{
+    /*
+     * Same as RuleSet::updateWeights(), but each phase is executed on
+     * the shards in parallel and the per-shard results are summed up
+     * in order afterwards.
+     */
+    std::vector<Rule*>& rules = this->_rules;
+    std::vector<Shard>& shards = this->_shards;
+    RuleAdjustment adjusted;
+    ReplayLog *log = this->_replaylog;
+    std::vector<int>& usedids = this->_usedids;
+    size_t i, count, usedcount = 0;
+    double totweight = 0, adjustment, _remainder = 0;
+    double minweight = this->_minweight, maxweight = this->_maxweight;
+
+    count = rules.size ();
+    if (count == 0)
+        return;
+
+    this->forEachShard ([&] (size_t shard, size_t begin, size_t end)
+    {
+        size_t j, used = 0;
+        for (j = begin; j < end; j++)
+        {
+            if (rules[j]->getUsed ())
+                used++;
+        }
+        shards[shard].used = used;
+    });
+    for (i = 0; i < shards.size (); i++)
+    {
+        shards[i].offset = usedcount;
+        usedcount += shards[i].used;
+    }
+    if (usedcount == 0 || usedcount == count)
+        return;
+
+    adjustment = this->calculateAdjustment (fitness);
+    adjusted.rules = &rules;
+    adjusted.adjustment = adjustment;
+    adjusted.compensation = calculateCompensation (adjustment, usedcount,
+        count);
+
+    this->forEachShard ([&] (size_t shard, size_t begin, size_t end)
+    {
+        double remainder = 0;
+
+        shards[shard].weight = adjustWeights (adjusted, begin, end,
+            minweight, maxweight, remainder);
+        shards[shard].remainder = remainder;
+    });
+    for (i = 0; i < shards.size (); i++)
+    {
+        _remainder += shards[i].remainder;
+        totweight += shards[i].weight;
+    }
+
+    this->_weight = totweight;
+    this->distributeRemainder (_remainder);
+
+    /*
+     * Each shard writes the ids of its used rules for the log at its own
+     * position while resetting them.
+     */
+    if (log != 0)
+        usedids.resize (usedcount);
+    this->forEachShard ([&] (size_t shard, size_t begin, size_t end)
+    {
+        size_t j, used = 0;
+        double wsum = 0;
+
+        for (j = begin; j < end; j++)
+        {
+            if (log != 0 && rules[j]->getUsed () &&
+                used < shards[shard].used)
+                usedids[shards[shard].offset + used++] = rules[j]->getId ();
+            rules[j]->setUsed (false);
+            wsum += rules[j]->getWeight ();
+        }
+        shards[shard].weight = wsum;
+    });
+    totweight = 0;
+    for (i = 0; i < shards.size (); i++)
+        totweight += shards[i].weight;
+    this->_weight = totweight;
+    if (log != 0)
+        log->writeUpdate (adjustment, totweight, &usedids[0], usedcount);
+    this->refreshOrder ();
+}
+
+void ShardedRuleSet::distributeRemainder (double remainder)
+{
+    this->forEachShard ([&] (size_t, size_t begin, size_t end)
+    {
+        this->distributeRemainder (remainder, begin, end);
+    });
+}
+
+void ShardedRuleSet::distributeRemainder (double remainder, size_t begin,
+    size_t /* end */)
+{
+    /* Only the first shard forwards the remainder for the whole set. */
+    if (begin == 0)
+        this->RuleSet::distributeRemainder (remainder);
+}
+
+} // namespace
@@ -0,0 +1,233 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _SHARDEDRULESET_H_
+#define _SHARDEDRULESET_H_
+
+#include <vector>
+#include <functional>
+#include "RuleSet.h"
+#include "ThreadPool.h"
+
+namespace dynrules
+{
+    /**
+     * \brief A RuleSet, which updates the weights of its rules in parallel.
+     *
+     * ShardedRuleSet partitions its rules into shards of consecutive rules
+     * and processes the shards on a ThreadPool within updateWeights().
+     * The per-shard results (used rules, remainder and weight) are summed
+     * up in the order of the shards. The results thus only depend on the
+     * shard size, but not on the amount of threads or the order, in which
+     * the shards are processed. The weights of the individual rules are
+     * identical to the ones calculated by RuleSet::updateWeights().
+     *
+     * calculateAdjustment() is called on the thread calling updateWeights().
+     * The remainder can be distributed in parallel by overriding
+     * distributeRemainder(double, size_t, size_t), which is called for
+     * each shard.
+     */
+    class ShardedRuleSet : public RuleSet
+    {
+    public:
+        /**
+         * \brief Creates a new ShardedRuleSet instance.
+         *
+         * \param minweight The minimum weight for the individual rules.
+         * \param maxweight The maximum weight for the individual rules.
+         * \param pool The ThreadPool to process the shards on. If it is
+         * NULL, the shards are processed on the calling thread.
+         * \param shardsize The amount of rules per shard. It will be
+         * rounded up to a multiple of ShardedRuleSet::ALIGNMENT.
+         * \exception invalid_argument Thrown, if minweight is greater than
+         * the set maxweight or shardsize is 0.
+         */
+        ShardedRuleSet (double minweight, double maxweight, ThreadPool* pool,
+            size_t shardsize = 4096);
+
+        /**
+         * \brief Destroys the ShardedRuleSet.
+         */
+        virtual ~ShardedRuleSet ();
+
+        /**
+         * \brief The shard size is a multiple of this, so that the rule
+         * pointers of a shard start on a separate 64 byte cache line.
+         */
+        static const size_t ALIGNMENT = 64 / sizeof (Rule*);
+
+        /**
+         * \brief Gets the ThreadPool used for processing the shards.
+         *
+         * \return The ThreadPool or NULL, if the shards are processed on
+         * the calling thread.
+         */
+        ThreadPool* getThreadPool () const;
+
+        /**
+         * \brief Sets the ThreadPool to use for processing the shards.
+         *
+         * \param pool The ThreadPool to use or NULL to process the shards
+         * on the calling thread.
+         */
+        void setThreadPool (ThreadPool* pool);
+
+        /**
+         * \brief Gets the amount of rules per shard.
+         *
+         * \return The amount of rules per shard.
+         */
+        size_t getShardSize () const;
+
+        /**
+         * \brief Sets the amount of rules per shard.
+         *
+         * \param shardsize The amount of rules per shard. It will be
+         * rounded up to a multiple of ShardedRuleSet::ALIGNMENT.
+         * \exception invalid_argument Thrown, if shardsize is 0.
+         */
+        void setShardSize (size_t shardsize);
+
+        /**
+         * \brief Gets the current amount of shards.
+         *
+         * \return The amount of shards for the current amount of rules.
+         */
+        size_t getShardCount () const;
+
+        /**
+         * \brief Updates the weights of all contained Rules objects in
+         * parallel.
+         *
+         * \param fitness The measure of the overall fitness of the
+         * performance or whatever is suitable in the concrete
+         * RuleSet::calculateAdjustment() implementation.
+         */
+        void updateWeights (void *fitness);
+
+        /**
+         * \brief Distributes the remainder of the weight differences.
+         *
+         * Calls distributeRemainder(double, size_t, size_t) for all
+         * shards in parallel.
+         *
+         * \param remainder The remainder to distribute.
+         */
+        void distributeRemainder (double remainder);
+
+        /**
+         * \brief Distributes the remainder of the weight differences on
+         * a single shard.
+         *
+         * This is called concurrently for different shards and thus must
+         * only modify the rules of the passed range. The default
+         * implementation forwards the remainder once, for the shard
+         * starting at index 0, to RuleSet::distributeRemainder(double),
+         * so that it is distributed exactly like by a plain RuleSet.
+         *
+         * \param remainder The total remainder to distribute.
+         * \param begin The index of the first rule of the shard.
+         * \param end The index after the last rule of the shard.
+         */
+        virtual void distributeRemainder (double remainder, size_t begin,
+            size_t end);
+
+    protected:
+
+        /**
+         * \brief The per-shard results of a processing phase.
+         *
+         * Each result is kept on its own cache line, so that threads
+         * processing neighbouring shards do not contend on it.
+         */
+        struct alignas(64) Shard
+        {
+            /**
+             * \brief The amount of used rules.
+             */
+            size_t used;
+
+            /**
+             * \brief The position of the ids of the used rules of the
+             * shard for the ReplayLog.
+             */
+            size_t offset;
+
+            /**
+             * \brief The remainder of the weight adjustments.
+             */
+            double remainder;
+
+            /**
+             * \brief The weight of the rules.
+             */
+            double weight;
+        };
+
+        /**
+         * \brief Calls func for all shards and waits for it to finish.
+         *
+         * func is only referenced, so that processing the shards does not
+         * allocate any memory.
+         *
+         * \param func The function to call with the index of the shard,
+         * the index of its first rule and the index after its last rule.
+         */
+        template <typename Func>
+        void forEachShard (const Func& func)
+        {
+            size_t i, count = this->getShardCount ();
+            struct
+            {
+                const Func *func;
+                size_t shardsize;
+                size_t total;
+            } context = { &func, this->_shardsize, this->_rules.size () };
+
+            this->_shards.resize (count);
+            /* Only capture a single reference to fit into std::function. */
+            std::function<void (size_t)> task = [&context] (size_t shard)
+            {
+                size_t begin = shard * context.shardsize;
+                size_t end = (context.total - begin > context.shardsize) ?
+                    begin + context.shardsize : context.total;
+                (*context.func) (shard, begin, end);
+            };
+
+            if (this->_pool)
+                this->_pool->run (count, task);
+            else
+            {
+                for (i = 0; i < count; i++)
+                    task (i);
+            }
+        }
+
+        /**
+         * \brief The ThreadPool to process the shards on.
+         */
+        ThreadPool* _pool;
+
+        /**
+         * \brief The amount of rules per shard.
+         */
+        size_t _shardsize;
+
+        /**
+         * \brief The results of the current processing phase.
+         */
+        std::vector<Shard> _shards;
+
+    private:
+        ShardedRuleSet (const ShardedRuleSet&);
+        ShardedRuleSet& operator= (const ShardedRuleSet&);
+    };
+
+} // namespace
+
+#endif /* _SHARDEDRULESET_H_ */
@@ -0,0 +1,381 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include <new>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <stdint.h>
+#include "SharedWeights.h"
+#include "Selection.h"
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace dynrules
+{
+
+/**
+ * \brief The layout of a shared weights segment.
+ *
+ * The header is followed by two buffers of count weights each, starting
+ * at SharedWeightsHeader::BUFFER_OFFSET. The generation counter determines
+ * the current buffer, generation % 2. The writing counter is the newest
+ * generation, whose buffer the publisher started to write, and is either
+ * generation or generation + 1.
+ */
+struct SharedWeightsHeader
+{
+    static const uint32_t MAGIC = 0x57594e44; /* "DNYW" */
+    static const uint32_t VERSION = 2;
+    static const size_t BUFFER_OFFSET = 128;
+
+    uint32_t magic;
+    uint32_t version;
+    uint64_t count;
+    double minweight;
+    double maxweight;
+    double weight[2];
+    std::atomic<uint64_t> generation;
+    std::atomic<uint64_t> writing;
+};
+
+/*
+ * The weights of the current buffer for selectRouletteRule().
+ */
+struct _PublishedWeights
+{
+    const double *weights;
+
+    double operator() (size_t index) const
+    {
+        return weights[index];
+    }
+};
+
+#ifndef _WIN32
+
+static_assert (sizeof (SharedWeightsHeader) <=
+    SharedWeightsHeader::BUFFER_OFFSET, "header exceeds the buffer offset");
+static_assert (ATOMIC_LLONG_LOCK_FREE == 2,
+    "the generation counter must be lock-free to be shared");
+
+static size_t _segment_size (size_t count)
+{
+    return SharedWeightsHeader::BUFFER_OFFSET + 2 * count * sizeof (double);
+}
+
+static double* _segment_buffer (SharedWeightsHeader* header, uint64_t index)
+{
+    return reinterpret_cast<double*>(reinterpret_cast<char*>(header) +
+        SharedWeightsHeader::BUFFER_OFFSET) + (index % 2) * header->count;
+}
+
+static const double* _segment_buffer (const SharedWeightsHeader* header,
+    uint64_t index)
+{
+    return reinterpret_cast<const double*>(
+        reinterpret_cast<const char*>(header) +
+        SharedWeightsHeader::BUFFER_OFFSET) + (index % 2) * header->count;
+}
+
+static std::runtime_error _segment_error (const std::string& name,
+    const char *action)
+{
+    return std::runtime_error (std::string ("could not ") + action +
+        " segment '" + name + "': " + std::strerror (errno));
+}
+
+SharedWeightPublisher::SharedWeightPublisher (const std::string& name,
+    size_t count, double minweight, double maxweight) :
+    _name(name),
+    _header(0),
+    _size(_segment_size (count))
+{
+    void *addr;
+    int fd;
+
+    if (minweight > maxweight)
+        throw std::invalid_argument ("minweight must not be greater than maxweight");
+
+    /*
+     * Never reinitialize an existing segment, since readers or another
+     * publisher might still use it.
+     */
+    fd = shm_open (name.c_str (), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd == -1)
+        throw _segment_error (name, "create");
+    if (ftruncate (fd, static_cast<off_t>(this->_size)) == -1)
+    {
+        std::runtime_error error = _segment_error (name, "resize");
+        close (fd);
+        shm_unlink (name.c_str ());
+        throw error;
+    }
+    addr = mmap (0, this->_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close (fd);
+    if (addr == MAP_FAILED)
+    {
+        std::runtime_error error = _segment_error (name, "map");
+        shm_unlink (name.c_str ());
+        throw error;
+    }
+
+    /* A new segment is zero-filled already. */
+    this->_header = new (addr) SharedWeightsHeader;
+    this->_header->count = count;
+    this->_header->minweight = minweight;
+    this->_header->maxweight = maxweight;
+    this->_header->generation.store (0);
+    this->_header->writing.store (0);
+    this->_header->version = SharedWeightsHeader::VERSION;
+    /* Readers check the magic value to ensure the segment is initialized. */
+    std::atomic_thread_fence (std::memory_order_release);
+    this->_header->magic = SharedWeightsHeader::MAGIC;
+}
+
+SharedWeightPublisher::~SharedWeightPublisher ()
+{
+    munmap (this->_header, this->_size);
+}
+
+const std::string& SharedWeightPublisher::getName () const
+{
+    return this->_name;
+}
+
+size_t SharedWeightPublisher::getCount () const
+{
+    return static_cast<size_t>(this->_header->count);
+}
+
+unsigned long long SharedWeightPublisher::getGeneration () const
+{
+    return this->_header->generation.load (std::memory_order_relaxed);
+}
+
+double* SharedWeightPublisher::getNextBuffer ()
+{
+    uint64_t generation =
+        this->_header->generation.load (std::memory_order_relaxed) + 1;
+
+    /*
+     * Mark the buffer as being written before writing it, like the
+     * sequence counter of a seqlock, so that readers of the generation
+     * two before detect the overwritten buffer.
+     */
+    this->_header->writing.store (generation, std::memory_order_relaxed);
+    std::atomic_thread_fence (std::memory_order_seq_cst);
+    return _segment_buffer (this->_header, generation);
+}
+
+unsigned long long SharedWeightPublisher::commit (double weight)
+{
+    uint64_t generation =
+        this->_header->generation.load (std::memory_order_relaxed) + 1;
+
+    this->_header->weight[generation % 2] = weight;
+    this->_header->generation.store (generation, std::memory_order_release);
+    return generation;
+}
+
+unsigned long long SharedWeightPublisher::publish (const double* weights,
+    size_t count, double weight)
+{
+    if (count != this->getCount ())
+        throw std::invalid_argument ("count must match the amount of weights");
+
+    std::memcpy (this->getNextBuffer (), weights, count * sizeof (double));
+    return this->commit (weight);
+}
+
+unsigned long long SharedWeightPublisher::publish (const RuleSet& ruleset)
+{
+    size_t i, count = ruleset.getCount ();
+    double *buffer;
+
+    if (count != this->getCount ())
+        throw std::invalid_argument ("count must match the amount of weights");
+
+    buffer = this->getNextBuffer ();
+    for (i = 0; i < count; i++)
+        buffer[i] = ruleset.getRule (i)->getWeight ();
+    return this->commit (ruleset.getWeight ());
+}
+
+unsigned long long SharedWeightPublisher::publish (const WeightOverlay& weights)
+{
+    size_t i, count = weights.getCount ();
+    double *buffer;
+
+    if (count != this->getCount ())
+        throw std::invalid_argument ("count must match the amount of weights");
+
+    buffer = this->getNextBuffer ();
+    for (i = 0; i < count; i++)
+        buffer[i] = weights.getWeight (i);
+    return this->commit (weights.getWeight ());
+}
+
+void SharedWeightPublisher::unlink ()
+{
+    SharedWeightPublisher::unlink (this->_name);
+}
+
+void SharedWeightPublisher::unlink (const std::string& name)
+{
+    shm_unlink (name.c_str ());
+}
+
+SharedWeights::SharedWeights (RuleSet* ruleset, const std::string& name) :
+    WeightOverlay(ruleset),
+    _header(0),
+    _size(0),
+    _current(0),
+    _generation(0)
+{
+    const SharedWeightsHeader *header;
+    struct stat st;
+    void *addr;
+    int fd;
+
+    fd = shm_open (name.c_str (), O_RDONLY, 0);
+    if (fd == -1)
+        throw _segment_error (name, "open");
+    if (fstat (fd, &st) == -1)
+    {
+        std::runtime_error error = _segment_error (name, "stat");
+        close (fd);
+        throw error;
+    }
+    if (static_cast<size_t>(st.st_size) < SharedWeightsHeader::BUFFER_OFFSET)
+    {
+        close (fd);
+        throw std::runtime_error ("segment '" + name +
+            "' is not a weights segment");
+    }
+    this->_size = static_cast<size_t>(st.st_size);
+    addr = mmap (0, this->_size, PROT_READ, MAP_SHARED, fd, 0);
+    close (fd);
+    if (addr == MAP_FAILED)
+        throw _segment_error (name, "map");
+
+    header = static_cast<const SharedWeightsHeader*>(addr);
+    this->_header = header;
+    if (header->magic != SharedWeightsHeader::MAGIC ||
+        header->version != SharedWeightsHeader::VERSION ||
+        _segment_size (static_cast<size_t>(header->count)) != this->_size)
+    {
+        munmap (addr, this->_size);
+        throw std::runtime_error ("segment '" + name +
+            "' is not a weights segment");
+    }
+    std::atomic_thread_fence (std::memory_order_acquire);
+    if (header->count != ruleset->getCount ())
+    {
+        munmap (addr, this->_size);
+        throw std::invalid_argument
+            ("the amount of rules must match the amount of weights");
+    }
+    this->refresh ();
+}
+
+SharedWeights::~SharedWeights ()
+{
+    munmap (const_cast<SharedWeightsHeader*>(this->_header), this->_size);
+}
+
+unsigned long long SharedWeights::refresh ()
+{
+    uint64_t generation =
+        this->_header->generation.load (std::memory_order_acquire);
+
+    this->_current = _segment_buffer (this->_header, generation);
+    this->_weight = this->_header->weight[generation % 2];
+    this->_generation = generation;
+    return generation;
+}
+
+unsigned long long SharedWeights::getGeneration () const
+{
+    return this->_generation;
+}
+
+bool SharedWeights::isConsistent () const
+{
+    /*
+     * The publisher overwrites the buffer used by the generation N, once
+     * it starts writing the generation N + 2. Order the preceding reads
+     * of the buffer before loading the writing counter.
+     */
+    std::atomic_thread_fence (std::memory_order_acquire);
+    return this->_header->writing.load (std::memory_order_relaxed) -
+        this->_generation < 2;
+}
+
+size_t SharedWeights::getCount () const
+{
+    return static_cast<size_t>(this->_header->count);
+}
+
+double SharedWeights::getWeight (size_t index) const
+{
+    if (index >= this->_header->count)
+        throw std::out_of_range ("index out of range");
+    return this->_current[index];
+}
+
+bool SharedWeights::getUsed (size_t index) const
+{
+    if (index >= this->_header->count)
+        throw std::out_of_range ("index out of range");
+    return false;
+}
+
+void SharedWeights::setUsed (size_t /* index */, bool /* used */)
+{
+    throw std::logic_error ("shared weights are read-only");
+}
+
+size_t SharedWeights::selectRule (double fraction) const
+{
+    _PublishedWeights weights = { this->_current };
+    return selectRouletteRule (weights,
+        static_cast<size_t>(this->_header->count), fraction);
+}
+
+void SharedWeights::reset ()
+{
+    if (this->_header->count != this->_ruleset->getCount ())
+        throw std::invalid_argument
+            ("the amount of rules must match the amount of weights");
+    this->refresh ();
+}
+
+void SharedWeights::updateWeights (void* /* fitness */)
+{
+    throw std::logic_error ("shared weights are read-only");
+}
+
+void SharedWeights::storeWeight (size_t /* index */, double /* weight */)
+{
+    throw std::logic_error ("shared weights are read-only");
+}
+
+void SharedWeights::clearUsed ()
+{
+}
+
+#endif /* !_WIN32 */
+
+} // namespace
@@ -0,0 +1,342 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _SHAREDWEIGHTS_H_
+#define _SHAREDWEIGHTS_H_
+
+#include <string>
+#include "RuleSet.h"
+#include "WeightOverlay.h"
+
+namespace dynrules
+{
+    /**
+     * \brief The layout of a shared weights segment.
+     */
+    struct SharedWeightsHeader;
+
+    /**
+     * \brief Publishes rule weights to other processes using a POSIX
+     * shared memory segment.
+     *
+     * SharedWeightPublisher is used by the learning process, which
+     * updates the weights of a RuleSet, to make the current weights
+     * available to any amount of reading processes, which attach to the
+     * segment using SharedWeights.
+     *
+     * The segment keeps two weight buffers. Each call to publish() writes
+     * the weights into the buffer, which is not the current one and then
+     * increments the generation counter of the segment, which makes the
+     * written buffer the current one.
+     *
+     * There must be only one SharedWeightPublisher per segment.
+     *
+     * This is only available on platforms supporting POSIX shared memory.
+     */
+    class SharedWeightPublisher
+    {
+    public:
+        /**
+         * \brief Creates a new SharedWeightPublisher and its segment.
+         *
+         * Creates the shared memory segment and initializes it with all
+         * weights being 0 at generation 0. An existing segment is never
+         * reused, since other processes might still use it. A stale
+         * segment, e.g. of a crashed publisher, has to be removed using
+         * unlink(const std::string&) first.
+         *
+         * \param name The name of the segment, which must start with a
+         * slash, e.g. "/dynrules-weights".
+         * \param count The amount of weights to publish.
+         * \param minweight The minimum weight of the rules.
+         * \param maxweight The maximum weight of the rules.
+         * \exception runtime_error Thrown, if the segment could not be
+         * created or already exists.
+         */
+        SharedWeightPublisher (const std::string& name, size_t count,
+            double minweight, double maxweight);
+
+        /**
+         * \brief Destroys the SharedWeightPublisher.
+         *
+         * The segment is detached, but not removed, so that attached
+         * readers can continue to use it. Use unlink() to remove it.
+         */
+        virtual ~SharedWeightPublisher ();
+
+        /**
+         * \brief Gets the name of the segment.
+         *
+         * \return The name of the segment.
+         */
+        const std::string& getName () const;
+
+        /**
+         * \brief Gets the amount of weights within the segment.
+         *
+         * \return The amount of weights.
+         */
+        size_t getCount () const;
+
+        /**
+         * \brief Gets the generation of the current weights.
+         *
+         * \return The generation of the current weights.
+         */
+        unsigned long long getGeneration () const;
+
+        /**
+         * \brief Publishes new weights.
+         *
+         * \param weights The weights to publish.
+         * \param count The amount of weights.
+         * \param weight The total of the weights.
+         * \return The generation of the published weights.
+         * \exception invalid_argument Thrown, if count does not match
+         * getCount().
+         */
+        unsigned long long publish (const double* weights, size_t count,
+            double weight);
+
+        /**
+         * \brief Publishes the weights of the Rule objects of a RuleSet.
+         *
+         * \param ruleset The RuleSet to publish the weights for.
+         * \return The generation of the published weights.
+         * \exception invalid_argument Thrown, if the amount of rules does
+         * not match getCount().
+         */
+        unsigned long long publish (const RuleSet& ruleset);
+
+        /**
+         * \brief Publishes the weights of a WeightOverlay.
+         *
+         * \param weights The WeightOverlay to publish the weights for.
+         * \return The generation of the published weights.
+         * \exception invalid_argument Thrown, if the amount of weights
+         * does not match getCount().
+         */
+        unsigned long long publish (const WeightOverlay& weights);
+
+        /**
+         * \brief Removes the segment.
+         *
+         * Attached readers can continue to use the segment, but no new
+         * readers can attach to it anymore.
+         */
+        void unlink ();
+
+        /**
+         * \brief Removes a segment.
+         *
+         * Attached readers and publishers can continue to use the
+         * segment, but no new ones can attach to it anymore.
+         *
+         * \param name The name of the segment.
+         */
+        static void unlink (const std::string& name);
+
+    protected:
+
+        /**
+         * \brief Gets the buffer, which is written by the next publish().
+         *
+         * Marks the buffer as being written, so that it must be written
+         * and committed afterwards.
+         *
+         * \return The next buffer.
+         */
+        double* getNextBuffer ();
+
+        /**
+         * \brief Makes the buffer written to the current one.
+         *
+         * \param weight The total of the weights.
+         * \return The generation of the published weights.
+         */
+        unsigned long long commit (double weight);
+
+        /**
+         * \brief The name of the segment.
+         */
+        std::string _name;
+
+        /**
+         * \brief The mapped segment.
+         */
+        SharedWeightsHeader* _header;
+
+        /**
+         * \brief The size of the mapped segment in bytes.
+         */
+        size_t _size;
+
+    private:
+        SharedWeightPublisher (const SharedWeightPublisher&);
+        SharedWeightPublisher& operator= (const SharedWeightPublisher&);
+    };
+
+    /**
+     * \brief Read-only rule weights, which are published by another
+     * process.
+     *
+     * SharedWeights attaches to the shared memory segment of a
+     * SharedWeightPublisher and uses the weights within the segment
+     * directly, without copying them. It can be passed to
+     * LearnSystem::createRules(const WeightOverlay&, unsigned int) to
+     * create scripts from the published weights.
+     *
+     * The RuleSet must contain the same rules in the same order as the
+     * one of the publishing process, so that the weights match the rules.
+     * Only the rule code is taken from the RuleSet.
+     *
+     * SharedWeights uses the generation of the weights, which was current
+     * at the time of construction or of the last refresh(). Once the
+     * publisher starts writing the second generation after it, that
+     * buffer is overwritten, while it might be read. The publisher marks
+     * each buffer before writing it, so that this can be detected using
+     * isConsistent() after reading the weights:
+     *
+     * \code
+     *   std::string script;
+     *   do
+     *   {
+     *       weights.refresh ();
+     *       script = lsystem.createRules (weights, 10);
+     *   } while (!weights.isConsistent ());
+     * \endcode
+     *
+     * This is only available on platforms supporting POSIX shared memory.
+     */
+    class SharedWeights : public WeightOverlay
+    {
+    public:
+        using WeightOverlay::getWeight;
+
+        /**
+         * \brief Creates a new SharedWeights instance and attaches it to
+         * a shared memory segment.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \param name The name of the segment.
+         * \exception invalid_argument Thrown, if ruleset is NULL or the
+         * amount of rules does not match the amount of weights within
+         * the segment.
+         * \exception runtime_error Thrown, if the segment could not be
+         * attached or is not a valid weights segment.
+         */
+        SharedWeights (RuleSet* ruleset, const std::string& name);
+
+        /**
+         * \brief Destroys the SharedWeights and detaches from the segment.
+         */
+        virtual ~SharedWeights ();
+
+        /**
+         * \brief Uses the current generation of the published weights.
+         *
+         * \return The generation of the weights used.
+         */
+        unsigned long long refresh ();
+
+        /**
+         * \brief Gets the generation of the weights used.
+         *
+         * \return The generation of the weights used.
+         */
+        unsigned long long getGeneration () const;
+
+        /**
+         * \brief Checks, whether the weights used were not overwritten by
+         * the publisher since the last refresh().
+         *
+         * This has to be called after reading the weights. The weights
+         * read before are consistent, if it returns true.
+         *
+         * \return true, if the weights are consistent, false otherwise.
+         */
+        bool isConsistent () const;
+
+        size_t getCount () const;
+        double getWeight (size_t index) const;
+
+        /**
+         * \brief Gets whether a specific rule was used or not.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \return Always false.
+         * \exception out_of_range Thrown, if index is out of range.
+         */
+        bool getUsed (size_t index) const;
+
+        /**
+         * \brief Not supported.
+         *
+         * \exception logic_error Always thrown, since the weights are
+         * read-only.
+         */
+        void setUsed (size_t index, bool used);
+
+        size_t selectRule (double fraction) const;
+
+        /**
+         * \brief Uses the current generation of the published weights.
+         *
+         * \exception invalid_argument Thrown, if the amount of rules of
+         * the RuleSet does not match the amount of published weights.
+         */
+        void reset ();
+
+        /**
+         * \brief Not supported.
+         *
+         * \exception logic_error Always thrown, since the weights are
+         * read-only.
+         */
+        void updateWeights (void *fitness);
+
+    protected:
+
+        /**
+         * \brief Not supported.
+         *
+         * \exception logic_error Always thrown, since the weights are
+         * read-only.
+         */
+        void storeWeight (size_t index, double weight);
+
+        void clearUsed ();
+
+        /**
+         * \brief The mapped segment.
+         */
+        const SharedWeightsHeader* _header;
+
+        /**
+         * \brief The size of the mapped segment in bytes.
+         */
+        size_t _size;
+
+        /**
+         * \brief The weights buffer used.
+         */
+        const double* _current;
+
+        /**
+         * \brief The generation of the weights used.
+         */
+        unsigned long long _generation;
+
+    private:
+        SharedWeights (const SharedWeights&);
+        SharedWeights& operator= (const SharedWeights&);
+    };
+
+} // namespace
+
+#endif /* _SHAREDWEIGHTS_H_ */
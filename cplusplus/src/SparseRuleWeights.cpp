@@ -0,0 +1,268 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <algorithm>
+#include <stdexcept>
+#include "SparseRuleWeights.h"
+#include "Adjustment.h"
+
+namespace dynrules
+{
+
+/*
+ * Accesses the weights for adjustWeights() and collects the weights, which
+ * still deviate from the shared weights after the update.
+ */
+struct SparseRuleWeights::AdjustedEntries
+{
+    const SparseRuleWeights *overlay;
+    std::vector<Entry> *entries;
+    double adjustment;
+    double compensation;
+    double minweight;
+    double maxweight;
+    size_t e;
+    size_t u;
+    bool stored;
+    bool used;
+
+    double get (size_t index)
+    {
+        const std::vector<Entry>& current = overlay->_entries;
+
+        stored = (e < current.size () && current[e].index == index);
+        if (stored)
+            return current[e++].weight;
+        return overlay->getSharedWeight (index);
+    }
+
+    double change (size_t index)
+    {
+        const std::vector<unsigned int>& usedrules = overlay->_used;
+
+        used = (u < usedrules.size () && usedrules[u] == index);
+        if (used)
+            u++;
+        return used ? adjustment : compensation;
+    }
+
+    double store (size_t index, double weight)
+    {
+        Entry entry;
+        double shared;
+
+        /* The shared weight after the compensation was added. */
+        shared = overlay->_ruleset->getRule (index)->getWeight () +
+            overlay->_offset + compensation;
+        if (shared > maxweight)
+            shared = maxweight;
+        else if (shared < minweight)
+            shared = minweight;
+
+        /*
+         * The compensation of the unused rules is kept in the shared
+         * offset, unless the shared weight was limited before or after
+         * the update, which lets the weight differ from the shared one.
+         * Stored and used weights are dropped, once they match the shared
+         * weight.
+         */
+        if (!stored && !used)
+        {
+            if (weight == shared)
+                return shared;
+        }
+        else if (static_cast<float>(weight) == static_cast<float>(shared))
+            return shared;
+
+        entry.index = static_cast<unsigned int>(index);
+        entry.weight = static_cast<float>(weight);
+        entries->push_back (entry);
+        return entry.weight;
+    }
+};
+
+SparseRuleWeights::SparseRuleWeights (RuleSet* ruleset) :
+    WeightOverlay(ruleset),
+    _offset(0),
+    _entries(0),
+    _used(0),
+    _update(0)
+{
+    this->reset ();
+}
+
+SparseRuleWeights::~SparseRuleWeights ()
+{
+}
+
+size_t SparseRuleWeights::getStoredCount () const
+{
+    return this->_entries.size ();
+}
+
+size_t SparseRuleWeights::getCount () const
+{
+    return this->_ruleset->getCount ();
+}
+
+double SparseRuleWeights::getSharedWeight (size_t index) const
+{
+    double weight = this->_ruleset->getRule (index)->getWeight () +
+        this->_offset;
+
+    if (weight > this->_ruleset->getMaxWeight ())
+        return this->_ruleset->getMaxWeight ();
+    if (weight < this->_ruleset->getMinWeight ())
+        return this->_ruleset->getMinWeight ();
+    return weight;
+}
+
+size_t SparseRuleWeights::findEntry (size_t index) const
+{
+    size_t low = 0, high = this->_entries.size (), mid;
+
+    while (low < high)
+    {
+        mid = low + (high - low) / 2;
+        if (this->_entries[mid].index < index)
+            low = mid + 1;
+        else
+            high = mid;
+    }
+    return low;
+}
+
+double SparseRuleWeights::getWeight (size_t index) const
+{
+    size_t pos;
+
+    if (index >= this->getCount ())
+        throw std::out_of_range ("index out of range");
+
+    pos = this->findEntry (index);
+    if (pos < this->_entries.size () && this->_entries[pos].index == index)
+        return this->_entries[pos].weight;
+    return this->getSharedWeight (index);
+}
+
+bool SparseRuleWeights::getUsed (size_t index) const
+{
+    if (index >= this->getCount ())
+        throw std::out_of_range ("index out of range");
+    return std::binary_search (this->_used.begin (), this->_used.end (),
+        static_cast<unsigned int>(index));
+}
+
+void SparseRuleWeights::setUsed (size_t index, bool used)
+{
+    std::vector<unsigned int>::iterator iter;
+
+    if (index >= this->getCount ())
+        throw std::out_of_range ("index out of range");
+
+    iter = std::lower_bound (this->_used.begin (), this->_used.end (),
+        static_cast<unsigned int>(index));
+    if (iter != this->_used.end () && *iter == index)
+    {
+        if (!used)
+            this->_used.erase (iter);
+    }
+    else if (used)
+        this->_used.insert (iter, static_cast<unsigned int>(index));
+}
+
+double SparseRuleWeights::sumWeights () const
+{
+    size_t i, e = 0, count = this->getCount ();
+    double totweight = 0;
+
+    for (i = 0; i < count; i++)
+    {
+        if (e < this->_entries.size () && this->_entries[e].index == i)
+            totweight += this->_entries[e++].weight;
+        else
+            totweight += this->getSharedWeight (i);
+    }
+    return totweight;
+}
+
+void SparseRuleWeights::reset ()
+{
+    this->_offset = 0;
+    this->_entries.clear ();
+    this->_used.clear ();
+    this->_weight = this->sumWeights ();
+}
+
+void SparseRuleWeights::storeWeight (size_t index, double weight)
+{
+    Entry entry;
+    size_t pos;
+
+    if (index >= this->getCount ())
+        throw std::out_of_range ("index out of range");
+
+    pos = this->findEntry (index);
+    if (pos < this->_entries.size () && this->_entries[pos].index == index)
+    {
+        this->_entries[pos].weight = static_cast<float>(weight);
+        return;
+    }
+    entry.index = static_cast<unsigned int>(index);
+    entry.weight = static_cast<float>(weight);
+    this->_entries.insert (this->_entries.begin () +
+        static_cast<std::ptrdiff_t>(pos), entry);
+}
+
+void SparseRuleWeights::clearUsed ()
+{
+    this->_used.clear ();
+}
+
+void SparseRuleWeights::updateWeights (void *fitness)
+{
+    /*
+     * Same as WeightOverlay::updateWeights(), but the compensation for the
+     * unused rules is added to the shared offset. Only the used rules and
+     * the rules, which reach the weight limits, are stored separately.
+     */
+    AdjustedEntries weights;
+    size_t count, usedcount;
+    double _remainder = 0;
+    double minweight = this->_ruleset->getMinWeight ();
+    double maxweight = this->_ruleset->getMaxWeight ();
+
+    count = this->getCount ();
+    usedcount = this->_used.size ();
+    if (count == 0 || usedcount == 0 || usedcount == count)
+        return;
+
+    weights.overlay = this;
+    weights.entries = &this->_update;
+    weights.adjustment = this->_ruleset->calculateAdjustment (fitness);
+    weights.compensation = calculateCompensation (weights.adjustment,
+        usedcount, count);
+    weights.minweight = minweight;
+    weights.maxweight = maxweight;
+    weights.e = weights.u = 0;
+    weights.stored = weights.used = false;
+
+    this->_update.clear ();
+    this->_update.reserve (this->_entries.size () + usedcount);
+    this->_weight = adjustWeights (weights, 0, count, minweight, maxweight,
+        _remainder);
+    this->_entries.swap (this->_update);
+    this->_offset += weights.compensation;
+
+    this->distributeRemainder (_remainder);
+
+    this->clearUsed ();
+    this->_weight = this->sumWeights ();
+}
+
+} // namespace
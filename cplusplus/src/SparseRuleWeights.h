@@ -0,0 +1,150 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _SPARSERULEWEIGHTS_H_
+#define _SPARSERULEWEIGHTS_H_
+
+#include <vector>
+#include "WeightOverlay.h"
+
+namespace dynrules
+{
+    /**
+     * \brief A sparse set of rule weights on top of a shared RuleSet.
+     *
+     * SparseRuleWeights only stores the weights of those rules, which
+     * deviate from the weights of the shared RuleSet. All other rules use
+     * the weight of the Rule within the RuleSet plus an offset, which is
+     * shared by all of them. As the compensation of the weight updates is
+     * applied to all unused rules equally, it is kept in that shared
+     * offset, so that only the used rules and the rules, which reached
+     * the minimum or maximum weight, need to be stored separately. Stored
+     * weights, which match the shared weight again after an update, are
+     * removed.
+     *
+     * Each stored weight costs 8 bytes, so that SparseRuleWeights is well
+     * suited for large amounts of agents, which learn individually, but
+     * do not move too far away from the weights of the shared RuleSet.
+     *
+     * If the weights of the RuleSet change, reset() should be called to
+     * keep the total weight in sync.
+     */
+    class SparseRuleWeights : public WeightOverlay
+    {
+    public:
+        using WeightOverlay::getWeight;
+
+        /**
+         * \brief Creates a new SparseRuleWeights instance.
+         *
+         * The initial weights are the ones of the Rule objects of the
+         * passed RuleSet.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \exception invalid_argument Thrown, if the passed argument
+         * is NULL.
+         */
+        SparseRuleWeights (RuleSet* ruleset);
+
+        /**
+         * \brief Destroys the SparseRuleWeights.
+         */
+        virtual ~SparseRuleWeights ();
+
+        /**
+         * \brief Gets the amount of separately stored weights.
+         *
+         * \return The amount of separately stored weights.
+         */
+        size_t getStoredCount () const;
+
+        size_t getCount () const;
+        double getWeight (size_t index) const;
+        bool getUsed (size_t index) const;
+        void setUsed (size_t index, bool used);
+        void reset ();
+        void updateWeights (void *fitness);
+
+    protected:
+
+        /**
+         * \brief A separately stored weight.
+         */
+        struct Entry
+        {
+            /**
+             * \brief The index of the rule within the RuleSet.
+             */
+            unsigned int index;
+
+            /**
+             * \brief The weight of the rule.
+             */
+            float weight;
+        };
+
+        /**
+         * \brief Accesses the weights for adjustWeights().
+         */
+        struct AdjustedEntries;
+
+        void storeWeight (size_t index, double weight);
+        void clearUsed ();
+
+        /**
+         * \brief Gets the weight of a rule, which is not stored
+         * separately.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \return The weight of the Rule within the RuleSet plus the
+         * shared offset.
+         */
+        double getSharedWeight (size_t index) const;
+
+        /**
+         * \brief Finds the position of a separately stored weight.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \return The position within _entries, at which the weight is or
+         * would have to be stored.
+         */
+        size_t findEntry (size_t index) const;
+
+        /**
+         * \brief Calculates the sum of all weights.
+         *
+         * \return The sum of all weights.
+         */
+        double sumWeights () const;
+
+        /**
+         * \brief The offset for all rules, which are not stored
+         * separately.
+         */
+        double _offset;
+
+        /**
+         * \brief The separately stored weights, sorted by their index.
+         */
+        std::vector<Entry> _entries;
+
+        /**
+         * \brief The indices of the used rules in ascending order.
+         */
+        std::vector<unsigned int> _used;
+
+        /**
+         * \brief The buffer for the separately stored weights of the
+         * next update, which keeps its memory between the updates.
+         */
+        std::vector<Entry> _update;
+    };
+
+} // namespace
+
+#endif /* _SPARSERULEWEIGHTS_H_ */
@@ -0,0 +1,149 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include "ThreadPool.h"
+
+namespace dynrules
+{
+
+ThreadPool::ThreadPool (unsigned int threads) :
+    _workers(),
+    _task(0),
+    _tasks(0),
+    _next(0),
+    _busy(0),
+    _generation(0),
+    _stop(false),
+    _error(),
+    _lock(),
+    _runlock(),
+    _cond(),
+    _donecond()
+{
+    unsigned int i;
+
+    if (threads == 0)
+        threads = std::thread::hardware_concurrency ();
+    for (i = 1; i < threads; i++)
+        this->_workers.push_back (std::thread (&ThreadPool::work, this));
+}
+
+ThreadPool::~ThreadPool ()
+{
+    size_t i;
+
+    {
+        std::lock_guard<std::mutex> guard (this->_lock);
+        this->_stop = true;
+        this->_cond.notify_all ();
+    }
+    for (i = 0; i < this->_workers.size (); i++)
+        this->_workers[i].join ();
+}
+
+unsigned int ThreadPool::getThreads () const
+{
+    return static_cast<unsigned int>(this->_workers.size ()) + 1;
+}
+
+void ThreadPool::work ()
+{
+    const std::function<void (size_t)>* task;
+    unsigned long generation = 0;
+    size_t tasks;
+
+    while (true)
+    {
+        {
+            std::unique_lock<std::mutex> guard (this->_lock);
+            while (!this->_stop && generation == this->_generation)
+                this->_cond.wait (guard);
+            if (this->_stop)
+                return;
+            generation = this->_generation;
+            /* The batch might have been finished by the other threads. */
+            if (this->_task == 0)
+                continue;
+            task = this->_task;
+            tasks = this->_tasks;
+            this->_busy++;
+        }
+
+        this->execute (task, tasks);
+
+        std::lock_guard<std::mutex> guard (this->_lock);
+        this->_busy--;
+        if (this->_busy == 0)
+            this->_donecond.notify_all ();
+    }
+}
+
+void ThreadPool::execute (const std::function<void (size_t)>* task,
+    size_t tasks)
+{
+    size_t index;
+
+    while ((index = this->_next.fetch_add (1)) < tasks)
+    {
+        try
+        {
+            (*task) (index);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> guard (this->_lock);
+            if (!this->_error)
+                this->_error = std::current_exception ();
+            /* Let the other threads skip the remaining tasks. */
+            this->_next = tasks;
+        }
+    }
+}
+
+void ThreadPool::run (size_t tasks, const std::function<void (size_t)>& task)
+{
+    std::lock_guard<std::mutex> runguard (this->_runlock);
+    std::exception_ptr error;
+    size_t i;
+
+    if (tasks == 0)
+        return;
+    if (this->_workers.empty () || tasks == 1)
+    {
+        for (i = 0; i < tasks; i++)
+            task (i);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard (this->_lock);
+        this->_task = &task;
+        this->_tasks = tasks;
+        this->_next = 0;
+        this->_error = std::exception_ptr ();
+        this->_busy++;
+        this->_generation++;
+        this->_cond.notify_all ();
+    }
+
+    this->execute (&task, tasks);
+
+    {
+        std::unique_lock<std::mutex> guard (this->_lock);
+        this->_busy--;
+        while (this->_busy > 0)
+            this->_donecond.wait (guard);
+        this->_task = 0;
+        error = this->_error;
+        this->_error = std::exception_ptr ();
+    }
+    if (error)
+        std::rethrow_exception (error);
+}
+
+} // namespace
@@ -0,0 +1,164 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <exception>
+
+namespace dynrules
+{
+    /**
+     * \brief A simple pool of threads for processing independent tasks.
+     *
+     * ThreadPool executes a batch of tasks, identified by their index, on
+     * a fixed set of worker threads and the calling thread. Idle threads
+     * claim the next unprocessed task, so that threads finishing early
+     * take over the remaining work of slower ones.
+     *
+     * \code
+     *   ThreadPool pool (4);
+     *   pool.run (shards, [&] (size_t shard) { process (shard); });
+     * \endcode
+     *
+     * The order, in which the tasks are executed and the thread executing
+     * a task are not specified.
+     */
+    class ThreadPool
+    {
+    public:
+        /**
+         * \brief Creates a new ThreadPool.
+         *
+         * \param threads The amount of threads to use, including the
+         * thread calling run(). If it is 0, the amount of hardware threads
+         * will be used.
+         */
+        ThreadPool (unsigned int threads = 0);
+
+        /**
+         * \brief Destroys the ThreadPool.
+         *
+         * Waits for the worker threads to finish.
+         */
+        virtual ~ThreadPool ();
+
+        /**
+         * \brief Gets the amount of threads used, including the thread
+         * calling run().
+         *
+         * \return The amount of threads.
+         */
+        unsigned int getThreads () const;
+
+        /**
+         * \brief Executes a batch of tasks and waits for them to finish.
+         *
+         * Calls task once for each index from 0 to tasks - 1. Concurrent
+         * calls to run() are executed one after another.
+         *
+         * \param tasks The amount of tasks to execute.
+         * \param task The function to execute for each task index.
+         * \exception exception The first exception, which was thrown by
+         * task. The remaining tasks will not be executed in this case.
+         */
+        void run (size_t tasks, const std::function<void (size_t)>& task);
+
+    protected:
+
+        /**
+         * \brief Waits for batches and executes their tasks on a worker
+         * thread.
+         */
+        void work ();
+
+        /**
+         * \brief Claims and executes tasks of the current batch, until all
+         * tasks were claimed.
+         *
+         * \param task The function to execute.
+         * \param tasks The amount of tasks of the batch.
+         */
+        void execute (const std::function<void (size_t)>* task,
+            size_t tasks);
+
+        /**
+         * \brief The worker threads.
+         */
+        std::vector<std::thread> _workers;
+
+        /**
+         * \brief The function of the current batch or NULL, if there is
+         * no batch to process.
+         */
+        const std::function<void (size_t)>* _task;
+
+        /**
+         * \brief The amount of tasks of the current batch.
+         */
+        size_t _tasks;
+
+        /**
+         * \brief The index of the next task to claim.
+         */
+        std::atomic<size_t> _next;
+
+        /**
+         * \brief The amount of threads processing the current batch.
+         */
+        unsigned int _busy;
+
+        /**
+         * \brief Incremented for each new batch.
+         */
+        unsigned long _generation;
+
+        /**
+         * \brief Indicates, whether the worker threads shall stop.
+         */
+        bool _stop;
+
+        /**
+         * \brief The first exception thrown by a task of the current batch.
+         */
+        std::exception_ptr _error;
+
+        /**
+         * \brief Guards the batch state.
+         */
+        std::mutex _lock;
+
+        /**
+         * \brief Serializes calls to run().
+         */
+        std::mutex _runlock;
+
+        /**
+         * \brief Signals a new batch or stop request to the workers.
+         */
+        std::condition_variable _cond;
+
+        /**
+         * \brief Signals, that a worker finished processing a batch.
+         */
+        std::condition_variable _donecond;
+
+    private:
+        ThreadPool (const ThreadPool&);
+        ThreadPool& operator= (const ThreadPool&);
+    };
+
+} // namespace
+
+#endif /* _THREADPOOL_H_ */
@@ -0,0 +1,168 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include <algorithm>
+#include "VersionedRuleWeights.h"
+
+namespace dynrules
+{
+
+VersionedRuleWeights::VersionedRuleWeights (RuleSet* ruleset,
+    size_t pagesize) :
+    WeightOverlay(ruleset),
+    _pagesize(pagesize),
+    _version(),
+    _used(0),
+    _usedpages(),
+    _pageused()
+{
+    if (pagesize == 0)
+        throw std::invalid_argument ("pagesize must not be 0");
+    this->reset ();
+}
+
+VersionedRuleWeights::VersionedRuleWeights (RuleSet* ruleset,
+    const VersionedRuleWeights& weights) :
+    WeightOverlay(ruleset),
+    _pagesize(weights._pagesize),
+    _version(weights._version),
+    _used(weights._used),
+    _usedpages(weights._usedpages),
+    _pageused(weights._pageused)
+{
+    this->_weight = weights._weight;
+}
+
+VersionedRuleWeights::~VersionedRuleWeights ()
+{
+}
+
+size_t VersionedRuleWeights::getPageSize () const
+{
+    return this->_pagesize;
+}
+
+VersionedRuleWeights::Snapshot VersionedRuleWeights::snapshot () const
+{
+    /*
+     * The version is only shared, if its weights did not change since,
+     * so that the total weight is the same for all of its users.
+     */
+    this->_version->weight = this->_weight;
+    return this->_version;
+}
+
+void VersionedRuleWeights::rollback (const Snapshot& snapshot)
+{
+    if (!snapshot)
+        throw std::invalid_argument ("snapshot must not be empty");
+    if (snapshot->count != this->_version->count ||
+        snapshot->pagesize != this->_pagesize)
+        throw std::invalid_argument ("snapshot does not match the weights");
+
+    this->_version = std::const_pointer_cast<Version>(snapshot);
+    this->_weight = snapshot->weight;
+    this->clearUsed ();
+}
+
+size_t VersionedRuleWeights::getCount () const
+{
+    return this->_version->count;
+}
+
+double VersionedRuleWeights::getWeight (size_t index) const
+{
+    if (index >= this->_version->count)
+        throw std::out_of_range ("index out of range");
+    return (*this->_version->pages[index / this->_pagesize])
+        [index % this->_pagesize];
+}
+
+bool VersionedRuleWeights::getUsed (size_t index) const
+{
+    return this->_used.at (index) != 0;
+}
+
+void VersionedRuleWeights::setUsed (size_t index, bool used)
+{
+    size_t page = index / this->_pagesize;
+
+    this->_used.at (index) = used ? 1 : 0;
+    if (used && !this->_pageused[page])
+    {
+        this->_pageused[page] = 1;
+        this->_usedpages.push_back (page);
+    }
+}
+
+void VersionedRuleWeights::reset ()
+{
+    size_t i, count = this->_ruleset->getCount ();
+    size_t pagesize = this->_pagesize;
+    std::shared_ptr<Version> version (new Version ());
+    double weight, totweight = 0;
+
+    version->count = count;
+    version->pagesize = pagesize;
+    for (i = 0; i < count; i++)
+    {
+        if (i % pagesize == 0)
+            version->pages.push_back (std::shared_ptr<Page> (new Page (
+                (count - i > pagesize) ? pagesize : count - i)));
+        weight = this->_ruleset->getRule (i)->getWeight ();
+        (*version->pages.back ())[i % pagesize] = weight;
+        totweight += weight;
+    }
+    version->weight = totweight;
+
+    this->_version = version;
+    this->_used.assign (count, 0);
+    this->_usedpages.clear ();
+    this->_pageused.assign (version->pages.size (), 0);
+    this->_weight = totweight;
+}
+
+void VersionedRuleWeights::storeWeight (size_t index, double weight)
+{
+    std::shared_ptr<Page>& page = this->_version->pages[index / this->_pagesize];
+
+    if (page->at (index % this->_pagesize) == weight)
+        return;
+
+    /* Copy the page table and page, if they are shared with snapshots. */
+    if (this->_version.use_count () > 1)
+    {
+        this->_version.reset (new Version (*this->_version));
+        this->storeWeight (index, weight);
+        return;
+    }
+    if (page.use_count () > 1)
+        page.reset (new Page (*page));
+    (*page)[index % this->_pagesize] = weight;
+}
+
+void VersionedRuleWeights::clearUsed ()
+{
+    size_t i, begin, end;
+
+    /* Only clear the pages, which rules were marked as used on. */
+    for (i = 0; i < this->_usedpages.size (); i++)
+    {
+        begin = this->_usedpages[i] * this->_pagesize;
+        end = begin + this->_pagesize;
+        if (end > this->_used.size ())
+            end = this->_used.size ();
+        std::fill (this->_used.begin () + static_cast<std::ptrdiff_t>(begin),
+            this->_used.begin () + static_cast<std::ptrdiff_t>(end), 0);
+        this->_pageused[this->_usedpages[i]] = 0;
+    }
+    this->_usedpages.clear ();
+}
+
+} // namespace
@@ -0,0 +1,195 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _VERSIONEDRULEWEIGHTS_H_
+#define _VERSIONEDRULEWEIGHTS_H_
+
+#include <vector>
+#include <memory>
+#include "WeightOverlay.h"
+
+namespace dynrules
+{
+    /**
+     * \brief Rule weights with cheap snapshots and rollback.
+     *
+     * VersionedRuleWeights stores the weights in fixed-size pages, which
+     * are shared between the current weights and all snapshots taken from
+     * them. Taking a snapshot and rolling back to it only copies a
+     * reference. A page is copied on the first change after a snapshot
+     * was taken, so that the costs of a learning episode are proportional
+     * to the amount of pages it changes.
+     *
+     * \code
+     *   VersionedRuleWeights weights (ruleset);
+     *   VersionedRuleWeights::Snapshot before = weights.snapshot ();
+     *   ... learn using weights.setUsed () and weights.updateWeights () ...
+     *   if (discard)
+     *       weights.rollback (before);
+     * \endcode
+     *
+     * Snapshots can also be used for evaluating different weight sets
+     * against each other by rolling back to each of them in turn.
+     *
+     * Snapshots and VersionedRuleWeights instances must not be used by
+     * multiple threads at the same time.
+     */
+    class VersionedRuleWeights : public WeightOverlay
+    {
+    protected:
+        struct Version;
+
+    public:
+        using WeightOverlay::getWeight;
+
+        /**
+         * \brief A snapshot of the weights.
+         *
+         * A snapshot keeps the pages it refers to alive, until it is
+         * destroyed.
+         */
+        typedef std::shared_ptr<const Version> Snapshot;
+
+        /**
+         * \brief Creates a new VersionedRuleWeights instance.
+         *
+         * The initial weights are the ones of the Rule objects of the
+         * passed RuleSet.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \param pagesize The amount of weights per page.
+         * \exception invalid_argument Thrown, if ruleset is NULL or
+         * pagesize is 0.
+         */
+        VersionedRuleWeights (RuleSet* ruleset, size_t pagesize = 512);
+
+        /**
+         * \brief Creates a new VersionedRuleWeights instance sharing the
+         * pages of another one.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \param weights The VersionedRuleWeights to take the weights from.
+         * \exception invalid_argument Thrown, if ruleset is NULL.
+         */
+        VersionedRuleWeights (RuleSet* ruleset,
+            const VersionedRuleWeights& weights);
+
+        /**
+         * \brief Destroys the VersionedRuleWeights.
+         */
+        virtual ~VersionedRuleWeights ();
+
+        /**
+         * \brief Gets the amount of weights per page.
+         *
+         * \return The amount of weights per page.
+         */
+        size_t getPageSize () const;
+
+        /**
+         * \brief Takes a snapshot of the current weights.
+         *
+         * \return The snapshot.
+         */
+        Snapshot snapshot () const;
+
+        /**
+         * \brief Restores the weights of a snapshot.
+         *
+         * The usage states of all rules will be reset. Only the pages,
+         * which contain rules marked as used, are cleared, so that a
+         * rollback takes time proportional to the pages touched since the
+         * last update or rollback.
+         *
+         * \param snapshot The snapshot to restore.
+         * \exception invalid_argument Thrown, if snapshot is empty or does
+         * not match the amount of rules or the page size.
+         */
+        void rollback (const Snapshot& snapshot);
+
+        size_t getCount () const;
+        double getWeight (size_t index) const;
+        bool getUsed (size_t index) const;
+        void setUsed (size_t index, bool used);
+        void reset ();
+
+    protected:
+
+        /**
+         * \brief A page of weights.
+         */
+        typedef std::vector<double> Page;
+
+        /**
+         * \brief The pages and total weight of a set of weights.
+         */
+        struct Version
+        {
+            Version () : count(0), pagesize(0), weight(0), pages()
+            {
+            }
+
+            /**
+             * \brief The amount of weights.
+             */
+            size_t count;
+
+            /**
+             * \brief The amount of weights per page.
+             */
+            size_t pagesize;
+
+            /**
+             * \brief The total weight.
+             */
+            double weight;
+
+            /**
+             * \brief The pages, which might be shared with other versions.
+             */
+            std::vector<std::shared_ptr<Page> > pages;
+        };
+
+        void storeWeight (size_t index, double weight);
+        void clearUsed ();
+
+        /**
+         * \brief The amount of weights per page.
+         */
+        size_t _pagesize;
+
+        /**
+         * \brief The current weights, which might be shared with
+         * snapshots.
+         */
+        std::shared_ptr<Version> _version;
+
+        /**
+         * \brief The usage states of the rules.
+         */
+        std::vector<unsigned char> _used;
+
+        /**
+         * \brief The indices of the pages, which contain rules marked as
+         * used.
+         */
+        std::vector<size_t> _usedpages;
+
+        /**
+         * \brief Indicates for each page, whether it is in _usedpages.
+         */
+        std::vector<unsigned char> _pageused;
+
+    private:
+        VersionedRuleWeights (const VersionedRuleWeights&);
+        VersionedRuleWeights& operator= (const VersionedRuleWeights&);
+    };
+
+} // namespace
+
+#endif /* _VERSIONEDRULEWEIGHTS_H_ */
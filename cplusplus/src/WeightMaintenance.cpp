@@ -0,0 +1,170 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include "WeightMaintenance.h"
+
+namespace dynrules
+{
+
+typedef std::chrono::steady_clock _Clock;
+
+WeightMaintenance::WeightMaintenance (RuleSet* ruleset) :
+    _ruleset(ruleset),
+    _decay(1),
+    _target(0),
+    _chunksize(4096),
+    _interval(0),
+    _running(false),
+    _position(0),
+    _center(0),
+    _scale(1),
+    _passes(0),
+    _started(false),
+    _laststart()
+{
+    if (ruleset == 0)
+        throw std::invalid_argument ("ruleset must not be NULL");
+}
+
+WeightMaintenance::~WeightMaintenance ()
+{
+}
+
+RuleSet* WeightMaintenance::getRuleSet () const
+{
+    return this->_ruleset;
+}
+
+double WeightMaintenance::getDecay () const
+{
+    return this->_decay;
+}
+
+void WeightMaintenance::setDecay (double decay)
+{
+    if (!(decay >= 0 && decay <= 1))
+        throw std::invalid_argument ("decay must be between 0 and 1");
+    this->_decay = decay;
+}
+
+double WeightMaintenance::getTargetWeight () const
+{
+    return this->_target;
+}
+
+void WeightMaintenance::setTargetWeight (double weight)
+{
+    if (!(weight >= 0))
+        throw std::invalid_argument ("weight must not be negative");
+    this->_target = weight;
+}
+
+size_t WeightMaintenance::getChunkSize () const
+{
+    return this->_chunksize;
+}
+
+void WeightMaintenance::setChunkSize (size_t chunksize)
+{
+    if (chunksize == 0)
+        throw std::invalid_argument ("chunksize must be greater than 0");
+    this->_chunksize = chunksize;
+}
+
+unsigned int WeightMaintenance::getInterval () const
+{
+    return this->_interval;
+}
+
+void WeightMaintenance::setInterval (unsigned int milliseconds)
+{
+    this->_interval = milliseconds;
+}
+
+bool WeightMaintenance::isRunning () const
+{
+    return this->_running;
+}
+
+unsigned long WeightMaintenance::getPasses () const
+{
+    return this->_passes;
+}
+
+void WeightMaintenance::start ()
+{
+    size_t count = this->_ruleset->getCount ();
+    double weight = this->_ruleset->getWeight ();
+
+    this->_running = true;
+    this->_started = true;
+    this->_laststart = _Clock::now ();
+    this->_position = 0;
+    this->_center = (count > 0) ? weight / static_cast<double>(count) : 0;
+    this->_scale = (this->_target > 0 && weight > 0) ?
+        this->_target / weight : 1;
+}
+
+bool WeightMaintenance::processChunk ()
+{
+    size_t count = this->_ruleset->getCount (), chunk = 0;
+
+    /* Rules might have been removed since the pass started. */
+    if (this->_position < count)
+    {
+        chunk = count - this->_position;
+        if (chunk > this->_chunksize)
+            chunk = this->_chunksize;
+        this->_ruleset->rescaleWeights (this->_center, this->_decay,
+            this->_scale, this->_position, chunk);
+        this->_position += chunk;
+    }
+    if (this->_position < count)
+        return false;
+
+    /* The chunks kept the order of the rules, so refresh it only once. */
+    if (chunk < count)
+        this->_ruleset->updateOrder ();
+    this->_running = false;
+    this->_passes++;
+    return true;
+}
+
+bool WeightMaintenance::step (unsigned int microseconds)
+{
+    _Clock::time_point now = _Clock::now ();
+    _Clock::time_point deadline = now +
+        std::chrono::microseconds (microseconds);
+
+    if (!this->_running)
+    {
+        if (this->_interval == 0 || (this->_decay == 1 && this->_target == 0))
+            return false;
+        if (this->_started && now - this->_laststart <
+            std::chrono::milliseconds (this->_interval))
+            return false;
+        this->start ();
+    }
+
+    while (!this->processChunk ())
+    {
+        if (_Clock::now () >= deadline)
+            return false;
+    }
+    return true;
+}
+
+void WeightMaintenance::run ()
+{
+    if (!this->_running)
+        this->start ();
+    while (!this->processChunk ());
+}
+
+} // namespace
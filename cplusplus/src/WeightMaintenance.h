@@ -0,0 +1,273 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _WEIGHTMAINTENANCE_H_
+#define _WEIGHTMAINTENANCE_H_
+
+#include <chrono>
+#include "RuleSet.h"
+
+namespace dynrules
+{
+    /**
+     * \brief Decays and normalizes the weights of a RuleSet in small,
+     * time-sliced steps.
+     *
+     * Over long runs, the weights of the rules saturate at the minimum and
+     * maximum weight, so that the weights lose the information about the
+     * rules performing well recently. WeightMaintenance periodically
+     * moves the weights toward their mean (see setDecay()) and scales
+     * them to a total weight (see setTargetWeight()).
+     *
+     * Instead of changing all weights at once, a pass over the weights is
+     * split into chunks of rules, which are changed via
+     * RuleSet::rescaleWeights(). The mean and scale of a pass are taken on
+     * its start, the chunks are processed by step() within a time budget.
+     * The RuleSet is consistent after each chunk, so that scripts can be
+     * created and weights updated between the steps of a pass. If the
+     * RuleSet orders the rules by their weight, the order is updated once
+     * at the end of a pass, see RuleSet::setOrderByWeight().
+     *
+     * \code
+     *   WeightMaintenance maintenance (ruleset);
+     *   maintenance.setDecay (0.9);
+     *   maintenance.setInterval (1000);
+     *   while (running)
+     *   {
+     *       ... create scripts and update the weights ...
+     *       maintenance.step (50);
+     *   }
+     * \endcode
+     *
+     * The steps must be run on the thread updating the weights of the
+     * RuleSet, e.g. between the rounds of a LearnPipeline, see
+     * LearnPipeline::setMaintenance().
+     */
+    class WeightMaintenance
+    {
+    public:
+        /**
+         * \brief Creates a new WeightMaintenance, which neither decays nor
+         * normalizes the weights.
+         *
+         * \param ruleset The RuleSet to maintain the weights of.
+         * \exception invalid_argument Thrown, if ruleset is NULL.
+         */
+        WeightMaintenance (RuleSet* ruleset);
+
+        /**
+         * \brief Destroys the WeightMaintenance.
+         */
+        virtual ~WeightMaintenance ();
+
+        /**
+         * \brief Gets the RuleSet to maintain the weights of.
+         *
+         * \return The RuleSet.
+         */
+        RuleSet* getRuleSet () const;
+
+        /**
+         * \brief Gets the fraction of the distance to the mean weight,
+         * which each pass keeps.
+         *
+         * \return The fraction of the distance to keep.
+         */
+        double getDecay () const;
+
+        /**
+         * \brief Sets the fraction of the distance to the mean weight,
+         * which each pass keeps.
+         *
+         * \param decay The fraction of the distance to keep, between 0
+         * and 1. 1, which is the default, does not decay the weights.
+         * \exception invalid_argument Thrown, if decay is not within the
+         * range 0 to 1.
+         */
+        void setDecay (double decay);
+
+        /**
+         * \brief Gets the total weight to scale the weights to.
+         *
+         * \return The total weight or 0, if the weights are not scaled.
+         */
+        double getTargetWeight () const;
+
+        /**
+         * \brief Sets the total weight to scale the weights to.
+         *
+         * \param weight The total weight or 0, which is the default, to
+         * not scale the weights.
+         * \exception invalid_argument Thrown, if weight is negative.
+         */
+        void setTargetWeight (double weight);
+
+        /**
+         * \brief Gets the amount of rules changed at once.
+         *
+         * \return The amount of rules per chunk.
+         */
+        size_t getChunkSize () const;
+
+        /**
+         * \brief Sets the amount of rules changed at once.
+         *
+         * step() checks its time budget after each chunk. If the RuleSet
+         * walks over the rules by their weight, the order is updated after
+         * each chunk, which takes O(n) steps, so that the chunks should not
+         * be too small in that case.
+         *
+         * \param chunksize The amount of rules per chunk. The default is
+         * 4096.
+         * \exception invalid_argument Thrown, if chunksize is 0.
+         */
+        void setChunkSize (size_t chunksize);
+
+        /**
+         * \brief Gets the time between the starts of two passes.
+         *
+         * \return The time in milliseconds or 0, if passes are only
+         * started via start().
+         */
+        unsigned int getInterval () const;
+
+        /**
+         * \brief Sets the time between the starts of two passes.
+         *
+         * If the interval elapsed since the last pass started, step()
+         * starts a new pass. The first pass is started by the first
+         * step().
+         *
+         * \param milliseconds The time in milliseconds or 0, which is the
+         * default, to only start passes via start().
+         */
+        void setInterval (unsigned int milliseconds);
+
+        /**
+         * \brief Checks, whether a pass is in progress.
+         *
+         * \return true, if a pass was started, but not finished yet, false
+         * otherwise.
+         */
+        bool isRunning () const;
+
+        /**
+         * \brief Gets the amount of finished passes.
+         *
+         * \return The amount of finished passes.
+         */
+        unsigned long getPasses () const;
+
+        /**
+         * \brief Starts a new pass over the weights.
+         *
+         * Takes the mean weight and the scale for the pass from the
+         * current total weight of the RuleSet. A pass in progress is
+         * restarted.
+         */
+        void start ();
+
+        /**
+         * \brief Changes the weights of the current pass within a time
+         * budget.
+         *
+         * Starts a new pass, if none is in progress and the interval
+         * elapsed. Changes chunks of rules, until the pass is finished or
+         * the budget is exhausted. At least one chunk is changed, if a pass
+         * is in progress. If a ReplayLog is set for the RuleSet, each
+         * chunk is written to it, see RuleSet::rescaleWeights().
+         *
+         * \param microseconds The time budget in microseconds.
+         * \return true, if a pass was finished, false otherwise.
+         */
+        bool step (unsigned int microseconds);
+
+        /**
+         * \brief Finishes the current pass or runs a complete pass, if none
+         * is in progress.
+         */
+        void run ();
+
+    protected:
+
+        /**
+         * \brief Changes the next chunk of rules.
+         *
+         * \return true, if the pass was finished, false otherwise.
+         */
+        bool processChunk ();
+
+        /**
+         * \brief The RuleSet to maintain the weights of.
+         */
+        RuleSet *_ruleset;
+
+        /**
+         * \brief The fraction of the distance to the mean to keep.
+         */
+        double _decay;
+
+        /**
+         * \brief The total weight to scale to or 0.
+         */
+        double _target;
+
+        /**
+         * \brief The amount of rules per chunk.
+         */
+        size_t _chunksize;
+
+        /**
+         * \brief The time between the starts of two passes in
+         * milliseconds.
+         */
+        unsigned int _interval;
+
+        /**
+         * \brief Indicates, whether a pass is in progress.
+         */
+        bool _running;
+
+        /**
+         * \brief The index of the next rule of the current pass.
+         */
+        size_t _position;
+
+        /**
+         * \brief The mean weight of the current pass.
+         */
+        double _center;
+
+        /**
+         * \brief The scale of the current pass.
+         */
+        double _scale;
+
+        /**
+         * \brief The amount of finished passes.
+         */
+        unsigned long _passes;
+
+        /**
+         * \brief Indicates, whether a pass was started before.
+         */
+        bool _started;
+
+        /**
+         * \brief The start of the last pass.
+         */
+        std::chrono::steady_clock::time_point _laststart;
+
+    private:
+        WeightMaintenance (const WeightMaintenance&);
+        WeightMaintenance& operator= (const WeightMaintenance&);
+    };
+
+} // namespace
+
+#endif /* _WEIGHTMAINTENANCE_H_ */
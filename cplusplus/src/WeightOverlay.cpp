@@ -0,0 +1,177 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#include <stdexcept>
+#include "WeightOverlay.h"
+#include "Selection.h"
+#include "Adjustment.h"
+
+namespace dynrules
+{
+
+/* Accesses the weights of an overlay for adjustWeights(). */
+struct WeightOverlay::AdjustedWeights
+{
+    WeightOverlay *overlay;
+    double adjustment;
+    double compensation;
+
+    double get (size_t index) const
+    {
+        return overlay->getWeight (index);
+    }
+
+    double change (size_t index) const
+    {
+        return overlay->getUsed (index) ? adjustment : compensation;
+    }
+
+    double store (size_t index, double weight) const
+    {
+        overlay->storeWeight (index, weight);
+        return overlay->getWeight (index);
+    }
+};
+
+/* Weight accessor for the generic selection functions. */
+struct _OverlayWeights
+{
+    const WeightOverlay *weights;
+
+    double operator() (size_t index) const
+    {
+        return weights->getWeight (index);
+    }
+};
+
+WeightOverlay::WeightOverlay (RuleSet* ruleset) :
+    _ruleset(ruleset),
+    _weight(0)
+{
+    if (ruleset == 0)
+        throw std::invalid_argument ("ruleset must not be NULL");
+}
+
+WeightOverlay::~WeightOverlay ()
+{
+}
+
+RuleSet* WeightOverlay::getRuleSet () const
+{
+    return this->_ruleset;
+}
+
+void WeightOverlay::setRuleSet (RuleSet* ruleset)
+{
+    if (ruleset == 0)
+        throw std::invalid_argument ("ruleset must not be NULL");
+    this->_ruleset = ruleset;
+    this->reset ();
+}
+
+double WeightOverlay::getWeight () const
+{
+    return this->_weight;
+}
+
+void WeightOverlay::setWeight (size_t index, double weight)
+{
+    double minweight = this->_ruleset->getMinWeight ();
+    double maxweight = this->_ruleset->getMaxWeight ();
+
+    if (weight > maxweight)
+        weight = maxweight;
+    else if (weight < minweight)
+        weight = minweight;
+
+    this->_weight -= this->getWeight (index);
+    this->storeWeight (index, weight);
+    this->_weight += this->getWeight (index);
+}
+
+void WeightOverlay::setWeights (const double* weights, size_t count)
+{
+    size_t i;
+    double weight, totweight = 0;
+    double minweight = this->_ruleset->getMinWeight ();
+    double maxweight = this->_ruleset->getMaxWeight ();
+
+    if (count != this->getCount ())
+        throw std::invalid_argument ("count must match the amount of rules");
+
+    for (i = 0; i < count; i++)
+    {
+        weight = weights[i];
+        if (weight > maxweight)
+            weight = maxweight;
+        else if (weight < minweight)
+            weight = minweight;
+        this->storeWeight (i, weight);
+        totweight += this->getWeight (i);
+    }
+    this->_weight = totweight;
+}
+
+size_t WeightOverlay::selectRule (double fraction) const
+{
+    _OverlayWeights weights = { this };
+    return selectRouletteRule (weights, this->getCount (), fraction);
+}
+
+size_t WeightOverlay::selectBest (size_t* indices, size_t count) const
+{
+    _OverlayWeights weights = { this };
+    return selectBestRules (weights, this->getCount (), indices, count);
+}
+
+size_t WeightOverlay::selectSoftmax (double fraction, double temperature) const
+{
+    _OverlayWeights weights = { this };
+    return selectSoftmaxRule (weights, this->getCount (),
+        this->_ruleset->getMaxWeight (), fraction, temperature);
+}
+
+void WeightOverlay::updateWeights (void *fitness)
+{
+    AdjustedWeights weights = { this, 0, 0 };
+    size_t i, count, usedcount = 0;
+    double totweight = 0, _remainder = 0;
+
+    count = this->getCount ();
+    if (count == 0)
+        return;
+
+    for (i = 0; i < count; i++)
+    {
+        if (this->getUsed (i))
+            usedcount++;
+    }
+    if (usedcount == 0 || usedcount == count)
+        return;
+
+    weights.adjustment = this->_ruleset->calculateAdjustment (fitness);
+    weights.compensation = calculateCompensation (weights.adjustment,
+        usedcount, count);
+
+    this->_weight = adjustWeights (weights, 0, count,
+        this->_ruleset->getMinWeight (), this->_ruleset->getMaxWeight (),
+        _remainder);
+    this->distributeRemainder (_remainder);
+
+    this->clearUsed ();
+    for (i = 0; i < count; i++)
+        totweight += this->getWeight (i);
+    this->_weight = totweight;
+}
+
+void WeightOverlay::distributeRemainder (double remainder)
+{
+    this->_ruleset->distributeOverlayRemainder (*this, remainder);
+}
+
+} // namespace
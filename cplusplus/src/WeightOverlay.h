@@ -0,0 +1,254 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _WEIGHTOVERLAY_H_
+#define _WEIGHTOVERLAY_H_
+
+#include "RuleSet.h"
+
+namespace dynrules
+{
+    /**
+     * \brief An abstract set of rule weights on top of a shared RuleSet.
+     *
+     * A WeightOverlay keeps its own weight and usage state for each Rule of
+     * a RuleSet, which acts as shared rule catalog. The Rule objects (and
+     * thus their code) are stored only once within the RuleSet, while any
+     * amount of WeightOverlay instances can learn independently from each
+     * other.
+     *
+     * The weight at index i belongs to the Rule at index i of the
+     * RuleSet. If Rule objects are added to or removed from the RuleSet,
+     * reset() has to be called to realign the weights.
+     *
+     * The weight adjustments are calculated using the
+     * RuleSet::calculateAdjustment() method of the shared RuleSet.
+     *
+     * Inheriting classes decide on how the weights are stored and must
+     * implement getCount(), getWeight(size_t), getUsed(), setUsed(),
+     * reset(), storeWeight() and clearUsed().
+     */
+    class WeightOverlay
+    {
+    public:
+        /**
+         * \brief Creates a new WeightOverlay instance.
+         *
+         * \param ruleset The RuleSet to use as rule catalog.
+         * \exception invalid_argument Thrown, if the passed argument
+         * is NULL.
+         */
+        WeightOverlay (RuleSet* ruleset);
+
+        /**
+         * \brief Destroys the WeightOverlay.
+         */
+        virtual ~WeightOverlay ();
+
+        /**
+         * \brief Gets the RuleSet used as rule catalog.
+         *
+         * \return The RuleSet used as rule catalog.
+         */
+        RuleSet* getRuleSet () const;
+
+        /**
+         * \brief Sets the RuleSet to use as rule catalog.
+         *
+         * This will reset() the weights to the ones of the new RuleSet.
+         *
+         * \param ruleset The RuleSet to use.
+         * \exception invalid_argument Thrown, if the passed argument
+         * is NULL.
+         */
+        void setRuleSet (RuleSet* ruleset);
+
+        /**
+         * \brief Gets the amount of weights.
+         *
+         * \return The amount of weights.
+         */
+        virtual size_t getCount () const = 0;
+
+        /**
+         * \brief Gets the current weight of all rules.
+         *
+         * \return The sum of all weights.
+         */
+        double getWeight () const;
+
+        /**
+         * \brief Gets the weight of a specific rule.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \return The weight of the rule.
+         * \exception out_of_range Thrown, if index is out of range.
+         */
+        virtual double getWeight (size_t index) const = 0;
+
+        /**
+         * \brief Sets the weight of a specific rule.
+         *
+         * The weight will be limited to the minimum and maximum weight of
+         * the RuleSet.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \param weight The weight to set.
+         * \exception out_of_range Thrown, if index is out of range.
+         */
+        void setWeight (size_t index, double weight);
+
+        /**
+         * \brief Sets the weights of all rules at once.
+         *
+         * The weights will be limited to the minimum and maximum weight of
+         * the RuleSet and the total weight will be recalculated.
+         *
+         * \param weights The weights to set, in the order of the rules
+         * within the RuleSet.
+         * \param count The amount of weights.
+         * \exception invalid_argument Thrown, if count does not match
+         * getCount().
+         */
+        virtual void setWeights (const double* weights, size_t count);
+
+        /**
+         * \brief Gets whether a specific rule was used or not.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \return The usage state of the rule.
+         * \exception out_of_range Thrown, if index is out of range.
+         */
+        virtual bool getUsed (size_t index) const = 0;
+
+        /**
+         * \brief Sets whether a specific rule was used or not.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \param used The usage state to set.
+         * \exception out_of_range Thrown, if index is out of range.
+         */
+        virtual void setUsed (size_t index, bool used) = 0;
+
+        /**
+         * \brief Selects a rule based on the weights.
+         *
+         * Walks through the weights and returns the index of the first
+         * rule, at which the sum of the weights exceeds fraction. This is
+         * used by the LearnSystem for the roulette wheel selection of
+         * the rules. Implementations must not take more than one pass over
+         * the weights, even for fractions exceeding the total weight, see
+         * selectRouletteRule().
+         *
+         * \param fraction A value between 0 and the total weight.
+         * \return The index of the selected rule.
+         */
+        virtual size_t selectRule (double fraction) const;
+
+        /**
+         * \brief Gets the indices of the rules with the highest weights.
+         *
+         * Rules with equal weights are ordered by their index. This is
+         * used by the LearnSystem for the greedy selection of the rules.
+         * The default implementation needs O(n log count) steps.
+         *
+         * \param indices The array to store the indices at.
+         * \param count The amount of indices to store.
+         * \return The amount of indices stored. The indices are ordered by
+         * descending weight.
+         */
+        virtual size_t selectBest (size_t* indices, size_t count) const;
+
+        /**
+         * \brief Selects a rule with a probability proportional to
+         * exp(weight / temperature).
+         *
+         * This is used by the LearnSystem for the softmax selection of the
+         * rules. The default implementation needs O(n) steps.
+         *
+         * \param fraction A value between 0 and 1.
+         * \param temperature The temperature, which must be greater than
+         * 0.
+         * \return The index of the selected rule.
+         */
+        virtual size_t selectSoftmax (double fraction,
+            double temperature) const;
+
+        /**
+         * \brief Resets the weights to the ones of the RuleSet.
+         *
+         * Resets the weights to the current weights of the Rule objects
+         * within the RuleSet and clears all usage states.
+         */
+        virtual void reset () = 0;
+
+        /**
+         * \brief Updates the weights of all rules.
+         *
+         * Updates the weights of all rules based on Pieter Spronck's
+         * dynamic scripting algorithm, just like RuleSet::updateWeights()
+         * does.
+         *
+         * \param fitness The measure of the overall fitness of the
+         * performance or whatever is suitable in the concrete
+         * RuleSet::calculateAdjustment() implementation.
+         */
+        virtual void updateWeights (void *fitness);
+
+        /**
+         * \brief Distributes the remainder of the weight differences.
+         *
+         * Distributes the remainder of the weight differences between the
+         * last weights and current weights. The default implementation
+         * calls RuleSet::distributeOverlayRemainder() of the RuleSet.
+         *
+         * \param remainder The remainder to distribute.
+         */
+        virtual void distributeRemainder (double remainder);
+
+    protected:
+
+        /**
+         * \brief Accesses the weights for adjustWeights().
+         */
+        struct AdjustedWeights;
+
+        /**
+         * \brief Stores the weight of a specific rule.
+         *
+         * Stores the weight without limiting it or updating the total
+         * weight.
+         *
+         * \param index The index of the rule within the RuleSet.
+         * \param weight The weight to store.
+         */
+        virtual void storeWeight (size_t index, double weight) = 0;
+
+        /**
+         * \brief Clears the usage states of all rules.
+         */
+        virtual void clearUsed () = 0;
+
+        /**
+         * \brief The RuleSet used as rule catalog.
+         */
+        RuleSet* _ruleset;
+
+        /**
+         * \brief The current weight of all rules.
+         */
+        double _weight;
+
+    private:
+        WeightOverlay (const WeightOverlay&);
+        WeightOverlay& operator= (const WeightOverlay&);
+    };
+
+} // namespace
+
+#endif /* _WEIGHTOVERLAY_H_ */
@@ -0,0 +1,180 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+#ifndef _WEIGHTSTORAGE_H_
+#define _WEIGHTSTORAGE_H_
+
+namespace dynrules
+{
+    /**
+     * \brief Storage policy for weights as double values.
+     *
+     * Weights are stored without any loss of precision, so that the
+     * weight updates produce exactly the same results as
+     * RuleSet::updateWeights(). Each weight requires 8 bytes.
+     */
+    struct DoubleWeight
+    {
+        /**
+         * \brief The type used for storing a weight.
+         */
+        typedef double value_type;
+
+        /**
+         * \brief Indicates, whether the weight updates round the weights
+         * stochastically.
+         */
+        static const bool STOCHASTIC = false;
+
+        /**
+         * \brief Converts a weight into its stored representation.
+         *
+         * \param weight The weight to convert. It must be within the
+         * minimum and maximum weight.
+         * \param minweight The minimum weight.
+         * \param step The weight difference between two stored values.
+         * \param dither The fraction of a step in the range [0, 1), which
+         * is added before rounding down to a stored value. 0.5 rounds to
+         * the nearest stored value, a uniformly distributed random value
+         * rounds stochastically. Only used, if STOCHASTIC is true.
+         * \return The stored representation of the weight.
+         */
+        static value_type encode (double weight, double minweight,
+            double step, double dither = 0.5)
+        {
+            (void) minweight;
+            (void) step;
+            (void) dither;
+            return weight;
+        }
+
+        /**
+         * \brief Converts a stored weight back into its value.
+         *
+         * \param value The stored weight.
+         * \param minweight The minimum weight.
+         * \param step The weight difference between two stored values.
+         * \return The weight.
+         */
+        static double decode (value_type value, double minweight,
+            double step)
+        {
+            (void) minweight;
+            (void) step;
+            return value;
+        }
+    };
+
+    /**
+     * \brief Storage policy for weights as float values.
+     *
+     * The weight updates are calculated with double precision and then
+     * rounded to the nearest float value, causing a relative error of at
+     * most 2^-24 (about 6e-8) per stored weight and update. Each weight
+     * requires 4 bytes.
+     */
+    struct FloatWeight
+    {
+        /**
+         * \brief The type used for storing a weight.
+         */
+        typedef float value_type;
+
+        /**
+         * \copydoc DoubleWeight::STOCHASTIC
+         */
+        static const bool STOCHASTIC = false;
+
+        /**
+         * \copydoc DoubleWeight::encode()
+         */
+        static value_type encode (double weight, double minweight,
+            double step, double dither = 0.5)
+        {
+            (void) minweight;
+            (void) step;
+            (void) dither;
+            return static_cast<float>(weight);
+        }
+
+        /**
+         * \copydoc DoubleWeight::decode()
+         */
+        static double decode (value_type value, double minweight,
+            double step)
+        {
+            (void) minweight;
+            (void) step;
+            return value;
+        }
+    };
+
+    /**
+     * \brief Storage policy for weights as 16-bit fixed-point values.
+     *
+     * The weights are stored as 65536 equidistant steps between the
+     * minimum and maximum weight, which were set at the time the weights
+     * were reset. The weight updates are calculated with double precision
+     * and then rounded stochastically to one of the two neighbouring
+     * steps, with a probability proportional to the distance to the other
+     * step. This causes an absolute error of less than
+     * (maxweight - minweight) / 65535 per stored weight and update, but
+     * the expected stored weight is the exact one, so that changes
+     * smaller than a step still accumulate over many updates instead of
+     * being rounded away. Setting the weights rounds them to the nearest
+     * step. Stored weights can never leave the weight limits. Each weight
+     * requires 2 bytes.
+     */
+    struct FixedWeight
+    {
+        /**
+         * \brief The type used for storing a weight.
+         */
+        typedef unsigned short value_type;
+
+        /**
+         * \brief The largest stored value.
+         */
+        static const unsigned int MAXVALUE = 65535;
+
+        /**
+         * \copydoc DoubleWeight::STOCHASTIC
+         */
+        static const bool STOCHASTIC = true;
+
+        /**
+         * \copydoc DoubleWeight::encode()
+         */
+        static value_type encode (double weight, double minweight,
+            double step, double dither = 0.5)
+        {
+            double value;
+
+            if (step == 0)
+                return 0;
+            value = (weight - minweight) / step + dither;
+            if (value <= 0)
+                return 0;
+            if (value >= MAXVALUE)
+                return MAXVALUE;
+            return static_cast<value_type>(value);
+        }
+
+        /**
+         * \copydoc DoubleWeight::decode()
+         */
+        static double decode (value_type value, double minweight,
+            double step)
+        {
+            return minweight + value * step;
+        }
+    };
+
+} // namespace
+
+#endif /* _WEIGHTSTORAGE_H_ */
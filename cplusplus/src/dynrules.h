@@ -11,8 +11,29 @@
 
 #include "Rule.h"
 #include "RuleSet.h"
+#include "WeightStorage.h"
+#include "Selection.h"
+#include "Adjustment.h"
+#include "WeightOverlay.h"
+#include "RuleWeights.h"
+#include "SparseRuleWeights.h"
+#include "VersionedRuleWeights.h"
+#include "RankedRuleWeights.h"
+#include "WeightMaintenance.h"
+#include "ScriptHandle.h"
+#include "LatencyHistogram.h"
 #include "LearnSystem.h"
 #include "RuleManager.h"
 #include "MMapRuleManager.h"
+#include "FileRuleManager.h"
+#include "RuleStream.h"
+#include "CodeCache.h"
+#include "CodeStore.h"
+#include "ThreadPool.h"
+#include "ShardedRuleSet.h"
+#include "SharedWeights.h"
+#include "ReplicatedWeights.h"
+#include "ReplayLog.h"
+#include "LearnPipeline.h"
 
 #endif /* _DYNRULES_H_ */
@@ -18,7 +18,8 @@ if sys.version_info[0] >= 3:
     unicode = str
 
 __version__ = "0.1.0"
-__all__ = ["Rule", "RuleSet", "RuleManager", "LearnSystem", "MMapRuleManager"]
+__all__ = ["Rule", "RuleSet", "RuleManager", "LearnSystem", "MMapRuleManager",
+           "CRule", "CRuleSet", "CLearnSystem", "CRuleWeights"]
 
 
 class Rule(object):
@@ -171,6 +172,39 @@ class RuleSet(object):
         self._weight -= self._rules[rule.id].weight
         del self._rules[rule.id]
 
+    def get_weights(self):
+        """Gets the weights of all managed Rules as list.
+
+        The weights are in the same order as the Rules returned by rules.
+        """
+        return [rule.weight for rule in self._rules.values()]
+
+    def set_weights(self, weights):
+        """Sets the weights of all managed Rules at once.
+
+        weights must be a sequence of weights in the same order as the
+        Rules returned by rules. The weights are limited to the minimum
+        and maximum weight.
+
+        Raises a ValueError, if the amount of weights does not match the
+        amount of Rules.
+        """
+        rules = list(self._rules.values())
+        weights = [float(weight) for weight in weights]
+        if len(weights) != len(rules):
+            raise ValueError("amount of weights must match the amount of rules")
+        minweight = self.minweight
+        maxweight = self.maxweight
+        totweight = 0
+        for rule, weight in zip(rules, weights):
+            if weight > maxweight:
+                weight = maxweight
+            elif weight < minweight:
+                weight = minweight
+            rule.weight = weight
+            totweight += weight
+        self._weight = totweight
+
     def calculate_adjustment(self, fitness):
         """Calculates the reward or penalty for the active rules.
 
@@ -220,17 +254,20 @@ class RuleSet(object):
         remainder = 0
 
         for rule in rules:
+            # The intermediate weight might be negative, so it must not be
+            # assigned before limiting it.
             if rule.used:
-                rule.weight += adjustment
+                weight = rule.weight + adjustment
             else:
-                rule.weight += compensation
-
-            if rule.weight < minweight:
-                remainder += rule.weight - minweight
-                rule.weight = minweight
-            elif rule.weight > maxweight:
-                remainder += rule.weight - maxweight
-                rule.weight = maxweight
+                weight = rule.weight + compensation
+
+            if weight < minweight:
+                remainder += weight - minweight
+                weight = minweight
+            elif weight > maxweight:
+                remainder += weight - maxweight
+                weight = maxweight
+            rule.weight = weight
             totweight += rule.weight
 
         self._weight = totweight
@@ -457,20 +494,26 @@ class LearnSystem(object):
         buflen = 0
         rules = self._ruleset.rules
 
+        if not weights > 0 or len(rules) == 0:
+            return ""
+
         for i in range(maxrules):
             tries = 0
             while tries < maxtries:
-                j = 0
                 selected = -1
                 wsum = 0
                 fraction = uniform(0, weights)
-                while selected == -1:
+                # Walk over the rules at most once, since rounding errors
+                # may leave the sum of the weights below the fraction.
+                for j in range(len(rules)):
                     wsum += rules[j].weight
                     if wsum > fraction:
                         selected = j
                         break
-                    else:
-                        j += 1
+                if selected == -1:
+                    selected = len(rules) - 1
+                    while selected > 0 and not rules[selected].weight > 0:
+                        selected -= 1
 
                 # Here we differ from Spronck's algorithm, which
                 # adds a lineadded = ... check. Instead we use
@@ -490,3 +533,16 @@ class LearnSystem(object):
                 tries += 1
                 break
         return buf.getvalue()
+
+
+# The native C++ implementation of Rule, RuleSet and LearnSystem, if the
+# optional extension was built. Otherwise the pure Python classes are used.
+# CRuleWeights has no pure Python counterpart and is None in that case.
+try:
+    from dynrules._dynrules import Rule as CRule, RuleSet as CRuleSet, \
+         LearnSystem as CLearnSystem, RuleWeights as CRuleWeights
+except ImportError:
+    CRule = Rule
+    CRuleSet = RuleSet
+    CLearnSystem = LearnSystem
+    CRuleWeights = None
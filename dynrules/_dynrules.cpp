@@ -0,0 +1,1895 @@
+/*
+ * dynrules - Python dynamic rules engine
+ *
+ * Authors: Marcus von Appen
+ *
+ * This file is distributed under the Public Domain.
+ */
+
+/*
+ * Native Rule, RuleSet, RuleWeights and LearnSystem types for the dynrules
+ * package, which wrap the C++ framework in cplusplus/src.
+ */
+
+#include <Python.h>
+#include <structmember.h>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "Rule.h"
+#include "RuleSet.h"
+#include "RuleWeights.h"
+#include "SparseRuleWeights.h"
+#include "LearnSystem.h"
+
+#if PY_MAJOR_VERSION >= 3
+#define IS_PYTHON_3
+#define Int_Check(x) PyLong_Check(x)
+#define Text_Check(x) PyUnicode_Check(x)
+#define Text_FromStringAndSize(x,y) PyUnicode_FromStringAndSize(x,y)
+#define Bytes_Check(x) PyBytes_Check(x)
+#define Bytes_AS_STRING(x) PyBytes_AS_STRING(x)
+#define Bytes_GET_SIZE(x) PyBytes_GET_SIZE(x)
+#else
+#define Int_Check(x) (PyInt_Check(x) || PyLong_Check(x))
+#define Text_Check(x) (PyString_Check(x) || PyUnicode_Check(x))
+#define Text_FromStringAndSize(x,y) PyString_FromStringAndSize(x,y)
+#define Bytes_Check(x) PyString_Check(x)
+#define Bytes_AS_STRING(x) PyString_AS_STRING(x)
+#define Bytes_GET_SIZE(x) PyString_GET_SIZE(x)
+#endif
+
+/*
+ * Thrown by the C++ callbacks, if the invoked Python code raised an
+ * exception. The Python error indicator is left set.
+ */
+struct _PythonError
+{
+};
+
+/*
+ * The kind of a C++ exception, which was caught while the GIL was
+ * released.
+ */
+enum
+{
+    _ERROR_NONE,
+    _ERROR_PYTHON,
+    _ERROR_MEMORY,
+    _ERROR_VALUE,
+    _ERROR_INDEX,
+    _ERROR_RUNTIME
+};
+
+/*
+ * A C++ exception caught while the GIL was released. The message is
+ * copied into a fixed buffer, so that catching it does not allocate.
+ */
+typedef struct
+{
+    int kind;
+    char message[256];
+} _CaughtError;
+
+/*
+ * Stores the exception currently being handled. Must be called from
+ * within a catch block. The GIL does not need to be held.
+ */
+static void
+_catch_error (_CaughtError *error)
+{
+    const char *message = "unknown C++ exception";
+
+    try
+    {
+        throw;
+    }
+    catch (_PythonError&)
+    {
+        error->kind = _ERROR_PYTHON;
+        return;
+    }
+    catch (std::bad_alloc&)
+    {
+        error->kind = _ERROR_MEMORY;
+        return;
+    }
+    catch (std::invalid_argument& e)
+    {
+        error->kind = _ERROR_VALUE;
+        message = e.what ();
+    }
+    catch (std::domain_error& e)
+    {
+        error->kind = _ERROR_VALUE;
+        message = e.what ();
+    }
+    catch (std::out_of_range& e)
+    {
+        error->kind = _ERROR_INDEX;
+        message = e.what ();
+    }
+    catch (std::exception& e)
+    {
+        error->kind = _ERROR_RUNTIME;
+        message = e.what ();
+    }
+    catch (...)
+    {
+        error->kind = _ERROR_RUNTIME;
+    }
+    strncpy (error->message, message, sizeof (error->message) - 1);
+    error->message[sizeof (error->message) - 1] = '\0';
+}
+
+/*
+ * Raises the Python exception for an error caught by _catch_error(). The
+ * GIL must be held. Returns 1, if an exception was raised, 0 otherwise.
+ */
+static int
+_raise_error (const _CaughtError *error)
+{
+    switch (error->kind)
+    {
+    case _ERROR_NONE:
+        return 0;
+    case _ERROR_PYTHON:
+        /* The Python error indicator is already set. */
+        break;
+    case _ERROR_MEMORY:
+        PyErr_NoMemory ();
+        break;
+    case _ERROR_VALUE:
+        PyErr_SetString (PyExc_ValueError, error->message);
+        break;
+    case _ERROR_INDEX:
+        PyErr_SetString (PyExc_IndexError, error->message);
+        break;
+    default:
+        PyErr_SetString (PyExc_RuntimeError, error->message);
+        break;
+    }
+    return 1;
+}
+
+/*
+ * RuleSet implementation, which calls the calculate_adjustment() and
+ * distribute_remainder() methods of its Python object.
+ */
+class _PyRuleSetImpl : public dynrules::RuleSet
+{
+public:
+    _PyRuleSetImpl (PyObject *self) : RuleSet (0, 0), _self(self)
+    {
+    }
+
+    double calculateAdjustment (void *fitness)
+    {
+        PyGILState_STATE state = PyGILState_Ensure ();
+        PyObject *result;
+        double adjustment = -1;
+
+        result = PyObject_CallMethod (this->_self,
+            (char*) "calculate_adjustment", (char*) "(O)", (PyObject*) fitness);
+        if (result)
+        {
+            adjustment = PyFloat_AsDouble (result);
+            Py_DECREF (result);
+        }
+        if (!result || (adjustment == -1 && PyErr_Occurred ()))
+        {
+            PyGILState_Release (state);
+            throw _PythonError ();
+        }
+        PyGILState_Release (state);
+        return adjustment;
+    }
+
+    void distributeRemainder (double remainder)
+    {
+        PyGILState_STATE state = PyGILState_Ensure ();
+        PyObject *result;
+
+        result = PyObject_CallMethod (this->_self,
+            (char*) "distribute_remainder", (char*) "(d)", remainder);
+        if (!result)
+        {
+            PyGILState_Release (state);
+            throw _PythonError ();
+        }
+        Py_DECREF (result);
+        PyGILState_Release (state);
+    }
+
+private:
+    /* Borrowed, the Python object owns the _PyRuleSetImpl. */
+    PyObject *_self;
+
+    _PyRuleSetImpl (const _PyRuleSetImpl&);
+    _PyRuleSetImpl& operator= (const _PyRuleSetImpl&);
+};
+
+/*
+ * LearnSystem implementation, which does not delete its RuleSet, since
+ * it is owned by the Python RuleSet object.
+ */
+class _PyLearnSystemImpl : public dynrules::LearnSystem
+{
+public:
+    _PyLearnSystemImpl (dynrules::RuleSet *ruleset) : LearnSystem (ruleset)
+    {
+    }
+
+    ~_PyLearnSystemImpl ()
+    {
+        this->_ruleset = 0;
+    }
+};
+
+typedef struct
+{
+    PyObject_HEAD
+    dynrules::Rule *rule;
+    PyObject *id;
+    PyObject *code;
+    PyObject *dict;
+} PyRule;
+
+typedef struct
+{
+    PyObject_HEAD
+    _PyRuleSetImpl *ruleset;
+    PyObject *rules;
+    PyObject *dict;
+    int busy;
+} PyRuleSet;
+
+typedef struct
+{
+    PyObject_HEAD
+    dynrules::WeightOverlay *weights;
+    const char *format;
+    PyObject *ruleset;
+    PyObject *dict;
+    Py_ssize_t exports;
+    int busy;
+} PyRuleWeights;
+
+/*
+ * Exports the weights or usage states of a PyRuleWeights via the buffer
+ * protocol.
+ */
+typedef struct
+{
+    PyObject_HEAD
+    PyRuleWeights *owner;
+    int used;
+    Py_ssize_t shape[1];
+    Py_ssize_t strides[1];
+} PyWeightView;
+
+typedef struct
+{
+    PyObject_HEAD
+    _PyLearnSystemImpl *lsystem;
+    PyObject *ruleset;
+    PyObject *dict;
+} PyLearnSystem;
+
+static PyTypeObject PyRule_Type;
+static PyTypeObject PyRuleSet_Type;
+static PyTypeObject PyRuleWeights_Type;
+static PyTypeObject PyWeightView_Type;
+static PyTypeObject PyLearnSystem_Type;
+
+#define PyRule_Check(x) (PyObject_TypeCheck(x, &PyRule_Type))
+#define PyRuleSet_Check(x) (PyObject_TypeCheck(x, &PyRuleSet_Type))
+
+/*
+ * Fails with a RuntimeError, if the RuleSet is processed on behalf of
+ * another thread.
+ */
+static int
+_ruleset_check_busy (PyRuleSet *self)
+{
+    if (self->busy)
+    {
+        PyErr_SetString (PyExc_RuntimeError,
+            "RuleSet is in use by update_weights() or create_rules()");
+        return 1;
+    }
+    return 0;
+}
+
+/*
+ * Copies the weights of a buffer of doubles or a sequence of numbers into
+ * weights.
+ */
+static int
+_get_weights (PyObject *obj, std::vector<double>& weights)
+{
+    PyObject *seq, *item;
+    Py_ssize_t i, count;
+    Py_buffer view;
+
+    if (PyObject_CheckBuffer (obj) &&
+        PyObject_GetBuffer (obj, &view, PyBUF_FORMAT | PyBUF_C_CONTIGUOUS) == 0)
+    {
+        if (view.itemsize == sizeof (double) && view.format &&
+            (strcmp (view.format, "d") == 0 || strcmp (view.format, "@d") == 0))
+        {
+            const double *buf = (const double*) view.buf;
+            weights.assign (buf, buf + view.len / view.itemsize);
+            PyBuffer_Release (&view);
+            return 1;
+        }
+        PyBuffer_Release (&view);
+    }
+    PyErr_Clear ();
+
+    seq = PySequence_Fast (obj, "weights must be a sequence of numbers");
+    if (!seq)
+        return 0;
+    count = PySequence_Fast_GET_SIZE (seq);
+    weights.resize ((size_t) count);
+    for (i = 0; i < count; i++)
+    {
+        item = PyNumber_Float (PySequence_Fast_GET_ITEM (seq, i));
+        if (!item)
+        {
+            Py_DECREF (seq);
+            return 0;
+        }
+        weights[(size_t) i] = PyFloat_AS_DOUBLE (item);
+        Py_DECREF (item);
+    }
+    Py_DECREF (seq);
+    return 1;
+}
+
+/* Rule */
+static PyObject*
+_rule_new (PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyRule *self = (PyRule*) type->tp_alloc (type, 0);
+    if (!self)
+        return NULL;
+
+    try
+    {
+        self->rule = new dynrules::Rule (0);
+    }
+    catch (std::bad_alloc&)
+    {
+        Py_DECREF (self);
+        return PyErr_NoMemory ();
+    }
+    Py_INCREF (Py_None);
+    self->id = Py_None;
+    Py_INCREF (Py_None);
+    self->code = Py_None;
+    self->dict = NULL;
+    return (PyObject*) self;
+}
+
+static int
+_rule_init (PyRule *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { (char*) "rid", NULL };
+    PyObject *rid, *tmp;
+    long id;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwds, "O", kwlist, &rid))
+        return -1;
+
+    /* The C++ Rule only carries integer ids, others are mapped to -1. */
+    id = Int_Check (rid) ? PyLong_AsLong (rid) : -1;
+    if (id == -1 && PyErr_Occurred ())
+        PyErr_Clear ();
+    self->rule->setId ((int) id);
+
+    tmp = self->id;
+    Py_INCREF (rid);
+    self->id = rid;
+    Py_XDECREF (tmp);
+    return 0;
+}
+
+static int
+_rule_traverse (PyRule *self, visitproc visit, void *arg)
+{
+    Py_VISIT (self->id);
+    Py_VISIT (self->code);
+    Py_VISIT (self->dict);
+    return 0;
+}
+
+static int
+_rule_clear (PyRule *self)
+{
+    Py_CLEAR (self->id);
+    Py_CLEAR (self->code);
+    Py_CLEAR (self->dict);
+    return 0;
+}
+
+static void
+_rule_dealloc (PyRule *self)
+{
+    PyObject_GC_UnTrack (self);
+    _rule_clear (self);
+    delete self->rule;
+    Py_TYPE (self)->tp_free ((PyObject*) self);
+}
+
+static PyObject*
+_rule_getid (PyRule *self, void *closure)
+{
+    Py_INCREF (self->id);
+    return self->id;
+}
+
+static PyObject*
+_rule_getweight (PyRule *self, void *closure)
+{
+    return PyFloat_FromDouble (self->rule->getWeight ());
+}
+
+static int
+_rule_setweight (PyRule *self, PyObject *value, void *closure)
+{
+    PyObject *val;
+    double weight;
+
+    if (!value)
+    {
+        PyErr_SetString (PyExc_AttributeError, "cannot delete weight");
+        return -1;
+    }
+    val = PyNumber_Float (value);
+    if (!val)
+        return -1;
+    weight = PyFloat_AS_DOUBLE (val);
+    Py_DECREF (val);
+    if (weight < 0)
+    {
+        PyErr_SetString (PyExc_ValueError, "weight must not be negative");
+        return -1;
+    }
+    self->rule->setWeight (weight);
+    return 0;
+}
+
+static PyObject*
+_rule_getused (PyRule *self, void *closure)
+{
+    return PyBool_FromLong (self->rule->getUsed ());
+}
+
+static int
+_rule_setused (PyRule *self, PyObject *value, void *closure)
+{
+    int used;
+
+    if (!value)
+    {
+        PyErr_SetString (PyExc_AttributeError, "cannot delete used");
+        return -1;
+    }
+    used = PyObject_IsTrue (value);
+    if (used == -1)
+        return -1;
+    self->rule->setUsed (used != 0);
+    return 0;
+}
+
+static PyObject*
+_rule_getcode (PyRule *self, void *closure)
+{
+    Py_INCREF (self->code);
+    return self->code;
+}
+
+static int
+_rule_setcode (PyRule *self, PyObject *value, void *closure)
+{
+    PyObject *tmp, *bytes = NULL;
+    std::string code;
+
+    if (!value)
+        value = Py_None;
+
+    /*
+     * The object is kept as it is. The C++ Rule receives the raw data of
+     * byte strings and buffers and the UTF-8 representation of text.
+     */
+    if (PyUnicode_Check (value))
+    {
+        bytes = PyUnicode_AsUTF8String (value);
+        if (!bytes)
+            return -1;
+        code.assign (Bytes_AS_STRING (bytes), Bytes_GET_SIZE (bytes));
+        Py_DECREF (bytes);
+    }
+    else if (Bytes_Check (value))
+        code.assign (Bytes_AS_STRING (value), Bytes_GET_SIZE (value));
+    else if (PyObject_CheckBuffer (value))
+    {
+        Py_buffer view;
+        if (PyObject_GetBuffer (value, &view, PyBUF_SIMPLE) == -1)
+            return -1;
+        code.assign ((const char*) view.buf, (size_t) view.len);
+        PyBuffer_Release (&view);
+    }
+    else if (value != Py_None)
+    {
+        PyErr_SetString (PyExc_TypeError,
+            "code must be a string, buffer or None");
+        return -1;
+    }
+
+    try
+    {
+        self->rule->setCode (code);
+    }
+    catch (std::bad_alloc&)
+    {
+        PyErr_NoMemory ();
+        return -1;
+    }
+    tmp = self->code;
+    Py_INCREF (value);
+    self->code = value;
+    Py_XDECREF (tmp);
+    return 0;
+}
+
+static PyGetSetDef _rule_getsets[] = {
+    { (char*) "id", (getter) _rule_getid, NULL,
+      (char*) "Gets the id of the Rule.", NULL },
+    { (char*) "weight", (getter) _rule_getweight, (setter) _rule_setweight,
+      (char*) "Gets or sets the weight of the Rule.", NULL },
+    { (char*) "used", (getter) _rule_getused, (setter) _rule_setused,
+      (char*) "Indicates whether the Rule was used or not.", NULL },
+    { (char*) "code", (getter) _rule_getcode, (setter) _rule_setcode,
+      (char*) "Gets or sets the code of the Rule.", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+/* RuleSet */
+static PyObject*
+_ruleset_new (PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyRuleSet *self = (PyRuleSet*) type->tp_alloc (type, 0);
+    if (!self)
+        return NULL;
+
+    self->ruleset = NULL;
+    self->dict = NULL;
+    self->busy = 0;
+    self->rules = PyDict_New ();
+    if (!self->rules)
+    {
+        Py_DECREF (self);
+        return NULL;
+    }
+    try
+    {
+        self->ruleset = new _PyRuleSetImpl ((PyObject*) self);
+    }
+    catch (std::bad_alloc&)
+    {
+        Py_DECREF (self);
+        return PyErr_NoMemory ();
+    }
+    return (PyObject*) self;
+}
+
+static int
+_ruleset_setmaxweight (PyRuleSet *self, PyObject *value, void *closure);
+static int
+_ruleset_setminweight (PyRuleSet *self, PyObject *value, void *closure);
+
+static int
+_ruleset_init (PyRuleSet *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { (char*) "minweight", (char*) "maxweight", NULL };
+    PyObject *minweight, *maxweight;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwds, "OO", kwlist, &minweight,
+        &maxweight))
+        return -1;
+    if (_ruleset_setmaxweight (self, maxweight, NULL) == -1)
+        return -1;
+    if (_ruleset_setminweight (self, minweight, NULL) == -1)
+        return -1;
+    return 0;
+}
+
+static int
+_ruleset_traverse (PyRuleSet *self, visitproc visit, void *arg)
+{
+    Py_VISIT (self->rules);
+    Py_VISIT (self->dict);
+    return 0;
+}
+
+static int
+_ruleset_clear (PyRuleSet *self)
+{
+    if (self->ruleset)
+        self->ruleset->clear ();
+    Py_CLEAR (self->rules);
+    Py_CLEAR (self->dict);
+    return 0;
+}
+
+static void
+_ruleset_dealloc (PyRuleSet *self)
+{
+    PyObject_GC_UnTrack (self);
+    /* Clear the C++ RuleSet first, it must not delete the Rule objects. */
+    _ruleset_clear (self);
+    delete self->ruleset;
+    Py_TYPE (self)->tp_free ((PyObject*) self);
+}
+
+static PyObject*
+_ruleset_getrules (PyRuleSet *self, void *closure)
+{
+    return PyDict_Values (self->rules);
+}
+
+static PyObject*
+_ruleset_getweight (PyRuleSet *self, void *closure)
+{
+    return PyFloat_FromDouble (self->ruleset->getWeight ());
+}
+
+static PyObject*
+_ruleset_getminweight (PyRuleSet *self, void *closure)
+{
+    return PyFloat_FromDouble (self->ruleset->getMinWeight ());
+}
+
+static int
+_ruleset_setminweight (PyRuleSet *self, PyObject *value, void *closure)
+{
+    PyObject *val;
+    double minweight;
+
+    if (!value)
+    {
+        PyErr_SetString (PyExc_AttributeError, "cannot delete minweight");
+        return -1;
+    }
+    if (_ruleset_check_busy (self))
+        return -1;
+    val = PyNumber_Float (value);
+    if (!val)
+        return -1;
+    minweight = PyFloat_AS_DOUBLE (val);
+    Py_DECREF (val);
+    if (minweight < 0)
+    {
+        PyErr_SetString (PyExc_ValueError, "minweight must not be negative");
+        return -1;
+    }
+    if (minweight > self->ruleset->getMaxWeight ())
+    {
+        PyErr_SetString (PyExc_ValueError,
+            "minweight must be smaller or equal to the set maxweight");
+        return -1;
+    }
+    self->ruleset->setMinWeight (minweight);
+    return 0;
+}
+
+static PyObject*
+_ruleset_getmaxweight (PyRuleSet *self, void *closure)
+{
+    return PyFloat_FromDouble (self->ruleset->getMaxWeight ());
+}
+
+static int
+_ruleset_setmaxweight (PyRuleSet *self, PyObject *value, void *closure)
+{
+    PyObject *val;
+    double maxweight;
+
+    if (!value)
+    {
+        PyErr_SetString (PyExc_AttributeError, "cannot delete maxweight");
+        return -1;
+    }
+    if (_ruleset_check_busy (self))
+        return -1;
+    val = PyNumber_Float (value);
+    if (!val)
+        return -1;
+    maxweight = PyFloat_AS_DOUBLE (val);
+    Py_DECREF (val);
+    if (maxweight < 0)
+    {
+        PyErr_SetString (PyExc_ValueError, "maxweight must not be negative");
+        return -1;
+    }
+    if (maxweight < self->ruleset->getMinWeight ())
+    {
+        PyErr_SetString (PyExc_ValueError,
+            "maxweight must be smaller or equal to the set minweight");
+        return -1;
+    }
+    self->ruleset->setMaxWeight (maxweight);
+    return 0;
+}
+
+static PyObject*
+_ruleset_clearrules (PyRuleSet *self)
+{
+    if (_ruleset_check_busy (self))
+        return NULL;
+    PyDict_Clear (self->rules);
+    self->ruleset->clear ();
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_ruleset_add (PyRuleSet *self, PyObject *args)
+{
+    PyObject *rule, *values;
+    PyRule *prule;
+    Py_ssize_t i, count;
+    int replace;
+
+    if (!PyArg_ParseTuple (args, "O:add", &rule))
+        return NULL;
+    if (!PyRule_Check (rule))
+    {
+        PyErr_SetString (PyExc_TypeError, "rule must be a Rule");
+        return NULL;
+    }
+    if (_ruleset_check_busy (self))
+        return NULL;
+
+    prule = (PyRule*) rule;
+    replace = PyDict_Contains (self->rules, prule->id);
+    if (replace == -1 || PyDict_SetItem (self->rules, prule->id, rule) == -1)
+        return NULL;
+
+    try
+    {
+        if (!replace)
+        {
+            self->ruleset->addRule (prule->rule);
+            Py_RETURN_NONE;
+        }
+
+        /*
+         * A Rule with the same id replaces the existing one at its
+         * position, so the C++ RuleSet has to be rebuilt in the same
+         * order.
+         */
+        values = PyDict_Values (self->rules);
+        if (!values)
+            return NULL;
+        self->ruleset->clear ();
+        count = PyList_GET_SIZE (values);
+        for (i = 0; i < count; i++)
+        {
+            self->ruleset->addRule
+                (((PyRule*) PyList_GET_ITEM (values, i))->rule);
+        }
+        Py_DECREF (values);
+    }
+    catch (std::bad_alloc&)
+    {
+        return PyErr_NoMemory ();
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_ruleset_find (PyRuleSet *self, PyObject *args)
+{
+    PyObject *rid, *rule;
+
+    if (!PyArg_ParseTuple (args, "O:find", &rid))
+        return NULL;
+    rule = PyDict_GetItem (self->rules, rid);
+    if (!rule)
+    {
+        if (PyErr_Occurred ())
+            return NULL;
+        Py_RETURN_NONE;
+    }
+    Py_INCREF (rule);
+    return rule;
+}
+
+static PyObject*
+_ruleset_remove (PyRuleSet *self, PyObject *args)
+{
+    PyObject *rule, *existing;
+
+    if (!PyArg_ParseTuple (args, "O:remove", &rule))
+        return NULL;
+    if (!PyRule_Check (rule))
+    {
+        PyErr_SetString (PyExc_TypeError, "rule must be a Rule");
+        return NULL;
+    }
+    if (_ruleset_check_busy (self))
+        return NULL;
+
+    existing = PyDict_GetItem (self->rules, ((PyRule*) rule)->id);
+    if (!existing)
+    {
+        if (!PyErr_Occurred ())
+            PyErr_SetString (PyExc_ValueError, "rule does not exist");
+        return NULL;
+    }
+    if (existing != rule)
+    {
+        PyErr_SetString (PyExc_ValueError,
+            "rule does not match rule in RuleSet");
+        return NULL;
+    }
+
+    self->ruleset->removeRule (((PyRule*) rule)->rule);
+    if (PyDict_DelItem (self->rules, ((PyRule*) rule)->id) == -1)
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_ruleset_calculateadjustment (PyRuleSet *self, PyObject *args)
+{
+    PyErr_SetString (PyExc_NotImplementedError, "method not implemented");
+    return NULL;
+}
+
+static PyObject*
+_ruleset_distributeremainder (PyRuleSet *self, PyObject *args)
+{
+    PyErr_SetString (PyExc_NotImplementedError, "method not implemented");
+    return NULL;
+}
+
+static PyObject*
+_ruleset_updateweights (PyRuleSet *self, PyObject *args)
+{
+    PyObject *fitness;
+    _CaughtError error = { _ERROR_NONE, "" };
+
+    if (!PyArg_ParseTuple (args, "O:update_weights", &fitness))
+        return NULL;
+    if (_ruleset_check_busy (self))
+        return NULL;
+
+    /*
+     * The weights are updated without holding the GIL. It is reacquired
+     * for the calculate_adjustment() and distribute_remainder() calls.
+     */
+    Py_INCREF (self);
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS;
+    try
+    {
+        self->ruleset->updateWeights ((void*) fitness);
+    }
+    catch (...)
+    {
+        _catch_error (&error);
+    }
+    Py_END_ALLOW_THREADS;
+    self->busy = 0;
+    Py_DECREF (self);
+
+    if (_raise_error (&error))
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_ruleset_getweights (PyRuleSet *self)
+{
+    PyObject *list, *item;
+    size_t i, count = self->ruleset->getCount ();
+
+    list = PyList_New ((Py_ssize_t) count);
+    if (!list)
+        return NULL;
+    for (i = 0; i < count; i++)
+    {
+        item = PyFloat_FromDouble (self->ruleset->getRule (i)->getWeight ());
+        if (!item)
+        {
+            Py_DECREF (list);
+            return NULL;
+        }
+        PyList_SET_ITEM (list, (Py_ssize_t) i, item);
+    }
+    return list;
+}
+
+static PyObject*
+_ruleset_setweights (PyRuleSet *self, PyObject *args)
+{
+    PyObject *obj;
+    std::vector<double> weights;
+
+    if (!PyArg_ParseTuple (args, "O:set_weights", &obj))
+        return NULL;
+    if (_ruleset_check_busy (self))
+        return NULL;
+    try
+    {
+        if (!_get_weights (obj, weights))
+            return NULL;
+    }
+    catch (std::bad_alloc&)
+    {
+        return PyErr_NoMemory ();
+    }
+    if (weights.size () != self->ruleset->getCount ())
+    {
+        PyErr_SetString (PyExc_ValueError,
+            "amount of weights must match the amount of rules");
+        return NULL;
+    }
+    if (!weights.empty ())
+        self->ruleset->setWeights (&weights[0], weights.size ());
+    Py_RETURN_NONE;
+}
+
+static PyGetSetDef _ruleset_getsets[] = {
+    { (char*) "rules", (getter) _ruleset_getrules, NULL,
+      (char*) "Gets the list of currently managed Rule objects.", NULL },
+    { (char*) "weight", (getter) _ruleset_getweight, NULL,
+      (char*) "Gets the total weight of all managed Rules.", NULL },
+    { (char*) "minweight", (getter) _ruleset_getminweight,
+      (setter) _ruleset_setminweight,
+      (char*) "Gets or sets the minimum weight to use for rules.", NULL },
+    { (char*) "maxweight", (getter) _ruleset_getmaxweight,
+      (setter) _ruleset_setmaxweight,
+      (char*) "Gets or sets the maximum weight to use for rules.", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyMethodDef _ruleset_methods[] = {
+    { "clear", (PyCFunction) _ruleset_clearrules, METH_NOARGS,
+      "Removes all rules from the RuleSet." },
+    { "add", (PyCFunction) _ruleset_add, METH_VARARGS,
+      "Adds a Rule to the RuleSet." },
+    { "find", (PyCFunction) _ruleset_find, METH_VARARGS,
+      "Tries to find the Rule with the matching id and returns it." },
+    { "remove", (PyCFunction) _ruleset_remove, METH_VARARGS,
+      "Removes a Rule from the RuleSet." },
+    { "calculate_adjustment", (PyCFunction) _ruleset_calculateadjustment,
+      METH_VARARGS,
+      "Calculates the reward or penalty for the active rules." },
+    { "distribute_remainder", (PyCFunction) _ruleset_distributeremainder,
+      METH_VARARGS,
+      "Distributes the remainder of the weight differences." },
+    { "update_weights", (PyCFunction) _ruleset_updateweights, METH_VARARGS,
+      "Updates the weights of all contained rules." },
+    { "get_weights", (PyCFunction) _ruleset_getweights, METH_NOARGS,
+      "Gets the weights of all managed Rules as list." },
+    { "set_weights", (PyCFunction) _ruleset_setweights, METH_VARARGS,
+      "Sets the weights of all managed Rules at once." },
+    { NULL, NULL, 0, NULL }
+};
+
+/* WeightView */
+/* Gets the stored weights or usage states of a BasicRuleWeights. */
+template <typename Weights>
+static void*
+_weightview_getdata (dynrules::WeightOverlay *overlay, int used,
+    Py_ssize_t *itemsize)
+{
+    Weights *weights = static_cast<Weights*> (overlay);
+
+    if (used)
+    {
+        *itemsize = 1;
+        return (void*) weights->getUsedData ();
+    }
+    *itemsize = sizeof (typename Weights::value_type);
+    return (void*) weights->getData ();
+}
+
+static int
+_weightview_getbuffer (PyWeightView *self, Py_buffer *view, int flags)
+{
+    static double empty = 0;
+    dynrules::WeightOverlay *weights = self->owner->weights;
+    const char *format = self->owner->format;
+    void *buf;
+    int readonly;
+
+    if (format[0] == 'f')
+        buf = _weightview_getdata<dynrules::FloatRuleWeights> (weights,
+            self->used, &view->itemsize);
+    else if (format[0] == 'H')
+        buf = _weightview_getdata<dynrules::FixedRuleWeights> (weights,
+            self->used, &view->itemsize);
+    else
+        buf = _weightview_getdata<dynrules::RuleWeights> (weights,
+            self->used, &view->itemsize);
+    if (self->used)
+    {
+        view->format = (char*) "B";
+        readonly = 0;
+    }
+    else
+    {
+        view->format = (char*) format;
+        readonly = 1;
+    }
+    if ((flags & PyBUF_WRITABLE) && readonly)
+    {
+        PyErr_SetString (PyExc_BufferError, "weights are read-only");
+        view->obj = NULL;
+        return -1;
+    }
+
+    self->shape[0] = (Py_ssize_t) weights->getCount ();
+    self->strides[0] = view->itemsize;
+    view->buf = buf ? buf : (void*) &empty;
+    view->len = self->shape[0] * view->itemsize;
+    view->readonly = readonly;
+    view->ndim = 1;
+    if (!(flags & PyBUF_FORMAT))
+        view->format = NULL;
+    view->shape = (flags & PyBUF_ND) ? self->shape : NULL;
+    view->strides = (flags & PyBUF_STRIDES) ? self->strides : NULL;
+    view->suboffsets = NULL;
+    view->internal = NULL;
+    Py_INCREF (self);
+    view->obj = (PyObject*) self;
+    self->owner->exports++;
+    return 0;
+}
+
+static void
+_weightview_releasebuffer (PyWeightView *self, Py_buffer *view)
+{
+    self->owner->exports--;
+}
+
+static void
+_weightview_dealloc (PyWeightView *self)
+{
+    Py_XDECREF (self->owner);
+    Py_TYPE (self)->tp_free ((PyObject*) self);
+}
+
+static PyBufferProcs _weightview_buffer = {
+#ifndef IS_PYTHON_3
+    NULL, NULL, NULL, NULL,
+#endif
+    (getbufferproc) _weightview_getbuffer,
+    (releasebufferproc) _weightview_releasebuffer
+};
+
+/* Creates a memoryview on the weights or usage states of a RuleWeights. */
+static PyObject*
+_weightview_create (PyRuleWeights *owner, int used)
+{
+    PyWeightView *view;
+    PyObject *mview;
+
+    view = PyObject_New (PyWeightView, &PyWeightView_Type);
+    if (!view)
+        return NULL;
+    Py_INCREF (owner);
+    view->owner = owner;
+    view->used = used;
+    mview = PyMemoryView_FromObject ((PyObject*) view);
+    Py_DECREF (view);
+    return mview;
+}
+
+/* RuleWeights */
+static PyObject*
+_ruleweights_new (PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyRuleWeights *self = (PyRuleWeights*) type->tp_alloc (type, 0);
+    if (!self)
+        return NULL;
+    self->weights = NULL;
+    self->format = "d";
+    self->ruleset = NULL;
+    self->dict = NULL;
+    self->exports = 0;
+    self->busy = 0;
+    return (PyObject*) self;
+}
+
+static int
+_ruleweights_init (PyRuleWeights *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { (char*) "ruleset", (char*) "storage", NULL };
+    PyObject *ruleset, *tmp;
+    const char *storage = "double", *format;
+    dynrules::RuleSet *rules;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwds, "O|s", kwlist, &ruleset,
+            &storage))
+        return -1;
+    if (!PyRuleSet_Check (ruleset))
+    {
+        PyErr_SetString (PyExc_TypeError, "ruleset must be a RuleSet");
+        return -1;
+    }
+    if (strcmp (storage, "double") == 0)
+        format = "d";
+    else if (strcmp (storage, "float") == 0)
+        format = "f";
+    else if (strcmp (storage, "fixed") == 0)
+        format = "H";
+    else if (strcmp (storage, "sparse") == 0)
+        format = NULL;
+    else
+    {
+        PyErr_SetString (PyExc_ValueError,
+            "storage must be 'double', 'float', 'fixed' or 'sparse'");
+        return -1;
+    }
+    if (self->exports > 0)
+    {
+        PyErr_SetString (PyExc_BufferError,
+            "cannot reinitialize RuleWeights with exported buffers");
+        return -1;
+    }
+
+    delete self->weights;
+    self->weights = NULL;
+    rules = ((PyRuleSet*) ruleset)->ruleset;
+    try
+    {
+        if (!format)
+            self->weights = new dynrules::SparseRuleWeights (rules);
+        else if (format[0] == 'f')
+            self->weights = new dynrules::FloatRuleWeights (rules);
+        else if (format[0] == 'H')
+            self->weights = new dynrules::FixedRuleWeights (rules);
+        else
+            self->weights = new dynrules::RuleWeights (rules);
+    }
+    catch (std::bad_alloc&)
+    {
+        PyErr_NoMemory ();
+        return -1;
+    }
+    self->format = format;
+    tmp = self->ruleset;
+    Py_INCREF (ruleset);
+    self->ruleset = ruleset;
+    Py_XDECREF (tmp);
+    return 0;
+}
+
+static int
+_ruleweights_traverse (PyRuleWeights *self, visitproc visit, void *arg)
+{
+    Py_VISIT (self->ruleset);
+    Py_VISIT (self->dict);
+    return 0;
+}
+
+static int
+_ruleweights_clear (PyRuleWeights *self)
+{
+    Py_CLEAR (self->ruleset);
+    Py_CLEAR (self->dict);
+    return 0;
+}
+
+static void
+_ruleweights_dealloc (PyRuleWeights *self)
+{
+    PyObject_GC_UnTrack (self);
+    delete self->weights;
+    _ruleweights_clear (self);
+    Py_TYPE (self)->tp_free ((PyObject*) self);
+}
+
+static int
+_ruleweights_check (PyRuleWeights *self, int resize)
+{
+    if (!self->weights || !self->ruleset)
+    {
+        PyErr_SetString (PyExc_RuntimeError,
+            "RuleWeights was not initialized");
+        return 0;
+    }
+    if (self->busy)
+    {
+        PyErr_SetString (PyExc_RuntimeError,
+            "RuleWeights is in use by update_weights()");
+        return 0;
+    }
+    if (resize && self->exports > 0)
+    {
+        PyErr_SetString (PyExc_BufferError,
+            "cannot reset RuleWeights with exported buffers");
+        return 0;
+    }
+    return 1;
+}
+
+static Py_ssize_t
+_ruleweights_length (PyRuleWeights *self)
+{
+    if (!_ruleweights_check (self, 0))
+        return -1;
+    return (Py_ssize_t) self->weights->getCount ();
+}
+
+static PyObject*
+_ruleweights_getruleset (PyRuleWeights *self, void *closure)
+{
+    if (!_ruleweights_check (self, 0))
+        return NULL;
+    Py_INCREF (self->ruleset);
+    return self->ruleset;
+}
+
+static int
+_ruleweights_setruleset (PyRuleWeights *self, PyObject *value, void *closure)
+{
+    PyObject *tmp;
+
+    if (!_ruleweights_check (self, 1))
+        return -1;
+    if (!value || !PyRuleSet_Check (value))
+    {
+        PyErr_SetString (PyExc_TypeError, "ruleset must be a RuleSet");
+        return -1;
+    }
+    try
+    {
+        self->weights->setRuleSet (((PyRuleSet*) value)->ruleset);
+    }
+    catch (std::bad_alloc&)
+    {
+        PyErr_NoMemory ();
+        return -1;
+    }
+    tmp = self->ruleset;
+    Py_INCREF (value);
+    self->ruleset = value;
+    Py_DECREF (tmp);
+    return 0;
+}
+
+static PyObject*
+_ruleweights_getweight (PyRuleWeights *self, void *closure)
+{
+    if (!_ruleweights_check (self, 0))
+        return NULL;
+    return PyFloat_FromDouble (self->weights->getWeight ());
+}
+
+/* Fails with a BufferError, if the weights are not stored contiguously. */
+static int
+_ruleweights_check_dense (PyRuleWeights *self)
+{
+    if (!self->format)
+    {
+        PyErr_SetString (PyExc_BufferError,
+            "sparse weights can't be exported");
+        return 0;
+    }
+    return 1;
+}
+
+static PyObject*
+_ruleweights_getweights (PyRuleWeights *self, void *closure)
+{
+    if (!_ruleweights_check (self, 0) || !_ruleweights_check_dense (self))
+        return NULL;
+    return _weightview_create (self, 0);
+}
+
+static PyObject*
+_ruleweights_getused (PyRuleWeights *self, void *closure)
+{
+    if (!_ruleweights_check (self, 0) || !_ruleweights_check_dense (self))
+        return NULL;
+    return _weightview_create (self, 1);
+}
+
+static PyObject*
+_ruleweights_item (PyRuleWeights *self, Py_ssize_t index)
+{
+    if (!_ruleweights_check (self, 0))
+        return NULL;
+    if (index < 0 || (size_t) index >= self->weights->getCount ())
+    {
+        PyErr_SetString (PyExc_IndexError, "index out of range");
+        return NULL;
+    }
+    return PyFloat_FromDouble (self->weights->getWeight ((size_t) index));
+}
+
+static PyObject*
+_ruleweights_reset (PyRuleWeights *self)
+{
+    if (!_ruleweights_check (self, 1))
+        return NULL;
+    try
+    {
+        self->weights->reset ();
+    }
+    catch (std::bad_alloc&)
+    {
+        return PyErr_NoMemory ();
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_ruleweights_setweights (PyRuleWeights *self, PyObject *args)
+{
+    PyObject *obj;
+    std::vector<double> weights;
+
+    if (!PyArg_ParseTuple (args, "O:set_weights", &obj))
+        return NULL;
+    if (!_ruleweights_check (self, 0))
+        return NULL;
+    try
+    {
+        if (!_get_weights (obj, weights))
+            return NULL;
+    }
+    catch (std::bad_alloc&)
+    {
+        return PyErr_NoMemory ();
+    }
+    if (weights.size () != self->weights->getCount ())
+    {
+        PyErr_SetString (PyExc_ValueError,
+            "amount of weights must match the amount of rules");
+        return NULL;
+    }
+    if (!weights.empty ())
+        self->weights->setWeights (&weights[0], weights.size ());
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_ruleweights_setused (PyRuleWeights *self, PyObject *args)
+{
+    Py_ssize_t index;
+    PyObject *used = Py_True;
+    int istrue;
+
+    if (!PyArg_ParseTuple (args, "n|O:set_used", &index, &used))
+        return NULL;
+    if (!_ruleweights_check (self, 0))
+        return NULL;
+    if (index < 0 || (size_t) index >= self->weights->getCount ())
+    {
+        PyErr_SetString (PyExc_IndexError, "index out of range");
+        return NULL;
+    }
+    istrue = PyObject_IsTrue (used);
+    if (istrue == -1)
+        return NULL;
+    try
+    {
+        self->weights->setUsed ((size_t) index, istrue == 1);
+    }
+    catch (std::bad_alloc&)
+    {
+        return PyErr_NoMemory ();
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_ruleweights_updateweights (PyRuleWeights *self, PyObject *args)
+{
+    PyObject *fitness;
+    _CaughtError error = { _ERROR_NONE, "" };
+
+    if (!PyArg_ParseTuple (args, "O:update_weights", &fitness))
+        return NULL;
+    if (!_ruleweights_check (self, 0))
+        return NULL;
+
+    Py_INCREF (self);
+    self->busy = 1;
+    Py_BEGIN_ALLOW_THREADS;
+    try
+    {
+        self->weights->updateWeights ((void*) fitness);
+    }
+    catch (...)
+    {
+        _catch_error (&error);
+    }
+    Py_END_ALLOW_THREADS;
+    self->busy = 0;
+    Py_DECREF (self);
+
+    if (_raise_error (&error))
+        return NULL;
+    Py_RETURN_NONE;
+}
+
+static PySequenceMethods _ruleweights_sequence = {
+    (lenfunc) _ruleweights_length, NULL, NULL,
+    (ssizeargfunc) _ruleweights_item, NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+static PyGetSetDef _ruleweights_getsets[] = {
+    { (char*) "ruleset", (getter) _ruleweights_getruleset,
+      (setter) _ruleweights_setruleset,
+      (char*) "Gets or sets the RuleSet used as rule catalog.", NULL },
+    { (char*) "weight", (getter) _ruleweights_getweight, NULL,
+      (char*) "Gets the total weight of all rules.", NULL },
+    { (char*) "weights", (getter) _ruleweights_getweights, NULL,
+      (char*) "Gets a read-only memoryview on the weights.", NULL },
+    { (char*) "used", (getter) _ruleweights_getused, NULL,
+      (char*) "Gets a writable memoryview on the usage states.", NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyMethodDef _ruleweights_methods[] = {
+    { "reset", (PyCFunction) _ruleweights_reset, METH_NOARGS,
+      "Resets the weights to the ones of the RuleSet." },
+    { "set_used", (PyCFunction) _ruleweights_setused, METH_VARARGS,
+      "Sets the usage state of a rule." },
+    { "set_weights", (PyCFunction) _ruleweights_setweights, METH_VARARGS,
+      "Sets the weights of all rules at once." },
+    { "update_weights", (PyCFunction) _ruleweights_updateweights,
+      METH_VARARGS, "Updates the weights of all rules." },
+    { NULL, NULL, 0, NULL }
+};
+
+/* LearnSystem */
+static PyObject*
+_lsystem_new (PyTypeObject *type, PyObject *args, PyObject *kwds)
+{
+    PyLearnSystem *self = (PyLearnSystem*) type->tp_alloc (type, 0);
+    if (!self)
+        return NULL;
+    self->lsystem = NULL;
+    self->ruleset = NULL;
+    self->dict = NULL;
+    return (PyObject*) self;
+}
+
+static int
+_lsystem_init (PyLearnSystem *self, PyObject *args, PyObject *kwds)
+{
+    static char *kwlist[] = { (char*) "ruleset", NULL };
+    PyObject *ruleset, *tmp;
+
+    if (!PyArg_ParseTupleAndKeywords (args, kwds, "O", kwlist, &ruleset))
+        return -1;
+    if (!PyRuleSet_Check (ruleset))
+    {
+        PyErr_SetString (PyExc_TypeError, "ruleset must be a RuleSet");
+        return -1;
+    }
+
+    delete self->lsystem;
+    self->lsystem = NULL;
+    try
+    {
+        self->lsystem = new _PyLearnSystemImpl
+            (((PyRuleSet*) ruleset)->ruleset);
+    }
+    catch (std::bad_alloc&)
+    {
+        PyErr_NoMemory ();
+        return -1;
+    }
+    tmp = self->ruleset;
+    Py_INCREF (ruleset);
+    self->ruleset = ruleset;
+    Py_XDECREF (tmp);
+    return 0;
+}
+
+static int
+_lsystem_traverse (PyLearnSystem *self, visitproc visit, void *arg)
+{
+    Py_VISIT (self->ruleset);
+    Py_VISIT (self->dict);
+    return 0;
+}
+
+static int
+_lsystem_clear (PyLearnSystem *self)
+{
+    Py_CLEAR (self->ruleset);
+    Py_CLEAR (self->dict);
+    return 0;
+}
+
+static void
+_lsystem_dealloc (PyLearnSystem *self)
+{
+    PyObject_GC_UnTrack (self);
+    delete self->lsystem;
+    _lsystem_clear (self);
+    Py_TYPE (self)->tp_free ((PyObject*) self);
+}
+
+static int
+_lsystem_check_init (PyLearnSystem *self)
+{
+    if (!self->lsystem || !self->ruleset)
+    {
+        PyErr_SetString (PyExc_RuntimeError,
+            "LearnSystem was not initialized");
+        return 0;
+    }
+    return 1;
+}
+
+static PyObject*
+_lsystem_getruleset (PyLearnSystem *self, void *closure)
+{
+    if (!_lsystem_check_init (self))
+        return NULL;
+    Py_INCREF (self->ruleset);
+    return self->ruleset;
+}
+
+static int
+_lsystem_setruleset (PyLearnSystem *self, PyObject *value, void *closure)
+{
+    PyObject *tmp;
+
+    if (!_lsystem_check_init (self))
+        return -1;
+    if (!value || !PyRuleSet_Check (value))
+    {
+        PyErr_SetString (PyExc_TypeError, "ruleset must be a RuleSet");
+        return -1;
+    }
+    self->lsystem->setRuleSet (((PyRuleSet*) value)->ruleset);
+    tmp = self->ruleset;
+    Py_INCREF (value);
+    self->ruleset = value;
+    Py_DECREF (tmp);
+    return 0;
+}
+
+static int
+_lsystem_getlimit (PyObject *value, const char *name, unsigned int *limit)
+{
+    long val;
+
+    if (!value)
+    {
+        PyErr_Format (PyExc_AttributeError, "cannot delete %s", name);
+        return 0;
+    }
+    val = PyLong_AsLong (value);
+    if (val == -1 && PyErr_Occurred ())
+        return 0;
+    if (val < 1)
+    {
+        PyErr_Format (PyExc_ValueError, "%s must be > 0", name);
+        return 0;
+    }
+    *limit = (unsigned int) val;
+    return 1;
+}
+
+static PyObject*
+_lsystem_getmaxtries (PyLearnSystem *self, void *closure)
+{
+    if (!_lsystem_check_init (self))
+        return NULL;
+    return PyLong_FromUnsignedLong (self->lsystem->getMaxTries ());
+}
+
+static int
+_lsystem_setmaxtries (PyLearnSystem *self, PyObject *value, void *closure)
+{
+    unsigned int maxtries;
+
+    if (!_lsystem_check_init (self))
+        return -1;
+    if (!_lsystem_getlimit (value, "maxtries", &maxtries))
+        return -1;
+    self->lsystem->setMaxTries (maxtries);
+    return 0;
+}
+
+static PyObject*
+_lsystem_getmaxscriptsize (PyLearnSystem *self, void *closure)
+{
+    if (!_lsystem_check_init (self))
+        return NULL;
+    return PyLong_FromUnsignedLong (self->lsystem->getMaxScriptSize ());
+}
+
+static int
+_lsystem_setmaxscriptsize (PyLearnSystem *self, PyObject *value,
+    void *closure)
+{
+    unsigned int maxscriptsize;
+
+    if (!_lsystem_check_init (self))
+        return -1;
+    if (!_lsystem_getlimit (value, "maxscriptsize", &maxscriptsize))
+        return -1;
+    self->lsystem->setMaxScriptSize (maxscriptsize);
+    return 0;
+}
+
+static PyObject*
+_lsystem_createheader (PyLearnSystem *self)
+{
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_lsystem_createfooter (PyLearnSystem *self)
+{
+    Py_RETURN_NONE;
+}
+
+static PyObject*
+_lsystem_createrules (PyLearnSystem *self, PyObject *args)
+{
+    PyRuleSet *ruleset;
+    std::string rules;
+    long maxrules;
+    _CaughtError error = { _ERROR_NONE, "" };
+
+    if (!PyArg_ParseTuple (args, "l:create_rules", &maxrules))
+        return NULL;
+    if (!_lsystem_check_init (self))
+        return NULL;
+    if (maxrules <= 0)
+    {
+        PyErr_SetString (PyExc_ValueError, "maxrules must be greater than 0");
+        return NULL;
+    }
+    ruleset = (PyRuleSet*) self->ruleset;
+    if (_ruleset_check_busy (ruleset))
+        return NULL;
+
+    Py_INCREF (ruleset);
+    ruleset->busy = 1;
+    Py_BEGIN_ALLOW_THREADS;
+    try
+    {
+        rules = self->lsystem->createRules ((unsigned int) maxrules);
+    }
+    catch (...)
+    {
+        _catch_error (&error);
+    }
+    Py_END_ALLOW_THREADS;
+    ruleset->busy = 0;
+    Py_DECREF (ruleset);
+
+    if (_raise_error (&error))
+        return NULL;
+    return Text_FromStringAndSize (rules.data (), (Py_ssize_t) rules.size ());
+}
+
+static PyObject*
+_lsystem_createscript (PyLearnSystem *self, PyObject *args)
+{
+    static const char *parts[] = { "create_header", NULL, "create_footer" };
+    PyObject *scriptfile, *maxrules, *filep, *io, *part, *result;
+    int i, isopen = 1;
+
+    if (!PyArg_ParseTuple (args, "OO:create_script", &scriptfile, &maxrules))
+        return NULL;
+
+    if (Text_Check (scriptfile))
+    {
+        io = PyImport_ImportModule ("io");
+        if (!io)
+            return NULL;
+        filep = PyObject_CallMethod (io, (char*) "open", (char*) "(Os)",
+            scriptfile, "a");
+        Py_DECREF (io);
+        if (!filep)
+            return NULL;
+        isopen = 0;
+    }
+    else
+    {
+        Py_INCREF (scriptfile);
+        filep = scriptfile;
+    }
+
+    for (i = 0; i < 3; i++)
+    {
+        if (parts[i])
+            part = PyObject_CallMethod ((PyObject*) self, (char*) parts[i],
+                NULL);
+        else
+            part = PyObject_CallMethod ((PyObject*) self,
+                (char*) "create_rules", (char*) "(O)", maxrules);
+        if (!part)
+            goto error;
+        result = PyObject_CallMethod (filep, (char*) "write", (char*) "(O)",
+            part);
+        Py_DECREF (part);
+        if (!result)
+            goto error;
+        Py_DECREF (result);
+    }
+
+    result = PyObject_CallMethod (filep, (char*) "flush", NULL);
+    if (!result)
+        goto error;
+    Py_DECREF (result);
+    if (!isopen)
+    {
+        result = PyObject_CallMethod (filep, (char*) "close", NULL);
+        if (!result)
+            goto error;
+        Py_DECREF (result);
+    }
+    Py_DECREF (filep);
+    Py_RETURN_NONE;
+
+error:
+    if (!isopen)
+    {
+        PyObject *type, *value, *traceback;
+        PyErr_Fetch (&type, &value, &traceback);
+        result = PyObject_CallMethod (filep, (char*) "close", NULL);
+        Py_XDECREF (result);
+        PyErr_Restore (type, value, traceback);
+    }
+    Py_DECREF (filep);
+    return NULL;
+}
+
+static PyGetSetDef _lsystem_getsets[] = {
+    { (char*) "ruleset", (getter) _lsystem_getruleset,
+      (setter) _lsystem_setruleset,
+      (char*) "Gets or sets the RuleSet to use by the LearnSystem.", NULL },
+    { (char*) "maxtries", (getter) _lsystem_getmaxtries,
+      (setter) _lsystem_setmaxtries,
+      (char*) "Gets or sets the maximum amount of tries to insert a script "
+      "rule.", NULL },
+    { (char*) "maxscriptsize", (getter) _lsystem_getmaxscriptsize,
+      (setter) _lsystem_setmaxscriptsize,
+      (char*) "Gets or sets the maximum script size for inserting rules.",
+      NULL },
+    { NULL, NULL, NULL, NULL, NULL }
+};
+
+static PyMethodDef _lsystem_methods[] = {
+    { "create_script", (PyCFunction) _lsystem_createscript, METH_VARARGS,
+      "Creates a script from the available RuleSet." },
+    { "create_header", (PyCFunction) _lsystem_createheader, METH_NOARGS,
+      "Creates the header for the script file." },
+    { "create_footer", (PyCFunction) _lsystem_createfooter, METH_NOARGS,
+      "Creates the footer for the script file." },
+    { "create_rules", (PyCFunction) _lsystem_createrules, METH_VARARGS,
+      "Creates a rule list from the currently active RuleSet." },
+    { NULL, NULL, 0, NULL }
+};
+
+static void
+_init_type (PyTypeObject *type, const char *name, Py_ssize_t size,
+    Py_ssize_t dictoffset, destructor dealloc, traverseproc traverse,
+    inquiry clear, newfunc tp_new, initproc tp_init, PyGetSetDef *getsets,
+    PyMethodDef *methods, const char *doc)
+{
+    type->tp_name = name;
+    type->tp_basicsize = size;
+    type->tp_dealloc = dealloc;
+    type->tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE |
+        Py_TPFLAGS_HAVE_GC;
+    type->tp_doc = doc;
+    type->tp_traverse = traverse;
+    type->tp_clear = clear;
+    type->tp_methods = methods;
+    type->tp_getset = getsets;
+    type->tp_dictoffset = dictoffset;
+    type->tp_init = tp_init;
+    type->tp_new = tp_new;
+}
+
+#ifdef IS_PYTHON_3
+static struct PyModuleDef _module = {
+    PyModuleDef_HEAD_INIT, "_dynrules",
+    "Native Rule, RuleSet, RuleWeights and LearnSystem types.", -1, NULL,
+    NULL, NULL, NULL, NULL
+};
+#define MODINIT_RETURN(x) return x
+PyMODINIT_FUNC PyInit__dynrules (void)
+#else
+#define MODINIT_RETURN(x) return
+PyMODINIT_FUNC init_dynrules (void)
+#endif
+{
+    PyObject *mod;
+
+    _init_type (&PyRule_Type, "dynrules._dynrules.Rule", sizeof (PyRule),
+        offsetof (PyRule, dict), (destructor) _rule_dealloc,
+        (traverseproc) _rule_traverse, (inquiry) _rule_clear, _rule_new,
+        (initproc) _rule_init, _rule_getsets, NULL,
+        "Rule(rid) -> Rule\n\n"
+        "A Rule carries a weight indicator and arbitrary code data for\n"
+        "usage in the dynamic script generation process.");
+    _init_type (&PyRuleSet_Type, "dynrules._dynrules.RuleSet",
+        sizeof (PyRuleSet), offsetof (PyRuleSet, dict),
+        (destructor) _ruleset_dealloc, (traverseproc) _ruleset_traverse,
+        (inquiry) _ruleset_clear, _ruleset_new, (initproc) _ruleset_init,
+        _ruleset_getsets, _ruleset_methods,
+        "RuleSet(minweight, maxweight) -> RuleSet\n\n"
+        "A rule container class that manages rules, their weights and\n"
+        "the weight distribution for the rules.");
+    _init_type (&PyRuleWeights_Type, "dynrules._dynrules.RuleWeights",
+        sizeof (PyRuleWeights), offsetof (PyRuleWeights, dict),
+        (destructor) _ruleweights_dealloc, (traverseproc) _ruleweights_traverse,
+        (inquiry) _ruleweights_clear, _ruleweights_new,
+        (initproc) _ruleweights_init, _ruleweights_getsets,
+        _ruleweights_methods,
+        "RuleWeights(ruleset, storage='double') -> RuleWeights\n\n"
+        "Independent weights on top of a shared RuleSet.");
+    PyRuleWeights_Type.tp_as_sequence = &_ruleweights_sequence;
+
+    PyWeightView_Type.tp_name = "dynrules._dynrules._WeightView";
+    PyWeightView_Type.tp_basicsize = sizeof (PyWeightView);
+    PyWeightView_Type.tp_dealloc = (destructor) _weightview_dealloc;
+    PyWeightView_Type.tp_flags = Py_TPFLAGS_DEFAULT;
+#ifndef IS_PYTHON_3
+    PyWeightView_Type.tp_flags |= Py_TPFLAGS_HAVE_NEWBUFFER;
+#endif
+    PyWeightView_Type.tp_as_buffer = &_weightview_buffer;
+
+    _init_type (&PyLearnSystem_Type, "dynrules._dynrules.LearnSystem",
+        sizeof (PyLearnSystem), offsetof (PyLearnSystem, dict),
+        (destructor) _lsystem_dealloc, (traverseproc) _lsystem_traverse,
+        (inquiry) _lsystem_clear, _lsystem_new, (initproc) _lsystem_init,
+        _lsystem_getsets, _lsystem_methods,
+        "LearnSystem(ruleset) -> LearnSystem\n\n"
+        "Creates new scripts based on a predefined RuleSet.");
+
+    if (PyType_Ready (&PyRule_Type) < 0 ||
+        PyType_Ready (&PyRuleSet_Type) < 0 ||
+        PyType_Ready (&PyRuleWeights_Type) < 0 ||
+        PyType_Ready (&PyWeightView_Type) < 0 ||
+        PyType_Ready (&PyLearnSystem_Type) < 0)
+        MODINIT_RETURN (NULL);
+
+#ifdef IS_PYTHON_3
+    mod = PyModule_Create (&_module);
+#else
+    mod = Py_InitModule3 ("_dynrules", NULL,
+        "Native Rule, RuleSet, RuleWeights and LearnSystem types.");
+#endif
+    if (!mod)
+        MODINIT_RETURN (NULL);
+
+    Py_INCREF (&PyRule_Type);
+    Py_INCREF (&PyRuleSet_Type);
+    Py_INCREF (&PyRuleWeights_Type);
+    Py_INCREF (&PyLearnSystem_Type);
+    if (PyModule_AddObject (mod, "Rule", (PyObject*) &PyRule_Type) < 0 ||
+        PyModule_AddObject (mod, "RuleSet", (PyObject*) &PyRuleSet_Type) < 0 ||
+        PyModule_AddObject (mod, "RuleWeights",
+            (PyObject*) &PyRuleWeights_Type) < 0 ||
+        PyModule_AddObject (mod, "LearnSystem",
+            (PyObject*) &PyLearnSystem_Type) < 0)
+    {
+        Py_DECREF (mod);
+        MODINIT_RETURN (NULL);
+    }
+    MODINIT_RETURN (mod);
+}
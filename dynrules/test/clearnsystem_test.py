@@ -0,0 +1,94 @@
+import os
+import tempfile
+import unittest
+from dynrules import Rule, CRule, CRuleSet, CLearnSystem
+
+
+@unittest.skipIf(CRule is Rule, "C++ extension not available")
+class CLearnSystemTest(unittest.TestCase):
+    def _create_ruleset(self):
+        ruleset = CRuleSet(10, 20)
+        for i in range(10):
+            rule = CRule(i)
+            rule.weight = 15
+            rule.code = "rule%d\n" % i
+            ruleset.add(rule)
+        return ruleset
+
+    def test_create(self):
+        lsystem = CLearnSystem(CRuleSet(10, 20))
+        self.assertTrue(isinstance(lsystem.ruleset, CRuleSet))
+        self.assertEqual(lsystem.maxtries, 100)
+        self.assertEqual(lsystem.maxscriptsize, 1024)
+        self.assertRaises(TypeError, CLearnSystem, None)
+
+    def test_limits(self):
+        lsystem = CLearnSystem(CRuleSet(10, 20))
+
+        def settries(x):
+            lsystem.maxtries = x
+
+        def setsize(x):
+            lsystem.maxscriptsize = x
+        self.assertRaises(ValueError, settries, 0)
+        self.assertRaises(ValueError, setsize, -100)
+        lsystem.maxtries = 10
+        lsystem.maxscriptsize = 10
+        self.assertEqual(lsystem.maxtries, 10)
+        self.assertEqual(lsystem.maxscriptsize, 10)
+
+    def test_ruleset(self):
+        lsystem = CLearnSystem(CRuleSet(10, 20))
+        ruleset = self._create_ruleset()
+        lsystem.ruleset = ruleset
+        self.assertTrue(lsystem.ruleset is ruleset)
+
+        def setr(x):
+            lsystem.ruleset = x
+        self.assertRaises(TypeError, setr, None)
+
+    def test_create_rules(self):
+        lsystem = CLearnSystem(self._create_ruleset())
+        self.assertRaises(ValueError, lsystem.create_rules, 0)
+        rules = lsystem.create_rules(5)
+        self.assertEqual(len(rules.splitlines()), 5)
+        lsystem.maxscriptsize = 12
+        self.assertEqual(len(lsystem.create_rules(5).splitlines()), 2)
+
+    def test_create_rules_outdated_weight(self):
+        ruleset = self._create_ruleset()
+        lsystem = CLearnSystem(ruleset)
+
+        # The total weight of the RuleSet is not updated by the rules.
+        for i in range(9):
+            ruleset.find(i).weight = 0
+        rules = lsystem.create_rules(10).splitlines()
+        self.assertEqual(rules, ["rule9"] * 10)
+        ruleset.find(9).weight = 0
+        rules = lsystem.create_rules(10).splitlines()
+        self.assertEqual(rules, ["rule0"] * 10)
+
+    def test_create_script(self):
+        class MyLearnSystem(CLearnSystem):
+            def create_header(self):
+                return "header\n"
+
+            def create_footer(self):
+                return "footer\n"
+
+        lsystem = MyLearnSystem(self._create_ruleset())
+        fd, fname = tempfile.mkstemp()
+        os.close(fd)
+        try:
+            lsystem.create_script(fname, 3)
+            with open(fname) as fp:
+                lines = fp.read().splitlines()
+        finally:
+            os.remove(fname)
+        self.assertEqual(len(lines), 5)
+        self.assertEqual(lines[0], "header")
+        self.assertEqual(lines[-1], "footer")
+
+
+if __name__ == "__main__":
+    unittest.main()
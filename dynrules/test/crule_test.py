@@ -0,0 +1,58 @@
+import unittest
+from dynrules import Rule, CRule
+
+
+@unittest.skipIf(CRule is Rule, "C++ extension not available")
+class CRuleTest(unittest.TestCase):
+    def test_create(self):
+        rule = CRule(1)
+        self.assertEqual(rule.id, 1)
+        self.assertEqual(rule.weight, 0)
+        self.assertEqual(rule.code, None)
+        self.assertFalse(rule.used)
+        rule = CRule("rule")
+        self.assertEqual(rule.id, "rule")
+
+    def test_weight(self):
+        rule = CRule(1)
+        rule.weight = 100
+        self.assertEqual(rule.weight, 100)
+
+        def setw(x):
+            rule.weight = x
+        self.assertRaises(ValueError, setw, -100)
+        self.assertRaises(ValueError, setw, "hello")
+        self.assertRaises(TypeError, setw, None)
+        self.assertEqual(rule.weight, 100)
+
+    def test_used(self):
+        rule = CRule(1)
+        rule.used = 1
+        self.assertTrue(rule.used)
+        rule.used = 0
+        self.assertFalse(rule.used)
+
+    def test_code(self):
+        rule = CRule(1)
+        rule.code = "Arbitrary string"
+        self.assertEqual(rule.code, "Arbitrary string")
+        rule.code = bytes("Arbitrary string", "ascii")
+        self.assertTrue(isinstance(rule.code, bytes))
+        rule.code = None
+        self.assertEqual(rule.code, None)
+
+        def setc(x):
+            rule.code = x
+        self.assertRaises(TypeError, setc, 10)
+
+    def test_subclass(self):
+        class MyRule(CRule):
+            pass
+        rule = MyRule(5)
+        rule.extra = "value"
+        self.assertEqual(rule.id, 5)
+        self.assertEqual(rule.extra, "value")
+
+
+if __name__ == "__main__":
+    unittest.main()
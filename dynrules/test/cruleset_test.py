@@ -0,0 +1,172 @@
+import threading
+import unittest
+from dynrules import Rule, CRule, CRuleSet
+
+
+@unittest.skipIf(CRule is Rule, "C++ extension not available")
+class CRuleSetTest(unittest.TestCase):
+    def test_create(self):
+        ruleset = CRuleSet(0, 20)
+        self.assertEqual(ruleset.minweight, 0)
+        self.assertEqual(ruleset.maxweight, 20)
+        self.assertEqual(ruleset.weight, 0)
+        self.assertEqual(ruleset.rules, [])
+
+        self.assertRaises(TypeError, CRuleSet, 0, None)
+        self.assertRaises(TypeError, CRuleSet, None, 10)
+        self.assertRaises(ValueError, CRuleSet, "hello", 10)
+        self.assertRaises(ValueError, CRuleSet, 10, "hello")
+        self.assertRaises(ValueError, CRuleSet, 10, 9)
+        self.assertRaises(ValueError, CRuleSet, -33, -34)
+
+    def test_minmaxweight(self):
+        ruleset = CRuleSet(10, 20)
+        ruleset.minweight = 20
+        self.assertEqual(ruleset.minweight, 20)
+        ruleset.minweight = 10
+
+        def setmin(x):
+            ruleset.minweight = x
+
+        def setmax(x):
+            ruleset.maxweight = x
+        self.assertRaises(ValueError, setmin, -1)
+        self.assertRaises(ValueError, setmin, 50)
+        self.assertRaises(ValueError, setmax, 8)
+        self.assertRaises(TypeError, setmax, None)
+
+    def test_rulesadd(self):
+        ruleset = CRuleSet(10, 20)
+        self.assertRaises(TypeError, ruleset.add, None)
+        self.assertRaises(TypeError, ruleset.add, Rule(1))
+
+        ruleset.add(CRule(1))
+        ruleset.add(CRule(1))
+        ruleset.add(CRule(1))
+        self.assertEqual(len(ruleset.rules), 1)
+        self.assertEqual(ruleset.weight, 10)
+
+        rule = CRule(2)
+        rule.weight = 100
+        ruleset.add(rule)
+        ruleset.add(CRule(3))
+        self.assertEqual(len(ruleset.rules), 3)
+        self.assertEqual(rule.weight, 20)
+        self.assertEqual(ruleset.weight, 40)
+
+        rule = CRule(2)
+        ruleset.add(rule)
+        self.assertEqual([r.id for r in ruleset.rules], [1, 2, 3])
+        self.assertTrue(ruleset.find(2) is rule)
+        self.assertEqual(ruleset.find(4), None)
+        self.assertEqual(ruleset.weight, 30)
+
+        ruleset.clear()
+        self.assertEqual(len(ruleset.rules), 0)
+        self.assertEqual(ruleset.weight, 0)
+
+    def test_rulesremove(self):
+        ruleset = CRuleSet(10, 20)
+        for i in range(10):
+            rule = CRule(i)
+            rule.weight = 10 + i
+            ruleset.add(rule)
+        self.assertEqual(ruleset.weight, 145)
+        rules = ruleset.rules
+
+        ruleset.remove(rules[3])
+        self.assertEqual(len(ruleset.rules), 9)
+        self.assertEqual(ruleset.weight, 132)
+
+        self.assertRaises(ValueError, ruleset.remove, CRule(7))
+        self.assertRaises(ValueError, ruleset.remove, rules[3])
+        self.assertRaises(TypeError, ruleset.remove, None)
+        ruleset.remove(rules[9])
+        self.assertEqual(len(ruleset.rules), 8)
+        self.assertEqual(ruleset.weight, 113)
+
+    def test_updateweights(self):
+        ruleset = CRuleSet(10, 20)
+        for i in range(10):
+            rule = CRule(i)
+            rule.weight = 15
+            ruleset.add(rule)
+
+        ruleset.rules[3].used = True
+        ruleset.rules[7].used = True
+        self.assertRaises(NotImplementedError, ruleset.update_weights, None)
+
+        ruleset.calculate_adjustment = lambda x: 3
+        ruleset.distribute_remainder = lambda x: None
+        ruleset.update_weights(None)
+        for x, rule in enumerate(ruleset.rules):
+            if x == 3 or x == 7:
+                self.assertTrue(rule.weight > 15)
+            else:
+                self.assertTrue(rule.weight < 15)
+        self.assertAlmostEqual(ruleset.weight, 150)
+
+    def test_updateweights_error(self):
+        class MyRuleSet(CRuleSet):
+            def calculate_adjustment(self, fitness):
+                return fitness * 2
+
+            def distribute_remainder(self, remainder):
+                raise KeyError(remainder)
+
+        ruleset = MyRuleSet(0, 20)
+        for i in range(4):
+            rule = CRule(i)
+            rule.weight = 10
+            rule.used = i == 0
+            ruleset.add(rule)
+        self.assertRaises(KeyError, ruleset.update_weights, 1)
+        self.assertRaises(TypeError, ruleset.update_weights, None)
+
+    def test_updateweights_threads(self):
+        rulesets = []
+        for t in range(4):
+            ruleset = CRuleSet(0, 100)
+            ruleset.calculate_adjustment = lambda x: x
+            ruleset.distribute_remainder = lambda x: None
+            for i in range(100):
+                rule = CRule(i)
+                rule.weight = 50
+                ruleset.add(rule)
+            rulesets.append(ruleset)
+
+        def update(ruleset):
+            rules = ruleset.rules
+            for i in range(50):
+                rules[i % 100].used = True
+                ruleset.update_weights(2)
+
+        threads = [threading.Thread(target=update, args=(r,))
+                   for r in rulesets]
+        for thread in threads:
+            thread.start()
+        for thread in threads:
+            thread.join()
+        for ruleset in rulesets:
+            self.assertAlmostEqual(ruleset.weight, 5000)
+
+    def test_weights(self):
+        ruleset = CRuleSet(10, 20)
+        for i in range(5):
+            ruleset.add(CRule(i))
+        self.assertEqual(ruleset.get_weights(), [10, 10, 10, 10, 10])
+
+        ruleset.set_weights([0, 12, 15.5, 20, 100])
+        self.assertEqual(ruleset.get_weights(), [10, 12, 15.5, 20, 20])
+        self.assertEqual([r.weight for r in ruleset.rules],
+                         [10, 12, 15.5, 20, 20])
+        self.assertEqual(ruleset.weight, 77.5)
+
+        self.assertRaises(ValueError, ruleset.set_weights, [10, 10])
+        self.assertRaises(ValueError, ruleset.set_weights, ["a"] * 5)
+        self.assertRaises(TypeError, ruleset.set_weights, None)
+        self.assertEqual(ruleset.weight, 77.5)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,162 @@
+import array
+import unittest
+from dynrules import CRule, CRuleSet, CRuleWeights
+
+
+@unittest.skipIf(CRuleWeights is None, "C++ extension not available")
+class CRuleWeightsTest(unittest.TestCase):
+    def _create_ruleset(self, count=10):
+        ruleset = CRuleSet(10, 20)
+        ruleset.calculate_adjustment = lambda x: x
+        ruleset.distribute_remainder = lambda x: None
+        for i in range(count):
+            rule = CRule(i)
+            rule.weight = 15
+            ruleset.add(rule)
+        return ruleset
+
+    def test_create(self):
+        ruleset = self._create_ruleset()
+        weights = CRuleWeights(ruleset)
+        self.assertTrue(weights.ruleset is ruleset)
+        self.assertEqual(len(weights), 10)
+        self.assertEqual(weights.weight, 150)
+        self.assertRaises(TypeError, CRuleWeights, None)
+
+    def test_weights(self):
+        weights = CRuleWeights(self._create_ruleset())
+        view = weights.weights
+        self.assertEqual(view.format, "d")
+        self.assertTrue(view.readonly)
+        self.assertEqual(view.tolist(), [15] * 10)
+
+        def setw():
+            view[0] = 12
+        self.assertRaises(TypeError, setw)
+
+        weights.set_weights(array.array("d", range(10, 30, 2)))
+        self.assertEqual(view.tolist(), [10, 12, 14, 16, 18, 20, 20, 20,
+                                         20, 20])
+        self.assertEqual(weights.weight, 170)
+        weights.set_weights([0] * 10)
+        self.assertEqual(weights.weight, 100)
+        self.assertRaises(ValueError, weights.set_weights, [1, 2])
+
+    def test_used(self):
+        weights = CRuleWeights(self._create_ruleset())
+        used = weights.used
+        self.assertEqual(used.format, "B")
+        self.assertFalse(used.readonly)
+        used[2] = 1
+        used[5] = 1
+        weights.update_weights(4)
+        view = weights.weights
+        for i in range(10):
+            if i == 2 or i == 5:
+                self.assertEqual(view[i], 19)
+            else:
+                self.assertEqual(view[i], 14)
+        self.assertEqual(used.tolist(), [0] * 10)
+        self.assertEqual(weights.weight, 150)
+
+    def test_storage(self):
+        ruleset = self._create_ruleset()
+        self.assertEqual(CRuleWeights(ruleset).weights.format, "d")
+        weights = CRuleWeights(ruleset, storage="float")
+        self.assertEqual(weights.weights.format, "f")
+        self.assertEqual(weights.weights.tolist(), [15] * 10)
+        weights = CRuleWeights(ruleset, storage="fixed")
+        view = weights.weights
+        self.assertEqual(view.format, "H")
+        self.assertEqual(view.itemsize, 2)
+        self.assertEqual(view.tolist(), [32768] * 10)
+        self.assertRaises(ValueError, CRuleWeights, ruleset, "half")
+
+    def test_fixed_small_updates(self):
+        # Updates smaller than a fixed-point step must not be rounded away,
+        # but accumulate like the exact weights.
+        ruleset = self._create_ruleset()
+        exact = CRuleWeights(ruleset)
+        fixed = CRuleWeights(ruleset, storage="fixed")
+        step = (20 - 10) / 65535.0
+        for i in range(3000):
+            for weights in (exact, fixed):
+                weights.used[0] = 1
+                weights.update_weights(step / 3)
+        expected = exact.weights.tolist()
+        actual = [10 + value * step for value in fixed.weights.tolist()]
+        self.assertAlmostEqual(expected[0], 15 + 1000 * step, places=9)
+        # The stochastic rounding deviates by a random walk of about 26
+        # steps after 3000 updates, rounding to the nearest step would
+        # deviate by 1000 steps for the first rule.
+        for i in range(10):
+            self.assertAlmostEqual(actual[i], expected[i], delta=100 * step)
+        self.assertAlmostEqual(fixed.weight, sum(actual), places=6)
+
+    def test_item_and_set_used(self):
+        weights = CRuleWeights(self._create_ruleset())
+        self.assertEqual(weights[3], 15)
+        self.assertRaises(IndexError, lambda: weights[10])
+        weights.set_used(3)
+        self.assertEqual(weights.used[3], 1)
+        weights.set_used(3, False)
+        self.assertEqual(weights.used[3], 0)
+        self.assertRaises(IndexError, weights.set_used, 10)
+
+    def test_sparse(self):
+        weights = CRuleWeights(self._create_ruleset(), storage="sparse")
+        self.assertEqual(weights.weight, 150)
+        self.assertRaises(BufferError, lambda: weights.weights)
+        self.assertRaises(BufferError, lambda: weights.used)
+        weights.set_used(2)
+        weights.set_used(5)
+        weights.update_weights(4)
+        self.assertEqual([weights[i] for i in range(10)],
+                         [14, 14, 19, 14, 14, 19, 14, 14, 14, 14])
+        self.assertEqual(weights.weight, 150)
+
+    def test_sparse_bounds(self):
+        # The unused rules keep their weights in a shared offset, which
+        # must not drift away, once their weights hit the minimum or
+        # maximum weight.
+        def create():
+            ruleset = CRuleSet(0, 30)
+            ruleset.calculate_adjustment = lambda x: x
+            ruleset.distribute_remainder = lambda x: None
+            for i in range(10):
+                rule = CRule(i)
+                rule.weight = 10
+                ruleset.add(rule)
+            return ruleset
+
+        expected = create()
+        sparse = CRuleWeights(create(), storage="sparse")
+        for step in range(200):
+            fitness = 6 if (step // 20) % 2 == 0 else -6
+            for i in (0, 1):
+                expected.rules[i].used = True
+                sparse.set_used(i)
+            expected.update_weights(fitness)
+            sparse.update_weights(fitness)
+            for i in range(10):
+                self.assertAlmostEqual(sparse[i], expected.rules[i].weight,
+                                       places=4)
+
+    def test_reset(self):
+        ruleset = self._create_ruleset()
+        weights = CRuleWeights(ruleset)
+        weights.set_weights([10] * 10)
+        ruleset.add(CRule(10))
+        view = weights.weights
+        self.assertRaises(BufferError, weights.reset)
+        view.release()
+        weights.reset()
+        self.assertEqual(len(weights), 11)
+        self.assertEqual(weights.weight, 160)
+        ruleset.clear()
+        weights.reset()
+        self.assertEqual(weights.weights.tolist(), [])
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -0,0 +1,53 @@
+import unittest
+from dynrules import CRuleWeights
+from dynrules.test.util.differential import Scenario, get_drivers, compare
+
+
+class DifferentialTest(unittest.TestCase):
+    def _compare(self, scenario):
+        drivers = get_drivers(scenario)
+        if CRuleWeights is None:
+            self.assertEqual(len(drivers), 1)
+        self.assertEqual(compare(scenario, drivers), None)
+        return drivers
+
+    def test_scenario(self):
+        scenario = Scenario(1, count=20, rounds=10)
+        self.assertEqual(len(scenario.weights), 20)
+        self.assertEqual(len(scenario.steps), 10)
+        self.assertEqual(scenario.steps, Scenario(1, 20, 10).steps)
+        self.assertNotEqual(scenario.steps, Scenario(2, 20, 10).steps)
+        self.assertRaises(ValueError, Scenario, 1, 1)
+
+    @unittest.skipIf(CRuleWeights is None, "C++ extension not available")
+    def test_all_drivers(self):
+        for seed in range(5):
+            drivers = self._compare(Scenario(seed, count=50, rounds=50,
+                                             distribute=False))
+            self.assertEqual([d.name for d in drivers],
+                             ["RuleSet", "CRuleSet", "CRuleWeights"])
+
+    def test_distribute(self):
+        for seed in range(5):
+            self._compare(Scenario(seed, count=50, rounds=50, usedratio=0.3))
+
+    def test_churn(self):
+        for seed in range(5):
+            self._compare(Scenario(seed, count=30, rounds=50, churn=0.5))
+
+    def test_narrow_range(self):
+        # Most updates hit the boundaries, which produces remainders and
+        # weights below 0 before limiting them.
+        for seed in range(5):
+            self._compare(Scenario(seed, count=10, rounds=100, minweight=0,
+                                   maxweight=1, usedratio=0.5))
+
+    def test_mismatch(self):
+        scenario = Scenario(3, count=10, rounds=5)
+        drivers = get_drivers(scenario)
+        drivers.append(get_drivers(Scenario(4, count=10, rounds=5))[0])
+        self.assertNotEqual(compare(scenario, drivers), None)
+
+
+if __name__ == "__main__":
+    unittest.main()
@@ -33,6 +33,24 @@ class LearnSystemTest(unittest.TestCase):
         lsystem.maxscriptsize = 10
         self.assertEqual(lsystem.maxscriptsize, 10)
 
+    def test_create_rules_outdated_weight(self):
+        ruleset = RuleSet(0, 20)
+        for i in range(3):
+            rule = Rule(i)
+            rule.weight = 10
+            rule.code = "rule%d\n" % i
+            ruleset.add(rule)
+        lsystem = LearnSystem(ruleset)
+
+        # The total weight of the RuleSet is not updated by the rules.
+        ruleset.rules[0].weight = 0
+        ruleset.rules[1].weight = 0
+        rules = lsystem.create_rules(10).splitlines()
+        self.assertEqual(rules, ["rule2"] * 10)
+        ruleset.rules[2].weight = 0
+        rules = lsystem.create_rules(10).splitlines()
+        self.assertEqual(rules, ["rule0"] * 10)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -123,6 +123,23 @@ class RuleSetTest(unittest.TestCase):
             else:
                 self.assertTrue(rule.weight < 15)
 
+    def test_weights(self):
+        ruleset = RuleSet(10, 20)
+        for i in range(5):
+            ruleset.add(Rule(i))
+        self.assertEqual(ruleset.get_weights(), [10, 10, 10, 10, 10])
+
+        ruleset.set_weights([0, 12, 15.5, 20, 100])
+        self.assertEqual(ruleset.get_weights(), [10, 12, 15.5, 20, 20])
+        self.assertEqual([r.weight for r in ruleset.rules],
+                         [10, 12, 15.5, 20, 20])
+        self.assertEqual(ruleset.weight, 77.5)
+
+        self.assertRaises(ValueError, ruleset.set_weights, [10, 10])
+        self.assertRaises(ValueError, ruleset.set_weights, ["a"] * 5)
+        self.assertRaises(TypeError, ruleset.set_weights, None)
+        self.assertEqual(ruleset.weight, 77.5)
+
 
 if __name__ == "__main__":
     unittest.main()
@@ -0,0 +1,254 @@
+"""Differential comparison of the Python and C++ implementations.
+
+Drives the pure Python RuleSet and the C++ based CRuleSet and CRuleWeights
+with the same seeded rule sets and fitness sequences, checks that they
+produce identical weights after each weight update and measures their
+throughput.
+
+Run it as script to print a throughput report:
+
+    python -m dynrules.test.util.differential [options]
+"""
+import optparse
+import random
+import sys
+import time
+
+from dynrules import Rule, RuleSet, CRule, CRuleSet, CRuleWeights
+
+__all__ = ["Scenario", "RuleSetDriver", "RuleWeightsDriver", "get_drivers",
+           "compare", "measure"]
+
+
+class Scenario(object):
+    """A seeded sequence of weight updates.
+
+    Each step consists of the indices of the used rules, the fitness to
+    pass to update_weights() and an optional replacement, which removes
+    the rule at a specific index and adds a new rule with a specific
+    weight before the update.
+
+    If distribute is True, the remainder of an update will be distributed
+    evenly over all rules.
+    """
+    def __init__(self, seed, count=100, rounds=100, minweight=0,
+                 maxweight=100, usedratio=0.1, churn=0.0, distribute=True):
+        """Creates a new Scenario."""
+        if count < 2:
+            raise ValueError("count must be greater than 1")
+        rnd = random.Random(seed)
+        self.seed = seed
+        self.minweight = minweight
+        self.maxweight = maxweight
+        self.churn = churn
+        self.distribute = distribute
+        self.weights = [rnd.uniform(minweight, maxweight)
+                        for i in range(count)]
+        self.steps = []
+
+        usedcount = min(max(1, int(count * usedratio)), count - 1)
+        for i in range(rounds):
+            used = sorted(rnd.sample(range(count), usedcount))
+            fitness = rnd.uniform(-1, 1)
+            replace = None
+            if churn > 0 and rnd.random() < churn:
+                replace = (rnd.randrange(count),
+                           rnd.uniform(minweight, maxweight))
+            self.steps.append((used, fitness, replace))
+
+    def adjustment(self, fitness):
+        """Calculates the adjustment for the used rules."""
+        return fitness * (self.maxweight - self.minweight) * 0.1
+
+
+class RuleSetDriver(object):
+    """Drives a RuleSet or CRuleSet through a Scenario."""
+    def __init__(self, name, ruletype, rulesettype, scenario):
+        """Creates a new RuleSetDriver."""
+        self.name = name
+        self._ruletype = ruletype
+        self._nextid = len(scenario.weights)
+        self.ruleset = rulesettype(scenario.minweight, scenario.maxweight)
+        self.ruleset.calculate_adjustment = scenario.adjustment
+        if scenario.distribute:
+            self.ruleset.distribute_remainder = self._distribute
+        else:
+            self.ruleset.distribute_remainder = lambda remainder: None
+        for rid, weight in enumerate(scenario.weights):
+            self._add(rid, weight)
+
+    def _add(self, rid, weight):
+        rule = self._ruletype(rid)
+        rule.weight = weight
+        self.ruleset.add(rule)
+
+    def _distribute(self, remainder):
+        ruleset = self.ruleset
+        minweight = ruleset.minweight
+        maxweight = ruleset.maxweight
+        rules = ruleset.rules
+        share = remainder / len(rules)
+        for rule in rules:
+            weight = rule.weight + share
+            if weight < minweight:
+                weight = minweight
+            elif weight > maxweight:
+                weight = maxweight
+            rule.weight = weight
+
+    def step(self, used, fitness, replace):
+        """Executes a single step of a Scenario."""
+        ruleset = self.ruleset
+        if replace is not None:
+            index, weight = replace
+            ruleset.remove(ruleset.rules[index])
+            self._add(self._nextid, weight)
+            self._nextid += 1
+        rules = ruleset.rules
+        for index in used:
+            rules[index].used = True
+        ruleset.update_weights(fitness)
+        # RuleSet does not reset the usage states on its own.
+        for index in used:
+            rules[index].used = False
+
+    def get_weights(self):
+        """Gets the current weights."""
+        return self.ruleset.get_weights()
+
+    def get_weight(self):
+        """Gets the current total weight."""
+        return self.ruleset.weight
+
+
+class RuleWeightsDriver(object):
+    """Drives a CRuleWeights through a Scenario.
+
+    CRuleWeights neither supports distributing the remainder nor changing
+    the rules, so only Scenarios without those can be used.
+    """
+    def __init__(self, name, scenario):
+        """Creates a new RuleWeightsDriver."""
+        if scenario.distribute or scenario.churn > 0:
+            raise ValueError("scenario must not distribute or replace rules")
+        self.name = name
+        ruleset = CRuleSet(scenario.minweight, scenario.maxweight)
+        ruleset.calculate_adjustment = scenario.adjustment
+        for rid, weight in enumerate(scenario.weights):
+            rule = CRule(rid)
+            rule.weight = weight
+            ruleset.add(rule)
+        self.weights = CRuleWeights(ruleset)
+        self._used = self.weights.used
+
+    def step(self, used, fitness, replace):
+        """Executes a single step of a Scenario."""
+        flags = self._used
+        for index in used:
+            flags[index] = 1
+        self.weights.update_weights(fitness)
+
+    def get_weights(self):
+        """Gets the current weights."""
+        return self.weights.weights.tolist()
+
+    def get_weight(self):
+        """Gets the current total weight."""
+        return self.weights.weight
+
+
+def get_drivers(scenario):
+    """Creates all drivers applicable to the Scenario.
+
+    The first driver uses the pure Python implementation and serves as
+    reference. If the C++ extension is not available, only the reference
+    driver is returned.
+    """
+    drivers = [RuleSetDriver("RuleSet", Rule, RuleSet, scenario)]
+    if CRuleWeights is None:
+        return drivers
+    drivers.append(RuleSetDriver("CRuleSet", CRule, CRuleSet, scenario))
+    if not scenario.distribute and scenario.churn == 0:
+        drivers.append(RuleWeightsDriver("CRuleWeights", scenario))
+    return drivers
+
+
+def compare(scenario, drivers):
+    """Runs the Scenario on all drivers and compares their weights.
+
+    The weights and total weight of each driver are compared with the
+    ones of the first driver after each step. Returns None, if all
+    weights are identical, or a description of the first difference.
+    """
+    reference = drivers[0]
+    for num, step in enumerate(scenario.steps):
+        for driver in drivers:
+            driver.step(*step)
+        expected = reference.get_weights()
+        total = reference.get_weight()
+        for driver in drivers[1:]:
+            weights = driver.get_weights()
+            if len(weights) != len(expected):
+                return "step %d: %s has %d weights, %s has %d" % \
+                    (num, driver.name, len(weights), reference.name,
+                     len(expected))
+            for index, (weight, exp) in enumerate(zip(weights, expected)):
+                if weight != exp:
+                    return "step %d: %s weight %d is %r, %s has %r" % \
+                        (num, driver.name, index, weight, reference.name, exp)
+            if driver.get_weight() != total:
+                return "step %d: %s total weight is %r, %s has %r" % \
+                    (num, driver.name, driver.get_weight(), reference.name,
+                     total)
+    return None
+
+
+def measure(scenario, driver):
+    """Runs the Scenario on the driver and returns the steps per second."""
+    steps = scenario.steps
+    start = time.time()
+    for step in steps:
+        driver.step(*step)
+    elapsed = time.time() - start
+    if elapsed <= 0:
+        return float("inf")
+    return len(steps) / elapsed
+
+
+def run():
+    """Compares the implementations and prints a throughput report."""
+    parser = optparse.OptionParser()
+    parser.add_option("-n", "--rules", type="int", default=1000,
+                      help="amount of rules (default: 1000)")
+    parser.add_option("-r", "--rounds", type="int", default=1000,
+                      help="amount of weight updates (default: 1000)")
+    parser.add_option("-s", "--seed", type="int", default=0,
+                      help="seed for the scenario (default: 0)")
+    parser.add_option("-c", "--churn", type="float", default=0.0,
+                      help="probability to replace a rule per update "
+                      "(default: 0)")
+    parser.add_option("-d", "--distribute", action="store_true",
+                      default=False,
+                      help="distribute the remainder of each update")
+    options, args = parser.parse_args()
+
+    scenario = Scenario(options.seed, options.rules, options.rounds,
+                        churn=options.churn, distribute=options.distribute)
+    result = compare(scenario, get_drivers(scenario))
+    if result is not None:
+        sys.stdout.write("MISMATCH: %s\n" % result)
+        return 1
+    sys.stdout.write("All implementations produced identical weights.\n")
+
+    reference = None
+    for driver in get_drivers(scenario):
+        rate = measure(scenario, driver)
+        if reference is None:
+            reference = rate
+        sys.stdout.write("%-14s %12.1f updates/s %8.2fx\n" %
+                         (driver.name, rate, rate / reference))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(run())
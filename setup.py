@@ -1,6 +1,55 @@
 #!/usr/bin/env python
-from distutils.core import setup
+from distutils.core import setup, Extension
+from distutils.command.build_ext import build_ext
+from distutils.errors import CCompilerError, DistutilsError
+import glob
 import os
+import sys
+
+
+class optional_build_ext(build_ext):
+    """Builds the C++ extension, if possible.
+
+    If the extension can't be built, a warning is printed and the pure
+    Python implementation is used.
+    """
+    def run(self):
+        try:
+            build_ext.run(self)
+        except (CCompilerError, DistutilsError):
+            self._warn()
+
+    def build_extension(self, ext):
+        try:
+            build_ext.build_extension(self, ext)
+        except (CCompilerError, DistutilsError):
+            self._warn()
+
+    def _warn(self):
+        sys.stderr.write("WARNING: The C++ extension could not be built. "
+                         "The pure Python implementation will be used.\n")
+
+
+def get_extensions():
+    """Gets the optional C++ extension, which wraps the C++ framework."""
+    if "--without-cpp" in sys.argv:
+        sys.argv.remove("--without-cpp")
+        return []
+    srcdir = os.path.join("cplusplus", "src")
+    sources = [os.path.join("dynrules", "_dynrules.cpp")] + \
+        sorted(glob.glob(os.path.join(srcdir, "*.cpp")))
+    args = []
+    libraries = []
+    if os.name == "posix":
+        # RuleStream uses std::thread
+        args = ["-pthread"]
+    if sys.platform.startswith("linux"):
+        # SharedWeights uses shm_open()
+        libraries = ["rt"]
+    return [Extension("dynrules._dynrules", sources=sources,
+                      include_dirs=[srcdir], language="c++",
+                      libraries=libraries, extra_compile_args=args,
+                      extra_link_args=args)]
 
 if __name__ == "__main__":
     fname = os.path.join(os.path.dirname(os.path.abspath(__file__)), "README.txt")
@@ -23,6 +72,8 @@ if __name__ == "__main__":
                      "dynrules.test.util",
                      ],
         "package_dir": {"dynrules.examples" : "examples"},
+        "ext_modules": get_extensions(),
+        "cmdclass": {"build_ext": optional_build_ext},
         "classifiers": [
             "Development Status :: 5 - Production/Stable",
             "Intended Audience :: Developers",